@@ -0,0 +1,101 @@
+#include "benchmark/benchmark.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/CommandLine.h"
+
+using namespace llvm;
+
+// Builds a module with Functions functions that each compute a chain of
+// Length arithmetic steps. Every step leaves something for instcombine to fold
+// and goes through a stack slot that SROA promotes, so the first instcombine
+// of the pipeline does real work and the later ones mostly find the functions
+// unchanged.
+static std::unique_ptr<Module> makeArithmeticChains(LLVMContext &Ctx,
+                                                    unsigned Functions,
+                                                    unsigned Length) {
+  auto M = make_unique<Module>("arithmetic-chains", Ctx);
+  Type *I32 = Type::getInt32Ty(Ctx);
+  FunctionType *FTy = FunctionType::get(I32, {I32, I32}, false);
+  IRBuilder<> B(Ctx);
+  for (unsigned FI = 0; FI < Functions; ++FI) {
+    Function *F = Function::Create(FTy, GlobalValue::ExternalLinkage,
+                                   "chain" + Twine(FI), M.get());
+    Value *X = &*F->arg_begin();
+    Value *Y = &*std::next(F->arg_begin());
+    B.SetInsertPoint(BasicBlock::Create(Ctx, "entry", F));
+    Value *Slot = B.CreateAlloca(I32);
+    Value *V = X;
+    for (unsigned S = 0; S < Length; ++S) {
+      B.CreateStore(V, Slot);
+      V = B.CreateLoad(I32, Slot);
+      V = B.CreateAdd(B.CreateAdd(V, B.getInt32(S)), B.getInt32(1));
+      V = B.CreateMul(V, Y);
+      V = B.CreateXor(V, B.CreateLShr(V, B.getInt32(3)));
+      V = B.CreateSub(B.CreateOr(V, B.getInt32(0)), X);
+    }
+    B.CreateRet(V);
+  }
+  return M;
+}
+
+static void setIncrementalInstCombine(bool Enabled) {
+  auto *Opt = static_cast<cl::opt<bool> *>(
+      cl::getRegisteredOptions()["instcombine-incremental"]);
+  Opt->setValue(Enabled);
+}
+
+// Runs a function simplification pipeline with three instcombines and reports
+// how many instructions instcombine visited, with and without incremental
+// instcombine. The count comes from the statistics, so it is only reported by
+// builds with assertions or LLVM_FORCE_ENABLE_STATS.
+static void BM_InstCombinePipeline(benchmark::State &State) {
+  setIncrementalInstCombine(State.range(0));
+  EnableStatistics(/*PrintOnExit=*/false);
+  LLVMContext Ctx;
+  uint64_t Visited = 0;
+  for (auto _ : State) {
+    State.PauseTiming();
+    std::unique_ptr<Module> M =
+        makeArithmeticChains(Ctx, State.range(1), State.range(2));
+    PassBuilder PB;
+    LoopAnalysisManager LAM;
+    FunctionAnalysisManager FAM;
+    CGSCCAnalysisManager CGAM;
+    ModuleAnalysisManager MAM;
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+    ModulePassManager MPM;
+    if (auto Err = PB.parsePassPipeline(
+            MPM, "function(instcombine,simplify-cfg,sroa,early-cse,"
+                 "instcombine,reassociate,instcombine)"))
+      report_fatal_error(toString(std::move(Err)));
+    ResetStatistics();
+    State.ResumeTiming();
+
+    MPM.run(*M, MAM);
+
+    State.PauseTiming();
+    for (const auto &Stat : GetStatistics())
+      if (Stat.first == "NumVisited")
+        Visited += Stat.second;
+    State.ResumeTiming();
+  }
+  State.counters["visited"] = double(Visited) / State.iterations();
+  setIncrementalInstCombine(false);
+}
+BENCHMARK(BM_InstCombinePipeline)
+    ->ArgNames({"incremental", "functions", "length"})
+    ->Args({0, 64, 32})
+    ->Args({1, 64, 32})
+    ->Args({0, 16, 256})
+    ->Args({1, 16, 256})
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
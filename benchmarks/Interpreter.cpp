@@ -0,0 +1,170 @@
+#include "benchmark/benchmark.h"
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/GenericValue.h"
+#include "llvm/ExecutionEngine/Interpreter.h"
+#include "llvm/ExecutionEngine/MCJIT.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/TargetSelect.h"
+
+using namespace llvm;
+
+// Builds i64 @sumsq(i64 %n), which adds up the squares below n in a loop.
+static Function *addSumOfSquares(Module &M) {
+  LLVMContext &Ctx = M.getContext();
+  Type *I64 = Type::getInt64Ty(Ctx);
+  Function *F = Function::Create(FunctionType::get(I64, {I64}, false),
+                                 GlobalValue::ExternalLinkage, "sumsq", &M);
+  BasicBlock *Entry = BasicBlock::Create(Ctx, "entry", F);
+  BasicBlock *Loop = BasicBlock::Create(Ctx, "loop", F);
+  BasicBlock *Exit = BasicBlock::Create(Ctx, "exit", F);
+  IRBuilder<> B(Entry);
+  B.CreateBr(Loop);
+
+  B.SetInsertPoint(Loop);
+  PHINode *I = B.CreatePHI(I64, 2);
+  PHINode *Acc = B.CreatePHI(I64, 2);
+  Value *Next = B.CreateAdd(I, B.getInt64(1));
+  Value *Sum = B.CreateAdd(Acc, B.CreateMul(I, I));
+  B.CreateCondBr(B.CreateICmpULT(Next, &*F->arg_begin()), Loop, Exit);
+  I->addIncoming(B.getInt64(0), Entry);
+  I->addIncoming(Next, Loop);
+  Acc->addIncoming(B.getInt64(0), Entry);
+  Acc->addIncoming(Sum, Loop);
+
+  B.SetInsertPoint(Exit);
+  B.CreateRet(Sum);
+  return F;
+}
+
+// Builds i32 @fib(i32 %n), the doubly recursive Fibonacci function.
+static Function *addFib(Module &M) {
+  LLVMContext &Ctx = M.getContext();
+  Type *I32 = Type::getInt32Ty(Ctx);
+  Function *F = Function::Create(FunctionType::get(I32, {I32}, false),
+                                 GlobalValue::ExternalLinkage, "fib", &M);
+  Value *N = &*F->arg_begin();
+  BasicBlock *Entry = BasicBlock::Create(Ctx, "entry", F);
+  BasicBlock *Recurse = BasicBlock::Create(Ctx, "recurse", F);
+  BasicBlock *Done = BasicBlock::Create(Ctx, "done", F);
+  IRBuilder<> B(Entry);
+  B.CreateCondBr(B.CreateICmpSLT(N, B.getInt32(2)), Done, Recurse);
+
+  B.SetInsertPoint(Recurse);
+  Value *F1 = B.CreateCall(F, {B.CreateSub(N, B.getInt32(1))});
+  Value *F2 = B.CreateCall(F, {B.CreateSub(N, B.getInt32(2))});
+  B.CreateRet(B.CreateAdd(F1, F2));
+
+  B.SetInsertPoint(Done);
+  B.CreateRet(N);
+  return F;
+}
+
+// Builds i64 @expr(i64 %x), a one-shot expression of the kind that is cheaper
+// to interpret than to compile.
+static Function *addExpr(Module &M) {
+  LLVMContext &Ctx = M.getContext();
+  Type *I64 = Type::getInt64Ty(Ctx);
+  Function *F = Function::Create(FunctionType::get(I64, {I64}, false),
+                                 GlobalValue::ExternalLinkage, "expr", &M);
+  Value *X = &*F->arg_begin();
+  IRBuilder<> B(BasicBlock::Create(Ctx, "entry", F));
+  Value *V = B.CreateAdd(B.CreateMul(X, B.getInt64(3)), B.getInt64(7));
+  B.CreateRet(B.CreateXor(V, B.CreateLShr(X, B.getInt64(2))));
+  return F;
+}
+
+static void setBytecode(bool Enable) {
+  auto &Opts = cl::getRegisteredOptions();
+  *static_cast<cl::opt<bool> *>(Opts["interpreter-bytecode"]) = Enable;
+}
+
+static std::unique_ptr<ExecutionEngine> createEngine(std::unique_ptr<Module> M,
+                                                     EngineKind::Kind Kind) {
+  std::string Err;
+  std::unique_ptr<ExecutionEngine> EE(
+      EngineBuilder(std::move(M)).setEngineKind(Kind).setErrorStr(&Err)
+          .create());
+  if (!EE)
+    report_fatal_error(Err);
+  return EE;
+}
+
+static GenericValue intArg(unsigned Bits, uint64_t Val) {
+  GenericValue GV;
+  GV.IntVal = APInt(Bits, Val);
+  return GV;
+}
+
+// Runs the sum of squares below N through the interpreter, with bytecode or
+// without.
+static void BM_InterpreterLoop(benchmark::State &State) {
+  setBytecode(State.range(0));
+  LLVMContext Ctx;
+  auto M = make_unique<Module>("loop", Ctx);
+  Function *F = addSumOfSquares(*M);
+  auto EE = createEngine(std::move(M), EngineKind::Interpreter);
+  GenericValue N = intArg(64, State.range(1));
+
+  for (auto _ : State)
+    benchmark::DoNotOptimize(EE->runFunction(F, N).IntVal.getZExtValue());
+  State.SetItemsProcessed(State.iterations() * State.range(1));
+}
+BENCHMARK(BM_InterpreterLoop)
+    ->Args({0, 1000})
+    ->Args({1, 1000})
+    ->Unit(benchmark::kMicrosecond);
+
+// Runs fib(N) through the interpreter, with bytecode or without.
+static void BM_InterpreterFib(benchmark::State &State) {
+  setBytecode(State.range(0));
+  LLVMContext Ctx;
+  auto M = make_unique<Module>("fib", Ctx);
+  Function *F = addFib(*M);
+  auto EE = createEngine(std::move(M), EngineKind::Interpreter);
+  GenericValue N = intArg(32, State.range(1));
+
+  for (auto _ : State)
+    benchmark::DoNotOptimize(EE->runFunction(F, N).IntVal.getZExtValue());
+}
+BENCHMARK(BM_InterpreterFib)
+    ->Args({0, 15})
+    ->Args({1, 15})
+    ->Unit(benchmark::kMicrosecond);
+
+// Latency to the first result of a one-shot expression: build the module,
+// create the engine, and run the expression once.  The interpreter is measured
+// with bytecode and without; MCJIT pays for code generation instead.
+static void BM_FirstResultInterpreter(benchmark::State &State) {
+  setBytecode(State.range(0));
+  LLVMContext Ctx;
+  for (auto _ : State) {
+    auto M = make_unique<Module>("expr", Ctx);
+    Function *F = addExpr(*M);
+    auto EE = createEngine(std::move(M), EngineKind::Interpreter);
+    benchmark::DoNotOptimize(
+        EE->runFunction(F, intArg(64, 42)).IntVal.getZExtValue());
+  }
+}
+BENCHMARK(BM_FirstResultInterpreter)
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMicrosecond);
+
+static void BM_FirstResultMCJIT(benchmark::State &State) {
+  InitializeNativeTarget();
+  InitializeNativeTargetAsmPrinter();
+  LLVMContext Ctx;
+  for (auto _ : State) {
+    auto M = make_unique<Module>("expr", Ctx);
+    addExpr(*M);
+    auto EE = createEngine(std::move(M), EngineKind::JIT);
+    auto *Expr = (uint64_t(*)(uint64_t))EE->getFunctionAddress("expr");
+    benchmark::DoNotOptimize(Expr(42));
+  }
+}
+BENCHMARK(BM_FirstResultMCJIT)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
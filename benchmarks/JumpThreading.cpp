@@ -0,0 +1,76 @@
+#include "benchmark/benchmark.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Transforms/Scalar/JumpThreading.h"
+
+using namespace llvm;
+
+// Builds a function that dispatches on its argument Stages times in a row.
+// Every case of a stage ends up in a join block that switches on the argument
+// again, so jump threading threads each case to the matching case of the next
+// stage, querying LazyValueInfo and erasing blocks all along the way.
+static std::unique_ptr<Module> makeSwitchChain(LLVMContext &Ctx,
+                                               unsigned Stages,
+                                               unsigned Cases) {
+  auto M = make_unique<Module>("switch-chain", Ctx);
+  Type *I32 = Type::getInt32Ty(Ctx);
+  Type *Void = Type::getVoidTy(Ctx);
+  FunctionCallee Sink = M->getOrInsertFunction("sink", Void, I32);
+  Function *F = Function::Create(FunctionType::get(Void, {I32}, false),
+                                 GlobalValue::ExternalLinkage, "dispatch",
+                                 M.get());
+  Value *X = &*F->arg_begin();
+
+  IRBuilder<> B(Ctx);
+  BasicBlock *Dispatch = BasicBlock::Create(Ctx, "entry", F);
+  for (unsigned S = 0; S < Stages; ++S) {
+    BasicBlock *Join = BasicBlock::Create(Ctx, "join", F);
+    B.SetInsertPoint(Dispatch);
+    SwitchInst *SI = B.CreateSwitch(X, Join, Cases);
+    for (unsigned C = 0; C < Cases; ++C) {
+      BasicBlock *Case = BasicBlock::Create(Ctx, "case", F);
+      SI->addCase(B.getInt32(C), Case);
+      B.SetInsertPoint(Case);
+      B.CreateCall(Sink, B.getInt32(S * Cases + C));
+      B.CreateBr(Join);
+    }
+    Dispatch = Join;
+  }
+  B.SetInsertPoint(Dispatch);
+  B.CreateRetVoid();
+  return M;
+}
+
+static void BM_JumpThreadingSwitchChain(benchmark::State &State) {
+  LLVMContext Ctx;
+  for (auto _ : State) {
+    State.PauseTiming();
+    std::unique_ptr<Module> M =
+        makeSwitchChain(Ctx, State.range(0), State.range(1));
+    PassBuilder PB;
+    LoopAnalysisManager LAM;
+    FunctionAnalysisManager FAM;
+    CGSCCAnalysisManager CGAM;
+    ModuleAnalysisManager MAM;
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+    FunctionPassManager FPM;
+    FPM.addPass(JumpThreadingPass());
+    State.ResumeTiming();
+
+    FPM.run(*M->getFunction("dispatch"), FAM);
+  }
+}
+BENCHMARK(BM_JumpThreadingSwitchChain)
+    ->Args({16, 16})
+    ->Args({64, 32})
+    ->Args({256, 32})
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,137 @@
+#include "benchmark/benchmark.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/FDRawByteChannel.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/NullResolver.h"
+#include "llvm/ExecutionEngine/Orc/OrcABISupport.h"
+#include "llvm/ExecutionEngine/Orc/OrcRemoteTargetClient.h"
+#include "llvm/ExecutionEngine/Orc/OrcRemoteTargetServer.h"
+#include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/TargetSelect.h"
+
+#include <sys/wait.h>
+
+using namespace llvm;
+using namespace llvm::orc;
+
+// Builds a module of Functions functions, each of which reads a global of its
+// own and calls the previous one. With function and data sections every
+// function and global is a section of its own, so loading the object remotely
+// writes one section per function and global.
+static std::unique_ptr<Module> makeCallChain(LLVMContext &Ctx,
+                                             unsigned Functions) {
+  auto M = make_unique<Module>("call-chain", Ctx);
+  Type *I32 = Type::getInt32Ty(Ctx);
+  FunctionType *FT = FunctionType::get(I32, {I32}, false);
+  IRBuilder<> B(Ctx);
+  Function *Prev = nullptr;
+  for (unsigned I = 0; I < Functions; ++I) {
+    auto *G = new GlobalVariable(*M, I32, false, GlobalValue::ExternalLinkage,
+                                 B.getInt32(I), "g" + Twine(I));
+    Function *F = Function::Create(FT, GlobalValue::ExternalLinkage,
+                                   "f" + Twine(I), M.get());
+    B.SetInsertPoint(BasicBlock::Create(Ctx, "entry", F));
+    Value *V = B.CreateAdd(&*F->arg_begin(), B.CreateLoad(G));
+    if (Prev)
+      V = B.CreateCall(Prev, {V});
+    B.CreateRet(V);
+    Prev = F;
+  }
+  return M;
+}
+
+static std::unique_ptr<MemoryBuffer> compileCallChain(unsigned Functions) {
+  InitializeNativeTarget();
+  InitializeNativeTargetAsmPrinter();
+  auto TM = cantFail(cantFail(JITTargetMachineBuilder::detectHost())
+                         .createTargetMachine());
+  TM->Options.FunctionSections = true;
+  TM->Options.DataSections = true;
+  LLVMContext Ctx;
+  auto M = makeCallChain(Ctx, Functions);
+  M->setDataLayout(TM->createDataLayout());
+  return SimpleCompiler(*TM)(*M);
+}
+
+struct ChildProcess {
+  pid_t PID;
+  int InFD, OutFD;
+};
+
+// Forks a child that serves JIT requests over a pair of pipes: the same
+// transport lli -remote-mcjit uses to talk to lli-child-target.
+static ChildProcess launchChild() {
+  int ToChild[2], FromChild[2];
+  if (pipe(ToChild) || pipe(FromChild))
+    report_fatal_error("Could not create pipes");
+
+  pid_t PID = fork();
+  if (PID == 0) {
+    close(ToChild[1]);
+    close(FromChild[0]);
+    rpc::FDRawByteChannel Channel(ToChild[0], FromChild[1]);
+    remote::OrcRemoteTargetServer<rpc::FDRawByteChannel, OrcGenericABI> Server(
+        Channel,
+        [](const std::string &Name) {
+          return RTDyldMemoryManager::getSymbolAddressInProcess(Name);
+        },
+        [](uint8_t *Addr, uint32_t Size) {
+          RTDyldMemoryManager::registerEHFramesInProcess(Addr, Size);
+        },
+        [](uint8_t *Addr, uint32_t Size) {
+          RTDyldMemoryManager::deregisterEHFramesInProcess(Addr, Size);
+        });
+    while (!Server.receivedTerminate())
+      if (Server.handleOne())
+        _exit(1);
+    _exit(0);
+  }
+
+  close(ToChild[0]);
+  close(FromChild[1]);
+  return {PID, FromChild[0], ToChild[1]};
+}
+
+// Loads and finalizes the object in the child once per iteration, with the
+// memory manager calls batched or sent one at a time.
+static void BM_RemoteJITLoadObject(benchmark::State &State) {
+  auto Obj = compileCallChain(State.range(0));
+  auto ObjFile = cantFail(
+      object::ObjectFile::createObjectFile(Obj->getMemBufferRef()));
+
+  ChildProcess Child = launchChild();
+  rpc::FDRawByteChannel Channel(Child.InFD, Child.OutFD);
+  ExecutionSession ES;
+  auto Client = cantFail(remote::OrcRemoteTargetClient::Create(Channel, ES));
+  Client->setBatchMemoryCalls(State.range(1));
+  NullLegacyResolver Resolver;
+
+  for (auto _ : State) {
+    auto MemMgr = cantFail(Client->createRemoteMemoryManager());
+    RuntimeDyld Dyld(*MemMgr, Resolver);
+    Dyld.loadObject(*ObjFile);
+    Dyld.finalizeWithMemoryManagerLocking();
+    if (Dyld.hasError())
+      report_fatal_error(Dyld.getErrorString());
+    Dyld.deregisterEHFrames();
+  }
+  State.SetBytesProcessed(State.iterations() * Obj->getBufferSize());
+
+  cantFail(Client->terminateSession());
+  Client.reset();
+  waitpid(Child.PID, nullptr, 0);
+  close(Child.InFD);
+  close(Child.OutFD);
+}
+BENCHMARK(BM_RemoteJITLoadObject)
+    ->Args({16, 0})
+    ->Args({16, 1})
+    ->Args({256, 0})
+    ->Args({256, 1})
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,62 @@
+#include "benchmark/benchmark.h"
+#include "llvm/MC/StringTableBuilder.h"
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+// Generates Itanium-mangled looking names: nested names with a few common
+// namespaces and classes, and parameter lists drawn from a small vocabulary,
+// so that many names share long suffixes like real C++ symbol tables do.
+static std::vector<std::string> makeMangledNames(size_t Count) {
+  static const char *Namespaces[] = {"4llvm", "3std", "5clang", "3lld",
+                                     "6detail"};
+  static const char *Classes[] = {"11SmallVector", "8DenseMap", "9StringRef",
+                                  "6Module", "8Function", "10BasicBlock",
+                                  "11Instruction", "5Value"};
+  static const char *Params[] = {"v", "i", "j", "m", "b", "PKc",
+                                 "RKNS_9StringRefE", "PNS_5ValueE", "S0_",
+                                 "RKS1_"};
+  std::mt19937 Rand(0);
+  std::vector<std::string> Names;
+  Names.reserve(Count);
+  for (size_t I = 0; I < Count; ++I) {
+    std::string Name = Rand() % 4 ? "_ZN" : "_ZNK";
+    Name += Namespaces[Rand() % 5];
+    Name += Classes[Rand() % 8];
+    std::string Method = "method" + std::to_string(Rand() % (Count / 8 + 1));
+    Name += std::to_string(Method.size()) + Method + "E";
+    for (unsigned J = 0, E = Rand() % 4; J <= E; ++J)
+      Name += Params[Rand() % 10];
+    Names.push_back(std::move(Name));
+  }
+  return Names;
+}
+
+static void finalizeTable(benchmark::State &State, bool Parallel) {
+  std::vector<std::string> Names = makeMangledNames(State.range(0));
+  for (auto _ : State) {
+    StringTableBuilder B(StringTableBuilder::ELF);
+    for (const std::string &Name : Names)
+      B.add(Name);
+    if (Parallel)
+      B.finalizeParallel();
+    else
+      B.finalize();
+    benchmark::DoNotOptimize(B.getSize());
+  }
+  State.SetItemsProcessed(State.iterations() * Names.size());
+}
+
+static void BM_StringTableFinalize(benchmark::State &State) {
+  finalizeTable(State, /*Parallel=*/false);
+}
+BENCHMARK(BM_StringTableFinalize)->Range(1 << 12, 1 << 20);
+
+static void BM_StringTableFinalizeParallel(benchmark::State &State) {
+  finalizeTable(State, /*Parallel=*/true);
+}
+BENCHMARK(BM_StringTableFinalizeParallel)->Range(1 << 12, 1 << 20);
+
+BENCHMARK_MAIN();
@@ -303,9 +303,14 @@ public:
   using IsCapturedCacheT = SmallDenseMap<const Value *, bool, 8>;
   IsCapturedCacheT IsCapturedCache;
 
+  /// The number of alias queries currently being answered with this info.
+  /// Only the results of queries made at depth zero are final.
+  unsigned Depth = 0;
+
   AAQueryInfo() : AliasCache(), IsCapturedCache() {}
 };
 
+class AliasQueryCache;
 class BatchAAResults;
 
 class AAResults {
@@ -331,6 +336,13 @@ public:
   /// analyses become invalid.
   void addAADependencyID(AnalysisKey *ID) { AADeps.push_back(ID); }
 
+  /// Remember the results of top-level alias queries in \p Cache, and answer
+  /// repeated queries from it while an AliasQueryCache::ReadOnlyScope is open.
+  void setQueryCache(AliasQueryCache *Cache) { QueryCache = Cache; }
+
+  /// Returns the cache set with setQueryCache, if any.
+  AliasQueryCache *getQueryCache() const { return QueryCache; }
+
   /// Handle invalidation events in the new pass manager.
   ///
   /// The aggregation is invalidated if any of the underlying analyses is
@@ -765,6 +777,8 @@ private:
 
   std::vector<AnalysisKey *> AADeps;
 
+  AliasQueryCache *QueryCache = nullptr;
+
   friend class BatchAAResults;
 };
 
@@ -1110,12 +1124,7 @@ public:
     ResultGetters.push_back(&getModuleAAResultImpl<AnalysisT>);
   }
 
-  Result run(Function &F, FunctionAnalysisManager &AM) {
-    Result R(AM.getResult<TargetLibraryAnalysis>(F));
-    for (auto &Getter : ResultGetters)
-      (*Getter)(F, AM, R);
-    return R;
-  }
+  Result run(Function &F, FunctionAnalysisManager &AM);
 
 private:
   friend AnalysisInfoMixin<AAManager>;
@@ -0,0 +1,113 @@
+//===- AliasQueryCache.h - Cross-pass alias query cache ---------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the AliasQueryCache class, which remembers the results of
+// top-level alias queries for a function across passes.
+//
+// AAQueryInfo and BatchAAResults only cache results for the duration of one
+// batch of queries. When the query cache is enabled with -enable-aa-query-cache
+// the AAResults built by AAManager carry an AliasQueryCache, so that read-only
+// passes which run over unchanged IR do not recompute the same queries.
+//
+// A pass may change the IR between two queries in ways that nothing can
+// observe from the outside (setOperand, inserting a capturing store, ...), so
+// the cache is only consulted inside an AliasQueryCache::ReadOnlyScope, which
+// passes that never change the IR open around their queries. Transform passes
+// never see the cache. All entries are dropped as soon as any pass does not
+// preserve all analyses on the function.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ANALYSIS_ALIASQUERYCACHE_H
+#define LLVM_ANALYSIS_ALIASQUERYCACHE_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/IR/PassManager.h"
+
+namespace llvm {
+
+class Function;
+
+/// Returns true if AAManager should attach an AliasQueryCache to the
+/// AAResults it builds.
+bool isAAQueryCacheEnabled();
+
+/// A cache of alias query results for one function that outlives individual
+/// passes.
+///
+/// Only the results of top-level queries are stored. Results computed inside a
+/// recursive query may depend on assumptions made by the outer query and are
+/// never cached.
+class AliasQueryCache {
+public:
+  /// Lets the AAResults a cache is attached to answer and record queries
+  /// through the cache while the scope is alive. Only passes that do not
+  /// change the IR may open one; the IR must not change while it is alive.
+  class ReadOnlyScope {
+    AliasQueryCache *Cache;
+
+  public:
+    explicit ReadOnlyScope(AAResults &AA);
+    ~ReadOnlyScope();
+    ReadOnlyScope(const ReadOnlyScope &) = delete;
+    ReadOnlyScope &operator=(const ReadOnlyScope &) = delete;
+  };
+
+  /// Returns true if a ReadOnlyScope is open on this cache.
+  bool isActive() const { return ActiveScopes != 0; }
+
+  /// Get the cached result of the alias query for \p LocA and \p LocB, if any.
+  Optional<AliasResult> lookup(const MemoryLocation &LocA,
+                               const MemoryLocation &LocB) const;
+
+  /// Remember the result of the alias query for \p LocA and \p LocB.
+  void insert(const MemoryLocation &LocA, const MemoryLocation &LocB,
+              AliasResult Result);
+
+  /// Free the memory used by this class.
+  void releaseMemory();
+
+  /// Returns the number of cached queries.
+  unsigned size() const { return Results.size(); }
+
+  /// Handle invalidation events in the new pass manager.
+  ///
+  /// The cache itself is never invalidated, since the AAResults of the
+  /// function point to it, but all of its entries are dropped unless all
+  /// analyses on the function are preserved.
+  bool invalidate(Function &, const PreservedAnalyses &PA,
+                  FunctionAnalysisManager::Invalidator &);
+
+private:
+  using LocPair = AAQueryInfo::LocPair;
+
+  DenseMap<LocPair, AliasResult> Results;
+
+  /// The number of ReadOnlyScopes open on this cache.
+  unsigned ActiveScopes = 0;
+};
+
+/// The analysis pass which yields an AliasQueryCache.
+///
+/// The analysis does nothing by itself, and just returns an empty cache which
+/// gets filled in as AAResults is queried.
+class AliasQueryCacheAnalysis
+    : public AnalysisInfoMixin<AliasQueryCacheAnalysis> {
+  friend AnalysisInfoMixin<AliasQueryCacheAnalysis>;
+  static AnalysisKey Key;
+
+public:
+  using Result = AliasQueryCache;
+  AliasQueryCache run(Function &F, FunctionAnalysisManager &);
+};
+
+} // end namespace llvm
+
+#endif // LLVM_ANALYSIS_ALIASQUERYCACHE_H
@@ -235,6 +235,20 @@ public:
 
   void flush();
 
+  /// Like flush(), but with -defer-domtree-updates the pending updates are
+  /// handed over to the available trees instead of being applied. The trees
+  /// apply them when they are flushed explicitly: by the analysis manager or
+  /// wrapper pass handing them to the next pass, by getDomTree() or
+  /// getPostDomTree(), or by their next update. The updates of several passes
+  /// are thus applied as one batch, or replaced by a recalculation if there
+  /// are enough of them. Falls back to flush() while BasicBlocks are awaiting
+  /// deletion, as deleting them needs up-to-date trees.
+  ///
+  /// Only call this once the caller is done changing the CFG and querying the
+  /// trees, e.g. at the end of a pass. Querying a tree before it is flushed
+  /// asserts.
+  void deferFlush();
+
   ///@}
 
   /// Debug method to help view the internal state of this class.
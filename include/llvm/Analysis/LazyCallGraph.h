@@ -1138,6 +1138,26 @@ private:
   /// thin air.
   SmallSetVector<Function *, 4> LibFunctions;
 
+  /// The functions a function calls or references, with the kind of edge to
+  /// each of them.
+  using ScannedEdgeList =
+      SmallVector<PointerIntPair<Function *, 1, Edge::Kind>, 4>;
+
+  /// The edges found by scanning function bodies in parallel ahead of the
+  /// walk that builds the RefSCCs. Nodes take their edges from here instead
+  /// of scanning their function when they are populated during the walk.
+  DenseMap<const Function *, ScannedEdgeList> ScannedEdges;
+
+  /// Finds the functions \p F calls or references, in the order the node of
+  /// \p F adds edges to them, except for the implicit edges to library
+  /// functions. This only reads the IR, so it is safe to call for different
+  /// functions concurrently.
+  static void scanEdges(Function &F, ScannedEdgeList &Edges);
+
+  /// Scans the bodies of the defined functions whose nodes aren't populated
+  /// yet on a thread pool and fills ScannedEdges.
+  void scanEdgesInParallel(unsigned Threads);
+
   /// Helper to insert a new function, with an already looked-up entry in
   /// the NodeMap.
   Node &insertInto(Function &F, Node *&MappedN);
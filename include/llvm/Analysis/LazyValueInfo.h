@@ -16,6 +16,7 @@
 
 #include "llvm/IR/PassManager.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/CFGUpdate.h"
 
 namespace llvm {
   class AssumptionCache;
@@ -106,6 +107,13 @@ public:
   /// Inform the analysis cache that we have erased a block.
   void eraseBlock(BasicBlock *BB);
 
+  /// Inform the analysis cache that edges have been inserted into or deleted
+  /// from the CFG, with the same updates that are passed to a DomTreeUpdater.
+  /// Only the cached values in the blocks after a changed edge are dropped.
+  /// The updates must be applied in the order they were made to the CFG, and
+  /// an edge's source block must still be in the function.
+  void applyUpdates(ArrayRef<cfg::Update<BasicBlock *>> Updates);
+
   /// Print the \LazyValueInfo Analysis.
   /// We pass in the DTree that is required for identifying which basic blocks
   /// we can solve/print for, in the LVIPrinter. The DT is optional
@@ -119,6 +127,11 @@ public:
   /// instance was initialized without a DT pointer.
   void enableDT();
 
+  /// Starts a new -lvi-function-solve-budget. The cache outlives the pass
+  /// that filled it, so each pass calls this before its first query to not
+  /// inherit a budget an earlier pass exhausted.
+  void resetSolveBudget();
+
   // For old PM pass. Delete once LazyValueInfoWrapperPass is gone.
   void releaseMemory();
 
@@ -154,6 +154,16 @@ typedef OuterAnalysisManagerProxy<FunctionAnalysisManager, Loop,
 
 /// Returns the minimum set of Analyses that all loop passes must preserve.
 PreservedAnalyses getLoopPassPreservedAnalyses();
+
+/// For function passes that transform individual loop nests: clears the
+/// cached loop analyses and the scalar evolution information of the nests
+/// containing \p ChangedLoops and returns the analyses that remain valid, so
+/// that the cached loop analyses of all other nests are kept for the passes
+/// that follow. The pass must also preserve the dominator tree and loop info
+/// for this to take effect.
+PreservedAnalyses invalidateChangedLoopNests(LoopAnalysisManager &LAM,
+                                             ScalarEvolution &SE,
+                                             ArrayRef<Loop *> ChangedLoops);
 }
 
 #endif // LLVM_ANALYSIS_LOOPANALYSISMANAGER_H
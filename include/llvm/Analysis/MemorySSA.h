@@ -784,6 +784,31 @@ public:
   /// about the beginning or end of a block.
   enum InsertionPlace { Beginning, End };
 
+  /// Counters describing the work done by the clobber walkers of this
+  /// MemorySSA. They are printed by MemorySSAWalkerStatsPrinterPass.
+  struct WalkerStatistics {
+    /// Number of upward walks started.
+    unsigned Walks = 0;
+    /// Number of accesses visited by all walks.
+    unsigned WalkSteps = 0;
+    /// Number of queries answered by an already optimized access.
+    unsigned OptimizedHits = 0;
+    /// Number of location queries answered by the clobber cache.
+    unsigned CacheHits = 0;
+    /// Number of location queries that had to walk.
+    unsigned CacheMisses = 0;
+    /// Number of walks cut short because the function's walk budget was
+    /// exhausted.
+    unsigned BudgetExhausted = 0;
+  };
+
+  const WalkerStatistics &getWalkerStatistics() const { return WalkerStats; }
+
+  /// Drop the results cached by the clobber walkers for location queries.
+  /// This happens automatically whenever accesses are created, moved or
+  /// removed, or phi edges are changed through MemorySSAUpdater.
+  void invalidateClobberCache() { ++ClobberCacheEpoch; }
+
 protected:
   // Used by Memory SSA annotater, dumpers, and wrapper pass
   friend class MemorySSAAnnotatedWriter;
@@ -891,6 +916,10 @@ private:
   std::unique_ptr<CachingWalker<AliasAnalysis>> Walker;
   std::unique_ptr<SkipSelfWalker<AliasAnalysis>> SkipWalker;
   unsigned NextID;
+
+  // Walker cache and budget bookkeeping
+  unsigned ClobberCacheEpoch = 0;
+  WalkerStatistics WalkerStats;
 };
 
 // Internal MemorySSA utils, for use by MemorySSA classes and walkers
@@ -948,6 +977,20 @@ public:
   PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
 };
 
+/// Printer pass for the clobber walker statistics of \c MemorySSA.
+///
+/// This only reports on a MemorySSA that is already cached, so that it can be
+/// placed after the passes whose walks should be measured.
+class MemorySSAWalkerStatsPrinterPass
+    : public PassInfoMixin<MemorySSAWalkerStatsPrinterPass> {
+  raw_ostream &OS;
+
+public:
+  explicit MemorySSAWalkerStatsPrinterPass(raw_ostream &OS) : OS(OS) {}
+
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
+};
+
 /// Verifier pass for \c MemorySSA.
 struct MemorySSAVerifierPass : PassInfoMixin<MemorySSAVerifierPass> {
   PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
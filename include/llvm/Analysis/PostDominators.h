@@ -72,7 +72,10 @@ struct PostDominatorTreeWrapperPass : public FunctionPass {
     initializePostDominatorTreeWrapperPassPass(*PassRegistry::getPassRegistry());
   }
 
-  PostDominatorTree &getPostDomTree() { return DT; }
+  PostDominatorTree &getPostDomTree() {
+    DT.flushDeferredUpdates();
+    return DT;
+  }
   const PostDominatorTree &getPostDomTree() const { return DT; }
 
   bool runOnFunction(Function &F) override;
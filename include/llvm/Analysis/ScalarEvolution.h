@@ -987,6 +987,20 @@ public:
   bool invalidate(Function &F, const PreservedAnalyses &PA,
                   FunctionAnalysisManager::Invalidator &Inv);
 
+  /// The number of entries in one of the internal caches of ScalarEvolution
+  /// and an estimate of the bytes of memory it uses.
+  struct CacheMemoryUsage {
+    const char *Name;
+    size_t Entries;
+    size_t Bytes;
+  };
+
+  /// Append the memory usage of the SCEV nodes and of each cache to \p Usage.
+  void getMemoryUsage(SmallVectorImpl<CacheMemoryUsage> &Usage) const;
+
+  /// Print the memory usage of the SCEV nodes and of each cache.
+  void printMemoryUsage(raw_ostream &OS) const;
+
   /// Collect parametric terms occurring in step expressions (first step of
   /// delinearization).
   void collectParametricTerms(const SCEV *Expr,
@@ -1303,6 +1317,13 @@ private:
     /// Test whether this BackedgeTakenInfo contains complete information.
     bool hasFullInfo() const { return isComplete(); }
 
+    /// Return the number of bytes of heap memory used by the exit list.
+    size_t getExitListMemorySize() const {
+      return ExitNotTaken.capacity() > 1
+                 ? ExitNotTaken.capacity() * sizeof(ExitNotTakenInfo)
+                 : 0;
+    }
+
     /// Return an expression indicating the exact *backedge-taken*
     /// count of the loop if it is known or SCEVCouldNotCompute
     /// otherwise.  If execution makes it to the backedge on every
@@ -1415,6 +1436,32 @@ private:
   /// Memoized results from getRange
   DenseMap<const SCEV *, ConstantRange> SignedRanges;
 
+  /// The maximum number of entries in each of the range and backedge-taken
+  /// count caches, or zero if they are unbounded. The caches are trimmed when
+  /// they are full by dropping the entries that were not looked up since the
+  /// previous trim.
+  unsigned DerivedCacheLimit;
+
+  /// The cached ranges and backedge-taken counts that were looked up since
+  /// the caches were last trimmed. Only maintained if DerivedCacheLimit is set.
+  SmallPtrSet<const SCEV *, 16> UsedUnsignedRanges;
+  SmallPtrSet<const SCEV *, 16> UsedSignedRanges;
+  SmallPtrSet<const Loop *, 4> UsedBackedgeTakenCounts;
+  SmallPtrSet<const Loop *, 4> UsedPredicatedBackedgeTakenCounts;
+
+  /// The number of backedge-taken counts being computed. Their cache entries
+  /// are placeholders until then, so the caches can't be trimmed.
+  unsigned PendingBackedgeTakenCounts = 0;
+
+  /// Drop the entries of a range cache that weren't used since the last trim.
+  void trimRangeCache(DenseMap<const SCEV *, ConstantRange> &Cache,
+                      SmallPtrSetImpl<const SCEV *> &Used);
+
+  /// Drop the entries of a backedge-taken count cache that weren't used since
+  /// the last trim.
+  void trimBackedgeTakenCache(DenseMap<const Loop *, BackedgeTakenInfo> &Cache,
+                              SmallPtrSetImpl<const Loop *> &Used);
+
   /// Used to parameterize getRange
   enum RangeSignHint { HINT_RANGE_UNSIGNED, HINT_RANGE_SIGNED };
 
@@ -1424,6 +1471,10 @@ private:
     DenseMap<const SCEV *, ConstantRange> &Cache =
         Hint == HINT_RANGE_UNSIGNED ? UnsignedRanges : SignedRanges;
 
+    if (DerivedCacheLimit && Cache.size() >= DerivedCacheLimit)
+      trimRangeCache(Cache, Hint == HINT_RANGE_UNSIGNED ? UsedUnsignedRanges
+                                                        : UsedSignedRanges);
+
     auto Pair = Cache.try_emplace(S, std::move(CR));
     if (!Pair.second)
       Pair.first->second = std::move(CR);
@@ -1925,6 +1976,17 @@ public:
   PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
 };
 
+/// Printer pass for the memory used by \c ScalarEvolutionAnalysis results.
+class ScalarEvolutionMemoryPrinterPass
+    : public PassInfoMixin<ScalarEvolutionMemoryPrinterPass> {
+  raw_ostream &OS;
+
+public:
+  explicit ScalarEvolutionMemoryPrinterPass(raw_ostream &OS) : OS(OS) {}
+
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
+};
+
 class ScalarEvolutionWrapperPass : public FunctionPass {
   std::unique_ptr<ScalarEvolution> SE;
 
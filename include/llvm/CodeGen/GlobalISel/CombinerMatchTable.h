@@ -0,0 +1,147 @@
+//===- llvm/CodeGen/GlobalISel/CombinerMatchTable.h -------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+/// \file
+/// This file declares the opcodes of the match tables emitted by the
+/// -gen-global-isel-combiner tablegen backend and the interpreter that runs
+/// them.
+///
+/// A combiner's match table dispatches on the opcode of the root instruction
+/// and then tries the rules for that opcode in priority order, so each
+/// instruction only ever looks at the rules that can apply to it.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CODEGEN_GLOBALISEL_COMBINERMATCHTABLE_H
+#define LLVM_CODEGEN_GLOBALISEL_COMBINERMATCHTABLE_H
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdint>
+
+namespace llvm {
+
+enum {
+  /// Begin a try-block to attempt a match and jump to OnFail if it is
+  /// unsuccessful.
+  /// - OnFail - The MatchTable entry at which to resume if the match fails.
+  GICM_Try,
+
+  /// Switch over the opcode of the root instruction.
+  /// - LowerBound - numerically minimum opcode supported
+  /// - UpperBound - numerically maximum + 1 opcode supported
+  /// - Default - failure jump target
+  /// - JumpTable... - (UpperBound - LowerBound) jump targets, 0 for opcodes
+  ///   without rules
+  GICM_SwitchOpcode,
+
+  /// Check a rule's C++ match predicate.
+  /// - PredicateID - The predicate to test
+  GICM_CheckCxxPredicate,
+
+  /// Apply a rule. The combine has changed the function, so this also ends
+  /// the match.
+  /// - ApplyID - The apply code to run
+  GICM_ApplyAndDone,
+
+  /// Fail the current try-block, or completely fail to match if there is no
+  /// current try-block.
+  GICM_Reject,
+};
+
+/// Run \p MatchTable on the root instruction \p MI.
+///
+/// \p TestPredicate is called as bool(int64_t PredicateID) for each
+/// GICM_CheckCxxPredicate and \p Apply as void(int64_t ApplyID) for the first
+/// rule whose checks all succeed. Returns true if a rule was applied.
+template <typename PredicateFnTy, typename ApplyFnTy>
+bool executeCombinerMatchTable(const int64_t *MatchTable, MachineInstr &MI,
+                               PredicateFnTy &&TestPredicate,
+                               ApplyFnTy &&Apply) {
+  uint64_t CurrentIdx = 0;
+  SmallVector<uint64_t, 4> OnFailResumeAt;
+
+  auto handleReject = [&]() -> bool {
+    if (OnFailResumeAt.empty())
+      return false;
+    CurrentIdx = OnFailResumeAt.pop_back_val();
+    return true;
+  };
+
+  while (true) {
+    int64_t MatcherOpcode = MatchTable[CurrentIdx++];
+    switch (MatcherOpcode) {
+    case GICM_Try: {
+      OnFailResumeAt.push_back(MatchTable[CurrentIdx++]);
+      break;
+    }
+
+    case GICM_SwitchOpcode: {
+      int64_t LowerBound = MatchTable[CurrentIdx++];
+      int64_t UpperBound = MatchTable[CurrentIdx++];
+      int64_t Default = MatchTable[CurrentIdx++];
+      const int64_t Opcode = MI.getOpcode();
+
+      DEBUG_WITH_TYPE("gi-combiner", {
+        dbgs() << CurrentIdx << ": GICM_SwitchOpcode([" << LowerBound << ", "
+               << UpperBound << "), Default=" << Default
+               << ", JumpTable...) // Got=" << Opcode << "\n";
+      });
+      if (Opcode < LowerBound || UpperBound <= Opcode) {
+        CurrentIdx = Default;
+        break;
+      }
+      CurrentIdx = MatchTable[CurrentIdx + (Opcode - LowerBound)];
+      if (!CurrentIdx) {
+        CurrentIdx = Default;
+        break;
+      }
+      OnFailResumeAt.push_back(Default);
+      break;
+    }
+
+    case GICM_CheckCxxPredicate: {
+      int64_t PredicateID = MatchTable[CurrentIdx++];
+      DEBUG_WITH_TYPE("gi-combiner", {
+        dbgs() << CurrentIdx << ": GICM_CheckCxxPredicate(" << PredicateID
+               << ")\n";
+      });
+      if (!TestPredicate(PredicateID))
+        if (!handleReject())
+          return false;
+      break;
+    }
+
+    case GICM_ApplyAndDone: {
+      int64_t ApplyID = MatchTable[CurrentIdx++];
+      DEBUG_WITH_TYPE("gi-combiner", {
+        dbgs() << CurrentIdx << ": GICM_ApplyAndDone(" << ApplyID << ")\n";
+      });
+      Apply(ApplyID);
+      return true;
+    }
+
+    case GICM_Reject:
+      DEBUG_WITH_TYPE("gi-combiner",
+                      dbgs() << CurrentIdx << ": GICM_Reject\n");
+      if (!handleReject())
+        return false;
+      break;
+
+    default:
+      llvm_unreachable("Unexpected combiner match table opcode");
+    }
+  }
+}
+
+} // end namespace llvm
+
+#endif // LLVM_CODEGEN_GLOBALISEL_COMBINERMATCHTABLE_H
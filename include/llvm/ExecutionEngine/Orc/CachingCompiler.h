@@ -0,0 +1,73 @@
+//===- CachingCompiler.h - Compile IR through an on-disk cache --*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Contains a compile function for IRCompileLayer that keeps the objects it
+// produces in a directory on disk, so that later processes compiling the same
+// modules can skip code generation.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_EXECUTIONENGINE_ORC_CACHINGCOMPILER_H
+#define LLVM_EXECUTIONENGINE_ORC_CACHINGCOMPILER_H
+
+#include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <memory>
+#include <string>
+
+namespace llvm {
+
+class Module;
+class TargetMachine;
+
+namespace orc {
+
+class ExecutionSession;
+
+/// Compile functor that looks up the object for a module in an on-disk cache
+/// before compiling it, and adds the objects it compiles to the cache.
+///
+/// Objects are keyed by the hash the bitcode writer computes for the module,
+/// as ThinLTO keys its cache, combined with a key for the code generation
+/// configuration (see getTargetKey). Only relocatable objects are cached, so
+/// entries stay valid across processes. After adding an object the directory
+/// is pruned with the given CachePruningPolicy, so its size stays bounded.
+///
+/// Every lookup is counted as a hit or a miss on the ExecutionSession.
+/// Failing to write to the cache is not an error: the compiled object is
+/// returned as if no cache was used.
+class CachingIRCompiler {
+public:
+  CachingIRCompiler(ExecutionSession &ES,
+                    IRCompileLayer::CompileFunction Compile,
+                    std::string CacheDir, std::string TargetKey,
+                    CachePruningPolicy Policy = CachePruningPolicy());
+
+  /// Returns a string identifying the objects \p TM generates: the triple,
+  /// CPU, features, optimization level, relocation model and code model.
+  static std::string getTargetKey(const TargetMachine &TM);
+
+  Expected<std::unique_ptr<MemoryBuffer>> operator()(Module &M);
+
+private:
+  struct CacheState;
+
+  std::string getCacheKey(Module &M) const;
+  void addToCache(StringRef EntryPath, MemoryBufferRef Obj);
+
+  // Shared so that copies of the functor, which std::function makes, use
+  // the same pruning lock.
+  std::shared_ptr<CacheState> State;
+};
+
+} // end namespace orc
+} // end namespace llvm
+
+#endif // LLVM_EXECUTIONENGINE_ORC_CACHINGCOMPILER_H
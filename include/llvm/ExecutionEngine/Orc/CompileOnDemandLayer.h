@@ -40,9 +40,11 @@
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Type.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Utils/ValueMapper.h"
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <functional>
 #include <iterator>
@@ -61,7 +63,7 @@ namespace orc {
 
 class ExtractingIRMaterializationUnit;
 
-class CompileOnDemandLayer : public IRLayer {
+class CompileOnDemandLayer : public IRLayer, public ResourceManager {
   friend class PartitioningIRMaterializationUnit;
 
 public:
@@ -91,11 +93,101 @@ public:
   /// Sets the partition function.
   void setPartitionFunction(PartitionFunction Partition);
 
+  /// Enables tiered compilation. Functions reached through a lazy stub are
+  /// emitted to the base layer with a call counter at their entry. Once a
+  /// function has been called Threshold times, a copy of its uninstrumented IR
+  /// is emitted to OptimizingLayer on a background thread and the stub is
+  /// re-pointed to the result.
+  ///
+  /// The counters and the callback are addresses in this process, so this
+  /// only works when the JIT'd code runs in-process. Only function partitions
+  /// are tiered, not modules emitted whole. Must be called before any modules
+  /// are added.
+  void setTierUpLayer(IRLayer &OptimizingLayer, uint64_t Threshold);
+
+  /// Counts of speculatively compiled functions.
+  struct SpeculationStats {
+    /// Functions compiled ahead of their first call.
+    uint64_t Compiled = 0;
+    /// Speculatively compiled functions that were called since.
+    uint64_t Hits = 0;
+    /// Speculatively compiled functions that were not called (yet).
+    uint64_t getWasted() const { return Compiled - Hits; }
+  };
+
+  /// Enables speculative compilation. Whenever a function partition is
+  /// emitted because a function was called, up to MaxCallees of the
+  /// functions it calls directly that were not compiled yet are looked up
+  /// speculatively (see ExecutionSession::lookupSpeculatively), which
+  /// compiles them ahead of their first call. Callees are ranked by their
+  /// profile entry count, then by the number of call sites; callees the
+  /// profile says are never entered are skipped. Partitions emitted
+  /// speculatively do not speculate further.
+  ///
+  /// This pays off with a concurrent dispatcher that runs speculative units
+  /// on idle threads, e.g. MaterializationThreadPool. With the default
+  /// dispatcher callees are compiled eagerly on the calling thread. Must be
+  /// called before any modules are added.
+  void setSpeculation(unsigned MaxCallees);
+
+  /// Returns the speculation counts so far.
+  SpeculationStats getSpeculationStats() const;
+
+  ~CompileOnDemandLayer();
+
   /// Emits the given module. This should not be called by clients: it will be
   /// called by the JIT when a definition added via the add method is requested.
   void emit(MaterializationResponsibility R, ThreadSafeModule TSM) override;
 
+  /// Stops the tier-ups of the module's functions and waits for any that are
+  /// running, so that none adds an optimized copy once the module's symbols
+  /// are being removed.
+  void prepareToRemove(VModuleKey K) override;
+
+  /// Lets the module's functions tier up again after a failed removal, and
+  /// queues the tier-ups that were skipped in the meantime.
+  void cancelRemove(VModuleKey K) override;
+
+  /// Releases the stubs and call-through trampolines of the module's
+  /// functions, and drops its tier-up state. Called by
+  /// ExecutionSession::removeModule.
+  Error removeResources(VModuleKey K) override;
+
+  /// Stubs and trampolines come from pools shared by all modules, so no
+  /// memory is attributed to individual modules.
+  uint64_t getResourceSize(VModuleKey K) const override { return 0; }
+
 private:
+  struct TieredFunction;
+
+  /// An emitted partition whose functions are counted for tiering up.
+  struct TieredPartition {
+    std::mutex Mutex;
+    /// The partition as extracted, before the counters were added. Released
+    /// once every function in it has tiered up.
+    ThreadSafeModule TSM;
+    JITDylib *ImplD = nullptr;
+    IndirectStubsManager *ISMgr = nullptr;
+    /// The key of the module the partition came from. Optimized copies are
+    /// added with the same key, so that they are removed with the module.
+    VModuleKey K = VModuleKey();
+    unsigned NumPending = 0;
+    /// Set while the module is being removed. No tier-ups are done.
+    bool Removed = false;
+    /// Functions that became hot while Removed was set, to be tiered up if
+    /// the removal fails.
+    std::vector<TieredFunction *> Skipped;
+  };
+
+  /// A counted function. The instrumented code increments Calls directly.
+  struct TieredFunction {
+    std::atomic<uintptr_t> Calls{0};
+    CompileOnDemandLayer *Parent = nullptr;
+    std::shared_ptr<TieredPartition> Partition;
+    std::string Name;
+    SymbolStringPtr StubName;
+  };
+
   struct PerDylibResources {
   public:
     PerDylibResources(JITDylib &ImplD,
@@ -104,15 +196,25 @@ private:
     JITDylib &getImplDylib() { return ImplD; }
     IndirectStubsManager &getISManager() { return *ISMgr; }
 
+    /// Names of the functions called through lazy stubs.
+    SymbolNameSet &getLazyCallables() { return LazyCallables; }
+
+    /// Names of speculatively compiled functions that were not called yet.
+    SymbolNameSet &getPendingSpeculations() { return PendingSpeculations; }
+
   private:
     JITDylib &ImplD;
     std::unique_ptr<IndirectStubsManager> ISMgr;
+    SymbolNameSet LazyCallables;
+    SymbolNameSet PendingSpeculations;
   };
 
   using PerDylibResourcesMap = std::map<const JITDylib *, PerDylibResources>;
 
   PerDylibResources &getPerDylibResources(JITDylib &TargetD);
 
+  PerDylibResources *findPerDylibResourcesForImpl(JITDylib &ImplD);
+
   void cleanUpModule(Module &M);
 
   void expandPartition(GlobalValueSet &Partition);
@@ -120,14 +222,39 @@ private:
   void emitPartition(MaterializationResponsibility R, ThreadSafeModule TSM,
                      IRMaterializationUnit::SymbolNameToDefinitionMap Defs);
 
+  SymbolNameSet findLikelyCallees(const Module &M,
+                                  const GlobalValueSet &Partition,
+                                  PerDylibResources &PDR);
+
+  void notifyFirstCall(JITDylib &ImplD, const SymbolStringPtr &Name);
+
+  void addTierUpCounters(JITDylib &ImplD, VModuleKey K, ThreadSafeModule &TSM);
+
+  static void notifyHotFunction(void *Ctx);
+
+  void tierUp(TieredFunction &TF);
+
   mutable std::mutex CODLayerMutex;
 
   IRLayer &BaseLayer;
   LazyCallThroughManager &LCTMgr;
   IndirectStubsManagerBuilder BuildIndirectStubsManager;
   PerDylibResourcesMap DylibResources;
+  // The functions given lazy stubs for each module, by target dylib.
+  std::map<VModuleKey, std::vector<std::pair<const JITDylib *, SymbolNameSet>>>
+      ModuleCallables;
   PartitionFunction Partition = compileRequested;
   SymbolLinkagePromoter PromoteSymbols;
+
+  unsigned MaxSpeculatedCallees = 0;
+  SpeculationStats Speculation;
+
+  IRLayer *OptimizingLayer = nullptr;
+  uint64_t TierUpThreshold = 0;
+  std::vector<std::unique_ptr<TieredFunction>> TieredFunctions;
+  // Declared last so that pending tier-ups finish before the state they use
+  // is destroyed.
+  std::unique_ptr<ThreadPool> TierUpThreads;
 };
 
 /// Compile-on-demand layer.
@@ -19,6 +19,8 @@
 #include "llvm/IR/Module.h"
 #include "llvm/Support/Debug.h"
 
+#include <atomic>
+#include <list>
 #include <memory>
 #include <vector>
 
@@ -56,6 +58,15 @@ using SymbolDependenceMap = DenseMap<JITDylib *, SymbolNameSet>;
 /// A list of (JITDylib*, bool) pairs.
 using JITDylibSearchList = std::vector<std::pair<JITDylib *, bool>>;
 
+/// How urgently a dispatched MaterializationUnit is needed.
+enum class MaterializationPriority {
+  /// A query is (or may soon be) waiting for the unit's symbols.
+  Blocking,
+  /// The unit was requested ahead of time by a speculative lookup, and no
+  /// query is waiting for it yet.
+  Speculative
+};
+
 /// Render a SymbolStringPtr.
 raw_ostream &operator<<(raw_ostream &OS, const SymbolStringPtr &Sym);
 
@@ -262,6 +273,9 @@ public:
   /// Return the set of symbols that this source provides.
   const SymbolFlagsMap &getSymbols() const { return SymbolFlags; }
 
+  /// Returns the VModuleKey for this instance.
+  VModuleKey getVModuleKey() const { return K; }
+
   /// Called by materialization dispatchers (see
   /// ExecutionSession::DispatchMaterializationFunction) to trigger
   /// materialization of this MaterializationUnit.
@@ -520,6 +534,7 @@ public:
   /// add a definition for the unresolved symbols to the dylib.
   void setGenerator(GeneratorFunction DefGenerator) {
     this->DefGenerator = std::move(DefGenerator);
+    SymbolTableGeneration.fetch_add(1, std::memory_order_release);
   }
 
   /// Set the search order to be used when fixing up definitions in JITDylib.
@@ -634,6 +649,18 @@ private:
 
   using MaterializingInfosMap = DenseMap<SymbolStringPtr, MaterializingInfo>;
 
+  /// An immutable copy of the symbol table, published for lock-free lookups
+  /// of ready symbols. Generation is the value of SymbolTableGeneration the
+  /// copy was taken at.
+  struct SymbolTableSnapshot {
+    SymbolMap Symbols;
+    uint64_t Generation = 0;
+    bool HasGenerator = false;
+  };
+
+  /// Result of looking a symbol up in the snapshot.
+  enum class SnapshotLookupResult { Found, NotDefined, Unknown };
+
   using LookupImplActionFlags = enum {
     None = 0,
     NotifyFullyResolved = 1 << 0U,
@@ -668,10 +695,14 @@ private:
                                        const SymbolStringPtr &DependantName,
                                        MaterializingInfo &EmittedMI);
 
-  Error defineMaterializing(const SymbolFlagsMap &SymbolFlags);
+  Error defineMaterializing(const SymbolFlagsMap &SymbolFlags, VModuleKey K);
 
   void replace(std::unique_ptr<MaterializationUnit> MU);
 
+  void trackSymbols(VModuleKey K, const SymbolFlagsMap &SymbolFlags);
+
+  void untrackSymbol(const SymbolStringPtr &Name);
+
   SymbolNameSet getRequestedSymbols(const SymbolFlagsMap &SymbolFlags) const;
 
   void addDependencies(const SymbolStringPtr &Name,
@@ -683,6 +714,17 @@ private:
 
   void notifyFailed(const SymbolNameSet &FailedSymbols);
 
+  SnapshotLookupResult lookupInSnapshot(const SymbolStringPtr &Name,
+                                        bool MatchNonExported,
+                                        JITEvaluatedSymbol &Result,
+                                        bool &IsStale) const;
+
+  void noteSymbolTableChanged() {
+    SymbolTableGeneration.fetch_add(1, std::memory_order_release);
+  }
+
+  void noteStaleSnapshotLookup();
+
   ExecutionSession &ES;
   std::string JITDylibName;
   SymbolMap Symbols;
@@ -690,6 +732,52 @@ private:
   MaterializingInfosMap MaterializingInfos;
   GeneratorFunction DefGenerator;
   JITDylibSearchList SearchOrder;
+
+  // The symbols defined on behalf of each module, for
+  // ExecutionSession::removeModule. Symbols defined with the default
+  // VModuleKey are not tracked.
+  DenseMap<VModuleKey, SymbolNameSet> ModuleSymbols;
+  DenseMap<SymbolStringPtr, VModuleKey> SymbolModules;
+
+  // Bumped whenever a symbol is added, removed or becomes ready, or the
+  // generator changes. Only modified under the session lock, except by
+  // setGenerator.
+  std::atomic<uint64_t> SymbolTableGeneration{0};
+
+  // Accessed with std::atomic_load/std::atomic_store only. Rebuilt under the
+  // session lock once enough locked lookups have run into a stale copy, so
+  // that the cost of copying the table is spread over those lookups.
+  std::shared_ptr<const SymbolTableSnapshot> Snapshot;
+  size_t StaleSnapshotLookups = 0;
+};
+
+/// Interface for layers that hold resources (memory, EH frame registrations,
+/// stubs) on behalf of the modules added to an ExecutionSession.
+///
+/// ResourceManagers are registered with the ExecutionSession and are asked to
+/// release a module's resources by ExecutionSession::removeModule, once the
+/// module's symbols have been removed from all JITDylibs.
+class ResourceManager {
+public:
+  virtual ~ResourceManager();
+
+  /// Stop any work that could still add definitions for the module with the
+  /// given key. Called by ExecutionSession::removeModule without the session
+  /// lock held, before the module's symbols are removed. The removal may
+  /// still fail afterwards, so the module must stay usable.
+  virtual void prepareToRemove(VModuleKey K) {}
+
+  /// Undo prepareToRemove for the module with the given key. Called by
+  /// ExecutionSession::removeModule without the session lock held when the
+  /// module's symbols could not be removed.
+  virtual void cancelRemove(VModuleKey K) {}
+
+  /// Release all resources held for the module with the given key.
+  virtual Error removeResources(VModuleKey K) = 0;
+
+  /// Returns the number of bytes of memory held for the module with the given
+  /// key.
+  virtual uint64_t getResourceSize(VModuleKey K) const = 0;
 };
 
 /// An ExecutionSession represents a running JIT program.
@@ -705,6 +793,17 @@ public:
   using DispatchMaterializationFunction = std::function<void(
       JITDylib &JD, std::unique_ptr<MaterializationUnit> MU)>;
 
+  /// For dispatching MaterializationUnit::materialize calls, with the
+  /// priority of the lookup that triggered them.
+  using PrioritizedDispatchMaterializationFunction =
+      std::function<void(JITDylib &JD, std::unique_ptr<MaterializationUnit> MU,
+                         MaterializationPriority Priority)>;
+
+  /// For raising already dispatched speculative units to blocking priority
+  /// once a blocking query waits on some of their symbols.
+  using PromoteMaterializationFunction =
+      std::function<void(JITDylib &JD, const SymbolNameSet &Symbols)>;
+
   /// Construct an ExecutionSession.
   ///
   /// SymbolStringPools may be shared between ExecutionSessions.
@@ -741,6 +840,28 @@ public:
   void releaseVModule(VModuleKey Key) { /* FIXME: Recycle keys */
   }
 
+  /// Register a ResourceManager to be notified when modules are removed.
+  void registerResourceManager(ResourceManager &RM);
+
+  /// Deregister a previously registered ResourceManager.
+  void deregisterResourceManager(ResourceManager &RM);
+
+  /// Remove the module with the given key: Lets each registered
+  /// ResourceManager stop work on the module, removes every symbol defined
+  /// with the key from the JITDylibs of this session, then asks each
+  /// ResourceManager to release the module's resources, and finally releases
+  /// the key.
+  ///
+  /// If any of the module's symbols are still being materialized this method
+  /// returns a SymbolsCouldNotBeRemoved error and removes nothing. Callers are
+  /// responsible for ensuring that no code of the module is running, or will
+  /// be run through pointers obtained before the call.
+  Error removeModule(VModuleKey K);
+
+  /// Returns the number of bytes of memory held by the registered
+  /// ResourceManagers for the module with the given key.
+  uint64_t getModuleResourceSize(VModuleKey K);
+
   /// Set the error reporter function.
   ExecutionSession &setErrorReporter(ErrorReporter ReportError) {
     this->ReportError = std::move(ReportError);
@@ -755,10 +876,32 @@ public:
   /// Set the materialization dispatch function.
   ExecutionSession &setDispatchMaterialization(
       DispatchMaterializationFunction DispatchMaterialization) {
+    this->DispatchMaterialization =
+        [DispatchMaterialization](JITDylib &JD,
+                                  std::unique_ptr<MaterializationUnit> MU,
+                                  MaterializationPriority) {
+          DispatchMaterialization(JD, std::move(MU));
+        };
+    return *this;
+  }
+
+  /// Set a materialization dispatch function that takes the priority of
+  /// each unit into account.
+  ExecutionSession &setPrioritizedDispatchMaterialization(
+      PrioritizedDispatchMaterializationFunction DispatchMaterialization) {
     this->DispatchMaterialization = std::move(DispatchMaterialization);
     return *this;
   }
 
+  /// Set the function that promotes speculative units a blocking query
+  /// waits on. Units that have not been dispatched yet are promoted by the
+  /// session itself.
+  ExecutionSession &setPromoteMaterialization(
+      PromoteMaterializationFunction PromoteMaterialization) {
+    this->PromoteMaterialization = std::move(PromoteMaterialization);
+    return *this;
+  }
+
   void legacyFailQuery(AsynchronousSymbolQuery &Q, Error Err);
 
   using LegacyAsyncLookupFunction = std::function<SymbolNameSet(
@@ -793,10 +936,23 @@ public:
   /// dependenant symbols for this query (e.g. it is being made by a top level
   /// client to get an address to call) then the value NoDependenciesToRegister
   /// can be used.
+  ///
+  /// Queries for symbols that are all ready are answered from per-dylib
+  /// snapshots of the symbol tables without taking the session lock. Such
+  /// queries have no dependencies to register.
   void lookup(const JITDylibSearchList &SearchOrder, SymbolNameSet Symbols,
               SymbolsResolvedCallback OnResolve, SymbolsReadyCallback OnReady,
               RegisterDependenciesFunction RegisterDependencies);
 
+  /// Like the asynchronous lookup above, but for symbols that are not needed
+  /// yet: the materializations it triggers are dispatched with
+  /// MaterializationPriority::Speculative, so that dispatchers can run them
+  /// after the ones blocking other queries.
+  void lookupSpeculatively(const JITDylibSearchList &SearchOrder,
+                           SymbolNameSet Symbols,
+                           SymbolsResolvedCallback OnResolve,
+                           SymbolsReadyCallback OnReady);
+
   /// Blocking version of lookup above. Returns the resolved symbol map.
   /// If WaitUntilReady is true (the default), will not return until all
   /// requested symbols are ready (or an error occurs). If WaitUntilReady is
@@ -829,18 +985,36 @@ public:
                                       StringRef Symbol);
 
   /// Materialize the given unit.
-  void dispatchMaterialization(JITDylib &JD,
-                               std::unique_ptr<MaterializationUnit> MU) {
+  void dispatchMaterialization(
+      JITDylib &JD, std::unique_ptr<MaterializationUnit> MU,
+      MaterializationPriority Priority = MaterializationPriority::Blocking) {
     LLVM_DEBUG(runSessionLocked([&]() {
                  dbgs() << "Compiling, for " << JD.getName() << ", " << *MU
                         << "\n";
                }););
-    DispatchMaterialization(JD, std::move(MU));
+    DispatchMaterialization(JD, std::move(MU), Priority);
   }
 
   /// Dump the state of all the JITDylibs in this session.
   void dump(raw_ostream &OS);
 
+  /// Record the outcome of a lookup in an on-disk object cache (see
+  /// CachingIRCompiler). Safe to call from any compile thread.
+  void recordObjectCacheLookup(bool Hit) {
+    if (Hit)
+      ++ObjectCacheHits;
+    else
+      ++ObjectCacheMisses;
+  }
+
+  /// Returns the number of modules whose object was loaded from an object
+  /// cache instead of being compiled.
+  uint64_t getObjectCacheHits() const { return ObjectCacheHits; }
+
+  /// Returns the number of modules that had to be compiled because no object
+  /// for them was found in an object cache.
+  uint64_t getObjectCacheMisses() const { return ObjectCacheMisses; }
+
 private:
   static void logErrorsToStdErr(Error Err) {
     logAllUnhandledErrors(std::move(Err), errs(), "JIT session error: ");
@@ -848,26 +1022,58 @@ private:
 
   static void
   materializeOnCurrentThread(JITDylib &JD,
-                             std::unique_ptr<MaterializationUnit> MU) {
+                             std::unique_ptr<MaterializationUnit> MU,
+                             MaterializationPriority) {
     MU->doMaterialize(JD);
   }
 
+  bool lookupInSnapshots(const JITDylibSearchList &SearchOrder,
+                         const SymbolNameSet &Symbols, SymbolMap &Result,
+                         JITDylib *&StaleJD) const;
+
+  void lookupImpl(const JITDylibSearchList &SearchOrder, SymbolNameSet Symbols,
+                  SymbolsResolvedCallback OnResolve,
+                  SymbolsReadyCallback OnReady,
+                  RegisterDependenciesFunction RegisterDependencies,
+                  MaterializationPriority Priority);
+
   void runOutstandingMUs();
 
+  void promoteMaterializations(const SymbolDependenceMap &Waiting);
+
   mutable std::recursive_mutex SessionMutex;
   std::shared_ptr<SymbolStringPool> SSP;
   VModuleKey LastKey = 0;
   ErrorReporter ReportError = logErrorsToStdErr;
-  DispatchMaterializationFunction DispatchMaterialization =
+  PrioritizedDispatchMaterializationFunction DispatchMaterialization =
       materializeOnCurrentThread;
+  PromoteMaterializationFunction PromoteMaterialization;
 
   std::vector<std::unique_ptr<JITDylib>> JDs;
+  std::vector<ResourceManager *> ResourceManagers;
+
+  std::atomic<uint64_t> ObjectCacheHits{0};
+  std::atomic<uint64_t> ObjectCacheMisses{0};
 
   // FIXME: Remove this (and runOutstandingMUs) once the linking layer works
   //        with callbacks from asynchronous queries.
   mutable std::recursive_mutex OutstandingMUsMutex;
-  std::vector<std::pair<JITDylib *, std::unique_ptr<MaterializationUnit>>>
-      OutstandingMUs;
+  struct OutstandingMU {
+    JITDylib *JD;
+    std::unique_ptr<MaterializationUnit> MU;
+    MaterializationPriority Priority;
+  };
+  std::vector<OutstandingMU> OutstandingMUs;
+
+  // Speculative units taken off OutstandingMUs and being dispatched, which a
+  // promotion can't reach yet. Promoted records are promoted again once the
+  // dispatch returns.
+  struct SpeculativeDispatch {
+    JITDylib *JD;
+    SymbolNameSet Symbols;
+    bool Promoted;
+  };
+  std::list<SpeculativeDispatch> SpeculativeDispatches;
 };
 
 template <typename Func>
@@ -131,11 +131,19 @@ private:
 class CtorDtorRunner {
 public:
   CtorDtorRunner(JITDylib &JD) : JD(JD) {}
-  void add(iterator_range<CtorDtorIterator> CtorDtors);
+
+  /// Adds the given constructors or destructors. Those added under a key
+  /// other than the default can be dropped again with remove.
+  void add(iterator_range<CtorDtorIterator> CtorDtors,
+           VModuleKey K = VModuleKey());
+
+  /// Drops the not-yet-run constructors or destructors added under key K.
+  void remove(VModuleKey K);
+
   Error run();
 
 private:
-  using CtorDtorList = std::vector<SymbolStringPtr>;
+  using CtorDtorList = std::vector<std::pair<SymbolStringPtr, VModuleKey>>;
   using CtorDtorPriorityMap = std::map<unsigned, CtorDtorList>;
 
   JITDylib &JD;
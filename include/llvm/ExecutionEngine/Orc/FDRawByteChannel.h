@@ -0,0 +1,163 @@
+//===- FDRawByteChannel.h - File descriptor based byte-channel --*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// File descriptor based RawByteChannel, for talking to a JIT server in a child
+// process over a pair of pipes.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_EXECUTIONENGINE_ORC_FDRAWBYTECHANNEL_H
+#define LLVM_EXECUTIONENGINE_ORC_FDRAWBYTECHANNEL_H
+
+#include "llvm/ExecutionEngine/Orc/RawByteChannel.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#if !defined(_MSC_VER) && !defined(__MINGW32__) && !defined(MOLLENOS)
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+namespace llvm {
+namespace orc {
+namespace rpc {
+
+/// RPC channel that reads from and writes to file descriptors.
+///
+/// Serializing a call appends many small pieces (ids, sequence numbers and
+/// each argument), so writes are buffered until send() and reads are served
+/// from a buffer filled with as much as the descriptor has available. Large
+/// appends, such as section contents, bypass the buffers.
+class FDRawByteChannel final : public RawByteChannel {
+public:
+  FDRawByteChannel(int InFD, int OutFD) : InFD(InFD), OutFD(OutFD) {}
+
+  Error readBytes(char *Dst, unsigned Size) override {
+    assert(Dst && "Attempt to read into null.");
+    while (Size != 0) {
+      if (InPos == InEnd) {
+        // Read large blocks straight into their destination.
+        if (Size >= BufferSize)
+          return readFD(Dst, Size);
+        if (InBuffer.empty())
+          InBuffer.resize(BufferSize);
+        ssize_t Read = readSome(InBuffer.data(), BufferSize);
+        if (Read < 0)
+          return errorCodeToError(
+              std::error_code(errno, std::generic_category()));
+        InPos = 0;
+        InEnd = Read;
+      }
+      size_t N = std::min<size_t>(Size, InEnd - InPos);
+      memcpy(Dst, InBuffer.data() + InPos, N);
+      InPos += N;
+      Dst += N;
+      Size -= N;
+    }
+    return Error::success();
+  }
+
+  Error appendBytes(const char *Src, unsigned Size) override {
+    assert(Src && "Attempt to append from null.");
+    std::lock_guard<std::mutex> Lock(OutMutex);
+    if (OutBuffer.size() + Size <= BufferSize) {
+      OutBuffer.insert(OutBuffer.end(), Src, Src + Size);
+      return Error::success();
+    }
+    if (auto Err = flush())
+      return Err;
+    if (Size >= BufferSize)
+      return writeFD(Src, Size);
+    OutBuffer.insert(OutBuffer.end(), Src, Src + Size);
+    return Error::success();
+  }
+
+  Error send() override {
+    std::lock_guard<std::mutex> Lock(OutMutex);
+    return flush();
+  }
+
+private:
+  static const size_t BufferSize = 64 * 1024;
+
+  ssize_t readSome(char *Dst, size_t Size) {
+    while (true) {
+#if defined(LLVM_ON_VALI)
+      ssize_t Read = ::read(InFD, (void *)Dst, Size);
+#else
+      ssize_t Read = ::read(InFD, Dst, Size);
+#endif
+      if (Read > 0)
+        return Read;
+      if (Read == 0) {
+        errno = EPIPE;
+        return -1;
+      }
+      if (errno != EAGAIN && errno != EINTR)
+        return -1;
+    }
+  }
+
+  Error readFD(char *Dst, size_t Size) {
+    while (Size != 0) {
+      ssize_t Read = readSome(Dst, Size);
+      if (Read < 0)
+        return errorCodeToError(
+            std::error_code(errno, std::generic_category()));
+      Dst += Read;
+      Size -= Read;
+    }
+    return Error::success();
+  }
+
+  Error writeFD(const char *Src, size_t Size) {
+    size_t Completed = 0;
+    while (Completed < Size) {
+#if defined(LLVM_ON_VALI)
+      ssize_t Written =
+          ::write(OutFD, (void *)(Src + Completed), Size - Completed);
+#else
+      ssize_t Written = ::write(OutFD, Src + Completed, Size - Completed);
+#endif
+      if (Written < 0) {
+        auto ErrNo = errno;
+        if (ErrNo == EAGAIN || ErrNo == EINTR)
+          continue;
+        return errorCodeToError(
+            std::error_code(ErrNo, std::generic_category()));
+      }
+      Completed += Written;
+    }
+    return Error::success();
+  }
+
+  // Must be called with OutMutex held.
+  Error flush() {
+    if (OutBuffer.empty())
+      return Error::success();
+    auto Err = writeFD(OutBuffer.data(), OutBuffer.size());
+    OutBuffer.clear();
+    return Err;
+  }
+
+  int InFD, OutFD;
+  std::vector<char> InBuffer;
+  size_t InPos = 0, InEnd = 0;
+  std::mutex OutMutex;
+  std::vector<char> OutBuffer;
+};
+
+} // end namespace rpc
+} // end namespace orc
+} // end namespace llvm
+
+#endif // LLVM_EXECUTIONENGINE_ORC_FDRAWBYTECHANNEL_H
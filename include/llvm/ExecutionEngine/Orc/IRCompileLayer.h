@@ -40,6 +40,13 @@ public:
 
   void setNotifyCompiled(NotifyCompiledFunction NotifyCompiled);
 
+  /// Returns the function this layer compiles modules with.
+  CompileFunction getCompileFunction() const;
+
+  /// Replaces the function this layer compiles modules with, e.g. to wrap the
+  /// current one in a CachingIRCompiler.
+  void setCompileFunction(CompileFunction Compile);
+
   void emit(MaterializationResponsibility R, ThreadSafeModule TSM) override;
 
 private:
@@ -13,6 +13,7 @@
 #ifndef LLVM_EXECUTIONENGINE_ORC_INDIRECTIONUTILS_H
 #define LLVM_EXECUTIONENGINE_ORC_INDIRECTIONUTILS_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Twine.h"
@@ -23,6 +24,7 @@
 #include "llvm/Support/Process.h"
 #include "llvm/Transforms/Utils/ValueMapper.h"
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstdint>
 #include <functional>
@@ -59,6 +61,9 @@ public:
   /// Returns an error if no trampoline can be created.
   virtual Expected<JITTargetAddress> getTrampoline() = 0;
 
+  /// Returns the given trampoline to the pool for re-use.
+  virtual void releaseTrampoline(JITTargetAddress TrampolineAddr) = 0;
+
 private:
   virtual void anchor();
 };
@@ -99,7 +104,7 @@ public:
   }
 
   /// Returns the given trampoline to the pool for re-use.
-  void releaseTrampoline(JITTargetAddress TrampolineAddr) {
+  void releaseTrampoline(JITTargetAddress TrampolineAddr) override {
     std::lock_guard<std::mutex> Lock(LTPMutex);
     AvailableTrampolines.push_back(TrampolineAddr);
   }
@@ -283,6 +288,11 @@ public:
   /// Change the value of the implementation pointer for the stub.
   virtual Error updatePointer(StringRef Name, JITTargetAddress NewAddr) = 0;
 
+  /// Remove the stubs with the given names. Their slots will be re-used by
+  /// later calls to createStub and createStubs. Names that have no stub are
+  /// ignored.
+  virtual void removeStubs(ArrayRef<StringRef> StubNames) = 0;
+
 private:
   virtual void anchor();
 };
@@ -353,10 +363,22 @@ public:
     auto Key = I->second.first;
     AtomicIntPtr *AtomicStubPtr = reinterpret_cast<AtomicIntPtr *>(
         IndirectStubsInfos[Key.first].getPtr(Key.second));
-    *AtomicStubPtr = static_cast<uintptr_t>(NewAddr);
+    AtomicStubPtr->store(static_cast<uintptr_t>(NewAddr),
+                         std::memory_order_release);
     return Error::success();
   }
 
+  void removeStubs(ArrayRef<StringRef> StubNames) override {
+    std::lock_guard<std::mutex> Lock(StubsMutex);
+    for (auto &Name : StubNames) {
+      auto I = StubIndexes.find(Name);
+      if (I == StubIndexes.end())
+        continue;
+      FreeStubs.push_back(I->second.first);
+      StubIndexes.erase(I);
+    }
+  }
+
 private:
   Error reserveStubs(unsigned NumStubs) {
     if (NumStubs <= FreeStubs.size())
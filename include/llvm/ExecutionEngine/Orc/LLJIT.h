@@ -13,16 +13,18 @@
 #ifndef LLVM_EXECUTIONENGINE_ORC_LLJIT_H
 #define LLVM_EXECUTIONENGINE_ORC_LLJIT_H
 
+#include "llvm/ExecutionEngine/Orc/CachingCompiler.h"
 #include "llvm/ExecutionEngine/Orc/CompileOnDemandLayer.h"
 #include "llvm/ExecutionEngine/Orc/CompileUtils.h"
 #include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
 #include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
 #include "llvm/ExecutionEngine/Orc/IRTransformLayer.h"
 #include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/MaterializationThreadPool.h"
 #include "llvm/ExecutionEngine/Orc/ObjectTransformLayer.h"
 #include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
 #include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
-#include "llvm/Support/ThreadPool.h"
+#include "llvm/ExecutionEngine/SlabMemoryManager.h"
 
 namespace llvm {
 namespace orc {
@@ -61,6 +63,10 @@ public:
   /// Adds an IR module to the given JITDylib.
   Error addIRModule(JITDylib &JD, ThreadSafeModule TSM);
 
+  /// Adds an IR module to the given JITDylib under the given key (see
+  /// removeModule).
+  Error addIRModule(JITDylib &JD, ThreadSafeModule TSM, VModuleKey K);
+
   /// Adds an IR module to the Main JITDylib.
   Error addIRModule(ThreadSafeModule TSM) {
     return addIRModule(Main, std::move(TSM));
@@ -69,11 +75,23 @@ public:
   /// Adds an object file to the given JITDylib.
   Error addObjectFile(JITDylib &JD, std::unique_ptr<MemoryBuffer> Obj);
 
+  /// Adds an object file to the given JITDylib under the given key (see
+  /// removeModule).
+  Error addObjectFile(JITDylib &JD, std::unique_ptr<MemoryBuffer> Obj,
+                      VModuleKey K);
+
   /// Adds an object file to the given JITDylib.
   Error addObjectFile(std::unique_ptr<MemoryBuffer> Obj) {
     return addObjectFile(Main, std::move(Obj));
   }
 
+  /// Removes the symbols of the module or object added under key K and frees
+  /// its code and data (see ExecutionSession::removeModule). K should have
+  /// been allocated with getExecutionSession().allocateVModule(). The static
+  /// constructors and destructors of the module that have not run yet are
+  /// dropped and will not be run by runConstructors or runDestructors.
+  Error removeModule(VModuleKey K);
+
   /// Look up a symbol in JITDylib JD by the symbol's linker-mangled name (to
   /// look up symbols based on their IR name use the lookup function instead).
   Expected<JITEvaluatedSymbol> lookupLinkerMangled(JITDylib &JD,
@@ -105,6 +123,32 @@ public:
   /// Returns a reference to the ObjLinkingLayer
   RTDyldObjectLinkingLayer &getObjLinkingLayer() { return ObjLinkingLayer; }
 
+  /// Returns the pool of compile threads of a multi-threaded instance, e.g.
+  /// to print its latency histograms, or null.
+  MaterializationThreadPool *getCompileThreads() { return CompileThreads.get(); }
+
+  /// Keep the objects compiled from IR modules in CacheDir, and load them from
+  /// there instead of compiling modules that were compiled before, possibly by
+  /// another process. The directory is created if needed and pruned according
+  /// to Policy. Hits and misses are counted on the ExecutionSession.
+  ///
+  /// Must be called before any IR modules are added.
+  Error enableObjectCache(StringRef CacheDir,
+                          CachePruningPolicy Policy = CachePruningPolicy());
+
+  /// Carve the code and data of JIT'd objects out of large slabs shared by
+  /// all objects, rather than mapping memory for each object separately.
+  ///
+  /// Must be called before any modules or objects are added.
+  void enableSlabAllocation(
+      JITSlabAllocator::Options Opts = JITSlabAllocator::Options());
+
+  /// Returns the slab allocator, e.g. to print its statistics, or null if
+  /// slab allocation is not enabled.
+  const JITSlabAllocator *getSlabAllocator() const {
+    return SlabAllocator.get();
+  }
+
 protected:
 
   /// Create an LLJIT instance with a single compile thread.
@@ -119,13 +163,20 @@ protected:
 
   Error applyDataLayout(Module &M);
 
-  void recordCtorDtors(Module &M);
+  void recordCtorDtors(Module &M, VModuleKey K);
+
+  std::unique_ptr<RuntimeDyld::MemoryManager> createMemoryManager();
 
   std::unique_ptr<ExecutionSession> ES;
   JITDylib &Main;
 
   DataLayout DL;
-  std::unique_ptr<ThreadPool> CompileThreads;
+  std::string TargetKey;
+  /// For multi-threaded instances, which have no TargetMachine of their own,
+  /// the builder to compute TargetKey with once the object cache is enabled.
+  Optional<JITTargetMachineBuilder> TargetKeyJTMB;
+  std::unique_ptr<MaterializationThreadPool> CompileThreads;
+  std::unique_ptr<JITSlabAllocator> SlabAllocator;
 
   RTDyldObjectLinkingLayer ObjLinkingLayer;
   IRCompileLayer CompileLayer;
@@ -157,9 +208,37 @@ public:
     CODLayer.setPartitionFunction(std::move(Partition));
   }
 
+  /// Compile up to MaxCallees likely callees of each lazily compiled function
+  /// ahead of their first call (see CompileOnDemandLayer::setSpeculation).
+  void setSpeculation(unsigned MaxCallees) {
+    CODLayer.setSpeculation(MaxCallees);
+  }
+
+  /// Returns the counts of speculatively compiled functions.
+  CompileOnDemandLayer::SpeculationStats getSpeculationStats() const {
+    return CODLayer.getSpeculationStats();
+  }
+
+  /// Enables tiered compilation. Functions are first compiled by the compile
+  /// layer of this JIT, which should be configured for fast compilation (e.g.
+  /// CodeGenOpt::None, which selects FastISel). Functions called Threshold
+  /// times are then recompiled on a background thread: OptimizeTransform (e.g.
+  /// an -O3 pass pipeline) is run on them and they are compiled with a
+  /// compiler built from OptimizingJTMB.
+  ///
+  /// Must be called before any lazy modules are added.
+  void enableTieredCompilation(
+      JITTargetMachineBuilder OptimizingJTMB, uint64_t Threshold,
+      IRTransformLayer::TransformFunction OptimizeTransform =
+          IRTransformLayer::identityTransform);
+
   /// Add a module to be lazily compiled to JITDylib JD.
   Error addLazyIRModule(JITDylib &JD, ThreadSafeModule M);
 
+  /// Add a module to be lazily compiled to JITDylib JD under the given key
+  /// (see removeModule).
+  Error addLazyIRModule(JITDylib &JD, ThreadSafeModule M, VModuleKey K);
+
   /// Add a module to be lazily compiled to the main JITDylib.
   Error addLazyIRModule(ThreadSafeModule M) {
     return addLazyIRModule(Main, std::move(M));
@@ -183,6 +262,8 @@ private:
   std::function<std::unique_ptr<IndirectStubsManager>()> ISMBuilder;
 
   IRTransformLayer TransformLayer;
+  std::unique_ptr<IRCompileLayer> TierUpCompileLayer;
+  std::unique_ptr<IRTransformLayer> TierUpTransformLayer;
   CompileOnDemandLayer CODLayer;
 };
 
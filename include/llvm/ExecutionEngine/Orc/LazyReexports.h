@@ -80,6 +80,11 @@ public:
       JITDylib &SourceJD, SymbolStringPtr SymbolName,
       std::shared_ptr<NotifyResolvedFunction> NotifyResolved);
 
+  /// Return the trampolines bound to the given symbols in SourceJD to the
+  /// trampoline pool. Used when the symbols are removed from SourceJD.
+  void releaseCallThroughTrampolines(JITDylib &SourceJD,
+                                     const SymbolNameSet &SymbolNames);
+
 protected:
   LazyCallThroughManager(ExecutionSession &ES,
                          JITTargetAddress ErrorHandlerAddr,
@@ -155,11 +160,15 @@ createLocalLazyCallThroughManager(const Triple &T, ExecutionSession &ES,
 /// the same as calling the re-exported symbol.
 class LazyReexportsMaterializationUnit : public MaterializationUnit {
 public:
-  LazyReexportsMaterializationUnit(LazyCallThroughManager &LCTManager,
-                                   IndirectStubsManager &ISManager,
-                                   JITDylib &SourceJD,
-                                   SymbolAliasMap CallableAliases,
-                                   VModuleKey K);
+  /// Called with the aliasee after a lazy re-export was called for the first
+  /// time and its stub was updated to point at the aliasee.
+  using NotifyFirstCallFunction =
+      std::function<void(JITDylib &SourceJD, const SymbolStringPtr &Aliasee)>;
+
+  LazyReexportsMaterializationUnit(
+      LazyCallThroughManager &LCTManager, IndirectStubsManager &ISManager,
+      JITDylib &SourceJD, SymbolAliasMap CallableAliases, VModuleKey K,
+      NotifyFirstCallFunction NotifyFirstCall = NotifyFirstCallFunction());
 
   StringRef getName() const override;
 
@@ -172,6 +181,7 @@ private:
   IndirectStubsManager &ISManager;
   JITDylib &SourceJD;
   SymbolAliasMap CallableAliases;
+  NotifyFirstCallFunction NotifyFirstCall;
   std::shared_ptr<LazyCallThroughManager::NotifyResolvedFunction>
       NotifyResolved;
 };
@@ -182,10 +192,12 @@ private:
 inline std::unique_ptr<LazyReexportsMaterializationUnit>
 lazyReexports(LazyCallThroughManager &LCTManager,
               IndirectStubsManager &ISManager, JITDylib &SourceJD,
-              SymbolAliasMap CallableAliases, VModuleKey K = VModuleKey()) {
+              SymbolAliasMap CallableAliases, VModuleKey K = VModuleKey(),
+              LazyReexportsMaterializationUnit::NotifyFirstCallFunction
+                  NotifyFirstCall = nullptr) {
   return llvm::make_unique<LazyReexportsMaterializationUnit>(
       LCTManager, ISManager, SourceJD, std::move(CallableAliases),
-      std::move(K));
+      std::move(K), std::move(NotifyFirstCall));
 }
 
 } // End namespace orc
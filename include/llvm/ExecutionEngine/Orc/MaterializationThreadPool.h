@@ -0,0 +1,186 @@
+//===- MaterializationThreadPool.h - Prioritized dispatch ------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// A thread pool for materializing MaterializationUnits that runs the units
+// blocking queries before speculative ones, balances load by work-stealing,
+// and records per-unit latency histograms.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_EXECUTIONENGINE_ORC_MATERIALIZATIONTHREADPOOL_H
+#define LLVM_EXECUTIONENGINE_ORC_MATERIALIZATIONTHREADPOOL_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ExecutionEngine/Orc/Core.h"
+#include "llvm/Support/raw_ostream.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace llvm {
+namespace orc {
+
+/// Dispatches materializations to a fixed set of worker threads.
+///
+/// Each worker has a queue per MaterializationPriority. Units dispatched from
+/// a worker thread, e.g. by a lookup made while materializing, go to that
+/// worker's queues, others are spread round-robin. An idle worker takes the
+/// newest blocking unit from its own queue, then steals the oldest blocking
+/// unit from another worker, and only then turns to speculative units in the
+/// same order. A speculative unit therefore never delays a blocking one that
+/// is already queued. A speculative unit that a blocking query starts waiting
+/// for is promoted to its worker's blocking queue.
+///
+/// For every unit the time spent queued and the time spent materializing are
+/// recorded in histograms keyed by the unit's name.
+///
+/// Install with:
+/// \code
+///   ES.setPrioritizedDispatchMaterialization(
+///       [&Pool](JITDylib &JD, std::unique_ptr<MaterializationUnit> MU,
+///               MaterializationPriority Priority) {
+///         Pool.dispatch(JD, std::move(MU), Priority);
+///       });
+///   ES.setPromoteMaterialization(
+///       [&Pool](JITDylib &JD, const SymbolNameSet &Symbols) {
+///         Pool.promote(JD, Symbols);
+///       });
+/// \endcode
+class MaterializationThreadPool {
+public:
+  /// A histogram of durations with power-of-two microsecond buckets: bucket
+  /// I counts durations below 2^I us (and at least 2^(I-1) us), the last
+  /// bucket counts everything longer.
+  class LatencyHistogram {
+  public:
+    static const unsigned NumBuckets = 24;
+
+    void add(std::chrono::microseconds Duration);
+
+    uint64_t getCount() const { return Count; }
+    std::chrono::microseconds getTotal() const { return Total; }
+    std::chrono::microseconds getMax() const { return Max; }
+    ArrayRef<uint64_t> getBuckets() const { return Buckets; }
+
+    /// Returns an upper bound for the P-th percentile (0 < P <= 100), i.e.
+    /// the upper end of the bucket it falls in.
+    std::chrono::microseconds getPercentileBound(double P) const;
+
+    void print(raw_ostream &OS) const;
+
+  private:
+    uint64_t Buckets[NumBuckets] = {};
+    uint64_t Count = 0;
+    std::chrono::microseconds Total{0};
+    std::chrono::microseconds Max{0};
+  };
+
+  /// Latencies of the units with a given name.
+  struct UnitLatencies {
+    /// From dispatch until a worker started materializing the unit.
+    LatencyHistogram Queued;
+    /// Spent in MaterializationUnit::doMaterialize.
+    LatencyHistogram Materializing;
+  };
+
+  /// Creates a pool with NumThreads workers.
+  explicit MaterializationThreadPool(unsigned NumThreads);
+
+  /// Materializes all queued units, then joins the workers.
+  ~MaterializationThreadPool();
+
+  /// Queues MU for materialization in JD.
+  void dispatch(JITDylib &JD, std::unique_ptr<MaterializationUnit> MU,
+                MaterializationPriority Priority);
+
+  /// Moves the speculative units defining any of Symbols in JD that are still
+  /// queued to the blocking queues.
+  void promote(JITDylib &JD, const SymbolNameSet &Symbols);
+
+  /// Blocks until every unit dispatched so far has been materialized.
+  void wait();
+
+  /// Returns the number of units a worker took from another worker's queue.
+  uint64_t getNumStolen() const { return NumStolen; }
+
+  /// Returns the number of speculative units promoted to blocking.
+  uint64_t getNumPromoted() const { return NumPromoted; }
+
+  /// Returns a snapshot of the latency histograms, keyed by unit name.
+  StringMap<UnitLatencies> getLatencies() const;
+
+  /// Prints the latency histograms.
+  void printLatencies(raw_ostream &OS) const;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Task {
+    JITDylib *JD = nullptr;
+    std::unique_ptr<MaterializationUnit> MU;
+    Clock::time_point Dispatched;
+
+    // The worker whose queues hold the task. A promoted task is in both of
+    // them; Taken and Promoted are guarded by that worker's mutex.
+    unsigned Worker = 0;
+    bool Taken = false;
+    bool Promoted = false;
+
+    // The symbols a speculative task is indexed under.
+    std::vector<SymbolStringPtr> Symbols;
+  };
+  using TaskPtr = std::shared_ptr<Task>;
+
+  struct Worker {
+    std::mutex Mutex;
+    std::deque<TaskPtr> Queues[2];
+  };
+
+  static unsigned getQueueIndex(MaterializationPriority Priority) {
+    return Priority == MaterializationPriority::Blocking ? 0 : 1;
+  }
+
+  bool takeTask(unsigned Self, TaskPtr &T);
+  void run(unsigned Self);
+  void materialize(Task &T);
+
+  std::vector<std::unique_ptr<Worker>> Workers;
+  std::vector<std::thread> Threads;
+
+  std::mutex StateMutex;
+  std::condition_variable WorkAvailable;
+  std::condition_variable AllDone;
+  // Units sitting in a queue, and units dispatched but not yet materialized.
+  int NumQueued = 0;
+  unsigned NumPending = 0;
+  bool ShuttingDown = false;
+
+  std::atomic<unsigned> NextWorker{0};
+  std::atomic<uint64_t> NumStolen{0};
+  std::atomic<uint64_t> NumPromoted{0};
+
+  // Queued speculative tasks by the symbols they define. Lock after, never
+  // while holding, a worker's mutex.
+  std::mutex SpeculativeMutex;
+  DenseMap<std::pair<JITDylib *, SymbolStringPtr>, TaskPtr> SpeculativeTasks;
+
+  mutable std::mutex LatenciesMutex;
+  StringMap<UnitLatencies> Latencies;
+};
+
+} // end namespace orc
+} // end namespace llvm
+
+#endif // LLVM_EXECUTIONENGINE_ORC_MATERIALIZATIONTHREADPOOL_H
@@ -110,41 +110,58 @@ public:
                                 uintptr_t RWDataSize,
                                 uint32_t RWDataAlign) override {
       Unmapped.push_back(ObjectAllocs());
-
-      LLVM_DEBUG(dbgs() << "Allocator " << Id << " reserved:\n");
-
-      if (CodeSize != 0) {
-        Unmapped.back().RemoteCodeAddr =
-            Client.reserveMem(Id, CodeSize, CodeAlign);
-
-        LLVM_DEBUG(
-            dbgs() << "  code: "
-                   << format("0x%016" PRIx64, Unmapped.back().RemoteCodeAddr)
-                   << " (" << CodeSize << " bytes, alignment " << CodeAlign
-                   << ")\n");
-      }
-
-      if (RODataSize != 0) {
-        Unmapped.back().RemoteRODataAddr =
-            Client.reserveMem(Id, RODataSize, RODataAlign);
-
-        LLVM_DEBUG(
-            dbgs() << "  ro-data: "
-                   << format("0x%016" PRIx64, Unmapped.back().RemoteRODataAddr)
-                   << " (" << RODataSize << " bytes, alignment " << RODataAlign
-                   << ")\n");
+      ObjectAllocs &Allocs = Unmapped.back();
+
+      if (Client.BatchMemoryCalls) {
+        // Reserve all of the object's segments in a single round trip.
+        std::vector<std::tuple<uint64_t, uint32_t>> Blocks;
+        std::vector<JITTargetAddress *> Addrs;
+        if (CodeSize != 0) {
+          Blocks.push_back(std::make_tuple(CodeSize, CodeAlign));
+          Addrs.push_back(&Allocs.RemoteCodeAddr);
+        }
+        if (RODataSize != 0) {
+          Blocks.push_back(std::make_tuple(RODataSize, RODataAlign));
+          Addrs.push_back(&Allocs.RemoteRODataAddr);
+        }
+        if (RWDataSize != 0) {
+          Blocks.push_back(std::make_tuple(RWDataSize, RWDataAlign));
+          Addrs.push_back(&Allocs.RemoteRWDataAddr);
+        }
+        std::vector<JITTargetAddress> Reserved =
+            Client.reserveMemBatch(Id, Blocks);
+        for (unsigned I = 0; I != Reserved.size(); ++I)
+          *Addrs[I] = Reserved[I];
+      } else {
+        if (CodeSize != 0)
+          Allocs.RemoteCodeAddr = Client.reserveMem(Id, CodeSize, CodeAlign);
+        if (RODataSize != 0)
+          Allocs.RemoteRODataAddr =
+              Client.reserveMem(Id, RODataSize, RODataAlign);
+        if (RWDataSize != 0)
+          Allocs.RemoteRWDataAddr =
+              Client.reserveMem(Id, RWDataSize, RWDataAlign);
       }
 
-      if (RWDataSize != 0) {
-        Unmapped.back().RemoteRWDataAddr =
-            Client.reserveMem(Id, RWDataSize, RWDataAlign);
+      LLVM_DEBUG(dbgs() << "Allocator " << Id << " reserved:\n");
 
-        LLVM_DEBUG(
-            dbgs() << "  rw-data: "
-                   << format("0x%016" PRIx64, Unmapped.back().RemoteRWDataAddr)
-                   << " (" << RWDataSize << " bytes, alignment " << RWDataAlign
-                   << ")\n");
-      }
+      if (CodeSize != 0)
+        LLVM_DEBUG(dbgs() << "  code: "
+                          << format("0x%016" PRIx64, Allocs.RemoteCodeAddr)
+                          << " (" << CodeSize << " bytes, alignment "
+                          << CodeAlign << ")\n");
+
+      if (RODataSize != 0)
+        LLVM_DEBUG(dbgs() << "  ro-data: "
+                          << format("0x%016" PRIx64, Allocs.RemoteRODataAddr)
+                          << " (" << RODataSize << " bytes, alignment "
+                          << RODataAlign << ")\n");
+
+      if (RWDataSize != 0)
+        LLVM_DEBUG(dbgs() << "  rw-data: "
+                          << format("0x%016" PRIx64, Allocs.RemoteRWDataAddr)
+                          << " (" << RWDataSize << " bytes, alignment "
+                          << RWDataAlign << ")\n");
     }
 
     bool needsToReserveAllocationSpace() override { return true; }
@@ -179,6 +196,9 @@ public:
     bool finalizeMemory(std::string *ErrMsg = nullptr) override {
       LLVM_DEBUG(dbgs() << "Allocator " << Id << " finalizing:\n");
 
+      if (Client.BatchMemoryCalls)
+        return finalizeMemoryBatched(ErrMsg);
+
       for (auto &ObjAllocs : Unfinalized) {
         if (copyAndProtect(ObjAllocs.CodeAllocs, ObjAllocs.RemoteCodeAddr,
                            sys::Memory::MF_READ | sys::Memory::MF_EXEC))
@@ -283,6 +303,67 @@ public:
       }
     }
 
+    // Sends the contents of every unfinalized section in one message and all
+    // of the permission changes in another, appends the EH frame
+    // registrations, and then waits for all of the results at once.
+    bool finalizeMemoryBatched(std::string *ErrMsg) {
+      std::vector<DirectBufferWriter> Writes;
+      std::vector<std::tuple<JITTargetAddress, uint32_t>> Protections;
+      for (auto &ObjAllocs : Unfinalized) {
+        addWrites(ObjAllocs.CodeAllocs, ObjAllocs.RemoteCodeAddr,
+                  sys::Memory::MF_READ | sys::Memory::MF_EXEC, Writes,
+                  Protections);
+        addWrites(ObjAllocs.RODataAllocs, ObjAllocs.RemoteRODataAddr,
+                  sys::Memory::MF_READ, Writes, Protections);
+        addWrites(ObjAllocs.RWDataAllocs, ObjAllocs.RemoteRWDataAddr,
+                  sys::Memory::MF_READ | sys::Memory::MF_WRITE, Writes,
+                  Protections);
+      }
+
+      // The section contents are copied into the channel as the calls are
+      // appended, so the local allocations can go as soon as they have been.
+      Error Err = Writes.empty()
+                      ? Error::success()
+                      : Client.appendAsync<mem::WriteMemBatch>(Writes);
+      if (!Err && !Protections.empty())
+        Err = Client.appendAsync<mem::SetProtectionsBatch>(Id, Protections);
+      for (auto &EHFrame : UnfinalizedEHFrames)
+        if (!Err)
+          Err = Client.appendAsync<eh::RegisterEHFrames>(
+              EHFrame.Addr, static_cast<uint32_t>(EHFrame.Size));
+      Err = joinErrors(std::move(Err), Client.completeAsyncCalls());
+      Unfinalized.clear();
+
+      if (Err) {
+        // FIXME: Replace this once finalizeMemory can return an Error.
+        if (ErrMsg) {
+          raw_string_ostream ErrOut(*ErrMsg);
+          logAllUnhandledErrors(std::move(Err), ErrOut);
+        } else
+          Client.ES.reportError(std::move(Err));
+        return true;
+      }
+
+      RegisteredEHFrames = std::move(UnfinalizedEHFrames);
+      UnfinalizedEHFrames = {};
+
+      return false;
+    }
+
+    void
+    addWrites(const std::vector<Alloc> &Allocs,
+              JITTargetAddress RemoteSegmentAddr, unsigned Permissions,
+              std::vector<DirectBufferWriter> &Writes,
+              std::vector<std::tuple<JITTargetAddress, uint32_t>> &Protections) {
+      if (!RemoteSegmentAddr)
+        return;
+      assert(!Allocs.empty() && "No sections in allocated segment");
+      for (auto &Alloc : Allocs)
+        Writes.push_back(DirectBufferWriter(
+            Alloc.getLocalAddress(), Alloc.getRemoteAddress(), Alloc.getSize()));
+      Protections.push_back(std::make_tuple(RemoteSegmentAddr, Permissions));
+    }
+
     // Copies data for each alloc in the list, then set permissions on the
     // segment.
     bool copyAndProtect(const std::vector<Alloc> &Allocs,
@@ -352,12 +433,26 @@ public:
       if (auto Err = reserveStubs(StubInits.size()))
         return Err;
 
-      for (auto &Entry : StubInits)
-        if (auto Err = createStubInternal(Entry.first(), Entry.second.first,
-                                          Entry.second.second))
-          return Err;
+      if (!Client.BatchMemoryCalls) {
+        for (auto &Entry : StubInits)
+          if (auto Err = createStubInternal(Entry.first(), Entry.second.first,
+                                            Entry.second.second))
+            return Err;
+        return Error::success();
+      }
 
-      return Error::success();
+      // Initialize all of the stub pointers with a single message, so that
+      // the number of calls in flight doesn't grow with the number of stubs.
+      std::vector<std::tuple<JITTargetAddress, JITTargetAddress>> Ptrs;
+      for (auto &Entry : StubInits) {
+        auto Key = FreeStubs.back();
+        FreeStubs.pop_back();
+        StubIndexes[Entry.first()] = std::make_pair(Key, Entry.second.second);
+        Ptrs.push_back(std::make_tuple(getPtrAddr(Key), Entry.second.first));
+      }
+      if (Ptrs.empty())
+        return Error::success();
+      return Client.callB<mem::WritePtrBatch>(Ptrs);
     }
 
     JITEvaluatedSymbol findStub(StringRef Name, bool ExportedStubsOnly) override {
@@ -388,6 +483,16 @@ public:
       return Client.writePointer(getPtrAddr(Key), NewAddr);
     }
 
+    void removeStubs(ArrayRef<StringRef> StubNames) override {
+      for (auto &Name : StubNames) {
+        auto I = StubIndexes.find(Name);
+        if (I == StubIndexes.end())
+          continue;
+        FreeStubs.push_back(I->second.first);
+        StubIndexes.erase(I);
+      }
+    }
+
   private:
     struct RemoteIndirectStubsInfo {
       JITTargetAddress StubBase;
@@ -465,6 +570,11 @@ public:
       return TrampolineAddr;
     }
 
+    void releaseTrampoline(JITTargetAddress TrampolineAddr) override {
+      std::lock_guard<std::mutex> Lock(RTPMutex);
+      AvailableTrampolines.push_back(TrampolineAddr);
+    }
+
   private:
     Error grow() {
       JITTargetAddress BlockAddr = 0;
@@ -577,6 +687,12 @@ public:
     return callB<utils::GetSymbolAddress>(Name);
   }
 
+  /// Coalesce the memory manager's section writes, permission changes and
+  /// reservations, and stub initializations, into a few messages that are
+  /// sent without waiting for each other's results. On by default; turn it off
+  /// to talk to a server that does not support the batched calls.
+  void setBatchMemoryCalls(bool Batch) { BatchMemoryCalls = Batch; }
+
   /// Get the triple for the remote target.
   const std::string &getTargetTriple() const { return RemoteTargetTriple; }
 
@@ -589,6 +705,9 @@ private:
         ES(ES) {
     ErrorAsOutParameter EAO(&Err);
 
+    // Mark the empty error checked: it is only ever moved from.
+    (void)!!AsyncCallErr;
+
     addHandler<utils::RequestCompile>(
         [this](JITTargetAddress Addr) -> JITTargetAddress {
           if (CallbackManager)
@@ -605,7 +724,7 @@ private:
   }
 
   void deregisterEHFrames(JITTargetAddress Addr, uint32_t Size) {
-    if (auto Err = callB<eh::RegisterEHFrames>(Addr, Size))
+    if (auto Err = callB<eh::DeregisterEHFrames>(Addr, Size))
       ES.reportError(std::move(Err));
   }
 
@@ -680,6 +799,41 @@ private:
     return callB<mem::WritePtr>(Addr, PtrVal);
   }
 
+  std::vector<JITTargetAddress>
+  reserveMemBatch(ResourceIdMgr::ResourceId Id,
+                  const std::vector<std::tuple<uint64_t, uint32_t>> &Blocks) {
+    if (auto AddrsOrErr = callB<mem::ReserveMemBatch>(Id, Blocks))
+      return std::move(*AddrsOrErr);
+    else {
+      ES.reportError(AddrsOrErr.takeError());
+      return {};
+    }
+  }
+
+  // Appends a call to Func without sending it or waiting for its result.
+  // Func must return void. The calls go out together, and their errors are
+  // collected, by the next completeAsyncCalls.
+  template <typename Func, typename... ArgTs>
+  Error appendAsync(const ArgTs &... Args) {
+    ++NumAsyncCalls;
+    return appendCallAsync<Func>(
+        [this](Error Err) {
+          --NumAsyncCalls;
+          AsyncCallErr = joinErrors(std::move(AsyncCallErr), std::move(Err));
+          return Error::success();
+        },
+        Args...);
+  }
+
+  // Sends the calls appended by appendAsync and waits until all of them have
+  // returned. Returns their errors, if any.
+  Error completeAsyncCalls() {
+    Error Err = sendAppendedCalls();
+    while (!Err && NumAsyncCalls != 0)
+      Err = handleOne();
+    return joinErrors(std::move(Err), std::move(AsyncCallErr));
+  }
+
   static Error doNothing() { return Error::success(); }
 
   ExecutionSession &ES;
@@ -691,6 +845,9 @@ private:
   uint32_t RemoteIndirectStubSize = 0;
   ResourceIdMgr AllocatorIds, IndirectStubOwnerIds;
   Optional<RemoteCompileCallbackManager> CallbackManager;
+  bool BatchMemoryCalls = true;
+  unsigned NumAsyncCalls = 0;
+  Error AsyncCallErr = Error::success();
 };
 
 } // end namespace remote
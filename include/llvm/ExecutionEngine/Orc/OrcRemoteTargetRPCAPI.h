@@ -251,6 +251,18 @@ namespace mem {
     static const char *getName() { return "ReserveMem"; }
   };
 
+  /// Reserve a block of memory on the remote for each (Size, Align) pair in
+  /// Blocks, via the given allocator. Returns the addresses in order.
+  class ReserveMemBatch
+      : public rpc::Function<
+            ReserveMemBatch,
+            std::vector<JITTargetAddress>(
+                ResourceIdMgr::ResourceId AllocID,
+                std::vector<std::tuple<uint64_t, uint32_t>> Blocks)> {
+  public:
+    static const char *getName() { return "ReserveMemBatch"; }
+  };
+
   /// Set the memory protection on a memory block.
   class SetProtections
       : public rpc::Function<SetProtections,
@@ -260,6 +272,17 @@ namespace mem {
     static const char *getName() { return "SetProtections"; }
   };
 
+  /// Set the memory protections on several memory blocks, given as
+  /// (Dst, ProtFlags) pairs.
+  class SetProtectionsBatch
+      : public rpc::Function<
+            SetProtectionsBatch,
+            void(ResourceIdMgr::ResourceId AllocID,
+                 std::vector<std::tuple<JITTargetAddress, uint32_t>> Blocks)> {
+  public:
+    static const char *getName() { return "SetProtectionsBatch"; }
+  };
+
   /// Write to a remote memory block.
   class WriteMem
       : public rpc::Function<WriteMem, void(remote::DirectBufferWriter DB)> {
@@ -267,6 +290,14 @@ namespace mem {
     static const char *getName() { return "WriteMem"; }
   };
 
+  /// Write to several remote memory blocks.
+  class WriteMemBatch
+      : public rpc::Function<WriteMemBatch,
+                             void(std::vector<remote::DirectBufferWriter> DBs)> {
+  public:
+    static const char *getName() { return "WriteMemBatch"; }
+  };
+
   /// Write to a remote pointer.
   class WritePtr : public rpc::Function<WritePtr, void(JITTargetAddress Dst,
                                                        JITTargetAddress Val)> {
@@ -274,6 +305,16 @@ namespace mem {
     static const char *getName() { return "WritePtr"; }
   };
 
+  /// Write to several remote pointers, given as (Dst, Val) pairs.
+  class WritePtrBatch
+      : public rpc::Function<
+            WritePtrBatch,
+            void(std::vector<std::tuple<JITTargetAddress, JITTargetAddress>>
+                     Ptrs)> {
+  public:
+    static const char *getName() { return "WritePtrBatch"; }
+  };
+
 } // end namespace mem
 
 /// RPC functions for remote stub and trampoline management.
@@ -70,9 +70,14 @@ public:
         *this, &ThisT::handleDestroyRemoteAllocator);
     addHandler<mem::ReadMem>(*this, &ThisT::handleReadMem);
     addHandler<mem::ReserveMem>(*this, &ThisT::handleReserveMem);
+    addHandler<mem::ReserveMemBatch>(*this, &ThisT::handleReserveMemBatch);
     addHandler<mem::SetProtections>(*this, &ThisT::handleSetProtections);
+    addHandler<mem::SetProtectionsBatch>(*this,
+                                         &ThisT::handleSetProtectionsBatch);
     addHandler<mem::WriteMem>(*this, &ThisT::handleWriteMem);
+    addHandler<mem::WriteMemBatch>(*this, &ThisT::handleWriteMemBatch);
     addHandler<mem::WritePtr>(*this, &ThisT::handleWritePtr);
+    addHandler<mem::WritePtrBatch>(*this, &ThisT::handleWritePtrBatch);
     addHandler<eh::RegisterEHFrames>(*this, &ThisT::handleRegisterEHFrames);
     addHandler<eh::DeregisterEHFrames>(*this, &ThisT::handleDeregisterEHFrames);
     addHandler<stubs::CreateIndirectStubsOwner>(
@@ -394,6 +399,20 @@ private:
     return AllocAddr;
   }
 
+  Expected<std::vector<JITTargetAddress>>
+  handleReserveMemBatch(ResourceIdMgr::ResourceId Id,
+                        std::vector<std::tuple<uint64_t, uint32_t>> Blocks) {
+    std::vector<JITTargetAddress> Addrs;
+    for (auto &Block : Blocks) {
+      if (auto AddrOrErr =
+              handleReserveMem(Id, std::get<0>(Block), std::get<1>(Block)))
+        Addrs.push_back(*AddrOrErr);
+      else
+        return AddrOrErr.takeError();
+    }
+    return Addrs;
+  }
+
   Error handleSetProtections(ResourceIdMgr::ResourceId Id,
                              JITTargetAddress Addr, uint32_t Flags) {
     auto I = Allocators.find(Id);
@@ -410,6 +429,16 @@ private:
     return Allocator.setProtections(LocalAddr, Flags);
   }
 
+  Error handleSetProtectionsBatch(
+      ResourceIdMgr::ResourceId Id,
+      std::vector<std::tuple<JITTargetAddress, uint32_t>> Blocks) {
+    for (auto &Block : Blocks)
+      if (auto Err =
+              handleSetProtections(Id, std::get<0>(Block), std::get<1>(Block)))
+        return Err;
+    return Error::success();
+  }
+
   Error handleTerminateSession() {
     TerminateFlag = true;
     return Error::success();
@@ -421,6 +450,15 @@ private:
     return Error::success();
   }
 
+  Error handleWriteMemBatch(std::vector<DirectBufferWriter> DBWs) {
+    // As with handleWriteMem, the contents were copied into place while the
+    // arguments were deserialized.
+    LLVM_DEBUG(for (auto &DBW : DBWs) dbgs()
+               << "  Writing " << DBW.getSize() << " bytes to "
+               << format("0x%016x", DBW.getDst()) << "\n");
+    return Error::success();
+  }
+
   Error handleWritePtr(JITTargetAddress Addr, JITTargetAddress PtrVal) {
     LLVM_DEBUG(dbgs() << "  Writing pointer *" << format("0x%016x", Addr)
                       << " = " << format("0x%016x", PtrVal) << "\n");
@@ -430,6 +468,14 @@ private:
     return Error::success();
   }
 
+  Error handleWritePtrBatch(
+      std::vector<std::tuple<JITTargetAddress, JITTargetAddress>> Ptrs) {
+    for (auto &P : Ptrs)
+      if (auto Err = handleWritePtr(std::get<0>(P), std::get<1>(P)))
+        return Err;
+    return Error::success();
+  }
+
   SymbolLookupFtor SymbolLookup;
   EHFrameRegistrationFtor EHFramesRegister, EHFramesDeregister;
   std::map<ResourceIdMgr::ResourceId, Allocator> Allocators;
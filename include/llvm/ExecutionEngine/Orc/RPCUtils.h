@@ -401,8 +401,12 @@ template <typename WireRetT, typename HandlerRetT, typename ChannelT,
           typename FunctionIdT, typename SequenceNumberT>
 Error respond(ChannelT &C, const FunctionIdT &ResponseId,
               SequenceNumberT SeqNo, Expected<HandlerRetT> ResultOrErr) {
-  return RespondHelper<SupportsErrorReturn<WireRetT>::value>::
-    template sendResult<WireRetT>(C, ResponseId, SeqNo, std::move(ResultOrErr));
+  if (auto Err = RespondHelper<SupportsErrorReturn<WireRetT>::value>::
+          template sendResult<WireRetT>(C, ResponseId, SeqNo,
+                                        std::move(ResultOrErr)))
+    return Err;
+  // The caller is waiting on this response: flush buffering channels.
+  return C.send();
 }
 
 // Send an empty response message on the given channel to indicate that
@@ -411,8 +415,10 @@ template <typename WireRetT, typename ChannelT, typename FunctionIdT,
           typename SequenceNumberT>
 Error respond(ChannelT &C, const FunctionIdT &ResponseId, SequenceNumberT SeqNo,
               Error Err) {
-  return RespondHelper<SupportsErrorReturn<WireRetT>::value>::
-    sendResult(C, ResponseId, SeqNo, std::move(Err));
+  if (auto Err2 = RespondHelper<SupportsErrorReturn<WireRetT>::value>::
+          sendResult(C, ResponseId, SeqNo, std::move(Err)))
+    return Err2;
+  return C.send();
 }
 
 // Converts a given type to the equivalent error return type.
@@ -1523,6 +1529,13 @@ public:
       return std::move(Err);
     }
 
+    if (auto Err = this->C.send()) {
+      this->abandonPendingResponses();
+      detail::ResultTraits<typename Func::ReturnType>::consumeAbandoned(
+          std::move(Result));
+      return std::move(Err);
+    }
+
     while (!ReceivedResponse) {
       if (auto Err = this->handleOne()) {
         detail::ResultTraits<typename Func::ReturnType>::consumeAbandoned(
@@ -27,6 +27,7 @@
 #include <cassert>
 #include <functional>
 #include <list>
+#include <map>
 #include <memory>
 #include <string>
 #include <utility>
@@ -35,7 +36,7 @@
 namespace llvm {
 namespace orc {
 
-class RTDyldObjectLinkingLayer : public ObjectLayer {
+class RTDyldObjectLinkingLayer : public ObjectLayer, public ResourceManager {
 public:
   /// Functor for receiving object-loaded notifications.
   using NotifyLoadedFunction =
@@ -55,10 +56,19 @@ public:
       NotifyLoadedFunction NotifyLoaded = NotifyLoadedFunction(),
       NotifyEmittedFunction NotifyEmitted = NotifyEmittedFunction());
 
+  ~RTDyldObjectLinkingLayer();
+
   /// Emit the object.
   void emit(MaterializationResponsibility R,
             std::unique_ptr<MemoryBuffer> O) override;
 
+  /// Deregisters the EH frames of the objects linked for the given module and
+  /// destroys their memory managers, returning the memory to them.
+  Error removeResources(VModuleKey K) override;
+
+  /// Returns the total size of the sections loaded for the given module.
+  uint64_t getResourceSize(VModuleKey K) const override;
+
   /// Set the 'ProcessAllSections' flag.
   ///
   /// If set to true, all sections in each object file will be allocated using
@@ -117,7 +127,14 @@ private:
   bool ProcessAllSections = false;
   bool OverrideObjectFlags = false;
   bool AutoClaimObjectSymbols = false;
-  std::vector<std::unique_ptr<RuntimeDyld::MemoryManager>> MemMgrs;
+
+  // The memory managers of the objects linked for a module, and the number of
+  // bytes of the sections loaded into them.
+  struct ModuleResources {
+    std::vector<std::unique_ptr<RuntimeDyld::MemoryManager>> MemMgrs;
+    uint64_t Size = 0;
+  };
+  std::map<VModuleKey, ModuleResources> Resources;
 };
 
 class LegacyRTDyldObjectLinkingLayerBase {
@@ -234,6 +234,20 @@ public:
   bool hasError();
   StringRef getErrorString();
 
+  /// Relocation work done by all RuntimeDyld instances in this process.
+  struct RelocationStats {
+    uint64_t NumRelocations = 0;
+    /// External symbols that relocations were resolved against, and the
+    /// number of resolver lookups made to find them.
+    uint64_t NumExternalSymbols = 0;
+    uint64_t NumLookups = 0;
+    /// Time spent applying relocations, not counting symbol lookups.
+    uint64_t ApplyNanoseconds = 0;
+  };
+
+  static RelocationStats getRelocationStats();
+  static void printRelocationStats(raw_ostream &OS);
+
   /// By default, only sections that are "required for execution" are passed to
   /// the RTDyldMemoryManager, and other sections are discarded. Passing 'true'
   /// to this method will cause RuntimeDyld to pass all sections to its
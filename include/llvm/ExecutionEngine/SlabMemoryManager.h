@@ -0,0 +1,219 @@
+//===- SlabMemoryManager.h - Slab-based memory manager for RtDyld -*- C++ -*-=//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains the declaration of a memory manager that carves section
+// memory out of large slabs shared by all the objects loaded into a JIT.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_EXECUTIONENGINE_SLABMEMORYMANAGER_H
+#define LLVM_EXECUTIONENGINE_SLABMEMORYMANAGER_H
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
+#include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/Support/Memory.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+class raw_ostream;
+
+/// Hands out page-granular ranges of JIT memory from large slabs.
+///
+/// Code and data are kept in separate slabs, so the code of many small objects
+/// ends up densely packed in a few slabs instead of being spread over one
+/// mapping per object. Ranges given back by memory managers (e.g. the unused
+/// tail of a reservation, or the memory of a destroyed memory manager) are
+/// reused for later requests. Slabs are only unmapped when the allocator is
+/// destroyed, so it must outlive all memory managers created from it.
+///
+/// With UseHugePages, slabs are aligned to and sized in multiples of
+/// HugePageSize and, on Unix, the operating system is asked to back them with
+/// transparent huge pages. Changing the protection of part of a huge page
+/// splits it, but once all the pages of a slab carry the same permissions the
+/// kernel may back them with a huge page again; handing out ranges in address
+/// order makes that likely for code slabs.
+///
+/// All methods are thread-safe.
+class JITSlabAllocator {
+public:
+  using AllocationPurpose = SectionMemoryManager::AllocationPurpose;
+
+  /// The huge page size assumed when UseHugePages is set.
+  static constexpr size_t HugePageSize = 2 * 1024 * 1024;
+
+  struct Options {
+    /// The size of each slab. Rounded up to the page size, or to HugePageSize
+    /// if UseHugePages is set. Requests larger than a slab get a slab of their
+    /// own.
+    size_t SlabSize = 4 * 1024 * 1024;
+
+    /// Ask the operating system to back slabs with transparent huge pages.
+    /// Only honored on Unix.
+    bool UseHugePages = false;
+  };
+
+  /// A snapshot of the state of the allocator.
+  struct Stats {
+    unsigned NumSlabs = 0;
+    uint64_t SlabBytes = 0;
+
+    /// Live memory managers, and the memory they hold. SectionBytes only counts
+    /// sections of finalized memory; the rest of ReservedBytes is alignment
+    /// padding and the unused part of their last page.
+    unsigned NumMemoryManagers = 0;
+    uint64_t ReservedBytes = 0;
+    uint64_t SectionBytes = 0;
+
+    /// Memory given back between ranges still in use.
+    uint64_t FreeBytes = 0;
+    unsigned NumFreeRanges = 0;
+    uint64_t LargestFreeRange = 0;
+
+    /// Memory of the current slabs that was never handed out.
+    uint64_t SlabTailBytes = 0;
+
+    uint64_t NumFinalizations = 0;
+    uint64_t NumProtectionChanges = 0;
+  };
+
+  /// Creates an allocator that maps slabs through \p MM, or directly through
+  /// sys::Memory if \p MM is null.
+  JITSlabAllocator(Options Opts,
+                   SectionMemoryManager::MemoryMapper *MM = nullptr);
+
+  /// Creates an allocator with default options.
+  JITSlabAllocator(SectionMemoryManager::MemoryMapper *MM = nullptr)
+      : JITSlabAllocator(Options(), MM) {}
+  JITSlabAllocator(const JITSlabAllocator &) = delete;
+  void operator=(const JITSlabAllocator &) = delete;
+  ~JITSlabAllocator();
+
+  /// Creates a memory manager backed by this allocator, e.g. for use as the
+  /// GetMemoryManager function of an RTDyldObjectLinkingLayer.
+  std::unique_ptr<RuntimeDyld::MemoryManager> createMemoryManager();
+
+  Stats getStats() const;
+  void printStats(raw_ostream &OS) const;
+
+private:
+  friend class SlabMemoryManager;
+
+  struct Pool {
+    std::vector<sys::MemoryBlock> Slabs;
+    // The part of the most recent slab that was never handed out.
+    uintptr_t Cur = 0, End = 0;
+    // Ranges given back, keyed by start address, coalesced.
+    std::map<uintptr_t, size_t> FreeRanges;
+  };
+
+  /// Returns a read-write range of at least \p Size bytes (rounded up to the
+  /// page size), or a null block if no memory could be mapped.
+  sys::MemoryBlock allocate(AllocationPurpose Purpose, size_t Size,
+                            std::error_code &EC);
+
+  /// Gives \p Block back. If \p Protected it is first made read-write again.
+  void release(AllocationPurpose Purpose, sys::MemoryBlock Block,
+               bool Protected);
+
+  std::error_code protect(const sys::MemoryBlock &Block, unsigned Flags);
+
+  Pool &getPool(AllocationPurpose Purpose) {
+    return Purpose == AllocationPurpose::Code ? CodePool : DataPool;
+  }
+  void addFreeRange(Pool &P, uintptr_t Start, size_t Size);
+
+  Options Opts;
+  SectionMemoryManager::MemoryMapper *MMapper;
+  size_t PageSize;
+
+  mutable std::mutex AllocatorMutex;
+  Pool CodePool, DataPool;
+  unsigned NumMemoryManagers = 0;
+  uint64_t ReservedBytes = 0;
+  uint64_t SectionBytes = 0;
+  uint64_t NumFinalizations = 0;
+  std::atomic<uint64_t> NumProtectionChanges{0};
+};
+
+/// A memory manager for RuntimeDyld that takes its memory from a
+/// JITSlabAllocator.
+///
+/// It asks RuntimeDyld to reserve space for each object up front, so an
+/// object's code, read-only data and read-write data each occupy one
+/// contiguous range. finalizeMemory then changes permissions with a single
+/// call per range, and gives the unused pages of each range back to the
+/// allocator. Sections allocated after a finalization go to fresh pages, so
+/// finalized memory is never writable and executable at the same time.
+///
+/// Destroying the memory manager returns all its memory to the allocator.
+class SlabMemoryManager : public RTDyldMemoryManager {
+public:
+  SlabMemoryManager(JITSlabAllocator &Slabs);
+  SlabMemoryManager(const SlabMemoryManager &) = delete;
+  void operator=(const SlabMemoryManager &) = delete;
+  ~SlabMemoryManager() override;
+
+  bool needsToReserveAllocationSpace() override { return true; }
+
+  void reserveAllocationSpace(uintptr_t CodeSize, uint32_t CodeAlign,
+                              uintptr_t RODataSize, uint32_t RODataAlign,
+                              uintptr_t RWDataSize,
+                              uint32_t RWDataAlign) override;
+
+  uint8_t *allocateCodeSection(uintptr_t Size, unsigned Alignment,
+                               unsigned SectionID,
+                               StringRef SectionName) override;
+
+  uint8_t *allocateDataSection(uintptr_t Size, unsigned Alignment,
+                               unsigned SectionID, StringRef SectionName,
+                               bool IsReadOnly) override;
+
+  bool finalizeMemory(std::string *ErrMsg = nullptr) override;
+
+private:
+  struct MemoryGroup {
+    // Ranges obtained from the allocator. Ranges before FirstPending have had
+    // their permissions applied; the last range is being allocated from,
+    // between Cur and End.
+    SmallVector<sys::MemoryBlock, 4> Ranges;
+    unsigned FirstPending = 0;
+    uintptr_t Cur = 0, End = 0;
+  };
+
+  uint8_t *allocateSection(MemoryGroup &MemGroup, uintptr_t Size,
+                           unsigned Alignment);
+  void reserve(MemoryGroup &MemGroup, uintptr_t Size, unsigned Alignment);
+  bool obtainRange(MemoryGroup &MemGroup, uintptr_t Size);
+  void trimCurrentRange(MemoryGroup &MemGroup);
+  std::error_code applyMemoryGroupPermissions(MemoryGroup &MemGroup,
+                                              unsigned Permissions);
+
+  JITSlabAllocator::AllocationPurpose
+  getPurpose(const MemoryGroup &MemGroup) const;
+
+  JITSlabAllocator &Slabs;
+  MemoryGroup CodeMem;
+  MemoryGroup RODataMem;
+  MemoryGroup RWDataMem;
+  // Bytes of sections allocated, and the part of them reported to Slabs.
+  uint64_t SectionBytes = 0;
+  uint64_t FinalizedSectionBytes = 0;
+};
+
+} // end namespace llvm
+
+#endif // LLVM_EXECUTIONENGINE_SLABMEMORYMANAGER_H
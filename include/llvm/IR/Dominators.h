@@ -266,7 +266,12 @@ public:
     initializeDominatorTreeWrapperPassPass(*PassRegistry::getPassRegistry());
   }
 
-  DominatorTree &getDomTree() { return DT; }
+  // The caller may change the CFG before it queries the tree, so apply the
+  // deferred updates now.
+  DominatorTree &getDomTree() {
+    DT.flushDeferredUpdates();
+    return DT;
+  }
   const DominatorTree &getDomTree() const { return DT; }
 
   bool runOnFunction(Function &F) override;
@@ -776,7 +776,11 @@ public:
         detail::AnalysisResultModel<IRUnitT, PassT, typename PassT::Result,
                                     PreservedAnalyses, Invalidator>;
 
-    return static_cast<ResultModelT &>(ResultConcept).Result;
+    // The caller may change the IR before it queries the result, so results
+    // that defer updates must catch up with the IR now.
+    auto &Result = static_cast<ResultModelT &>(ResultConcept).Result;
+    detail::flushDeferredUpdates(Result, 0);
+    return Result;
   }
 
   /// Get the cached result of an analysis pass for a given IR unit.
@@ -797,7 +801,9 @@ public:
         detail::AnalysisResultModel<IRUnitT, PassT, typename PassT::Result,
                                     PreservedAnalyses, Invalidator>;
 
-    return &static_cast<ResultModelT *>(ResultConcept)->Result;
+    auto &Result = static_cast<ResultModelT *>(ResultConcept)->Result;
+    detail::flushDeferredUpdates(Result, 0);
+    return &Result;
   }
 
   /// Register an analysis pass with the manager.
@@ -890,6 +896,12 @@ public:
 
     // Now erase the results that were marked above as invalidated.
     if (!IsResultInvalidated.empty()) {
+      // Report the invalidated results to the instrumentation, if it is set up
+      // for this IR unit.
+      PassInstrumentation *PI = nullptr;
+      if (AnalysisPasses.count(PassInstrumentationAnalysis::ID()))
+        PI = getCachedResult<PassInstrumentationAnalysis>(IR);
+
       for (auto I = ResultsList.begin(), E = ResultsList.end(); I != E;) {
         AnalysisKey *ID = I->first;
         if (!IsResultInvalidated.lookup(ID)) {
@@ -901,6 +913,9 @@ public:
           dbgs() << "Invalidating analysis: " << this->lookUpPass(ID).name()
                  << " on " << IR.getName() << "\n";
 
+        if (PI)
+          PI->runAnalysisInvalidated(this->lookUpPass(ID), IR);
+
         I = ResultsList.erase(I);
         AnalysisResults.erase({ID, &IR});
       }
@@ -231,6 +231,15 @@ struct AnalysisResultModel<IRUnitT, PassT, ResultT, PreservedAnalysesT,
   ResultT Result;
 };
 
+/// Applies the updates an analysis result has deferred, for results that can
+/// defer updates until they are queried, like dominator trees.
+template <typename ResultT>
+auto flushDeferredUpdates(ResultT &Result, int)
+    -> decltype(Result.flushDeferredUpdates()) {
+  return Result.flushDeferredUpdates();
+}
+template <typename ResultT> void flushDeferredUpdates(ResultT &, long) {}
+
 /// Abstract concept of an analysis pass.
 ///
 /// This concept is parameterized over the IR unit that it can run over and
@@ -182,13 +182,23 @@ private:
   bool fragmentNeedsRelaxation(const MCRelaxableFragment *IF,
                                const MCAsmLayout &Layout) const;
 
+  /// Per-section bookkeeping of the incremental relaxation engine: which
+  /// fragments may need relaxation, which fragment sizes their fixups depend
+  /// on, and which fragments changed size in the previous round.
+  struct RelaxationState;
+
   /// Perform one layout iteration and return true if any offsets
   /// were adjusted.
-  bool layoutOnce(MCAsmLayout &Layout);
+  bool layoutOnce(MCAsmLayout &Layout, RelaxationState &State);
 
   /// Perform one layout iteration of the given section and return true
   /// if any offsets were adjusted.
-  bool layoutSectionOnce(MCAsmLayout &Layout, MCSection &Sec);
+  bool layoutSectionOnce(MCAsmLayout &Layout, MCSection &Sec,
+                         RelaxationState &State);
+
+  /// Relax \p F if it is a fragment kind that may need relaxation. Returns
+  /// true if its size or contents changed.
+  bool relaxFragment(MCAsmLayout &Layout, MCFragment &F);
 
   bool relaxInstruction(MCAsmLayout &Layout, MCRelaxableFragment &IF);
 
@@ -31,7 +31,7 @@ private:
   unsigned Alignment;
   bool Finalized = false;
 
-  void finalizeStringTable(bool Optimize);
+  void finalizeStringTable(bool Optimize, bool Parallel = false);
   void initSize();
 
 public:
@@ -48,6 +48,11 @@ public:
   /// be added after this point.
   void finalize();
 
+  /// Like finalize, but sorts the strings on multiple threads if there are
+  /// enough of them to pay for it. The resulting table is identical to the
+  /// one built by finalize.
+  void finalizeParallel();
+
   /// Finalize the string table without reording it. In this mode, offsets
   /// returned by add will still be valid.
   void finalizeInOrder();
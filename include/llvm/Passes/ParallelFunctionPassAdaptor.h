@@ -0,0 +1,79 @@
+//===- ParallelFunctionPassAdaptor.h ---------------------------*- C++ -*--===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file
+///
+/// This header defines a module pass adaptor that runs a function pass
+/// pipeline over the functions of a module on several threads.
+///
+/// LLVMContext is not thread-safe: constants, types and metadata are uniqued in
+/// the context and shared constants carry use-lists that every function
+/// updates. Rather than locking all of that, the adaptor gives each thread its
+/// own LLVMContext. The module is split into partitions of whole functions,
+/// each partition is serialized to bitcode and optimized in a private context,
+/// and the optimized function bodies are linked back into the original module
+/// in partition order, so the output does not depend on thread scheduling.
+///
+/// The output is not guaranteed to match the serial function(...) pipeline, so
+/// the adaptor is only used when a pipeline asks for parallel-function(...)
+/// explicitly; no default pipeline uses it. Each partition is optimized
+/// without any of the state of the outer pipeline:
+///
+/// - the default AA pipeline is used instead of -aa-pipeline,
+/// - PassBuilder callbacks and pass instrumentation are not run,
+/// - cached module analyses (GlobalsAA, ProfileSummaryInfo, ...) are not
+///   available,
+/// - local globals have external linkage while the partition is optimized,
+///   and every partition has its own copy of every global variable definition.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_PASSES_PARALLELFUNCTIONPASSADAPTOR_H
+#define LLVM_PASSES_PARALLELFUNCTIONPASSADAPTOR_H
+
+#include "llvm/IR/PassManager.h"
+#include <functional>
+
+namespace llvm {
+
+class Module;
+
+/// A module pass that runs a function pipeline over the functions of a module
+/// concurrently.
+///
+/// Each partition only contains declarations of the functions in the other
+/// partitions, so the pipeline must only consist of function passes, which
+/// can't look at or change other functions anyway. Modules the adaptor can't
+/// split and merge back faithfully (modules with debug info, unnamed globals or
+/// address-taken blocks) are processed serially instead.
+class ParallelModuleToFunctionPassAdaptor
+    : public PassInfoMixin<ParallelModuleToFunctionPassAdaptor> {
+public:
+  /// Runs the function pipeline over every function defined in a module.
+  ///
+  /// The callback is called concurrently, each time for a module in a
+  /// different LLVMContext, so it must set up its own pass and analysis
+  /// managers and must not share IR-related state between calls.
+  using RunPipelineFn = std::function<void(Module &)>;
+
+  /// \p Threads is the maximum number of threads to use. If it is zero, the
+  /// value of -parallel-function-threads is used, and if that is zero too, one
+  /// thread per hardware thread.
+  explicit ParallelModuleToFunctionPassAdaptor(RunPipelineFn RunPipeline,
+                                               unsigned Threads = 0)
+      : RunPipeline(std::move(RunPipeline)), Threads(Threads) {}
+
+  PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM);
+
+private:
+  RunPipelineFn RunPipeline;
+  unsigned Threads;
+};
+
+} // end namespace llvm
+
+#endif // LLVM_PASSES_PARALLELFUNCTIONPASSADAPTOR_H
@@ -15,10 +15,15 @@
 #ifndef LLVM_PASSES_STANDARDINSTRUMENTATIONS_H
 #define LLVM_PASSES_STANDARDINSTRUMENTATIONS_H
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Optional.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/IR/PassInstrumentation.h"
 #include "llvm/IR/PassTimingInfo.h"
 
+#include <chrono>
+#include <map>
 #include <string>
 #include <utility>
 
@@ -53,11 +58,106 @@ private:
   bool StoreModuleDesc = false;
 };
 
+/// Instrumentation to report how well analysis results are reused across a
+/// pipeline (-analysis-reuse-report).
+///
+/// It counts the analysis computations each pass requests and the analysis
+/// results each pass invalidates, with the time spent computing them. When an
+/// analysis is computed again on an IR unit it was invalidated on, the
+/// recomputation is charged to the invalidating pass. Passes that invalidate
+/// analyses on IR they didn't change are flagged as over-invalidating; to find
+/// them, the IR unit is hashed before and after every pass, so the report is
+/// meant for compile-time investigations rather than regular builds.
+class AnalysisReuseReport {
+public:
+  /// Writes the JSON report to \p ReportFile ("-" for stdout) when destroyed.
+  explicit AnalysisReuseReport(std::string ReportFile = "");
+  ~AnalysisReuseReport();
+
+  AnalysisReuseReport(const AnalysisReuseReport &) = delete;
+  void operator=(const AnalysisReuseReport &) = delete;
+
+  void registerCallbacks(PassInstrumentationCallbacks &PIC);
+
+  /// Prints the report collected so far.
+  void print(raw_ostream &OS) const;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  /// Counters for a (pass, analysis) pair.
+  struct PairCounters {
+    unsigned Computed = 0;
+    unsigned Invalidated = 0;
+    unsigned InvalidatedWithoutChange = 0;
+    unsigned Recomputed = 0;
+    Clock::duration ComputeTime = Clock::duration::zero();
+    Clock::duration RecomputeTime = Clock::duration::zero();
+    /// Time spent recomputing results invalidated without changing the IR.
+    Clock::duration WastedTime = Clock::duration::zero();
+  };
+
+  struct PassCounters {
+    unsigned Runs = 0;
+    unsigned RunsWithoutChange = 0;
+  };
+
+  struct RunningPass {
+    StringRef Name;
+    /// Hash of the IR unit before the pass ran. Not computed for pass
+    /// managers, adaptors and repeated-pass wrappers, which only forward what
+    /// their passes preserve.
+    Optional<size_t> IRHash;
+  };
+
+  struct RunningAnalysis {
+    StringRef Name;
+    const void *IR;
+    StringRef RequestedBy;
+    Clock::time_point Start;
+    /// Time spent computing analyses this one requested.
+    Clock::duration NestedTime;
+  };
+
+  struct Invalidation {
+    StringRef Pass;
+    bool WithoutChange;
+  };
+
+  /// Drops the passes above the innermost running \p PassID from PassStack.
+  /// They were skipped by another BeforePass callback.
+  void popSkippedPasses(StringRef PassID);
+  bool beforePass(StringRef PassID, Any IR);
+  void afterPass(StringRef PassID, Any IR);
+  void afterPassInvalidated(StringRef PassID);
+  void beforeAnalysis(StringRef AnalysisID, Any IR);
+  void afterAnalysis(StringRef AnalysisID, Any IR);
+  void analysisInvalidated(StringRef AnalysisID, Any IR);
+
+  std::string ReportFile;
+  SmallVector<RunningPass, 8> PassStack;
+  SmallVector<RunningAnalysis, 8> AnalysisStack;
+  /// The pass that has just finished, which is the one the analysis manager
+  /// invalidates results for.
+  Optional<Invalidation> LastPass;
+  /// Whether LastPass is a pass manager or adaptor, whose invalidations are
+  /// not charged to it.
+  bool LastPassForwards = false;
+  /// The last invalidation of each analysis result that has not been
+  /// recomputed yet, by analysis and IR unit.
+  DenseMap<std::pair<StringRef, const void *>, Invalidation> InvalidatedBy;
+  /// The last invalidation of each analysis result charged to a pass.
+  DenseMap<std::pair<StringRef, const void *>, Invalidation> LastInvalidatedBy;
+  std::map<std::pair<StringRef, StringRef>, PairCounters> Pairs;
+  StringMap<PassCounters> Passes;
+};
+
 /// This class provides an interface to register all the standard pass
 /// instrumentations and manages their state (if any).
 class StandardInstrumentations {
   PrintIRInstrumentation PrintIR;
   TimePassesHandler TimePasses;
+  std::unique_ptr<AnalysisReuseReport> AnalysisReuse;
 
 public:
   StandardInstrumentations() = default;
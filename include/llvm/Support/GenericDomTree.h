@@ -30,6 +30,7 @@
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/CFGUpdate.h"
+#include "llvm/Support/Compiler.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <cassert>
@@ -248,6 +249,12 @@ protected:
   mutable bool DFSInfoValid = false;
   mutable unsigned int SlowQueries = 0;
 
+  /// Updates that are applied the next time the tree is queried or updated.
+  SmallVector<UpdateType, 4> DeferredUpdates;
+  /// Set once so many updates were deferred that recalculating the tree is
+  /// cheaper than applying them.
+  bool RecalculateDeferred = false;
+
   friend struct DomTreeBuilder::SemiNCAInfo<DominatorTreeBase>;
 
  public:
@@ -259,7 +266,9 @@ protected:
         RootNode(Arg.RootNode),
         Parent(Arg.Parent),
         DFSInfoValid(Arg.DFSInfoValid),
-        SlowQueries(Arg.SlowQueries) {
+        SlowQueries(Arg.SlowQueries),
+        DeferredUpdates(std::move(Arg.DeferredUpdates)),
+        RecalculateDeferred(Arg.RecalculateDeferred) {
     Arg.wipe();
   }
 
@@ -270,6 +279,8 @@ protected:
     Parent = RHS.Parent;
     DFSInfoValid = RHS.DFSInfoValid;
     SlowQueries = RHS.SlowQueries;
+    DeferredUpdates = std::move(RHS.DeferredUpdates);
+    RecalculateDeferred = RHS.RecalculateDeferred;
     RHS.wipe();
     return *this;
   }
@@ -281,7 +292,10 @@ protected:
   /// multiple blocks if we are computing post dominators.  For forward
   /// dominators, this will always be a single block (the entry node).
   ///
-  const SmallVectorImpl<NodeT *> &getRoots() const { return Roots; }
+  const SmallVectorImpl<NodeT *> &getRoots() const {
+    assert(!hasDeferredUpdates() && "Querying a tree with deferred updates");
+    return Roots;
+  }
 
   /// isPostDominator - Returns true if analysis based of postdoms
   ///
@@ -290,6 +304,8 @@ protected:
   /// compare - Return false if the other dominator tree base matches this
   /// dominator tree base. Otherwise return true.
   bool compare(const DominatorTreeBase &Other) const {
+    assert(!hasDeferredUpdates() && !Other.hasDeferredUpdates() &&
+           "Comparing trees with deferred updates");
     if (Parent != Other.Parent) return true;
 
     if (Roots.size() != Other.Roots.size())
@@ -326,6 +342,7 @@ protected:
   /// may (but is not required to) be null for a forward (backwards)
   /// statically unreachable block.
   DomTreeNodeBase<NodeT> *getNode(const NodeT *BB) const {
+    assert(!hasDeferredUpdates() && "Querying a tree with deferred updates");
     auto I = DomTreeNodes.find(BB);
     if (I != DomTreeNodes.end())
       return I->second.get();
@@ -344,8 +361,14 @@ protected:
   /// post-dominance information must be capable of dealing with this
   /// possibility.
   ///
-  DomTreeNodeBase<NodeT> *getRootNode() { return RootNode; }
-  const DomTreeNodeBase<NodeT> *getRootNode() const { return RootNode; }
+  DomTreeNodeBase<NodeT> *getRootNode() {
+    assert(!hasDeferredUpdates() && "Querying a tree with deferred updates");
+    return RootNode;
+  }
+  const DomTreeNodeBase<NodeT> *getRootNode() const {
+    assert(!hasDeferredUpdates() && "Querying a tree with deferred updates");
+    return RootNode;
+  }
 
   /// Get all nodes dominated by R, including R itself.
   void getDescendants(NodeT *R, SmallVectorImpl<NodeT *> &Result) const {
@@ -436,6 +459,7 @@ protected:
   bool dominates(const NodeT *A, const NodeT *B) const;
 
   NodeT *getRoot() const {
+    assert(!hasDeferredUpdates() && "Querying a tree with deferred updates");
     assert(this->Roots.size() == 1 && "Should always have entry node!");
     return this->Roots[0];
   }
@@ -518,9 +542,45 @@ protected:
   /// \param Updates An unordered sequence of updates to perform.
   ///
   void applyUpdates(ArrayRef<UpdateType> Updates) {
+    flushDeferredUpdates();
     DomTreeBuilder::ApplyUpdates(*this, Updates);
   }
 
+  /// Inform the dominator tree about a sequence of CFG edge insertions and
+  /// deletions like applyUpdates(), but only update the tree when
+  /// flushDeferredUpdates() is called or the tree is updated again. The
+  /// updates deferred until then are applied as a single batch, and dropped in
+  /// favor of recalculating the tree if there are more of them than nodes in
+  /// the tree.
+  ///
+  /// The tree must not be queried until the updates are flushed; queries
+  /// assert that nothing is pending. The CFG must not be changed any further
+  /// until then either, except for changes the tree is told about with more
+  /// deferred updates. Blocks mentioned in the updates must not be deleted
+  /// before that either.
+  void deferUpdates(ArrayRef<UpdateType> Updates) {
+    assert(Parent && "Deferring updates for a tree that was never calculated");
+    if (RecalculateDeferred)
+      return;
+    DeferredUpdates.append(Updates.begin(), Updates.end());
+    if (DeferredUpdates.size() > DomTreeNodes.size()) {
+      DeferredUpdates.clear();
+      RecalculateDeferred = true;
+    }
+  }
+
+  /// Returns true if there are updates that haven't been applied yet.
+  bool hasDeferredUpdates() const {
+    return !DeferredUpdates.empty() || RecalculateDeferred;
+  }
+
+  /// Applies the updates deferred by deferUpdates(). Every update of the tree
+  /// does so first; the owner of the tree must do so before it is queried.
+  void flushDeferredUpdates() {
+    if (LLVM_UNLIKELY(hasDeferredUpdates()))
+      applyDeferredUpdates();
+  }
+
   /// Inform the dominator tree about a CFG edge insertion and update the tree.
   ///
   /// This function has to be called just before or just after making the update
@@ -535,6 +595,7 @@ protected:
     assert(To);
     assert(From->getParent() == Parent);
     assert(To->getParent() == Parent);
+    flushDeferredUpdates();
     DomTreeBuilder::InsertEdge(*this, From, To);
   }
 
@@ -553,6 +614,7 @@ protected:
     assert(To);
     assert(From->getParent() == Parent);
     assert(To->getParent() == Parent);
+    flushDeferredUpdates();
     DomTreeBuilder::DeleteEdge(*this, From, To);
   }
 
@@ -730,11 +792,15 @@ public:
   /// recalculate - compute a dominator tree for the given function
   void recalculate(ParentType &Func) {
     Parent = &Func;
+    DeferredUpdates.clear();
+    RecalculateDeferred = false;
     DomTreeBuilder::Calculate(*this);
   }
 
   void recalculate(ParentType &Func, ArrayRef<UpdateType> Updates) {
     Parent = &Func;
+    DeferredUpdates.clear();
+    RecalculateDeferred = false;
     DomTreeBuilder::CalculateWithUpdates(*this, Updates);
   }
 
@@ -753,6 +819,7 @@ public:
   ///             Takes O(N^2) time worst case, but is faster in practise (same
   ///             as tree construction).
   bool verify(VerificationLevel VL = VerificationLevel::Full) const {
+    assert(!hasDeferredUpdates() && "Verifying a tree with deferred updates");
     return DomTreeBuilder::Verify(*this, VL);
   }
 
@@ -766,6 +833,19 @@ protected:
     Parent = nullptr;
     DFSInfoValid = false;
     SlowQueries = 0;
+    DeferredUpdates.clear();
+    RecalculateDeferred = false;
+  }
+
+  void applyDeferredUpdates() {
+    if (RecalculateDeferred) {
+      recalculate(*Parent);
+      return;
+    }
+    // Applying the updates queries the tree, so take them out first.
+    SmallVector<UpdateType, 4> Updates;
+    Updates.swap(DeferredUpdates);
+    DomTreeBuilder::ApplyUpdates(*this, Updates);
   }
 
   // NewBB is split and now it has one successor. Update dominator tree to
@@ -851,6 +931,8 @@ protected:
     DomTreeNodes.clear();
     RootNode = nullptr;
     Parent = nullptr;
+    DeferredUpdates.clear();
+    RecalculateDeferred = false;
   }
 };
 
@@ -0,0 +1,84 @@
+//===- InstCombineChangeLog.h - Changes since the last instcombine -*- C++ -*-//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file
+///
+/// This file defines the change log incremental instcombine uses to find the
+/// instructions that were touched since instcombine last ran on a function.
+///
+/// The IR has no hook that fires when an instruction is created, moved or has
+/// an operand replaced, so the log doesn't record mutations as they happen.
+/// Instead it keeps a fingerprint of every instruction as instcombine left it
+/// and compares against those when instcombine runs again. An instruction is
+/// touched if it is new, or if its opcode, type, flags, operands, number of
+/// uses or position changed.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_INSTCOMBINE_INSTCOMBINECHANGELOG_H
+#define LLVM_TRANSFORMS_INSTCOMBINE_INSTCOMBINECHANGELOG_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/PassManager.h"
+
+namespace llvm {
+
+class Function;
+class Instruction;
+
+/// Returns true if instcombine only seeds its worklist with the instructions
+/// touched since it last ran on the function (-instcombine-incremental).
+bool isInstCombineIncrementalEnabled();
+
+/// The instructions of a function as instcombine last left them.
+class InstCombineChangeLog {
+public:
+  /// Returns true if instcombine has run on the function before, so that the
+  /// touched instructions are known.
+  bool hasSnapshot() const { return HasSnapshot; }
+
+  /// Records the current state of \p F as the one instcombine left it in.
+  void recordSnapshot(const Function &F);
+
+  /// Adds the instructions of \p F touched since the last snapshot to
+  /// \p Touched, along with the ones whose folds may have been enabled by the
+  /// change: their instruction operands, and all of their transitive users,
+  /// since known bits and other facts flow through any number of users.
+  void collectTouched(const Function &F,
+                      SmallPtrSetImpl<const Instruction *> &Touched) const;
+
+  /// The log tracks changes by itself, so other passes never invalidate it.
+  bool invalidate(Function &, const PreservedAnalyses &,
+                  FunctionAnalysisManager::Invalidator &) {
+    return false;
+  }
+
+private:
+  /// An address is only mistaken for an erased instruction if the instruction
+  /// now there has the same fingerprint, i.e. it is the same instruction at
+  /// the same place, which instcombine has already seen.
+  DenseMap<const Instruction *, size_t> Fingerprints;
+  bool HasSnapshot = false;
+};
+
+/// Provides the instcombine change log of a function. The result is only
+/// populated by instcombine itself.
+class InstCombineChangeLogAnalysis
+    : public AnalysisInfoMixin<InstCombineChangeLogAnalysis> {
+  friend AnalysisInfoMixin<InstCombineChangeLogAnalysis>;
+  static AnalysisKey Key;
+
+public:
+  using Result = InstCombineChangeLog;
+
+  InstCombineChangeLog run(Function &F, FunctionAnalysisManager &AM);
+};
+
+} // end namespace llvm
+
+#endif // LLVM_TRANSFORMS_INSTCOMBINE_INSTCOMBINECHANGELOG_H
@@ -24,6 +24,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/AliasQueryCache.h"
 #include "llvm/Analysis/BasicAliasAnalysis.h"
 #include "llvm/Analysis/CFLAndersAliasAnalysis.h"
 #include "llvm/Analysis/CFLSteensAliasAnalysis.h"
@@ -61,7 +62,8 @@ static cl::opt<bool> DisableBasicAA("disable-basicaa", cl::Hidden,
                                     cl::init(false));
 
 AAResults::AAResults(AAResults &&Arg)
-    : TLI(Arg.TLI), AAs(std::move(Arg.AAs)), AADeps(std::move(Arg.AADeps)) {
+    : TLI(Arg.TLI), AAs(std::move(Arg.AAs)), AADeps(std::move(Arg.AADeps)),
+      QueryCache(Arg.QueryCache) {
   for (auto &AA : AAs)
     AA->setAAResults(this);
 }
@@ -105,12 +107,26 @@ AliasResult AAResults::alias(const MemoryLocation &LocA,
 
 AliasResult AAResults::alias(const MemoryLocation &LocA,
                              const MemoryLocation &LocB, AAQueryInfo &AAQI) {
+  // Only top-level queries are cached: nested ones may rely on assumptions
+  // the outer query has not verified yet. The cache is only used by passes
+  // that promised not to change the IR.
+  bool UseCache = QueryCache && QueryCache->isActive() && AAQI.Depth == 0;
+  if (UseCache)
+    if (Optional<AliasResult> Cached = QueryCache->lookup(LocA, LocB))
+      return *Cached;
+
+  AliasResult Result = MayAlias;
+  ++AAQI.Depth;
   for (const auto &AA : AAs) {
-    auto Result = AA->alias(LocA, LocB, AAQI);
+    Result = AA->alias(LocA, LocB, AAQI);
     if (Result != MayAlias)
-      return Result;
+      break;
   }
-  return MayAlias;
+  --AAQI.Depth;
+
+  if (UseCache)
+    QueryCache->insert(LocA, LocB, Result);
+  return Result;
 }
 
 bool AAResults::pointsToConstantMemory(const MemoryLocation &Loc,
@@ -725,6 +741,15 @@ AAResults::Concept::~Concept() = default;
 // Provide a definition for the static object used to identify passes.
 AnalysisKey AAManager::Key;
 
+AAResults AAManager::run(Function &F, FunctionAnalysisManager &AM) {
+  Result R(AM.getResult<TargetLibraryAnalysis>(F));
+  for (auto &Getter : ResultGetters)
+    (*Getter)(F, AM, R);
+  if (isAAQueryCacheEnabled())
+    R.setQueryCache(&AM.getResult<AliasQueryCacheAnalysis>(F));
+  return R;
+}
+
 namespace {
 
 
@@ -9,6 +9,7 @@
 #include "llvm/Analysis/AliasAnalysisEvaluator.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/AliasQueryCache.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/DerivedTypes.h"
@@ -86,7 +87,9 @@ static inline bool isInterestingPointer(Value *V) {
 }
 
 PreservedAnalyses AAEvaluator::run(Function &F, FunctionAnalysisManager &AM) {
-  runInternal(F, AM.getResult<AAManager>(F));
+  AAResults &AA = AM.getResult<AAManager>(F);
+  AliasQueryCache::ReadOnlyScope CacheScope(AA);
+  runInternal(F, AA);
   return PreservedAnalyses::all();
 }
 
@@ -0,0 +1,82 @@
+//===- AliasQueryCache.cpp - Cross-pass alias query cache -----------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/AliasQueryCache.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/CommandLine.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "aa-query-cache"
+
+STATISTIC(NumCacheHits, "Number of alias queries answered from the cache");
+STATISTIC(NumCacheMisses, "Number of alias queries not found in the cache");
+STATISTIC(NumCacheInvalidations,
+          "Number of cached alias queries dropped because the function "
+          "changed");
+
+static cl::opt<bool> EnableAAQueryCache(
+    "enable-aa-query-cache", cl::Hidden, cl::init(false),
+    cl::desc("Cache the results of alias queries across passes until the "
+             "function is modified (new pass manager only)"));
+
+bool llvm::isAAQueryCacheEnabled() { return EnableAAQueryCache; }
+
+AliasQueryCache::ReadOnlyScope::ReadOnlyScope(AAResults &AA)
+    : Cache(AA.getQueryCache()) {
+  if (Cache)
+    ++Cache->ActiveScopes;
+}
+
+AliasQueryCache::ReadOnlyScope::~ReadOnlyScope() {
+  if (Cache)
+    --Cache->ActiveScopes;
+}
+
+Optional<AliasResult> AliasQueryCache::lookup(const MemoryLocation &LocA,
+                                              const MemoryLocation &LocB) const {
+  // Alias queries are symmetric, so look for both orders.
+  auto It = Results.find(LocPair(LocA, LocB));
+  if (It == Results.end())
+    It = Results.find(LocPair(LocB, LocA));
+  if (It == Results.end()) {
+    ++NumCacheMisses;
+    return None;
+  }
+  ++NumCacheHits;
+  return It->second;
+}
+
+void AliasQueryCache::insert(const MemoryLocation &LocA,
+                             const MemoryLocation &LocB, AliasResult Result) {
+  assert(isActive() && "Alias query cached outside of a read-only scope");
+  Results.insert({LocPair(LocA, LocB), Result});
+}
+
+void AliasQueryCache::releaseMemory() {
+  Results.clear();
+}
+
+bool AliasQueryCache::invalidate(Function &, const PreservedAnalyses &PA,
+                                 FunctionAnalysisManager::Invalidator &) {
+  // Any change to the function may change the result of any query: a new
+  // store can capture a pointer, and setOperand can rewrite an address
+  // without touching the pointer the query was keyed on. So unless the pass
+  // preserved everything, drop all entries.
+  if (!PA.areAllPreserved()) {
+    NumCacheInvalidations += Results.size();
+    Results.clear();
+  }
+  return false;
+}
+
+AnalysisKey AliasQueryCacheAnalysis::Key;
+AliasQueryCache AliasQueryCacheAnalysis::run(Function &F,
+                                             FunctionAnalysisManager &) {
+  return AliasQueryCache();
+}
@@ -13,15 +13,27 @@
 
 #include "llvm/Analysis/DomTreeUpdater.h"
 #include "llvm/ADT/SmallSet.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/PostDominators.h"
 #include "llvm/IR/Dominators.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/GenericDomTree.h"
 #include <algorithm>
 #include <functional>
 #include <utility>
 
+#define DEBUG_TYPE "dom-tree-updater"
+
 namespace llvm {
 
+STATISTIC(NumDeferredUpdates,
+          "Number of updates deferred until a tree is queried");
+
+static cl::opt<bool> DeferDomTreeUpdates(
+    "defer-domtree-updates", cl::Hidden, cl::init(false),
+    cl::desc("Let dominator trees apply the updates passes leave pending "
+             "once the trees are queried again"));
+
 bool DomTreeUpdater::isUpdateValid(
     const DominatorTree::UpdateType Update) const {
   const auto *From = Update.getFrom();
@@ -76,6 +88,29 @@ void DomTreeUpdater::flush() {
   dropOutOfDateUpdates();
 }
 
+void DomTreeUpdater::deferFlush() {
+  if (!DeferDomTreeUpdates || Strategy != UpdateStrategy::Lazy ||
+      hasPendingDeletedBB()) {
+    flush();
+    return;
+  }
+
+  const auto E = PendUpdates.end();
+  if (DT && hasPendingDomTreeUpdates()) {
+    const auto I = PendUpdates.begin() + PendDTUpdateIndex;
+    DT->deferUpdates(ArrayRef<DominatorTree::UpdateType>(I, E));
+    NumDeferredUpdates += E - I;
+    PendDTUpdateIndex = PendUpdates.size();
+  }
+  if (PDT && hasPendingPostDomTreeUpdates()) {
+    const auto I = PendUpdates.begin() + PendPDTUpdateIndex;
+    PDT->deferUpdates(ArrayRef<DominatorTree::UpdateType>(I, E));
+    NumDeferredUpdates += E - I;
+    PendPDTUpdateIndex = PendUpdates.size();
+  }
+  dropOutOfDateUpdates();
+}
+
 void DomTreeUpdater::applyPostDomTreeUpdates() {
   // No pending PostDomTreeUpdates.
   if (Strategy != UpdateStrategy::Lazy || !PDT)
@@ -304,6 +339,7 @@ DominatorTree &DomTreeUpdater::getDomTree() {
   assert(DT && "Invalid acquisition of a null DomTree");
   applyDomTreeUpdates();
   dropOutOfDateUpdates();
+  DT->flushDeferredUpdates();
   return *DT;
 }
 
@@ -311,6 +347,7 @@ PostDominatorTree &DomTreeUpdater::getPostDomTree() {
   assert(PDT && "Invalid acquisition of a null PostDomTree");
   applyPostDomTreeUpdates();
   dropOutOfDateUpdates();
+  PDT->flushDeferredUpdates();
   return *PDT;
 }
 
@@ -22,10 +22,14 @@
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/PassManager.h"
+#include "llvm/IR/PassTimingInfo.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/GraphWriter.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <cassert>
@@ -39,6 +43,15 @@ using namespace llvm;
 
 #define DEBUG_TYPE "lcg"
 
+static cl::opt<unsigned> EdgeScanThreads(
+    "lcg-edge-scan-threads", cl::Hidden, cl::init(0),
+    cl::desc("Scan the function bodies for call graph edges on this many "
+             "threads before forming the RefSCCs (0 scans each function "
+             "when the walk reaches it)"));
+
+static const char TimerGroupName[] = "lcg";
+static const char TimerGroupDescription[] = "Lazy Call Graph Construction";
+
 void LazyCallGraph::EdgeSequence::insertEdgeInternal(Node &TargetN,
                                                      Edge::Kind EK) {
   EdgeIndexMap.insert({&TargetN, Edges.size()});
@@ -77,6 +90,32 @@ LazyCallGraph::EdgeSequence &LazyCallGraph::Node::populateSlow() {
 
   Edges = EdgeSequence();
 
+  // Take the edges found by the parallel edge scan if there was one.
+  ScannedEdgeList Found;
+  auto ScannedI = G->ScannedEdges.find(F);
+  if (ScannedI != G->ScannedEdges.end()) {
+    Found = std::move(ScannedI->second);
+    G->ScannedEdges.erase(ScannedI);
+  } else {
+    scanEdges(*F, Found);
+  }
+  for (auto &E : Found)
+    addEdge(Edges->Edges, Edges->EdgeIndexMap, G->get(*E.getPointer()),
+            E.getInt());
+
+  // Add implicit reference edges to any defined libcall functions (if we
+  // haven't found an explicit edge).
+  for (auto *F : G->LibFunctions) {
+    Node &LibN = G->get(*F);
+    if (!Edges->EdgeIndexMap.count(&LibN))
+      addEdge(Edges->Edges, Edges->EdgeIndexMap, LibN,
+              LazyCallGraph::Edge::Ref);
+  }
+
+  return *Edges;
+}
+
+void LazyCallGraph::scanEdges(Function &F, ScannedEdgeList &Edges) {
   SmallVector<Constant *, 16> Worklist;
   SmallPtrSet<Function *, 4> Callees;
   SmallPtrSet<Constant *, 16> Visited;
@@ -97,15 +136,14 @@ LazyCallGraph::EdgeSequence &LazyCallGraph::Node::populateSlow() {
   // alias. Then a test of the address of the weak function against the new
   // strong definition's address would be an effective way to determine the
   // safety of optimizing a direct call edge.
-  for (BasicBlock &BB : *F)
+  for (BasicBlock &BB : F)
     for (Instruction &I : BB) {
       if (auto CS = CallSite(&I))
         if (Function *Callee = CS.getCalledFunction())
           if (!Callee->isDeclaration())
             if (Callees.insert(Callee).second) {
               Visited.insert(Callee);
-              addEdge(Edges->Edges, Edges->EdgeIndexMap, G->get(*Callee),
-                      LazyCallGraph::Edge::Call);
+              Edges.push_back({Callee, Edge::Call});
             }
 
       for (Value *Op : I.operand_values())
@@ -117,19 +155,9 @@ LazyCallGraph::EdgeSequence &LazyCallGraph::Node::populateSlow() {
   // We've collected all the constant (and thus potentially function or
   // function containing) operands to all of the instructions in the function.
   // Process them (recursively) collecting every function found.
-  visitReferences(Worklist, Visited, [&](Function &F) {
-    addEdge(Edges->Edges, Edges->EdgeIndexMap, G->get(F),
-            LazyCallGraph::Edge::Ref);
+  visitReferences(Worklist, Visited, [&](Function &Referenced) {
+    Edges.push_back({&Referenced, Edge::Ref});
   });
-
-  // Add implicit reference edges to any defined libcall functions (if we
-  // haven't found an explicit edge).
-  for (auto *F : G->LibFunctions)
-    if (!Visited.count(F))
-      addEdge(Edges->Edges, Edges->EdgeIndexMap, G->get(*F),
-              LazyCallGraph::Edge::Ref);
-
-  return *Edges;
 }
 
 void LazyCallGraph::Node::replaceFunction(Function &NewF) {
@@ -206,7 +234,8 @@ LazyCallGraph::LazyCallGraph(LazyCallGraph &&G)
     : BPA(std::move(G.BPA)), NodeMap(std::move(G.NodeMap)),
       EntryEdges(std::move(G.EntryEdges)), SCCBPA(std::move(G.SCCBPA)),
       SCCMap(std::move(G.SCCMap)),
-      LibFunctions(std::move(G.LibFunctions)) {
+      LibFunctions(std::move(G.LibFunctions)),
+      ScannedEdges(std::move(G.ScannedEdges)) {
   updateGraphPtrs();
 }
 
@@ -217,6 +246,7 @@ LazyCallGraph &LazyCallGraph::operator=(LazyCallGraph &&G) {
   SCCBPA = std::move(G.SCCBPA);
   SCCMap = std::move(G.SCCMap);
   LibFunctions = std::move(G.LibFunctions);
+  ScannedEdges = std::move(G.ScannedEdges);
   updateGraphPtrs();
   return *this;
 }
@@ -1703,6 +1733,15 @@ void LazyCallGraph::buildRefSCCs() {
 
   assert(RefSCCIndices.empty() && "Already mapped RefSCC indices!");
 
+  if (EdgeScanThreads) {
+    NamedRegionTimer T("scan", "Edge scan", TimerGroupName,
+                       TimerGroupDescription, TimePassesIsEnabled);
+    scanEdgesInParallel(EdgeScanThreads);
+  }
+
+  NamedRegionTimer T("refscc", "RefSCC formation", TimerGroupName,
+                     TimerGroupDescription, TimePassesIsEnabled);
+
   SmallVector<Node *, 16> Roots;
   for (Edge &E : *this)
     Roots.push_back(&E.getNode());
@@ -1735,6 +1774,40 @@ void LazyCallGraph::buildRefSCCs() {
         NewRC->verify();
 #endif
       });
+
+  // The scanned edges of functions the walk didn't reach may be out of date
+  // by the time their nodes are populated.
+  ScannedEdges.clear();
+}
+
+void LazyCallGraph::scanEdgesInParallel(unsigned Threads) {
+  Module &M = *begin()->getFunction().getParent();
+  std::vector<Function *> Functions;
+  for (Function &F : M) {
+    if (F.isDeclaration())
+      continue;
+    Node *N = NodeMap.lookup(&F);
+    if (!N || !N->isPopulated())
+      Functions.push_back(&F);
+  }
+
+  // Hand the functions out in chunks, so that scheduling the tasks doesn't
+  // cost more than scanning small functions.
+  std::vector<ScannedEdgeList> Found(Functions.size());
+  size_t ChunkSize = std::max<size_t>(1, Functions.size() / (Threads * 16));
+  ThreadPool Pool(Threads);
+  for (size_t Begin = 0; Begin < Functions.size(); Begin += ChunkSize) {
+    size_t End = std::min(Begin + ChunkSize, Functions.size());
+    Pool.async([&Functions, &Found, Begin, End] {
+      for (size_t I = Begin; I != End; ++I)
+        scanEdges(*Functions[I], Found[I]);
+    });
+  }
+  Pool.wait();
+
+  ScannedEdges.reserve(Functions.size());
+  for (size_t I = 0, E = Functions.size(); I != E; ++I)
+    ScannedEdges[Functions[I]] = std::move(Found[I]);
 }
 
 AnalysisKey LazyCallGraphAnalysis::Key;
@@ -15,6 +15,7 @@
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/AssumptionCache.h"
 #include "llvm/Analysis/ConstantFolding.h"
 #include "llvm/Analysis/InstructionSimplify.h"
@@ -33,6 +34,7 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/PatternMatch.h"
 #include "llvm/IR/ValueHandle.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/FormattedStream.h"
 #include "llvm/Support/raw_ostream.h"
@@ -42,10 +44,23 @@ using namespace PatternMatch;
 
 #define DEBUG_TYPE "lazy-value-info"
 
+STATISTIC(NumSolveBudgetExhausted,
+          "Number of queries given up on because the function's solve "
+          "budget was exhausted");
+
 // This is the number of worklist items we will process to try to discover an
 // answer for a given value.
 static const unsigned MaxProcessedPerValue = 500;
 
+// This is the number of worklist items we will process for all of the queries
+// one pass makes on a function together. Passes start a new budget with
+// LazyValueInfo::resetSolveBudget.
+static cl::opt<unsigned> FunctionSolveBudget(
+    "lvi-function-solve-budget", cl::Hidden, cl::init(0),
+    cl::desc("Maximum number of solver steps LazyValueInfo takes for all "
+             "queries of one pass on a function, after which values are "
+             "considered overdefined (0 = unlimited)"));
+
 char LazyValueInfoWrapperPass::ID = 0;
 INITIALIZE_PASS_BEGIN(LazyValueInfoWrapperPass, "lazy-value-info",
                 "Lazy Value Information Analysis", false, true)
@@ -132,12 +147,9 @@ namespace {
   /// A callback value handle updates the cache when values are erased.
   class LazyValueInfoCache;
   struct LVIValueHandle final : public CallbackVH {
-    // Needs to access getValPtr(), which is protected.
-    friend struct DenseMapInfo<LVIValueHandle>;
-
     LazyValueInfoCache *Parent;
 
-    LVIValueHandle(Value *V, LazyValueInfoCache *P)
+    LVIValueHandle(Value *V, LazyValueInfoCache *P = nullptr)
       : CallbackVH(V), Parent(P) { }
 
     void deleted() override;
@@ -150,90 +162,100 @@ namespace {
 namespace {
   /// This is the cache kept by LazyValueInfo which
   /// maintains information about queries across the clients' queries.
+  ///
+  /// The cache is organized by basic block, so that CFG changes, which only
+  /// affect the values cached for the blocks whose incoming edges changed and
+  /// the blocks after them, can be handled without looking at the rest.
   class LazyValueInfoCache {
-    /// This is all of the cached block information for exactly one Value*.
-    /// The entries are sorted by the BasicBlock* of the
-    /// entries, allowing us to do a lookup with a binary search.
-    /// Over-defined lattice values are recorded in OverDefinedCache to reduce
-    /// memory overhead.
-    struct ValueCacheEntryTy {
-      ValueCacheEntryTy(Value *V, LazyValueInfoCache *P) : Handle(V, P) {}
+    /// This is all of the cached information for exactly one BasicBlock: the
+    /// lattice values at the end of the block. Over-defined lattice values are
+    /// recorded in their own set to reduce memory overhead.
+    struct BlockCacheEntry {
+      SmallDenseMap<Value *, ValueLatticeElement, 4> LatticeElements;
+      SmallPtrSet<Value *, 4> OverDefined;
+    };
+
+    /// This is all of the cached information for all blocks.
+    DenseMap<PoisoningVH<BasicBlock>, std::unique_ptr<BlockCacheEntry>>
+        BlockCache;
+
+    /// This is the cached information for exactly one Value: a handle, so
+    /// that its entries are removed when it is deleted, and the blocks it has
+    /// entries in, so that removing them doesn't visit every block. Blocks
+    /// that were erased or had their entries dropped since may still be
+    /// listed.
+    struct ValueCacheEntry {
+      ValueCacheEntry(Value *V, LazyValueInfoCache *P) : Handle(V, P) {}
       LVIValueHandle Handle;
-      SmallDenseMap<PoisoningVH<BasicBlock>, ValueLatticeElement, 4> BlockVals;
+      SmallPtrSet<BasicBlock *, 4> Blocks;
     };
 
-    /// This tracks, on a per-block basis, the set of values that are
-    /// over-defined at the end of that block.
-    typedef DenseMap<PoisoningVH<BasicBlock>, SmallPtrSet<Value *, 4>>
-        OverDefinedCacheTy;
-    /// Keep track of all blocks that we have ever seen, so we
-    /// don't spend time removing unused blocks from our caches.
-    DenseSet<PoisoningVH<BasicBlock> > SeenBlocks;
+    /// This is all of the cached information for all values.
+    DenseMap<Value *, std::unique_ptr<ValueCacheEntry>> ValueCache;
+
+    const BlockCacheEntry *getBlockEntry(BasicBlock *BB) const {
+      auto I = BlockCache.find_as(BB);
+      if (I == BlockCache.end())
+        return nullptr;
+      return I->second.get();
+    }
 
-    /// This is all of the cached information for all values,
-    /// mapped from Value* to key information.
-    DenseMap<Value *, std::unique_ptr<ValueCacheEntryTy>> ValueCache;
-    OverDefinedCacheTy OverDefinedCache;
+    BlockCacheEntry *getOrCreateBlockEntry(BasicBlock *BB) {
+      std::unique_ptr<BlockCacheEntry> &Entry = BlockCache[BB];
+      if (!Entry)
+        Entry = make_unique<BlockCacheEntry>();
+      return Entry.get();
+    }
 
+    ValueCacheEntry *getOrCreateValueEntry(Value *Val) {
+      std::unique_ptr<ValueCacheEntry> &Entry = ValueCache[Val];
+      if (!Entry)
+        Entry = make_unique<ValueCacheEntry>(Val, this);
+      return Entry.get();
+    }
 
   public:
     void insertResult(Value *Val, BasicBlock *BB,
                       const ValueLatticeElement &Result) {
-      SeenBlocks.insert(BB);
+      BlockCacheEntry *Entry = getOrCreateBlockEntry(BB);
 
       // Insert over-defined values into their own cache to reduce memory
       // overhead.
       if (Result.isOverdefined())
-        OverDefinedCache[BB].insert(Val);
-      else {
-        auto It = ValueCache.find_as(Val);
-        if (It == ValueCache.end()) {
-          ValueCache[Val] = make_unique<ValueCacheEntryTy>(Val, this);
-          It = ValueCache.find_as(Val);
-          assert(It != ValueCache.end() && "Val was just added to the map!");
-        }
-        It->second->BlockVals[BB] = Result;
-      }
+        Entry->OverDefined.insert(Val);
+      else
+        Entry->LatticeElements[Val] = Result;
+
+      getOrCreateValueEntry(Val)->Blocks.insert(BB);
     }
 
     bool isOverdefined(Value *V, BasicBlock *BB) const {
-      auto ODI = OverDefinedCache.find(BB);
-
-      if (ODI == OverDefinedCache.end())
-        return false;
-
-      return ODI->second.count(V);
+      const BlockCacheEntry *Entry = getBlockEntry(BB);
+      return Entry && Entry->OverDefined.count(V);
     }
 
     bool hasCachedValueInfo(Value *V, BasicBlock *BB) const {
-      if (isOverdefined(V, BB))
-        return true;
-
-      auto I = ValueCache.find_as(V);
-      if (I == ValueCache.end())
-        return false;
-
-      return I->second->BlockVals.count(BB);
+      const BlockCacheEntry *Entry = getBlockEntry(BB);
+      return Entry &&
+             (Entry->OverDefined.count(V) || Entry->LatticeElements.count(V));
     }
 
     ValueLatticeElement getCachedValueInfo(Value *V, BasicBlock *BB) const {
-      if (isOverdefined(V, BB))
-        return ValueLatticeElement::getOverdefined();
-
-      auto I = ValueCache.find_as(V);
-      if (I == ValueCache.end())
+      const BlockCacheEntry *Entry = getBlockEntry(BB);
+      if (!Entry)
         return ValueLatticeElement();
-      auto BBI = I->second->BlockVals.find(BB);
-      if (BBI == I->second->BlockVals.end())
+      if (Entry->OverDefined.count(V))
+        return ValueLatticeElement::getOverdefined();
+      auto LatticeIt = Entry->LatticeElements.find(V);
+      if (LatticeIt == Entry->LatticeElements.end())
         return ValueLatticeElement();
-      return BBI->second;
+      return LatticeIt->second;
     }
 
     /// clear - Empty the cache.
     void clear() {
-      SeenBlocks.clear();
+      BlockCache.clear();
       ValueCache.clear();
-      OverDefinedCache.clear();
     }
 
     /// Inform the cache that a given value has been deleted.
@@ -248,22 +270,31 @@ namespace {
     /// flushes elements from the cache and does not add any.
     void threadEdgeImpl(BasicBlock *OldSucc,BasicBlock *NewSucc);
 
+    /// Updates the cache for a new edge into \p To. The new edge can only
+    /// make the values in \p To and the blocks reachable from it less
+    /// precise, so their cached lattice values are dropped. Over-defined
+    /// values stay over-defined.
+    void edgeInserted(BasicBlock *To);
+
     friend struct LVIValueHandle;
   };
 }
 
 void LazyValueInfoCache::eraseValue(Value *V) {
-  for (auto I = OverDefinedCache.begin(), E = OverDefinedCache.end(); I != E;) {
-    // Copy and increment the iterator immediately so we can erase behind
-    // ourselves.
-    auto Iter = I++;
-    SmallPtrSetImpl<Value *> &ValueSet = Iter->second;
-    ValueSet.erase(V);
-    if (ValueSet.empty())
-      OverDefinedCache.erase(Iter);
+  auto I = ValueCache.find(V);
+  if (I == ValueCache.end())
+    return;
+
+  for (BasicBlock *BB : I->second->Blocks) {
+    // Don't create a value handle for BB, it may have been erased already.
+    auto BI = BlockCache.find_as(BB);
+    if (BI == BlockCache.end())
+      continue;
+    BI->second->LatticeElements.erase(V);
+    BI->second->OverDefined.erase(V);
   }
 
-  ValueCache.erase(V);
+  ValueCache.erase(I);
 }
 
 void LVIValueHandle::deleted() {
@@ -273,18 +304,7 @@ void LVIValueHandle::deleted() {
 }
 
 void LazyValueInfoCache::eraseBlock(BasicBlock *BB) {
-  // Shortcut if we have never seen this block.
-  DenseSet<PoisoningVH<BasicBlock> >::iterator I = SeenBlocks.find(BB);
-  if (I == SeenBlocks.end())
-    return;
-  SeenBlocks.erase(I);
-
-  auto ODI = OverDefinedCache.find(BB);
-  if (ODI != OverDefinedCache.end())
-    OverDefinedCache.erase(ODI);
-
-  for (auto &I : ValueCache)
-    I.second->BlockVals.erase(BB);
+  BlockCache.erase(BB);
 }
 
 void LazyValueInfoCache::threadEdgeImpl(BasicBlock *OldSucc,
@@ -302,10 +322,11 @@ void LazyValueInfoCache::threadEdgeImpl(BasicBlock *OldSucc,
   std::vector<BasicBlock*> worklist;
   worklist.push_back(OldSucc);
 
-  auto I = OverDefinedCache.find(OldSucc);
-  if (I == OverDefinedCache.end())
+  auto I = BlockCache.find(OldSucc);
+  if (I == BlockCache.end() || I->second->OverDefined.empty())
     return; // Nothing to process here.
-  SmallVector<Value *, 4> ValsToClear(I->second.begin(), I->second.end());
+  SmallVector<Value *, 4> ValsToClear(I->second->OverDefined.begin(),
+                                      I->second->OverDefined.end());
 
   // Use a worklist to perform a depth-first search of OldSucc's successors.
   // NOTE: We do not need a visited list since any blocks we have already
@@ -319,10 +340,10 @@ void LazyValueInfoCache::threadEdgeImpl(BasicBlock *OldSucc,
     if (ToUpdate == NewSucc) continue;
 
     // If a value was marked overdefined in OldSucc, and is here too...
-    auto OI = OverDefinedCache.find(ToUpdate);
-    if (OI == OverDefinedCache.end())
+    auto OI = BlockCache.find(ToUpdate);
+    if (OI == BlockCache.end() || OI->second->OverDefined.empty())
       continue;
-    SmallPtrSetImpl<Value *> &ValueSet = OI->second;
+    SmallPtrSetImpl<Value *> &ValueSet = OI->second->OverDefined;
 
     bool changed = false;
     for (Value *V : ValsToClear) {
@@ -333,10 +354,8 @@ void LazyValueInfoCache::threadEdgeImpl(BasicBlock *OldSucc,
       // blocks successors too.
       changed = true;
 
-      if (ValueSet.empty()) {
-        OverDefinedCache.erase(OI);
+      if (ValueSet.empty())
         break;
-      }
     }
 
     if (!changed) continue;
@@ -345,6 +364,26 @@ void LazyValueInfoCache::threadEdgeImpl(BasicBlock *OldSucc,
   }
 }
 
+void LazyValueInfoCache::edgeInserted(BasicBlock *To) {
+  // Any value cached after To may have been computed from the values at the
+  // end of To, including values refined by assumes whose dominance the new
+  // edge changed, so walk everything reachable from To. Blocks without cached
+  // lattice values are still walked through, since the blocks after them may
+  // have been solved by querying the edge into them.
+  SmallVector<BasicBlock *, 16> Worklist;
+  SmallPtrSet<BasicBlock *, 16> Visited;
+  Worklist.push_back(To);
+  while (!Worklist.empty()) {
+    BasicBlock *BB = Worklist.pop_back_val();
+    if (!Visited.insert(BB).second)
+      continue;
+    auto I = BlockCache.find(BB);
+    if (I != BlockCache.end())
+      I->second->LatticeElements.clear();
+    Worklist.append(succ_begin(BB), succ_end(BB));
+  }
+}
+
 
 namespace {
 /// An assembly annotator class to print LazyValueCache information in
@@ -386,6 +425,11 @@ namespace {
     /// Keeps track of which block-value pairs are in BlockValueStack.
     DenseSet<std::pair<BasicBlock*, Value*> > BlockValueSet;
 
+    /// The number of work items solved since the cache was last cleared or
+    /// the budget was reset, which is checked against
+    /// -lvi-function-solve-budget.
+    unsigned FunctionSolveSteps = 0;
+
     /// Push BV onto BlockValueStack unless it's already in there.
     /// Returns true on success.
     bool pushBlockValue(const std::pair<BasicBlock *, Value *> &BV) {
@@ -452,6 +496,7 @@ namespace {
     /// Complete flush all previously computed values
     void clear() {
       TheCache.clear();
+      FunctionSolveSteps = 0;
     }
 
     /// Printing the LazyValueInfo Analysis.
@@ -483,10 +528,18 @@ namespace {
       }
     }
 
+    /// Starts counting solver steps against -lvi-function-solve-budget
+    /// from zero again.
+    void resetSolveBudget() { FunctionSolveSteps = 0; }
+
     /// This is the update interface to inform the cache that an edge from
     /// PredBB to OldSucc has been threaded to be from PredBB to NewSucc.
     void threadEdge(BasicBlock *PredBB,BasicBlock *OldSucc,BasicBlock *NewSucc);
 
+    /// This is the update interface to inform the cache that edges have been
+    /// inserted into or deleted from the CFG.
+    void applyUpdates(ArrayRef<cfg::Update<BasicBlock *>> Updates);
+
     LazyValueInfoImpl(AssumptionCache *AC, const DataLayout &DL,
                        DominatorTree *DT = nullptr)
         : AC(AC), DL(DL), DT(DT), DisabledDT(nullptr) {}
@@ -501,6 +554,7 @@ void LazyValueInfoImpl::solve() {
   unsigned processedCount = 0;
   while (!BlockValueStack.empty()) {
     processedCount++;
+    FunctionSolveSteps++;
     // Abort if we have to process too many values to get a result for this one.
     // Because of the design of the overdefined cache currently being per-block
     // to avoid naming-related issues (IE it wants to try to give different
@@ -509,9 +563,13 @@ void LazyValueInfoImpl::solve() {
     // the same overdefined result again and again.  Once something like
     // PredicateInfo is used in LVI or CVP, we should be able to make the
     // overdefined cache global, and remove this throttle.
-    if (processedCount > MaxProcessedPerValue) {
+    bool OverFunctionBudget =
+        FunctionSolveBudget && FunctionSolveSteps > FunctionSolveBudget;
+    if (processedCount > MaxProcessedPerValue || OverFunctionBudget) {
       LLVM_DEBUG(
           dbgs() << "Giving up on stack because we are getting too deep\n");
+      if (OverFunctionBudget)
+        ++NumSolveBudgetExhausted;
       // Fill in the original values
       while (!StartingStack.empty()) {
         std::pair<BasicBlock *, Value *> &e = StartingStack.back();
@@ -1462,6 +1520,18 @@ void LazyValueInfoImpl::threadEdge(BasicBlock *PredBB, BasicBlock *OldSucc,
   TheCache.threadEdgeImpl(OldSucc, NewSucc);
 }
 
+void LazyValueInfoImpl::applyUpdates(
+    ArrayRef<cfg::Update<BasicBlock *>> Updates) {
+  for (const cfg::Update<BasicBlock *> &U : Updates) {
+    if (U.getKind() == cfg::UpdateKind::Insert)
+      TheCache.edgeInserted(U.getTo());
+    else
+      // A deleted edge can only make values more precise, so cached values
+      // stay correct, but overdefined ones may now be solvable.
+      TheCache.threadEdgeImpl(U.getTo(), nullptr);
+  }
+}
+
 //===----------------------------------------------------------------------===//
 //                            LazyValueInfo Impl
 //===----------------------------------------------------------------------===//
@@ -1819,6 +1889,14 @@ void LazyValueInfo::eraseBlock(BasicBlock *BB) {
   }
 }
 
+void LazyValueInfo::applyUpdates(ArrayRef<cfg::Update<BasicBlock *>> Updates) {
+  if (PImpl && !Updates.empty()) {
+    const DataLayout &DL =
+        Updates.front().getFrom()->getModule()->getDataLayout();
+    getImpl(PImpl, AC, &DL, DT).applyUpdates(Updates);
+  }
+}
+
 
 void LazyValueInfo::printLVI(Function &F, DominatorTree &DTree, raw_ostream &OS) {
   if (PImpl) {
@@ -1831,6 +1909,11 @@ void LazyValueInfo::disableDT() {
     getImpl(PImpl, AC, DL, DT).disableDT();
 }
 
+void LazyValueInfo::resetSolveBudget() {
+  if (PImpl)
+    getImpl(PImpl, AC, DL, DT).resetSolveBudget();
+}
+
 void LazyValueInfo::enableDT() {
   if (PImpl)
     getImpl(PImpl, AC, DL, DT).enableDT();
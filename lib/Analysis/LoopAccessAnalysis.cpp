@@ -98,6 +98,13 @@ static cl::opt<unsigned> MemoryCheckMergeThreshold(
              "runtime memory checks. (default = 100)"),
     cl::init(100));
 
+/// Group the pointers by the non-constant part of their bounds instead of
+/// trying to add each pointer to every group.
+static cl::opt<bool> GroupChecksByBase(
+    "memory-check-group-by-base", cl::Hidden, cl::init(true),
+    cl::desc("Group runtime memory checks by the non-constant part of the "
+             "pointer bounds, which scales to loops with many pointers"));
+
 /// Maximum SIMD width.
 const unsigned VectorizerParams::MaxVectorWidth = 64;
 
@@ -276,6 +283,20 @@ static const SCEV *getMinFromExprs(const SCEV *I, const SCEV *J,
   return I;
 }
 
+/// Returns \p S without its constant offset, or null if \p S is a constant.
+/// Two expressions have a constant difference if they have the same base.
+static const SCEV *getNonConstantBase(const SCEV *S, ScalarEvolution *SE) {
+  if (isa<SCEVConstant>(S))
+    return nullptr;
+  const auto *Add = dyn_cast<SCEVAddExpr>(S);
+  if (!Add || !isa<SCEVConstant>(Add->getOperand(0)))
+    return S;
+  if (Add->getNumOperands() == 2)
+    return Add->getOperand(1);
+  SmallVector<const SCEV *, 4> Ops(std::next(Add->op_begin()), Add->op_end());
+  return SE->getAddExpr(Ops);
+}
+
 bool RuntimePointerChecking::CheckingPtrGroup::addPointer(unsigned Index) {
   const SCEV *Start = RtCheck.Pointers[Index].Start;
   const SCEV *End = RtCheck.Pointers[Index].End;
@@ -380,6 +401,44 @@ void RuntimePointerChecking::groupChecks(
     SmallVector<CheckingPtrGroup, 2> Groups;
     auto LeaderI = DepCands.findValue(DepCands.getLeaderValue(Access));
 
+    if (GroupChecksByBase) {
+      // A pointer can only join a group if the differences between its bounds
+      // and the group's are constant, which requires the bounds to have the
+      // same non-constant bases. Only trying the groups created for the same
+      // bases avoids comparing against every group. Those groups are tried
+      // in creation order, and each comparison counts against
+      // MemoryCheckMergeThreshold like in the greedy algorithm below.
+      DenseMap<std::pair<const SCEV *, const SCEV *>, SmallVector<unsigned, 2>>
+          GroupsForBases;
+      for (auto MI = DepCands.member_begin(LeaderI),
+                ME = DepCands.member_end();
+           MI != ME; ++MI) {
+        unsigned Pointer = PositionMap[MI->getPointer()];
+        Seen.insert(Pointer);
+
+        auto Bases =
+            std::make_pair(getNonConstantBase(Pointers[Pointer].Start, SE),
+                           getNonConstantBase(Pointers[Pointer].End, SE));
+        SmallVectorImpl<unsigned> &Candidates = GroupsForBases[Bases];
+        bool Merged = false;
+        for (unsigned Group : Candidates) {
+          if (TotalComparisons > MemoryCheckMergeThreshold)
+            break;
+          TotalComparisons++;
+          if (Groups[Group].addPointer(Pointer)) {
+            Merged = true;
+            break;
+          }
+        }
+        if (Merged)
+          continue;
+        Candidates.push_back(Groups.size());
+        Groups.push_back(CheckingPtrGroup(Pointer, *this));
+      }
+      llvm::copy(Groups, std::back_inserter(CheckingGroups));
+      continue;
+    }
+
     // Because DepCands is constructed by visiting accesses in the order in
     // which they appear in alias sets (which is deterministic) and the
     // iteration order within an equivalence class member is only dependent on
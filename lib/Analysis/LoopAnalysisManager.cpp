@@ -7,6 +7,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Analysis/LoopAnalysisManager.h"
+#include "llvm/ADT/DepthFirstIterator.h"
 #include "llvm/Analysis/BasicAliasAnalysis.h"
 #include "llvm/Analysis/GlobalsModRef.h"
 #include "llvm/Analysis/LoopInfo.h"
@@ -156,3 +157,28 @@ PreservedAnalyses llvm::getLoopPassPreservedAnalyses() {
   PA.preserve<SCEVAA>();
   return PA;
 }
+
+PreservedAnalyses
+llvm::invalidateChangedLoopNests(LoopAnalysisManager &LAM, ScalarEvolution &SE,
+                                 ArrayRef<Loop *> ChangedLoops) {
+  SmallPtrSet<Loop *, 4> Nests;
+  for (Loop *L : ChangedLoops) {
+    while (L->getParentLoop())
+      L = L->getParentLoop();
+    if (!Nests.insert(L).second)
+      continue;
+    SE.forgetTopmostLoop(L);
+    for (Loop *SubLoop : depth_first(L))
+      LAM.clear(*SubLoop, SubLoop->getName());
+  }
+
+  PreservedAnalyses PA;
+  PA.preserve<LoopAnalysisManagerFunctionProxy>();
+  PA.preserveSet<AllAnalysesOn<Loop>>();
+  PA.preserve<ScalarEvolutionAnalysis>();
+  PA.preserve<AAManager>();
+  PA.preserve<BasicAA>();
+  PA.preserve<GlobalsAA>();
+  PA.preserve<SCEVAA>();
+  return PA;
+}
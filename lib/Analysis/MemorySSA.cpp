@@ -75,6 +75,17 @@ static cl::opt<unsigned> MaxCheckLimit(
     cl::desc("The maximum number of stores/phis MemorySSA"
              "will consider trying to walk past (default = 100)"));
 
+static cl::opt<unsigned> FunctionWalkBudget(
+    "memssa-function-walk-budget", cl::Hidden, cl::init(0),
+    cl::desc("The maximum number of stores/phis the MemorySSA walkers will "
+             "walk past in total for one function before giving "
+             "conservative answers (default = 0, unlimited)"));
+
+static cl::opt<bool> EnableClobberCache(
+    "memssa-clobber-cache", cl::Hidden, cl::init(true),
+    cl::desc("Cache the results of MemorySSA clobber queries for explicit "
+             "memory locations"));
+
 // Always verify MemorySSA if expensive checking is enabled.
 #ifdef EXPENSIVE_CHECKS
 bool llvm::VerifyMemorySSA = true;
@@ -970,6 +981,40 @@ template <class AliasAnalysisType> class MemorySSA::ClobberWalkerBase {
   ClobberWalker<AliasAnalysisType> Walker;
   MemorySSA *MSSA;
 
+  /// Clobbers found for (access, location) queries, valid as long as
+  /// MSSA->ClobberCacheEpoch equals CacheEpoch.
+  using ClobberQuery = std::pair<const MemoryAccess *, MemoryLocation>;
+  DenseMap<ClobberQuery, MemoryAccess *> ClobberCache;
+  unsigned CacheEpoch = 0;
+
+  /// Run Walker.findClobber within both the query's and the function's walk
+  /// limits, and charge the steps taken to both. Sets \p Complete to whether
+  /// the walk finished before running out of either.
+  MemoryAccess *findClobber(MemoryAccess *Start, UpwardsMemoryQuery &Q,
+                            unsigned &UpwardWalkLimit, bool &Complete) {
+    WalkerStatistics &Stats = MSSA->WalkerStats;
+    ++Stats.Walks;
+    unsigned Limit = UpwardWalkLimit;
+    if (FunctionWalkBudget) {
+      unsigned Left = FunctionWalkBudget > Stats.WalkSteps
+                          ? FunctionWalkBudget - Stats.WalkSteps
+                          : 0;
+      if (Left < Limit) {
+        Limit = Left;
+        if (!Left)
+          ++Stats.BudgetExhausted;
+      }
+    }
+    // findClobber always takes at least one step.
+    unsigned InitialLimit = std::max(Limit, 1u);
+    MemoryAccess *Clobber = Walker.findClobber(Start, Q, Limit);
+    unsigned Steps = InitialLimit - Limit;
+    Stats.WalkSteps += Steps;
+    UpwardWalkLimit -= std::min(UpwardWalkLimit, Steps);
+    Complete = Limit != 0;
+    return Clobber;
+  }
+
 public:
   ClobberWalkerBase(MemorySSA *M, AliasAnalysisType *A, DominatorTree *D)
       : Walker(*M, *A, *D), MSSA(M) {}
@@ -1022,6 +1067,7 @@ public:
   void invalidateInfo(MemoryAccess *MA) override {
     if (auto *MUD = dyn_cast<MemoryUseOrDef>(MA))
       MUD->resetOptimized();
+    MSSA->invalidateClobberCache();
   }
 };
 
@@ -1058,6 +1104,7 @@ public:
   void invalidateInfo(MemoryAccess *MA) override {
     if (auto *MUD = dyn_cast<MemoryUseOrDef>(MA))
       MUD->resetOptimized();
+    MSSA->invalidateClobberCache();
   }
 };
 
@@ -1566,6 +1613,7 @@ MemorySSAWalker *MemorySSA::getSkipSelfWalker() {
 void MemorySSA::insertIntoListsForBlock(MemoryAccess *NewAccess,
                                         const BasicBlock *BB,
                                         InsertionPlace Point) {
+  invalidateClobberCache();
   auto *Accesses = getOrCreateAccessList(BB);
   if (Point == Beginning) {
     // If it's a phi node, it goes first, otherwise, it goes after any phi
@@ -1597,6 +1645,7 @@ void MemorySSA::insertIntoListsForBlock(MemoryAccess *NewAccess,
 
 void MemorySSA::insertIntoListsBefore(MemoryAccess *What, const BasicBlock *BB,
                                       AccessList::iterator InsertPt) {
+  invalidateClobberCache();
   auto *Accesses = getWritableBlockAccesses(BB);
   bool WasEnd = InsertPt == Accesses->end();
   Accesses->insert(AccessList::iterator(InsertPt), What);
@@ -1624,6 +1673,7 @@ void MemorySSA::insertIntoListsBefore(MemoryAccess *What, const BasicBlock *BB,
 }
 
 void MemorySSA::prepareForMoveTo(MemoryAccess *What, BasicBlock *BB) {
+  invalidateClobberCache();
   // Keep it in the lookup tables, remove from the lists
   removeFromLists(What, false);
 
@@ -1662,6 +1712,7 @@ void MemorySSA::moveTo(MemoryAccess *What, BasicBlock *BB,
 }
 
 MemoryPhi *MemorySSA::createMemoryPhi(BasicBlock *BB) {
+  invalidateClobberCache();
   assert(!getMemoryAccess(BB) && "MemoryPhi already exists for this BB");
   MemoryPhi *Phi = new MemoryPhi(BB->getContext(), BB, NextID++);
   // Phi's always are placed at the front of the block.
@@ -1768,6 +1819,7 @@ bool MemorySSA::dominatesUse(const MemoryAccess *Replacer,
 
 /// Properly remove \p MA from all of MemorySSA's lookup tables.
 void MemorySSA::removeFromLookups(MemoryAccess *MA) {
+  invalidateClobberCache();
   assert(MA->use_empty() &&
          "Trying to remove memory access that still has uses");
   BlockNumbering.erase(MA);
@@ -2208,6 +2260,21 @@ PreservedAnalyses MemorySSAPrinterPass::run(Function &F,
   return PreservedAnalyses::all();
 }
 
+PreservedAnalyses
+MemorySSAWalkerStatsPrinterPass::run(Function &F, FunctionAnalysisManager &AM) {
+  const MemorySSA::WalkerStatistics &Stats =
+      AM.getResult<MemorySSAAnalysis>(F).getMSSA().getWalkerStatistics();
+  OS << "MemorySSA walker statistics for function: " << F.getName() << "\n";
+  OS << "  walks: " << Stats.Walks << "\n";
+  OS << "  walk steps: " << Stats.WalkSteps << "\n";
+  OS << "  optimized access hits: " << Stats.OptimizedHits << "\n";
+  OS << "  clobber cache hits: " << Stats.CacheHits << "\n";
+  OS << "  clobber cache misses: " << Stats.CacheMisses << "\n";
+  OS << "  walks over budget: " << Stats.BudgetExhausted << "\n";
+
+  return PreservedAnalyses::all();
+}
+
 PreservedAnalyses MemorySSAVerifierPass::run(Function &F,
                                              FunctionAnalysisManager &AM) {
   AM.getResult<MemorySSAAnalysis>(F).getMSSA().verifyMemorySSA();
@@ -2267,6 +2334,21 @@ MemorySSA::ClobberWalkerBase<AliasAnalysisType>::getClobberingMemoryAccessBase(
   if (!isa<CallBase>(I) && I->isFenceLike())
     return StartingUseOrDef;
 
+  // Answer repeated queries from the cache, unless MemorySSA changed since
+  // they were cached.
+  ClobberQuery Key(StartingUseOrDef, Loc);
+  if (EnableClobberCache) {
+    if (CacheEpoch != MSSA->ClobberCacheEpoch) {
+      ClobberCache.clear();
+      CacheEpoch = MSSA->ClobberCacheEpoch;
+    }
+    if (MemoryAccess *Cached = ClobberCache.lookup(Key)) {
+      ++MSSA->WalkerStats.CacheHits;
+      return Cached;
+    }
+    ++MSSA->WalkerStats.CacheMisses;
+  }
+
   UpwardsMemoryQuery Q;
   Q.OriginalAccess = StartingUseOrDef;
   Q.StartingLoc = Loc;
@@ -2280,8 +2362,13 @@ MemorySSA::ClobberWalkerBase<AliasAnalysisType>::getClobberingMemoryAccessBase(
                                      ? StartingUseOrDef->getDefiningAccess()
                                      : StartingUseOrDef;
 
+  bool Complete;
   MemoryAccess *Clobber =
-      Walker.findClobber(DefiningAccess, Q, UpwardWalkLimit);
+      findClobber(DefiningAccess, Q, UpwardWalkLimit, Complete);
+  // A walk that was cut short only found a conservative answer; a later query
+  // with more budget may do better.
+  if (EnableClobberCache && Complete)
+    ClobberCache[Key] = Clobber;
   LLVM_DEBUG(dbgs() << "Starting Memory SSA clobber for " << *I << " is ");
   LLVM_DEBUG(dbgs() << *StartingUseOrDef << "\n");
   LLVM_DEBUG(dbgs() << "Final Memory SSA clobber for " << *I << " is ");
@@ -2304,6 +2391,7 @@ MemorySSA::ClobberWalkerBase<AliasAnalysisType>::getClobberingMemoryAccessBase(
   // Note: Currently, we store the optimized def result in a separate field,
   // since we can't use the defining access.
   if (StartingAccess->isOptimized()) {
+    ++MSSA->WalkerStats.OptimizedHits;
     if (!SkipSelf || !isa<MemoryDef>(StartingAccess))
       return StartingAccess->getOptimized();
     IsOptimized = true;
@@ -2338,7 +2426,8 @@ MemorySSA::ClobberWalkerBase<AliasAnalysisType>::getClobberingMemoryAccessBase(
       return DefiningAccess;
     }
 
-    OptimizedAccess = Walker.findClobber(DefiningAccess, Q, UpwardWalkLimit);
+    bool Complete;
+    OptimizedAccess = findClobber(DefiningAccess, Q, UpwardWalkLimit, Complete);
     StartingAccess->setOptimized(OptimizedAccess);
     if (MSSA->isLiveOnEntryDef(OptimizedAccess))
       StartingAccess->setOptimizedAccessType(None);
@@ -2357,7 +2446,8 @@ MemorySSA::ClobberWalkerBase<AliasAnalysisType>::getClobberingMemoryAccessBase(
       isa<MemoryDef>(StartingAccess) && UpwardWalkLimit) {
     assert(isa<MemoryDef>(Q.OriginalAccess));
     Q.SkipSelfAccess = true;
-    Result = Walker.findClobber(OptimizedAccess, Q, UpwardWalkLimit);
+    bool Complete;
+    Result = findClobber(OptimizedAccess, Q, UpwardWalkLimit, Complete);
   } else
     Result = OptimizedAccess;
 
@@ -455,6 +455,7 @@ void MemorySSAUpdater::fixupDefs(const SmallVectorImpl<WeakVH> &Vars) {
 
 void MemorySSAUpdater::removeEdge(BasicBlock *From, BasicBlock *To) {
   if (MemoryPhi *MPhi = MSSA->getMemoryAccess(To)) {
+    MSSA->invalidateClobberCache();
     MPhi->unorderedDeleteIncomingBlock(From);
     if (MPhi->getNumIncomingValues() == 1)
       removeMemoryAccess(MPhi);
@@ -464,6 +465,7 @@ void MemorySSAUpdater::removeEdge(BasicBlock *From, BasicBlock *To) {
 void MemorySSAUpdater::removeDuplicatePhiEdgesBetween(BasicBlock *From,
                                                       BasicBlock *To) {
   if (MemoryPhi *MPhi = MSSA->getMemoryAccess(To)) {
+    MSSA->invalidateClobberCache();
     bool Found = false;
     MPhi->unorderedDeleteIncomingIf([&](const MemoryAccess *, BasicBlock *B) {
       if (From != B)
@@ -921,6 +923,7 @@ void MemorySSAUpdater::applyInsertUpdates(ArrayRef<CFGUpdate> Updates,
       if (auto *IDFPhi = MSSA->getMemoryAccess(BBIDF)) {
         // Update existing Phi.
         // FIXME: some updates may be redundant, try to optimize and skip some.
+        MSSA->invalidateClobberCache();
         for (unsigned I = 0, E = IDFPhi->getNumIncomingValues(); I < E; ++I)
           IDFPhi->setIncomingValue(I, GetLastDef(IDFPhi->getIncomingBlock(I)));
       } else {
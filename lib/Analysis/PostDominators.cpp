@@ -50,6 +50,10 @@ bool PostDominatorTreeWrapperPass::runOnFunction(Function &F) {
 }
 
 void PostDominatorTreeWrapperPass::verifyAnalysis() const {
+  // Deferred updates are verified once the tree is flushed, before the next
+  // pass gets it.
+  if (DT.hasDeferredUpdates())
+    return;
   if (VerifyDomInfo)
     assert(DT.verify(PostDominatorTree::VerificationLevel::Full));
   else if (ExpensiveChecksEnabled)
@@ -118,6 +118,7 @@
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/KnownBits.h"
 #include "llvm/Support/SaveAndRestore.h"
 #include "llvm/Support/raw_ostream.h"
@@ -145,6 +146,9 @@ STATISTIC(NumTripCountsNotComputed,
           "Number of loops without predictable loop counts");
 STATISTIC(NumBruteForceTripCountsComputed,
           "Number of loops with trip counts computed by force");
+STATISTIC(NumRangesTrimmed, "Number of cached ranges dropped");
+STATISTIC(NumBackedgeTakenCountsTrimmed,
+          "Number of cached backedge-taken counts dropped");
 
 static cl::opt<unsigned>
 MaxBruteForceIterations("scalar-evolution-max-iterations", cl::ReallyHidden,
@@ -216,6 +220,12 @@ static cl::opt<unsigned>
                   cl::desc("Size of the expression which is considered huge"),
                   cl::init(4096));
 
+static cl::opt<unsigned> MaxDerivedCacheEntries(
+    "scalar-evolution-derived-cache-limit", cl::Hidden,
+    cl::desc("Maximum number of entries in each of the range and "
+             "backedge-taken count caches (0 = unbounded)"),
+    cl::init(0));
+
 //===----------------------------------------------------------------------===//
 //                           SCEV class definitions
 //===----------------------------------------------------------------------===//
@@ -5599,8 +5609,13 @@ ScalarEvolution::getRangeRef(const SCEV *S,
 
   // See if we've computed this range already.
   DenseMap<const SCEV *, ConstantRange>::iterator I = Cache.find(S);
-  if (I != Cache.end())
+  if (I != Cache.end()) {
+    if (DerivedCacheLimit)
+      (SignHint == ScalarEvolution::HINT_RANGE_UNSIGNED ? UsedUnsignedRanges
+                                                        : UsedSignedRanges)
+          .insert(S);
     return I->second;
+  }
 
   if (const SCEVConstant *C = dyn_cast<SCEVConstant>(S))
     return setRange(C, SignHint, ConstantRange(C->getAPInt()));
@@ -6675,19 +6690,44 @@ ScalarEvolution::getPredicatedBackedgeTakenInfo(const Loop *L) {
   if (BTI.hasFullInfo())
     return BTI;
 
+  if (DerivedCacheLimit) {
+    auto It = PredicatedBackedgeTakenCounts.find(L);
+    if (It != PredicatedBackedgeTakenCounts.end()) {
+      UsedPredicatedBackedgeTakenCounts.insert(L);
+      return It->second;
+    }
+    if (!PendingBackedgeTakenCounts &&
+        PredicatedBackedgeTakenCounts.size() >= DerivedCacheLimit)
+      trimBackedgeTakenCache(PredicatedBackedgeTakenCounts,
+                             UsedPredicatedBackedgeTakenCounts);
+  }
+
   auto Pair = PredicatedBackedgeTakenCounts.insert({L, BackedgeTakenInfo()});
 
   if (!Pair.second)
     return Pair.first->second;
 
+  ++PendingBackedgeTakenCounts;
   BackedgeTakenInfo Result =
       computeBackedgeTakenCount(L, /*AllowPredicates=*/true);
+  --PendingBackedgeTakenCounts;
 
   return PredicatedBackedgeTakenCounts.find(L)->second = std::move(Result);
 }
 
 const ScalarEvolution::BackedgeTakenInfo &
 ScalarEvolution::getBackedgeTakenInfo(const Loop *L) {
+  if (DerivedCacheLimit) {
+    auto It = BackedgeTakenCounts.find(L);
+    if (It != BackedgeTakenCounts.end()) {
+      UsedBackedgeTakenCounts.insert(L);
+      return It->second;
+    }
+    if (!PendingBackedgeTakenCounts &&
+        BackedgeTakenCounts.size() >= DerivedCacheLimit)
+      trimBackedgeTakenCache(BackedgeTakenCounts, UsedBackedgeTakenCounts);
+  }
+
   // Initially insert an invalid entry for this loop. If the insertion
   // succeeds, proceed to actually compute a backedge-taken count and
   // update the value. The temporary CouldNotCompute value tells SCEV
@@ -6701,7 +6741,9 @@ ScalarEvolution::getBackedgeTakenInfo(const Loop *L) {
   // computeBackedgeTakenCount may allocate memory for its result. Inserting it
   // into the BackedgeTakenCounts map transfers ownership. Otherwise, the result
   // must be cleared in this scope.
+  ++PendingBackedgeTakenCounts;
   BackedgeTakenInfo Result = computeBackedgeTakenCount(L);
+  --PendingBackedgeTakenCounts;
 
   // In product build, there are no usage of statistic.
   (void)NumTripCountsComputed;
@@ -11369,7 +11411,8 @@ ScalarEvolution::ScalarEvolution(Function &F, TargetLibraryInfo &TLI,
                                  LoopInfo &LI)
     : F(F), TLI(TLI), AC(AC), DT(DT), LI(LI),
       CouldNotCompute(new SCEVCouldNotCompute()), ValuesAtScopes(64),
-      LoopDispositions(64), BlockDispositions(64) {
+      LoopDispositions(64), BlockDispositions(64),
+      DerivedCacheLimit(MaxDerivedCacheEntries) {
   // To use guards for proving predicates, we need to scan every instruction in
   // relevant basic blocks, and not just terminators.  Doing this is a waste of
   // time if the IR does not actually contain any calls to
@@ -11404,6 +11447,12 @@ ScalarEvolution::ScalarEvolution(ScalarEvolution &&Arg)
       BlockDispositions(std::move(Arg.BlockDispositions)),
       UnsignedRanges(std::move(Arg.UnsignedRanges)),
       SignedRanges(std::move(Arg.SignedRanges)),
+      DerivedCacheLimit(Arg.DerivedCacheLimit),
+      UsedUnsignedRanges(std::move(Arg.UsedUnsignedRanges)),
+      UsedSignedRanges(std::move(Arg.UsedSignedRanges)),
+      UsedBackedgeTakenCounts(std::move(Arg.UsedBackedgeTakenCounts)),
+      UsedPredicatedBackedgeTakenCounts(
+          std::move(Arg.UsedPredicatedBackedgeTakenCounts)),
       UniqueSCEVs(std::move(Arg.UniqueSCEVs)),
       UniquePreds(std::move(Arg.UniquePreds)),
       SCEVAllocator(std::move(Arg.SCEVAllocator)),
@@ -11959,6 +12008,143 @@ bool ScalarEvolution::invalidate(
          Inv.invalidate<LoopAnalysis>(F, PA);
 }
 
+void ScalarEvolution::trimRangeCache(
+    DenseMap<const SCEV *, ConstantRange> &Cache,
+    SmallPtrSetImpl<const SCEV *> &Used) {
+  // getRangeRef returns references into the cache that must not be held
+  // across the computation of another range, as inserting into the cache may
+  // reallocate it anyway, so it is always safe to drop entries here.
+  for (auto I = Cache.begin(), E = Cache.end(); I != E;) {
+    if (Used.count(I->first)) {
+      ++I;
+      continue;
+    }
+    Cache.erase(I++);
+    ++NumRangesTrimmed;
+  }
+  Used.clear();
+}
+
+void ScalarEvolution::trimBackedgeTakenCache(
+    DenseMap<const Loop *, BackedgeTakenInfo> &Cache,
+    SmallPtrSetImpl<const Loop *> &Used) {
+  assert(!PendingBackedgeTakenCounts &&
+         "Dropping the placeholder of a backedge-taken count being computed!");
+  for (auto I = Cache.begin(), E = Cache.end(); I != E;) {
+    if (Used.count(I->first)) {
+      ++I;
+      continue;
+    }
+    I->second.clear();
+    Cache.erase(I++);
+    ++NumBackedgeTakenCountsTrimmed;
+  }
+  Used.clear();
+}
+
+/// Returns the bytes of heap memory used by \p V beyond its inline storage.
+template <typename T, unsigned N>
+static size_t getOutOfLineSize(const SmallVector<T, N> &V) {
+  return V.capacity() > N ? V.capacity() * sizeof(T) : 0;
+}
+
+void ScalarEvolution::getMemoryUsage(
+    SmallVectorImpl<CacheMemoryUsage> &Usage) const {
+  // The nodes themselves are allocated in SCEVAllocator, which also holds the
+  // predicates.
+  Usage.push_back({"SCEV nodes", UniqueSCEVs.size(),
+                   SCEVAllocator.getTotalMemory() +
+                       UniqueSCEVs.capacity() / 2 * sizeof(void *)});
+  Usage.push_back({"SCEV predicates", UniquePreds.size(),
+                   UniquePreds.capacity() / 2 * sizeof(void *)});
+
+  Usage.push_back(
+      {"ValueExprMap", ValueExprMap.size(), ValueExprMap.getMemorySize()});
+
+  // SetVector doesn't expose its capacity, so assume each value takes a slot
+  // in both its vector and its set.
+  size_t Bytes = ExprValueMap.getMemorySize();
+  for (const auto &Entry : ExprValueMap)
+    Bytes += Entry.second.size() * 2 * sizeof(ValueOffsetPair);
+  Usage.push_back({"ExprValueMap", ExprValueMap.size(), Bytes});
+
+  Usage.push_back({"HasRecMap", HasRecMap.size(), HasRecMap.getMemorySize()});
+  Usage.push_back({"MinTrailingZerosCache", MinTrailingZerosCache.size(),
+                   MinTrailingZerosCache.getMemorySize()});
+
+  auto AddBackedgeTakenCache =
+      [&](const char *Name,
+          const DenseMap<const Loop *, BackedgeTakenInfo> &Cache) {
+        size_t Bytes = Cache.getMemorySize();
+        for (const auto &Entry : Cache)
+          Bytes += Entry.second.getExitListMemorySize();
+        Usage.push_back({Name, Cache.size(), Bytes});
+      };
+  AddBackedgeTakenCache("BackedgeTakenCounts", BackedgeTakenCounts);
+  AddBackedgeTakenCache("PredicatedBackedgeTakenCounts",
+                        PredicatedBackedgeTakenCounts);
+
+  Usage.push_back({"ConstantEvolutionLoopExitValue",
+                   ConstantEvolutionLoopExitValue.size(),
+                   ConstantEvolutionLoopExitValue.getMemorySize()});
+
+  Bytes = ValuesAtScopes.getMemorySize();
+  for (const auto &Entry : ValuesAtScopes)
+    Bytes += getOutOfLineSize(Entry.second);
+  Usage.push_back({"ValuesAtScopes", ValuesAtScopes.size(), Bytes});
+
+  Bytes = LoopDispositions.getMemorySize();
+  for (const auto &Entry : LoopDispositions)
+    Bytes += getOutOfLineSize(Entry.second);
+  Usage.push_back({"LoopDispositions", LoopDispositions.size(), Bytes});
+
+  Usage.push_back({"LoopPropertiesCache", LoopPropertiesCache.size(),
+                   LoopPropertiesCache.getMemorySize()});
+
+  Bytes = BlockDispositions.getMemorySize();
+  for (const auto &Entry : BlockDispositions)
+    Bytes += getOutOfLineSize(Entry.second);
+  Usage.push_back({"BlockDispositions", BlockDispositions.size(), Bytes});
+
+  auto AddRangeCache =
+      [&](const char *Name,
+          const DenseMap<const SCEV *, ConstantRange> &Cache) {
+        size_t Bytes = Cache.getMemorySize();
+        // Ranges wider than 64 bits keep their bounds on the heap.
+        for (const auto &Entry : Cache)
+          if (Entry.second.getBitWidth() > 64)
+            Bytes += 2 * Entry.second.getLower().getNumWords() *
+                     sizeof(uint64_t);
+        Usage.push_back({Name, Cache.size(), Bytes});
+      };
+  AddRangeCache("UnsignedRanges", UnsignedRanges);
+  AddRangeCache("SignedRanges", SignedRanges);
+
+  Bytes = LoopUsers.getMemorySize();
+  for (const auto &Entry : LoopUsers)
+    Bytes += getOutOfLineSize(Entry.second);
+  Usage.push_back({"LoopUsers", LoopUsers.size(), Bytes});
+
+  Usage.push_back({"PredicatedSCEVRewrites", PredicatedSCEVRewrites.size(),
+                   PredicatedSCEVRewrites.getMemorySize()});
+}
+
+void ScalarEvolution::printMemoryUsage(raw_ostream &OS) const {
+  SmallVector<CacheMemoryUsage, 32> Usage;
+  getMemoryUsage(Usage);
+
+  size_t TotalBytes = 0;
+  OS << "  " << left_justify("Cache", 32) << right_justify("Entries", 10)
+     << right_justify("Bytes", 12) << "\n";
+  for (const CacheMemoryUsage &U : Usage) {
+    OS << "  " << left_justify(U.Name, 32) << format_decimal(U.Entries, 10)
+       << format_decimal(U.Bytes, 12) << "\n";
+    TotalBytes += U.Bytes;
+  }
+  OS << "  " << left_justify("Total", 32) << right_justify("", 10)
+     << format_decimal(TotalBytes, 12) << "\n";
+}
+
 AnalysisKey ScalarEvolutionAnalysis::Key;
 
 ScalarEvolution ScalarEvolutionAnalysis::run(Function &F,
@@ -11975,6 +12161,14 @@ ScalarEvolutionPrinterPass::run(Function &F, FunctionAnalysisManager &AM) {
   return PreservedAnalyses::all();
 }
 
+PreservedAnalyses
+ScalarEvolutionMemoryPrinterPass::run(Function &F,
+                                      FunctionAnalysisManager &AM) {
+  OS << "ScalarEvolution memory usage for function '" << F.getName() << "':\n";
+  AM.getResult<ScalarEvolutionAnalysis>(F).printMemoryUsage(OS);
+  return PreservedAnalyses::all();
+}
+
 INITIALIZE_PASS_BEGIN(ScalarEvolutionWrapperPass, "scalar-evolution",
                       "Scalar Evolution Analysis", false, true)
 INITIALIZE_PASS_DEPENDENCY(AssumptionCacheTracker)
@@ -56,6 +56,7 @@
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/GraphWriter.h"
 #include "llvm/Support/MachineValueType.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <cassert>
@@ -63,6 +64,7 @@
 #include <iterator>
 #include <limits>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <tuple>
 #include <utility>
@@ -125,6 +127,22 @@ static cl::opt<bool> EnableMemOpCluster("misched-cluster", cl::Hidden,
 static cl::opt<bool> VerifyScheduling("verify-misched", cl::Hidden,
   cl::desc("Verify machine instrs before and after machine scheduling"));
 
+/// Post-RA scheduling regions never cross block boundaries and do not update
+/// any function-wide liveness, so blocks can be scheduled concurrently. Each
+/// block gets a scheduler instance of its own, which keeps the result
+/// independent of the number of threads and of how blocks are grouped. The
+/// pre-RA scheduler always runs serially: its regions are coupled through
+/// in-order LiveIntervals and register pressure updates.
+static cl::opt<unsigned> PostMISchedThreads("postmisched-threads", cl::Hidden,
+  cl::desc("Number of threads used to schedule blocks in the post-RA machine "
+           "scheduler (0 or 1 schedules serially)"), cl::init(0));
+
+static cl::opt<unsigned> PostMISchedBlocksPerTask(
+    "postmisched-blocks-per-task", cl::Hidden,
+    cl::desc("Number of consecutive blocks scheduled by one post-RA machine "
+             "scheduler task"),
+    cl::init(16));
+
 // DAG subtrees must have at least this many nodes.
 static const unsigned MinSubtreeSize = 8;
 
@@ -157,6 +175,8 @@ public:
 
 protected:
   void scheduleRegions(ScheduleDAGInstrs &Scheduler, bool FixKillFlags);
+  void scheduleBlockRegions(ScheduleDAGInstrs &Scheduler,
+                            MachineBasicBlock &MBB, bool FixKillFlags);
 };
 
 /// MachineScheduler runs after coalescing and before register allocation.
@@ -187,6 +207,11 @@ public:
 
 protected:
   ScheduleDAGInstrs *createPostMachineScheduler();
+  void scheduleRegionsInParallel();
+
+  /// Threads for -postmisched-threads, created on first use and shared by
+  /// all functions the pass runs on.
+  std::unique_ptr<ThreadPool> Pool;
 };
 
 } // end anonymous namespace
@@ -416,8 +441,15 @@ bool PostMachineScheduler::runOnMachineFunction(MachineFunction &mf) {
 
   // Instantiate the selected scheduler for this target, function, and
   // optimization level.
-  std::unique_ptr<ScheduleDAGInstrs> Scheduler(createPostMachineScheduler());
-  scheduleRegions(*Scheduler, true);
+  // The debugging cutoff counts instructions across the whole function in
+  // scheduling order, which only the serial driver has.
+  if (PostMISchedThreads > 1 && !DumpCriticalPathLength &&
+      MISchedCutoff == ~0U) {
+    scheduleRegionsInParallel();
+  } else {
+    std::unique_ptr<ScheduleDAGInstrs> Scheduler(createPostMachineScheduler());
+    scheduleRegions(*Scheduler, true);
+  }
 
   if (VerifyScheduling)
     MF->verify(this, "After post machine scheduling.");
@@ -510,80 +542,126 @@ void MachineSchedulerBase::scheduleRegions(ScheduleDAGInstrs &Scheduler,
   //
   // TODO: Visit blocks in global postorder or postorder within the bottom-up
   // loop tree. Then we can optionally compute global RegPressure.
-  for (MachineFunction::iterator MBB = MF->begin(), MBBEnd = MF->end();
-       MBB != MBBEnd; ++MBB) {
+  for (MachineBasicBlock &MBB : *MF)
+    scheduleBlockRegions(Scheduler, MBB, FixKillFlags);
+  Scheduler.finalizeSchedule();
+}
 
-    Scheduler.startBlock(&*MBB);
+/// Schedule all regions of a single block.
+void MachineSchedulerBase::scheduleBlockRegions(ScheduleDAGInstrs &Scheduler,
+                                                MachineBasicBlock &MBB,
+                                                bool FixKillFlags) {
+  Scheduler.startBlock(&MBB);
 
 #ifndef NDEBUG
-    if (SchedOnlyFunc.getNumOccurrences() && SchedOnlyFunc != MF->getName())
-      continue;
-    if (SchedOnlyBlock.getNumOccurrences()
-        && (int)SchedOnlyBlock != MBB->getNumber())
-      continue;
+  if (SchedOnlyFunc.getNumOccurrences() && SchedOnlyFunc != MF->getName())
+    return;
+  if (SchedOnlyBlock.getNumOccurrences()
+      && (int)SchedOnlyBlock != MBB.getNumber())
+    return;
 #endif
 
-    // Break the block into scheduling regions [I, RegionEnd). RegionEnd
-    // points to the scheduling boundary at the bottom of the region. The DAG
-    // does not include RegionEnd, but the region does (i.e. the next
-    // RegionEnd is above the previous RegionBegin). If the current block has
-    // no terminator then RegionEnd == MBB->end() for the bottom region.
-    //
-    // All the regions of MBB are first found and stored in MBBRegions, which
-    // will be processed (MBB) top-down if initialized with true.
-    //
-    // The Scheduler may insert instructions during either schedule() or
-    // exitRegion(), even for empty regions. So the local iterators 'I' and
-    // 'RegionEnd' are invalid across these calls. Instructions must not be
-    // added to other regions than the current one without updating MBBRegions.
-
-    MBBRegionsVector MBBRegions;
-    getSchedRegions(&*MBB, MBBRegions, Scheduler.doMBBSchedRegionsTopDown());
-    for (MBBRegionsVector::iterator R = MBBRegions.begin();
-         R != MBBRegions.end(); ++R) {
-      MachineBasicBlock::iterator I = R->RegionBegin;
-      MachineBasicBlock::iterator RegionEnd = R->RegionEnd;
-      unsigned NumRegionInstrs = R->NumRegionInstrs;
-
-      // Notify the scheduler of the region, even if we may skip scheduling
-      // it. Perhaps it still needs to be bundled.
-      Scheduler.enterRegion(&*MBB, I, RegionEnd, NumRegionInstrs);
-
-      // Skip empty scheduling regions (0 or 1 schedulable instructions).
-      if (I == RegionEnd || I == std::prev(RegionEnd)) {
-        // Close the current region. Bundle the terminator if needed.
-        // This invalidates 'RegionEnd' and 'I'.
-        Scheduler.exitRegion();
-        continue;
-      }
-      LLVM_DEBUG(dbgs() << "********** MI Scheduling **********\n");
-      LLVM_DEBUG(dbgs() << MF->getName() << ":" << printMBBReference(*MBB)
-                        << " " << MBB->getName() << "\n  From: " << *I
-                        << "    To: ";
-                 if (RegionEnd != MBB->end()) dbgs() << *RegionEnd;
-                 else dbgs() << "End";
-                 dbgs() << " RegionInstrs: " << NumRegionInstrs << '\n');
-      if (DumpCriticalPathLength) {
-        errs() << MF->getName();
-        errs() << ":%bb. " << MBB->getNumber();
-        errs() << " " << MBB->getName() << " \n";
-      }
-
-      // Schedule a region: possibly reorder instructions.
-      // This invalidates the original region iterators.
-      Scheduler.schedule();
-
-      // Close the current region.
+  // Break the block into scheduling regions [I, RegionEnd). RegionEnd
+  // points to the scheduling boundary at the bottom of the region. The DAG
+  // does not include RegionEnd, but the region does (i.e. the next
+  // RegionEnd is above the previous RegionBegin). If the current block has
+  // no terminator then RegionEnd == MBB.end() for the bottom region.
+  //
+  // All the regions of MBB are first found and stored in MBBRegions, which
+  // will be processed (MBB) top-down if initialized with true.
+  //
+  // The Scheduler may insert instructions during either schedule() or
+  // exitRegion(), even for empty regions. So the local iterators 'I' and
+  // 'RegionEnd' are invalid across these calls. Instructions must not be
+  // added to other regions than the current one without updating MBBRegions.
+
+  MBBRegionsVector MBBRegions;
+  getSchedRegions(&MBB, MBBRegions, Scheduler.doMBBSchedRegionsTopDown());
+  for (MBBRegionsVector::iterator R = MBBRegions.begin();
+       R != MBBRegions.end(); ++R) {
+    MachineBasicBlock::iterator I = R->RegionBegin;
+    MachineBasicBlock::iterator RegionEnd = R->RegionEnd;
+    unsigned NumRegionInstrs = R->NumRegionInstrs;
+
+    // Notify the scheduler of the region, even if we may skip scheduling
+    // it. Perhaps it still needs to be bundled.
+    Scheduler.enterRegion(&MBB, I, RegionEnd, NumRegionInstrs);
+
+    // Skip empty scheduling regions (0 or 1 schedulable instructions).
+    if (I == RegionEnd || I == std::prev(RegionEnd)) {
+      // Close the current region. Bundle the terminator if needed.
+      // This invalidates 'RegionEnd' and 'I'.
       Scheduler.exitRegion();
+      continue;
     }
-    Scheduler.finishBlock();
-    // FIXME: Ideally, no further passes should rely on kill flags. However,
-    // thumb2 size reduction is currently an exception, so the PostMIScheduler
-    // needs to do this.
-    if (FixKillFlags)
-      Scheduler.fixupKills(*MBB);
+    LLVM_DEBUG(dbgs() << "********** MI Scheduling **********\n");
+    LLVM_DEBUG(dbgs() << MF->getName() << ":" << printMBBReference(MBB)
+                      << " " << MBB.getName() << "\n  From: " << *I
+                      << "    To: ";
+               if (RegionEnd != MBB.end()) dbgs() << *RegionEnd;
+               else dbgs() << "End";
+               dbgs() << " RegionInstrs: " << NumRegionInstrs << '\n');
+    if (DumpCriticalPathLength) {
+      errs() << MF->getName();
+      errs() << ":%bb. " << MBB.getNumber();
+      errs() << " " << MBB.getName() << " \n";
+    }
+
+    // Schedule a region: possibly reorder instructions.
+    // This invalidates the original region iterators.
+    Scheduler.schedule();
+
+    // Close the current region.
+    Scheduler.exitRegion();
   }
-  Scheduler.finalizeSchedule();
+  Scheduler.finishBlock();
+  // FIXME: Ideally, no further passes should rely on kill flags. However,
+  // thumb2 size reduction is currently an exception, so the PostMIScheduler
+  // needs to do this.
+  if (FixKillFlags)
+    Scheduler.fixupKills(MBB);
+}
+
+/// Schedule the blocks of the function on a thread pool.
+///
+/// Post-RA scheduling only reorders instructions within a block and does not
+/// maintain function-wide liveness, so blocks are independent of each other.
+/// Blocks are split into groups of consecutive blocks, one group per task, and
+/// every block is scheduled by a scheduler instance of its own. No strategy
+/// state carries over from one block to the next, so the output depends
+/// neither on the number of threads nor on the size of the groups, and matches
+/// the serial driver for every strategy that resets its state per region.
+void PostMachineScheduler::scheduleRegionsInParallel() {
+  SmallVector<MachineBasicBlock *, 32> Blocks;
+  for (MachineBasicBlock &MBB : *MF)
+    Blocks.push_back(&MBB);
+
+  unsigned BlocksPerTask = std::max(1u, (unsigned)PostMISchedBlocksPerTask);
+  unsigned NumTasks = (Blocks.size() + BlocksPerTask - 1) / BlocksPerTask;
+
+  // Targets may consult shared state of the pass while creating a scheduler,
+  // so only one task creates one at a time.
+  std::mutex CreateLock;
+
+  if (!Pool)
+    Pool = llvm::make_unique<ThreadPool>(PostMISchedThreads);
+  for (unsigned I = 0; I != NumTasks; ++I) {
+    ArrayRef<MachineBasicBlock *> Group = makeArrayRef(Blocks).slice(
+        I * BlocksPerTask,
+        std::min<size_t>(BlocksPerTask, Blocks.size() - I * BlocksPerTask));
+    Pool->async([this, Group, &CreateLock]() {
+      for (MachineBasicBlock *MBB : Group) {
+        std::unique_ptr<ScheduleDAGInstrs> Scheduler;
+        {
+          std::lock_guard<std::mutex> Guard(CreateLock);
+          Scheduler.reset(createPostMachineScheduler());
+        }
+        scheduleBlockRegions(*Scheduler, *MBB, /*FixKillFlags=*/true);
+        Scheduler->finalizeSchedule();
+      }
+    });
+  }
+  Pool->wait();
 }
 
 void MachineSchedulerBase::print(raw_ostream &O, const Module* m) const {
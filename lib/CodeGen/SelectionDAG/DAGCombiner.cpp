@@ -58,6 +58,7 @@
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/KnownBits.h"
 #include "llvm/Support/MachineValueType.h"
 #include "llvm/Support/MathExtras.h"
@@ -69,6 +70,7 @@
 #include <cstdint>
 #include <functional>
 #include <iterator>
+#include <map>
 #include <string>
 #include <tuple>
 #include <utility>
@@ -84,6 +86,9 @@ STATISTIC(OpsNarrowed     , "Number of load/op/store narrowed");
 STATISTIC(LdStFP2Int      , "Number of fp load/store pairs transformed to int");
 STATISTIC(SlicedLoads, "Number of load sliced");
 STATISTIC(NumFPLogicOpsConv, "Number of logic ops converted to fp ops");
+STATISTIC(NodesRevisited  , "Number of dag nodes visited more than once");
+STATISTIC(RevisitLimitHits, "Number of dag node visits skipped by the "
+                            "revisit limit");
 
 static cl::opt<bool>
 CombinerGlobalAA("combiner-global-alias-analysis", cl::Hidden,
@@ -111,6 +116,27 @@ static cl::opt<bool>
   MaySplitLoadIndex("combiner-split-load-index", cl::Hidden, cl::init(true),
                     cl::desc("DAG combiner may split indexing from loads"));
 
+/// When enabled, a combine only revisits the users whose operands were
+/// actually rewritten by the replacement, instead of every user of the
+/// replacement node (which may be a pre-existing, widely used node).
+static cl::opt<bool>
+  PreciseWorklist("combiner-precise-worklist", cl::Hidden, cl::init(false),
+                  cl::desc("Only revisit users of a combined node whose "
+                           "operands changed"));
+
+/// Bound the number of times a single node may be visited during one run of
+/// the combiner. A value of zero means no limit.
+static cl::opt<unsigned>
+  MaxNodeRevisits("combiner-max-node-revisits", cl::Hidden, cl::init(0),
+                  cl::desc("Maximum number of times the DAG combiner "
+                           "revisits a single node (0 = unlimited)"));
+
+static cl::opt<bool>
+  PrintNodeKindStats("combiner-print-node-stats", cl::Hidden,
+                     cl::init(false),
+                     cl::desc("Print the number of combines and revisits "
+                              "per node kind after each DAG combiner run"));
+
 namespace {
 
   class DAGCombiner {
@@ -148,6 +174,24 @@ namespace {
     /// which have not yet been combined to the worklist.
     SmallPtrSet<SDNode *, 32> CombinedNodes;
 
+    /// Whether visits are counted at all: only with a revisit limit, the
+    /// per node kind report or statistics enabled.
+    bool TrackVisits;
+
+    /// Number of times each live node has been pulled off the worklist and
+    /// considered for combining during the current run. Only maintained when
+    /// TrackVisits is set.
+    DenseMap<SDNode *, unsigned> VisitCounts;
+
+    /// Per node kind counters, only maintained with -combiner-print-node-stats.
+    struct NodeKindStats {
+      unsigned Visits = 0;
+      unsigned Revisits = 0;
+      unsigned Skipped = 0;
+      unsigned Combines = 0;
+    };
+    std::map<std::string, NodeKindStats> NodeKindCounts;
+
     // AA - Used for DAG load/store alias analysis.
     AliasAnalysis *AA;
 
@@ -158,6 +202,61 @@ namespace {
         AddToWorklist(Node);
     }
 
+    /// Record the current users of \p N, which is about to be replaced, so
+    /// that AddReplacedUsersToWorklist can tell which users were rewritten.
+    void collectUsersForRevisit(SDNode *N, SmallPtrSetImpl<SDNode *> &Users) {
+      if (!PreciseWorklist)
+        return;
+      for (SDNode *Node : N->uses())
+        Users.insert(Node);
+    }
+
+    /// Add the users of the replacement node \p N to the worklist. In precise
+    /// mode only the users that previously used the replaced node (and thus
+    /// had their operands rewritten) are added; the others are unaffected by
+    /// the replacement and do not need to be revisited.
+    void AddReplacedUsersToWorklist(SDNode *N,
+                                    const SmallPtrSetImpl<SDNode *> &OldUsers) {
+      if (!PreciseWorklist)
+        return AddUsersToWorklist(N);
+      for (SDNode *Node : N->uses())
+        if (OldUsers.count(Node))
+          AddToWorklist(Node);
+    }
+
+    /// Count a visit of \p N. Returns false if the node has exceeded the
+    /// revisit limit and should not be combined again in this run. Skipped
+    /// visits are not counted as visits.
+    bool recordVisit(SDNode *N) {
+      if (!TrackVisits)
+        return true;
+      unsigned Count = ++VisitCounts[N];
+      if (MaxNodeRevisits && Count > MaxNodeRevisits + 1) {
+        ++RevisitLimitHits;
+        if (PrintNodeKindStats)
+          ++NodeKindCounts[N->getOperationName(&DAG)].Skipped;
+        return false;
+      }
+      if (PrintNodeKindStats) {
+        NodeKindStats &Stats = NodeKindCounts[N->getOperationName(&DAG)];
+        ++Stats.Visits;
+        if (Count > 1)
+          ++Stats.Revisits;
+      }
+      if (Count > 1)
+        ++NodesRevisited;
+      return true;
+    }
+
+    /// Count a successful combine of \p N for the per node kind report.
+    void recordCombine(SDNode *N) {
+      if (PrintNodeKindStats)
+        ++NodeKindCounts[N->getOperationName(&DAG)].Combines;
+    }
+
+    /// Print and reset the per node kind counters.
+    void printNodeKindStats(raw_ostream &OS);
+
     // Prune potentially dangling nodes. This is called after
     // any visit to a node, but should also be called during a visit after any
     // failed combine which may have created a DAG node.
@@ -197,6 +296,8 @@ namespace {
         : DAG(D), TLI(D.getTargetLoweringInfo()), Level(BeforeLegalizeTypes),
           OptLevel(OL), AA(AA) {
       ForCodeSize = DAG.getMachineFunction().getFunction().hasOptSize();
+      TrackVisits =
+          MaxNodeRevisits || PrintNodeKindStats || AreStatisticsEnabled();
 
       MaximumLegalStoreInBits = 0;
       for (MVT VT : MVT::all_valuetypes())
@@ -232,6 +333,7 @@ namespace {
     void removeFromWorklist(SDNode *N) {
       CombinedNodes.erase(N);
       PruningList.remove(N);
+      VisitCounts.erase(N);
 
       auto It = WorklistMap.find(N);
       if (It == WorklistMap.end())
@@ -1054,13 +1156,15 @@ SDValue DAGCombiner::CombineTo(SDNode *N, const SDValue *To, unsigned NumTo,
            "Cannot combine value to value of different type!");
 
   WorklistRemover DeadNodes(*this);
+  SmallPtrSet<SDNode *, 16> OldUsers;
+  collectUsersForRevisit(N, OldUsers);
   DAG.ReplaceAllUsesWith(N, To);
   if (AddTo) {
     // Push the new nodes and any users onto the worklist
     for (unsigned i = 0, e = NumTo; i != e; ++i) {
       if (To[i].getNode()) {
         AddToWorklist(To[i].getNode());
-        AddUsersToWorklist(To[i].getNode());
+        AddReplacedUsersToWorklist(To[i].getNode(), OldUsers);
       }
     }
   }
@@ -1078,11 +1182,13 @@ CommitTargetLoweringOpt(const TargetLowering::TargetLoweringOpt &TLO) {
   // Replace all uses.  If any nodes become isomorphic to other nodes and
   // are deleted, make sure to remove them from our worklist.
   WorklistRemover DeadNodes(*this);
+  SmallPtrSet<SDNode *, 16> OldUsers;
+  collectUsersForRevisit(TLO.Old.getNode(), OldUsers);
   DAG.ReplaceAllUsesOfValueWith(TLO.Old, TLO.New);
 
   // Push the new node and any (possibly new) users onto the worklist.
   AddToWorklist(TLO.New.getNode());
-  AddUsersToWorklist(TLO.New.getNode());
+  AddReplacedUsersToWorklist(TLO.New.getNode(), OldUsers);
 
   // Finally, if the node is now dead, remove it from the graph.  The node
   // may not be dead if the replacement process recursively simplified to
@@ -1486,6 +1592,11 @@ void DAGCombiner::Run(CombineLevel AtLevel) {
         continue;
     }
 
+    // Give up on nodes that keep coming back; on wide DAGs a few nodes can
+    // otherwise be re-added after nearly every combine of their neighbours.
+    if (!recordVisit(N))
+      continue;
+
     LLVM_DEBUG(dbgs() << "\nCombining: "; N->dump(&DAG));
 
     // Add any operands of the new node which have not yet been combined to the
@@ -1502,6 +1613,7 @@ void DAGCombiner::Run(CombineLevel AtLevel) {
       continue;
 
     ++NodesCombined;
+    recordCombine(N);
 
     // If we get back the same node we passed in, rather than a new node or
     // zero, we know that the node must have defined multiple values and
@@ -1516,6 +1628,8 @@ void DAGCombiner::Run(CombineLevel AtLevel) {
 
     LLVM_DEBUG(dbgs() << " ... into: "; RV.getNode()->dump(&DAG));
 
+    SmallPtrSet<SDNode *, 16> OldUsers;
+    collectUsersForRevisit(N, OldUsers);
     if (N->getNumValues() == RV.getNode()->getNumValues())
       DAG.ReplaceAllUsesWith(N, RV.getNode());
     else {
@@ -1526,7 +1640,7 @@ void DAGCombiner::Run(CombineLevel AtLevel) {
 
     // Push the new node and any users onto the worklist
     AddToWorklist(RV.getNode());
-    AddUsersToWorklist(RV.getNode());
+    AddReplacedUsersToWorklist(RV.getNode(), OldUsers);
 
     // Finally, if the node is now dead, remove it from the graph.  The node
     // may not be dead if the replacement process recursively simplified to
@@ -1538,6 +1652,25 @@ void DAGCombiner::Run(CombineLevel AtLevel) {
   // If the root changed (e.g. it was a dead load, update the root).
   DAG.setRoot(Dummy.getValue());
   DAG.RemoveDeadNodes();
+
+  VisitCounts.clear();
+  if (PrintNodeKindStats)
+    printNodeKindStats(dbgs());
+}
+
+void DAGCombiner::printNodeKindStats(raw_ostream &OS) {
+  OS << "=== DAG combiner node statistics for '"
+     << DAG.getMachineFunction().getName() << "' (level " << Level
+     << ") ===\n";
+  OS << left_justify("Node", 32) << right_justify("Visits", 11)
+     << right_justify("Revisits", 11) << right_justify("Skipped", 11)
+     << right_justify("Combines", 11) << '\n';
+  for (const auto &KV : NodeKindCounts)
+    OS << left_justify(KV.first, 32) << format_decimal(KV.second.Visits, 11)
+       << format_decimal(KV.second.Revisits, 11)
+       << format_decimal(KV.second.Skipped, 11)
+       << format_decimal(KV.second.Combines, 11) << '\n';
+  NodeKindCounts.clear();
 }
 
 SDValue DAGCombiner::visit(SDNode *N) {
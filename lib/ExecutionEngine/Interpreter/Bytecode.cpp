@@ -0,0 +1,1115 @@
+//===-- Bytecode.cpp - Lower functions to register bytecode and run them --===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file contains the decoder that lowers a Function to the interpreter's
+//  register bytecode, and the loop that executes it.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Bytecode.h"
+#include "Interpreter.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/GetElementPtrTypeIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/MemAlloc.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+using namespace llvm;
+
+#define DEBUG_TYPE "interpreter"
+
+STATISTIC(NumDecoded, "Number of functions decoded to bytecode");
+STATISTIC(NumNotDecoded, "Number of functions left to the instruction walker");
+
+//===----------------------------------------------------------------------===//
+//                     Various Helper Functions
+//===----------------------------------------------------------------------===//
+
+// The interpreter keeps pointers in host format, as LoadValueFromMemory and
+// StoreValueToMemory do.
+static const unsigned PointerBits = sizeof(void *) * 8;
+
+// isSlotType - Return true if values of type Ty fit in a slot.
+static bool isSlotType(Type *Ty) {
+  if (auto *ITy = dyn_cast<IntegerType>(Ty))
+    return ITy->getBitWidth() <= 64;
+  return Ty->isFloatTy() || Ty->isDoubleTy() || Ty->isPointerTy();
+}
+
+static unsigned getSlotBits(Type *Ty) {
+  if (Ty->isPointerTy())
+    return PointerBits;
+  return Ty->getPrimitiveSizeInBits();
+}
+
+static uint64_t toSlot(const GenericValue &GV, Type *Ty) {
+  switch (Ty->getTypeID()) {
+  case Type::IntegerTyID:
+    return GV.IntVal.zextOrTrunc(64).getZExtValue() &
+           maskTrailingOnes<uint64_t>(getSlotBits(Ty));
+  case Type::FloatTyID:
+    return FloatToBits(GV.FloatVal);
+  case Type::DoubleTyID:
+    return DoubleToBits(GV.DoubleVal);
+  case Type::PointerTyID:
+    return (uintptr_t)GV.PointerVal;
+  default:
+    llvm_unreachable("Type does not fit in a slot!");
+  }
+}
+
+static GenericValue fromSlot(uint64_t Val, Type *Ty) {
+  GenericValue GV;
+  switch (Ty->getTypeID()) {
+  case Type::IntegerTyID:
+    GV.IntVal = APInt(getSlotBits(Ty), Val);
+    break;
+  case Type::FloatTyID:
+    GV.FloatVal = BitsToFloat(uint32_t(Val));
+    break;
+  case Type::DoubleTyID:
+    GV.DoubleVal = BitsToDouble(Val);
+    break;
+  case Type::PointerTyID:
+    GV.PointerVal = (PointerTy)(uintptr_t)Val;
+    break;
+  default:
+    memset(&GV.Untyped, 0, sizeof(GV.Untyped));
+    break;
+  }
+  return GV;
+}
+
+// canFoldConstant - ExecutionEngine::getConstantValue folds casts, GEPs and
+// binary operators; functions using any other constant expression are left to
+// the instruction walker, which evaluates them as it goes.
+static bool canFoldConstant(const Constant *C) {
+  if (isa<BlockAddress>(C) || isa<GlobalIFunc>(C))
+    return false;
+  auto *CE = dyn_cast<ConstantExpr>(C);
+  if (!CE)
+    return true;
+  switch (CE->getOpcode()) {
+  case Instruction::GetElementPtr:
+  case Instruction::Trunc:
+  case Instruction::ZExt:
+  case Instruction::SExt:
+  case Instruction::FPTrunc:
+  case Instruction::FPExt:
+  case Instruction::UIToFP:
+  case Instruction::SIToFP:
+  case Instruction::FPToUI:
+  case Instruction::FPToSI:
+  case Instruction::PtrToInt:
+  case Instruction::IntToPtr:
+  case Instruction::BitCast:
+  case Instruction::Add:
+  case Instruction::FAdd:
+  case Instruction::Sub:
+  case Instruction::FSub:
+  case Instruction::Mul:
+  case Instruction::FMul:
+  case Instruction::UDiv:
+  case Instruction::SDiv:
+  case Instruction::URem:
+  case Instruction::SRem:
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+    break;
+  default:
+    return false;
+  }
+  for (const Use &Op : CE->operands())
+    if (!canFoldConstant(cast<Constant>(Op)))
+      return false;
+  return true;
+}
+
+static inline int64_t sext(uint64_t Val, unsigned Shift) {
+  return int64_t(Val << Shift) >> Shift;
+}
+
+// shiftAmount - Clamp an oversized shift amount the way getShiftAmount in
+// Execution.cpp does.
+static inline unsigned shiftAmount(uint64_t Amt, unsigned Shift) {
+  unsigned Bits = 64 - Shift;
+  if (Amt < Bits)
+    return Amt;
+  return (NextPowerOf2(Bits - 1) - 1) & Amt;
+}
+
+static inline float asFloat(uint64_t Val) { return BitsToFloat(uint32_t(Val)); }
+static inline double asDouble(uint64_t Val) { return BitsToDouble(Val); }
+static inline uint64_t toBits(float Val) { return FloatToBits(Val); }
+static inline uint64_t toBits(double Val) { return DoubleToBits(Val); }
+
+// fpToInt - Convert the way APIntOps::RoundDoubleToAPInt does: values below
+// zero wrap, and values up to 2^64 convert as unsigned.
+static inline uint64_t fpToInt(double Val) {
+  if (Val >= 9223372036854775808.0)
+    return uint64_t(Val);
+  return uint64_t(int64_t(Val));
+}
+
+static bool compareFP(unsigned Pred, double L, double R) {
+  switch (Pred) {
+  case FCmpInst::FCMP_FALSE: return false;
+  case FCmpInst::FCMP_OEQ:   return L == R;
+  case FCmpInst::FCMP_OGT:   return L > R;
+  case FCmpInst::FCMP_OGE:   return L >= R;
+  case FCmpInst::FCMP_OLT:   return L < R;
+  case FCmpInst::FCMP_OLE:   return L <= R;
+  case FCmpInst::FCMP_ONE:   return L < R || L > R;
+  case FCmpInst::FCMP_ORD:   return !std::isnan(L) && !std::isnan(R);
+  case FCmpInst::FCMP_UNO:   return std::isnan(L) || std::isnan(R);
+  case FCmpInst::FCMP_UEQ:   return !(L < R || L > R);
+  case FCmpInst::FCMP_UGT:   return !(L <= R);
+  case FCmpInst::FCMP_UGE:   return !(L < R);
+  case FCmpInst::FCMP_ULT:   return !(L >= R);
+  case FCmpInst::FCMP_ULE:   return !(L > R);
+  case FCmpInst::FCMP_UNE:   return L != R;
+  case FCmpInst::FCMP_TRUE:  return true;
+  default:
+    llvm_unreachable("Invalid FCmp predicate!");
+  }
+}
+
+//===----------------------------------------------------------------------===//
+//                            Decoding Functions
+//===----------------------------------------------------------------------===//
+
+namespace llvm {
+
+// BytecodeDecoder - Lowers one function to bytecode.  Branch targets are
+// recorded as CFG edge numbers while the blocks are decoded, and patched to
+// code addresses once every block has been placed; edges into blocks with
+// PHI nodes get a few instructions of their own that move the incoming values.
+//
+class BytecodeDecoder {
+public:
+  BytecodeDecoder(Interpreter &Interp, Function &F)
+      : Interp(Interp), DL(Interp.getDataLayout()), F(F),
+        BF(llvm::make_unique<BytecodeFunction>()) {}
+
+  std::unique_ptr<BytecodeFunction> decode();
+
+private:
+  bool decodeInst(Instruction &I);
+  bool decodeIntrinsic(IntrinsicInst &II);
+  bool decodeBinaryOperator(BinaryOperator &I);
+  bool decodeCmp(CmpInst &I);
+  bool decodeCast(CastInst &I);
+  bool decodeLoad(LoadInst &I);
+  bool decodeStore(StoreInst &I);
+  bool decodeGEP(GetElementPtrInst &I);
+  bool decodeCall(CallInst &I);
+
+  bool getSlot(Value *V, uint32_t &Slot);
+  uint32_t getEdge(BasicBlock *From, BasicBlock *To);
+  uint32_t emitEdge(BasicBlock *From, BasicBlock *To);
+
+  BytecodeInst &emit(BytecodeInst::Opcode Op) {
+    BF->Code.emplace_back(Op);
+    return BF->Code.back();
+  }
+
+  Interpreter &Interp;
+  const DataLayout &DL;
+  Function &F;
+  std::unique_ptr<BytecodeFunction> BF;
+
+  DenseMap<Value *, uint32_t> ValueSlots;
+  DenseMap<BasicBlock *, uint32_t> BlockStarts;
+  DenseMap<std::pair<BasicBlock *, BasicBlock *>, uint32_t> EdgeNumbers;
+  std::vector<std::pair<BasicBlock *, BasicBlock *>> Edges;
+  uint32_t FirstTemp = 0;
+};
+
+} // End llvm namespace
+
+std::unique_ptr<BytecodeFunction> BytecodeDecoder::decode() {
+  Type *RetTy = F.getReturnType();
+  if (F.isVarArg() || (!RetTy->isVoidTy() && !isSlotType(RetTy)))
+    return nullptr;
+
+  BF->F = &F;
+  for (Argument &A : F.args()) {
+    if (!isSlotType(A.getType()))
+      return nullptr;
+    ValueSlots[&A] = BF->NumSlots++;
+  }
+  BF->NumArgs = BF->NumSlots;
+
+  // Number the results.  Calls get a slot even when they return void, so that
+  // returning into one never needs to check.
+  unsigned NumTemps = 0;
+  for (BasicBlock &BB : F) {
+    unsigned NumPHIs = 0;
+    for (Instruction &I : BB) {
+      if (isa<PHINode>(I))
+        ++NumPHIs;
+      if (!I.getType()->isVoidTy() || isa<CallInst>(I))
+        ValueSlots[&I] = BF->NumSlots++;
+    }
+    NumTemps = std::max(NumTemps, NumPHIs);
+  }
+  FirstTemp = BF->NumSlots;
+  BF->NumSlots += NumTemps;
+  BF->FirstConstant = BF->NumSlots;
+
+  for (BasicBlock &BB : F) {
+    BlockStarts[&BB] = BF->Code.size();
+    for (Instruction &I : BB)
+      if (!decodeInst(I)) {
+        LLVM_DEBUG(dbgs() << "Can't decode " << F.getName() << " to bytecode: "
+                          << I << "\n");
+        return nullptr;
+      }
+  }
+
+  // Place the edges, then point the branches at them.
+  size_t NumBlockInsts = BF->Code.size();
+  std::vector<uint32_t> EdgePCs;
+  for (unsigned I = 0; I != Edges.size(); ++I)
+    EdgePCs.push_back(emitEdge(Edges[I].first, Edges[I].second));
+
+  for (size_t I = 0; I != NumBlockInsts; ++I) {
+    BytecodeInst &BI = BF->Code[I];
+    switch (BI.Op) {
+    case BytecodeInst::Jump:
+      BI.Imm = EdgePCs[BI.Imm];
+      break;
+    case BytecodeInst::Br:
+      BI.B = EdgePCs[BI.B];
+      BI.C = EdgePCs[BI.C];
+      break;
+    case BytecodeInst::Switch:
+      BI.Imm = EdgePCs[BI.Imm];
+      for (unsigned C = 0; C != BI.C; ++C)
+        BF->Cases[BI.B + C].Target = EdgePCs[BF->Cases[BI.B + C].Target];
+      break;
+    default:
+      break;
+    }
+  }
+
+  return std::move(BF);
+}
+
+bool BytecodeDecoder::getSlot(Value *V, uint32_t &Slot) {
+  auto It = ValueSlots.find(V);
+  if (It != ValueSlots.end()) {
+    Slot = It->second;
+    return true;
+  }
+
+  auto *C = dyn_cast<Constant>(V);
+  if (!C || !isSlotType(C->getType()) || !canFoldConstant(C))
+    return false;
+  Slot = BF->NumSlots++;
+  ValueSlots[V] = Slot;
+  BF->InitialSlots.push_back(
+      isa<UndefValue>(C) ? 0
+                         : toSlot(Interp.getConstantValue(C), C->getType()));
+  return true;
+}
+
+uint32_t BytecodeDecoder::getEdge(BasicBlock *From, BasicBlock *To) {
+  auto Result = EdgeNumbers.insert({{From, To}, uint32_t(Edges.size())});
+  if (Result.second)
+    Edges.push_back({From, To});
+  return Result.first->second;
+}
+
+// emitEdge - Return the code address to branch to for the edge From -> To.
+// PHI nodes in To read all of their incoming values before any of them is
+// written, so with more than one PHI the values go through temporaries.
+uint32_t BytecodeDecoder::emitEdge(BasicBlock *From, BasicBlock *To) {
+  SmallVector<std::pair<uint32_t, uint32_t>, 4> Moves;
+  for (PHINode &PN : To->phis()) {
+    uint32_t Src, Dst;
+    bool Found = getSlot(PN.getIncomingValueForBlock(From), Src) &&
+                 getSlot(&PN, Dst);
+    (void)Found;
+    assert(Found && "PHI operands were checked when it was decoded");
+    Moves.push_back({Dst, Src});
+  }
+  if (Moves.empty())
+    return BlockStarts[To];
+
+  uint32_t PC = BF->Code.size();
+  if (Moves.size() == 1) {
+    BytecodeInst &BI = emit(BytecodeInst::Move);
+    BI.Dst = Moves[0].first;
+    BI.A = Moves[0].second;
+  } else {
+    for (unsigned I = 0; I != Moves.size(); ++I) {
+      BytecodeInst &BI = emit(BytecodeInst::Move);
+      BI.Dst = FirstTemp + I;
+      BI.A = Moves[I].second;
+    }
+    for (unsigned I = 0; I != Moves.size(); ++I) {
+      BytecodeInst &BI = emit(BytecodeInst::Move);
+      BI.Dst = Moves[I].first;
+      BI.A = FirstTemp + I;
+    }
+  }
+  emit(BytecodeInst::Jump).Imm = BlockStarts[To];
+  return PC;
+}
+
+bool BytecodeDecoder::decodeInst(Instruction &I) {
+  if (auto *II = dyn_cast<IntrinsicInst>(&I))
+    return decodeIntrinsic(*II);
+
+  if (!I.getType()->isVoidTy() && !isSlotType(I.getType()))
+    return false;
+  for (Value *Op : I.operands())
+    if (!isa<BasicBlock>(Op) && !isSlotType(Op->getType()))
+      return false;
+
+  switch (I.getOpcode()) {
+  case Instruction::Add:
+  case Instruction::Sub:
+  case Instruction::Mul:
+  case Instruction::UDiv:
+  case Instruction::SDiv:
+  case Instruction::URem:
+  case Instruction::SRem:
+  case Instruction::Shl:
+  case Instruction::LShr:
+  case Instruction::AShr:
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+  case Instruction::FAdd:
+  case Instruction::FSub:
+  case Instruction::FMul:
+  case Instruction::FDiv:
+  case Instruction::FRem:
+    return decodeBinaryOperator(cast<BinaryOperator>(I));
+  case Instruction::ICmp:
+  case Instruction::FCmp:
+    return decodeCmp(cast<CmpInst>(I));
+  case Instruction::Trunc:
+  case Instruction::ZExt:
+  case Instruction::SExt:
+  case Instruction::FPTrunc:
+  case Instruction::FPExt:
+  case Instruction::FPToUI:
+  case Instruction::FPToSI:
+  case Instruction::UIToFP:
+  case Instruction::SIToFP:
+  case Instruction::PtrToInt:
+  case Instruction::IntToPtr:
+  case Instruction::BitCast:
+    return decodeCast(cast<CastInst>(I));
+  case Instruction::Select: {
+    BytecodeInst &BI = emit(BytecodeInst::Select);
+    return getSlot(I.getOperand(0), BI.A) && getSlot(I.getOperand(1), BI.B) &&
+           getSlot(I.getOperand(2), BI.C) && getSlot(&I, BI.Dst);
+  }
+  case Instruction::Alloca: {
+    auto &AI = cast<AllocaInst>(I);
+    BytecodeInst &BI = emit(BytecodeInst::Alloca);
+    BI.Imm = DL.getTypeAllocSize(AI.getAllocatedType());
+    return getSlot(AI.getArraySize(), BI.A) && getSlot(&I, BI.Dst);
+  }
+  case Instruction::Load:
+    return decodeLoad(cast<LoadInst>(I));
+  case Instruction::Store:
+    return decodeStore(cast<StoreInst>(I));
+  case Instruction::GetElementPtr:
+    return decodeGEP(cast<GetElementPtrInst>(I));
+  case Instruction::PHI: {
+    // The moves are emitted on the incoming edges; make sure they can be.
+    auto &PN = cast<PHINode>(I);
+    uint32_t Slot;
+    for (Value *V : PN.incoming_values())
+      if (!getSlot(V, Slot))
+        return false;
+    return true;
+  }
+  case Instruction::Call:
+    return decodeCall(cast<CallInst>(I));
+  case Instruction::Br: {
+    auto &BI = cast<BranchInst>(I);
+    BasicBlock *BB = BI.getParent();
+    if (BI.isUnconditional()) {
+      emit(BytecodeInst::Jump).Imm = getEdge(BB, BI.getSuccessor(0));
+      return true;
+    }
+    BytecodeInst &Br = emit(BytecodeInst::Br);
+    Br.B = getEdge(BB, BI.getSuccessor(0));
+    Br.C = getEdge(BB, BI.getSuccessor(1));
+    return getSlot(BI.getCondition(), Br.A);
+  }
+  case Instruction::Switch: {
+    auto &SI = cast<SwitchInst>(I);
+    BasicBlock *BB = SI.getParent();
+    BytecodeInst &BI = emit(BytecodeInst::Switch);
+    BI.B = BF->Cases.size();
+    BI.C = SI.getNumCases();
+    BI.Imm = getEdge(BB, SI.getDefaultDest());
+    for (auto Case : SI.cases())
+      BF->Cases.push_back({Case.getCaseValue()->getZExtValue(),
+                           getEdge(BB, Case.getCaseSuccessor())});
+    return getSlot(SI.getCondition(), BI.A);
+  }
+  case Instruction::Ret: {
+    auto &RI = cast<ReturnInst>(I);
+    if (!RI.getReturnValue()) {
+      emit(BytecodeInst::RetVoid);
+      return true;
+    }
+    return getSlot(RI.getReturnValue(), emit(BytecodeInst::Ret).A);
+  }
+  case Instruction::Unreachable:
+    emit(BytecodeInst::Unreachable);
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool BytecodeDecoder::decodeIntrinsic(IntrinsicInst &II) {
+  BytecodeInst::Opcode Op;
+  switch (II.getIntrinsicID()) {
+  case Intrinsic::dbg_declare:
+  case Intrinsic::dbg_value:
+  case Intrinsic::dbg_label:
+  case Intrinsic::lifetime_start:
+  case Intrinsic::lifetime_end:
+    return true;
+  case Intrinsic::memcpy:
+    Op = BytecodeInst::MemCpy;
+    break;
+  case Intrinsic::memmove:
+    Op = BytecodeInst::MemMove;
+    break;
+  case Intrinsic::memset:
+    Op = BytecodeInst::MemSet;
+    break;
+  default:
+    // Anything else is lowered by IntrinsicLowering as the instruction walker
+    // reaches it.
+    return false;
+  }
+  BytecodeInst &BI = emit(Op);
+  return getSlot(II.getArgOperand(0), BI.A) &&
+         getSlot(II.getArgOperand(1), BI.B) &&
+         getSlot(II.getArgOperand(2), BI.C);
+}
+
+bool BytecodeDecoder::decodeBinaryOperator(BinaryOperator &I) {
+  using BC = BytecodeInst;
+  Type *Ty = I.getType();
+  BC::Opcode Op;
+  if (Ty->isFloatTy() || Ty->isDoubleTy()) {
+    bool F32 = Ty->isFloatTy();
+    switch (I.getOpcode()) {
+    case Instruction::FAdd: Op = F32 ? BC::FAddF32 : BC::FAddF64; break;
+    case Instruction::FSub: Op = F32 ? BC::FSubF32 : BC::FSubF64; break;
+    case Instruction::FMul: Op = F32 ? BC::FMulF32 : BC::FMulF64; break;
+    case Instruction::FDiv: Op = F32 ? BC::FDivF32 : BC::FDivF64; break;
+    case Instruction::FRem: Op = F32 ? BC::FRemF32 : BC::FRemF64; break;
+    default:
+      llvm_unreachable("Integer operator on floating point type!");
+    }
+  } else {
+    switch (I.getOpcode()) {
+    case Instruction::Add:  Op = BC::Add;  break;
+    case Instruction::Sub:  Op = BC::Sub;  break;
+    case Instruction::Mul:  Op = BC::Mul;  break;
+    case Instruction::UDiv: Op = BC::UDiv; break;
+    case Instruction::SDiv: Op = BC::SDiv; break;
+    case Instruction::URem: Op = BC::URem; break;
+    case Instruction::SRem: Op = BC::SRem; break;
+    case Instruction::Shl:  Op = BC::Shl;  break;
+    case Instruction::LShr: Op = BC::LShr; break;
+    case Instruction::AShr: Op = BC::AShr; break;
+    case Instruction::And:  Op = BC::And;  break;
+    case Instruction::Or:   Op = BC::Or;   break;
+    case Instruction::Xor:  Op = BC::Xor;  break;
+    default:
+      llvm_unreachable("Floating point operator on integer type!");
+    }
+  }
+
+  BytecodeInst &BI = emit(Op);
+  unsigned Bits = getSlotBits(Ty);
+  BI.Shift = 64 - Bits;
+  BI.Imm = maskTrailingOnes<uint64_t>(Bits);
+  return getSlot(I.getOperand(0), BI.A) && getSlot(I.getOperand(1), BI.B) &&
+         getSlot(&I, BI.Dst);
+}
+
+bool BytecodeDecoder::decodeCmp(CmpInst &I) {
+  using BC = BytecodeInst;
+  Type *Ty = I.getOperand(0)->getType();
+  BC::Opcode Op;
+  switch (I.getPredicate()) {
+  case ICmpInst::ICMP_EQ:  Op = BC::ICmpEQ;  break;
+  case ICmpInst::ICMP_NE:  Op = BC::ICmpNE;  break;
+  case ICmpInst::ICMP_UGT: Op = BC::ICmpUGT; break;
+  case ICmpInst::ICMP_UGE: Op = BC::ICmpUGE; break;
+  case ICmpInst::ICMP_ULT: Op = BC::ICmpULT; break;
+  case ICmpInst::ICMP_ULE: Op = BC::ICmpULE; break;
+  case ICmpInst::ICMP_SGT: Op = BC::ICmpSGT; break;
+  case ICmpInst::ICMP_SGE: Op = BC::ICmpSGE; break;
+  case ICmpInst::ICMP_SLT: Op = BC::ICmpSLT; break;
+  case ICmpInst::ICMP_SLE: Op = BC::ICmpSLE; break;
+  default:
+    Op = Ty->isFloatTy() ? BC::FCmpF32 : BC::FCmpF64;
+    break;
+  }
+
+  BytecodeInst &BI = emit(Op);
+  BI.Shift = 64 - getSlotBits(Ty);
+  BI.Pred = I.getPredicate();
+  return getSlot(I.getOperand(0), BI.A) && getSlot(I.getOperand(1), BI.B) &&
+         getSlot(&I, BI.Dst);
+}
+
+bool BytecodeDecoder::decodeCast(CastInst &I) {
+  using BC = BytecodeInst;
+  Type *SrcTy = I.getSrcTy();
+  Type *DstTy = I.getDestTy();
+  BC::Opcode Op;
+  switch (I.getOpcode()) {
+  case Instruction::ZExt:
+  case Instruction::BitCast:
+    Op = BC::Move;
+    break;
+  case Instruction::Trunc:
+  case Instruction::PtrToInt:
+  case Instruction::IntToPtr:
+    Op = BC::Trunc;
+    break;
+  case Instruction::SExt:
+    Op = BC::SExt;
+    break;
+  case Instruction::FPTrunc:
+    Op = BC::FPTrunc;
+    break;
+  case Instruction::FPExt:
+    Op = BC::FPExt;
+    break;
+  case Instruction::FPToUI:
+  case Instruction::FPToSI:
+    Op = SrcTy->isFloatTy() ? BC::FPToIntF32 : BC::FPToIntF64;
+    break;
+  case Instruction::UIToFP:
+    Op = DstTy->isFloatTy() ? BC::UIToFPF32 : BC::UIToFPF64;
+    break;
+  case Instruction::SIToFP:
+    Op = DstTy->isFloatTy() ? BC::SIToFPF32 : BC::SIToFPF64;
+    break;
+  default:
+    return false;
+  }
+
+  BytecodeInst &BI = emit(Op);
+  BI.Shift = 64 - getSlotBits(SrcTy);
+  BI.Imm = maskTrailingOnes<uint64_t>(getSlotBits(DstTy));
+  return getSlot(I.getOperand(0), BI.A) && getSlot(&I, BI.Dst);
+}
+
+bool BytecodeDecoder::decodeLoad(LoadInst &I) {
+  // Leave volatile loads to the instruction walker, which can print them.
+  if (!I.isSimple())
+    return false;
+
+  Type *Ty = I.getType();
+  unsigned Size = Ty->isPointerTy() ? sizeof(void *) : DL.getTypeStoreSize(Ty);
+  BytecodeInst::Opcode Op;
+  switch (Size) {
+  case 1: Op = BytecodeInst::Load8;  break;
+  case 2: Op = BytecodeInst::Load16; break;
+  case 4: Op = BytecodeInst::Load32; break;
+  case 8: Op = BytecodeInst::Load64; break;
+  default:
+    if (!sys::IsLittleEndianHost)
+      return false;
+    Op = BytecodeInst::LoadBytes;
+    break;
+  }
+
+  BytecodeInst &BI = emit(Op);
+  BI.Shift = Size;
+  BI.Imm = maskTrailingOnes<uint64_t>(getSlotBits(Ty));
+  return getSlot(I.getPointerOperand(), BI.A) && getSlot(&I, BI.Dst);
+}
+
+bool BytecodeDecoder::decodeStore(StoreInst &I) {
+  if (!I.isSimple())
+    return false;
+
+  Type *Ty = I.getValueOperand()->getType();
+  unsigned Size = Ty->isPointerTy() ? sizeof(void *) : DL.getTypeStoreSize(Ty);
+  BytecodeInst::Opcode Op;
+  switch (Size) {
+  case 1: Op = BytecodeInst::Store8;  break;
+  case 2: Op = BytecodeInst::Store16; break;
+  case 4: Op = BytecodeInst::Store32; break;
+  case 8: Op = BytecodeInst::Store64; break;
+  default:
+    if (!sys::IsLittleEndianHost)
+      return false;
+    Op = BytecodeInst::StoreBytes;
+    break;
+  }
+
+  BytecodeInst &BI = emit(Op);
+  BI.Shift = Size;
+  return getSlot(I.getValueOperand(), BI.A) &&
+         getSlot(I.getPointerOperand(), BI.B);
+}
+
+// decodeGEP - Fold the constant indices into one offset, and keep a scale for
+// each of the others.
+bool BytecodeDecoder::decodeGEP(GetElementPtrInst &I) {
+  int64_t Offset = 0;
+  uint32_t FirstIndex = BF->GEPIndices.size();
+  for (gep_type_iterator GTI = gep_type_begin(I), E = gep_type_end(I);
+       GTI != E; ++GTI) {
+    if (StructType *STy = GTI.getStructTypeOrNull()) {
+      unsigned Field = cast<ConstantInt>(GTI.getOperand())->getZExtValue();
+      Offset += DL.getStructLayout(STy)->getElementOffset(Field);
+      continue;
+    }
+
+    int64_t Scale = DL.getTypeAllocSize(GTI.getIndexedType());
+    if (auto *CI = dyn_cast<ConstantInt>(GTI.getOperand())) {
+      Offset += Scale * CI->getSExtValue();
+      continue;
+    }
+    BytecodeGEPIndex Index;
+    if (!getSlot(GTI.getOperand(), Index.Slot))
+      return false;
+    Index.Shift = 64 - getSlotBits(GTI.getOperand()->getType());
+    Index.Scale = Scale;
+    BF->GEPIndices.push_back(Index);
+  }
+
+  BytecodeInst &BI = emit(BytecodeInst::GEP);
+  BI.B = FirstIndex;
+  BI.C = BF->GEPIndices.size() - FirstIndex;
+  BI.Imm = Offset;
+  return getSlot(I.getPointerOperand(), BI.A) && getSlot(&I, BI.Dst);
+}
+
+bool BytecodeDecoder::decodeCall(CallInst &I) {
+  if (I.isInlineAsm())
+    return false;
+
+  BytecodeCall Call;
+  Call.CI = &I;
+  Call.Callee = I.getCalledFunction();
+  if (!Call.Callee && !getSlot(I.getCalledValue(), Call.CalleeSlot))
+    return false;
+  Call.FirstArg = BF->Args.size();
+  Call.NumArgs = I.arg_size();
+  for (Value *Arg : I.args()) {
+    uint32_t Slot;
+    if (!getSlot(Arg, Slot))
+      return false;
+    BF->Args.push_back(Slot);
+  }
+
+  BytecodeInst &BI = emit(BytecodeInst::Call);
+  BI.Imm = BF->Calls.size();
+  BF->Calls.push_back(Call);
+  return getSlot(&I, BI.Dst);
+}
+
+//===----------------------------------------------------------------------===//
+//                        Dispatch and Execution Code
+//===----------------------------------------------------------------------===//
+
+BytecodeEngine::BytecodeEngine(Interpreter &Interp) : Interp(Interp) {}
+
+BytecodeEngine::~BytecodeEngine() {}
+
+BytecodeFunction *BytecodeEngine::getFunction(Function *F) {
+  auto Result = Functions.try_emplace(F);
+  std::unique_ptr<BytecodeFunction> &BF = Result.first->second;
+  if (Result.second && !F->isDeclaration()) {
+    BF = BytecodeDecoder(Interp, *F).decode();
+    if (BF)
+      ++NumDecoded;
+    else
+      ++NumNotDecoded;
+  }
+  return BF.get();
+}
+
+namespace {
+
+// BytecodeFrame - One bytecode function invocation.  PC is only up to date
+// while the frame is calling another function.
+struct BytecodeFrame {
+  BytecodeFunction *BF;
+  size_t Base;
+  const BytecodeInst *PC = nullptr;
+  AllocaHolder Allocas;
+
+  BytecodeFrame(BytecodeFunction *BF, size_t Base) : BF(BF), Base(Base) {}
+};
+
+} // end anonymous namespace
+
+// Dispatch through a table of label addresses where the compiler supports it,
+// so that every handler ends in an indirect branch of its own.
+#if defined(__GNUC__)
+#define BYTECODE_THREADED_DISPATCH 1
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+GenericValue BytecodeEngine::run(BytecodeFunction &Entry,
+                                 ArrayRef<GenericValue> ArgVals) {
+  assert(ArgVals.size() == Entry.NumArgs &&
+         "Invalid number of values passed to function invocation!");
+
+  std::vector<BytecodeFrame> Frames;
+  size_t EntryBase = Slots.size();
+  Slots.resize(EntryBase + Entry.NumSlots);
+  Frames.emplace_back(&Entry, EntryBase);
+
+  BytecodeFunction *BF = &Entry;
+  uint64_t *Regs = Slots.data() + EntryBase;
+  unsigned ArgNo = 0;
+  for (Argument &A : Entry.F->args()) {
+    Regs[ArgNo] = toSlot(ArgVals[ArgNo], A.getType());
+    ++ArgNo;
+  }
+  std::copy(Entry.InitialSlots.begin(), Entry.InitialSlots.end(),
+            Regs + Entry.FirstConstant);
+
+  const BytecodeInst *PC = Entry.Code.data();
+  uint64_t RetVal;
+
+#ifdef BYTECODE_THREADED_DISPATCH
+  static const void *const Handlers[] = {
+#define HANDLE_BYTECODE_OP(Name) &&Op_##Name,
+#include "Bytecode.def"
+  };
+#define DISPATCH() goto *Handlers[PC->Op]
+#define OPCODE(Name) Op_##Name:
+#else
+#define DISPATCH() goto Dispatch
+#define OPCODE(Name) case BytecodeInst::Name:
+#endif
+#define NEXT()                                                                 \
+  do {                                                                         \
+    ++PC;                                                                      \
+    DISPATCH();                                                                \
+  } while (0)
+
+#define INT_BINOP(Name, Expr)                                                  \
+  OPCODE(Name) {                                                               \
+    uint64_t L = Regs[PC->A], R = Regs[PC->B];                                 \
+    Regs[PC->Dst] = uint64_t(Expr) & PC->Imm;                                  \
+    NEXT();                                                                    \
+  }
+#define FP_BINOP(Name, As, Expr)                                               \
+  OPCODE(Name) {                                                               \
+    auto L = As(Regs[PC->A]), R = As(Regs[PC->B]);                             \
+    Regs[PC->Dst] = toBits(Expr);                                              \
+    NEXT();                                                                    \
+  }
+#define CMP(Name, Expr)                                                        \
+  OPCODE(Name) {                                                               \
+    uint64_t L = Regs[PC->A], R = Regs[PC->B];                                 \
+    Regs[PC->Dst] = (Expr);                                                    \
+    NEXT();                                                                    \
+  }
+
+#ifdef BYTECODE_THREADED_DISPATCH
+  DISPATCH();
+#else
+Dispatch:
+  switch (PC->Op) {
+#endif
+
+  INT_BINOP(Add, L + R)
+  INT_BINOP(Sub, L - R)
+  INT_BINOP(Mul, L * R)
+  INT_BINOP(UDiv, L / R)
+  INT_BINOP(SDiv, sext(L, PC->Shift) / sext(R, PC->Shift))
+  INT_BINOP(URem, L % R)
+  INT_BINOP(SRem, sext(L, PC->Shift) % sext(R, PC->Shift))
+  INT_BINOP(Shl, L << shiftAmount(R, PC->Shift))
+  INT_BINOP(LShr, L >> shiftAmount(R, PC->Shift))
+  INT_BINOP(AShr, sext(L, PC->Shift) >> shiftAmount(R, PC->Shift))
+  INT_BINOP(And, L & R)
+  INT_BINOP(Or, L | R)
+  INT_BINOP(Xor, L ^ R)
+
+  FP_BINOP(FAddF32, asFloat, L + R)
+  FP_BINOP(FSubF32, asFloat, L - R)
+  FP_BINOP(FMulF32, asFloat, L * R)
+  FP_BINOP(FDivF32, asFloat, L / R)
+  FP_BINOP(FRemF32, asFloat, std::fmod(L, R))
+  FP_BINOP(FAddF64, asDouble, L + R)
+  FP_BINOP(FSubF64, asDouble, L - R)
+  FP_BINOP(FMulF64, asDouble, L * R)
+  FP_BINOP(FDivF64, asDouble, L / R)
+  FP_BINOP(FRemF64, asDouble, std::fmod(L, R))
+
+  CMP(ICmpEQ, L == R)
+  CMP(ICmpNE, L != R)
+  CMP(ICmpUGT, L > R)
+  CMP(ICmpUGE, L >= R)
+  CMP(ICmpULT, L < R)
+  CMP(ICmpULE, L <= R)
+  CMP(ICmpSGT, sext(L, PC->Shift) > sext(R, PC->Shift))
+  CMP(ICmpSGE, sext(L, PC->Shift) >= sext(R, PC->Shift))
+  CMP(ICmpSLT, sext(L, PC->Shift) < sext(R, PC->Shift))
+  CMP(ICmpSLE, sext(L, PC->Shift) <= sext(R, PC->Shift))
+  CMP(FCmpF32, compareFP(PC->Pred, asFloat(L), asFloat(R)))
+  CMP(FCmpF64, compareFP(PC->Pred, asDouble(L), asDouble(R)))
+
+  OPCODE(Select) {
+    Regs[PC->Dst] = Regs[PC->A] ? Regs[PC->B] : Regs[PC->C];
+    NEXT();
+  }
+  OPCODE(Move) {
+    Regs[PC->Dst] = Regs[PC->A];
+    NEXT();
+  }
+
+  OPCODE(Trunc) {
+    Regs[PC->Dst] = Regs[PC->A] & PC->Imm;
+    NEXT();
+  }
+  OPCODE(SExt) {
+    Regs[PC->Dst] = uint64_t(sext(Regs[PC->A], PC->Shift)) & PC->Imm;
+    NEXT();
+  }
+  OPCODE(FPTrunc) {
+    Regs[PC->Dst] = FloatToBits(float(asDouble(Regs[PC->A])));
+    NEXT();
+  }
+  OPCODE(FPExt) {
+    Regs[PC->Dst] = DoubleToBits(double(asFloat(Regs[PC->A])));
+    NEXT();
+  }
+  OPCODE(FPToIntF32) {
+    Regs[PC->Dst] = fpToInt(asFloat(Regs[PC->A])) & PC->Imm;
+    NEXT();
+  }
+  OPCODE(FPToIntF64) {
+    Regs[PC->Dst] = fpToInt(asDouble(Regs[PC->A])) & PC->Imm;
+    NEXT();
+  }
+  OPCODE(UIToFPF32) {
+    Regs[PC->Dst] = FloatToBits(float(Regs[PC->A]));
+    NEXT();
+  }
+  OPCODE(UIToFPF64) {
+    Regs[PC->Dst] = DoubleToBits(double(Regs[PC->A]));
+    NEXT();
+  }
+  OPCODE(SIToFPF32) {
+    Regs[PC->Dst] = FloatToBits(float(sext(Regs[PC->A], PC->Shift)));
+    NEXT();
+  }
+  OPCODE(SIToFPF64) {
+    Regs[PC->Dst] = DoubleToBits(double(sext(Regs[PC->A], PC->Shift)));
+    NEXT();
+  }
+
+  OPCODE(Alloca) {
+    // Avoid malloc-ing zero bytes, as visitAllocaInst does.
+    void *Memory = safe_malloc(std::max<uint64_t>(1, Regs[PC->A] * PC->Imm));
+    Frames.back().Allocas.add(Memory);
+    Regs[PC->Dst] = (uintptr_t)Memory;
+    NEXT();
+  }
+#define LOAD(Name, T)                                                          \
+  OPCODE(Name) {                                                               \
+    T Val;                                                                     \
+    memcpy(&Val, (void *)(uintptr_t)Regs[PC->A], sizeof(T));                   \
+    Regs[PC->Dst] = Val & PC->Imm;                                             \
+    NEXT();                                                                    \
+  }
+#define STORE(Name, T)                                                         \
+  OPCODE(Name) {                                                               \
+    T Val = T(Regs[PC->A]);                                                    \
+    memcpy((void *)(uintptr_t)Regs[PC->B], &Val, sizeof(T));                   \
+    NEXT();                                                                    \
+  }
+  LOAD(Load8, uint8_t)
+  LOAD(Load16, uint16_t)
+  LOAD(Load32, uint32_t)
+  LOAD(Load64, uint64_t)
+  OPCODE(LoadBytes) {
+    uint64_t Val = 0;
+    memcpy(&Val, (void *)(uintptr_t)Regs[PC->A], PC->Shift);
+    Regs[PC->Dst] = Val & PC->Imm;
+    NEXT();
+  }
+  STORE(Store8, uint8_t)
+  STORE(Store16, uint16_t)
+  STORE(Store32, uint32_t)
+  STORE(Store64, uint64_t)
+  OPCODE(StoreBytes) {
+    uint64_t Val = Regs[PC->A];
+    memcpy((void *)(uintptr_t)Regs[PC->B], &Val, PC->Shift);
+    NEXT();
+  }
+#undef LOAD
+#undef STORE
+  OPCODE(GEP) {
+    uint64_t Addr = Regs[PC->A] + PC->Imm;
+    for (const BytecodeGEPIndex *I = &BF->GEPIndices[PC->B],
+                                *E = I + PC->C;
+         I != E; ++I)
+      Addr += sext(Regs[I->Slot], I->Shift) * I->Scale;
+    Regs[PC->Dst] = uintptr_t(Addr);
+    NEXT();
+  }
+  OPCODE(MemCpy) {
+    memcpy((void *)(uintptr_t)Regs[PC->A], (void *)(uintptr_t)Regs[PC->B],
+           Regs[PC->C]);
+    NEXT();
+  }
+  OPCODE(MemMove) {
+    memmove((void *)(uintptr_t)Regs[PC->A], (void *)(uintptr_t)Regs[PC->B],
+            Regs[PC->C]);
+    NEXT();
+  }
+  OPCODE(MemSet) {
+    memset((void *)(uintptr_t)Regs[PC->A], int(Regs[PC->B]), Regs[PC->C]);
+    NEXT();
+  }
+
+  OPCODE(Jump) {
+    PC = BF->Code.data() + PC->Imm;
+    DISPATCH();
+  }
+  OPCODE(Br) {
+    PC = BF->Code.data() + (Regs[PC->A] ? PC->B : PC->C);
+    DISPATCH();
+  }
+  OPCODE(Switch) {
+    uint64_t Cond = Regs[PC->A];
+    uint64_t Target = PC->Imm;
+    for (const BytecodeSwitchCase *I = &BF->Cases[PC->B], *E = I + PC->C;
+         I != E; ++I)
+      if (I->Value == Cond) {
+        Target = I->Target;
+        break;
+      }
+    PC = BF->Code.data() + Target;
+    DISPATCH();
+  }
+  OPCODE(Call) {
+    BytecodeCall &Call = BF->Calls[PC->Imm];
+    BytecodeFunction *Target;
+    Function *Callee = Call.Callee;
+    if (Callee) {
+      if (!Call.Resolved) {
+        Call.Target = getFunction(Callee);
+        Call.Resolved = true;
+      }
+      Target = Call.Target;
+    } else {
+      // To handle indirect calls, we must get the pointer value from the
+      // argument and treat it as a function pointer.
+      Callee = (Function *)(uintptr_t)Regs[Call.CalleeSlot];
+      Target = getFunction(Callee);
+    }
+
+    if (!Target) {
+      // Box the arguments for the external function or instruction walker.
+      std::vector<GenericValue> Args;
+      Args.reserve(Call.NumArgs);
+      for (unsigned I = 0; I != Call.NumArgs; ++I)
+        Args.push_back(fromSlot(Regs[BF->Args[Call.FirstArg + I]],
+                                Call.CI->getArgOperand(I)->getType()));
+      GenericValue Result = Callee->isDeclaration()
+                                ? Interp.callExternalFunction(Callee, Args)
+                                : Interp.interpretFunction(Callee, Args);
+      Type *RetTy = Call.CI->getType();
+      if (!RetTy->isVoidTy())
+        Regs[PC->Dst] = toSlot(Result, RetTy);
+      NEXT();
+    }
+
+    assert(Call.NumArgs == Target->NumArgs &&
+           "Incorrect number of arguments passed into function call!");
+    Frames.back().PC = PC;
+    size_t Base = Slots.size();
+    Slots.resize(Base + Target->NumSlots);
+    uint64_t *CallerRegs = Slots.data() + Frames.back().Base;
+    Regs = Slots.data() + Base;
+    for (unsigned I = 0; I != Call.NumArgs; ++I)
+      Regs[I] = CallerRegs[BF->Args[Call.FirstArg + I]];
+    std::copy(Target->InitialSlots.begin(), Target->InitialSlots.end(),
+              Regs + Target->FirstConstant);
+    Frames.emplace_back(Target, Base);
+    BF = Target;
+    PC = Target->Code.data();
+    DISPATCH();
+  }
+  OPCODE(Ret) {
+    RetVal = Regs[PC->A];
+    goto Return;
+  }
+  OPCODE(RetVoid) {
+    RetVal = 0;
+    goto Return;
+  }
+  OPCODE(Unreachable) {
+    report_fatal_error("Program executed an 'unreachable' instruction!");
+  }
+
+#ifndef BYTECODE_THREADED_DISPATCH
+  }
+  llvm_unreachable("Invalid bytecode opcode!");
+#endif
+
+Return:
+  // Pop the frame, and continue after the call in the caller, if any.
+  Slots.resize(Frames.back().Base);
+  Frames.pop_back();
+  if (!Frames.empty()) {
+    BF = Frames.back().BF;
+    PC = Frames.back().PC;
+    Regs = Slots.data() + Frames.back().Base;
+    Regs[PC->Dst] = RetVal;
+    NEXT();
+  }
+
+#undef INT_BINOP
+#undef FP_BINOP
+#undef CMP
+#undef NEXT
+#undef OPCODE
+#undef DISPATCH
+
+  return fromSlot(RetVal, Entry.F->getReturnType());
+}
+
+#ifdef BYTECODE_THREADED_DISPATCH
+#pragma GCC diagnostic pop
+#endif
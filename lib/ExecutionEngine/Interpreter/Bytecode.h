@@ -0,0 +1,129 @@
+//===-- Bytecode.h - Pre-decoded register bytecode --------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This header defines the register bytecode that the interpreter lowers
+// functions to before running them.  Every value of a decoded function lives
+// in a 64-bit slot of its frame, so operands are slot numbers instead of
+// llvm::Value pointers and no GenericValue is built on the way through.
+// Functions using anything the bytecode can't express (vectors, aggregates,
+// wide integers, varargs, exceptions, most intrinsics) are left to the
+// instruction walker in Execution.cpp.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LIB_EXECUTIONENGINE_INTERPRETER_BYTECODE_H
+#define LLVM_LIB_EXECUTIONENGINE_INTERPRETER_BYTECODE_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ExecutionEngine/GenericValue.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace llvm {
+
+class CallInst;
+class Function;
+class Interpreter;
+struct BytecodeFunction;
+
+// BytecodeInst - One pre-decoded instruction.  A, B and C name source slots and
+// Dst the result slot; what Shift, Pred and Imm mean depends on the opcode (see
+// Bytecode.def).
+//
+struct BytecodeInst {
+  enum Opcode : uint16_t {
+#define HANDLE_BYTECODE_OP(Name) Name,
+#include "Bytecode.def"
+  };
+
+  uint16_t Op;
+  uint8_t Shift = 0;
+  uint8_t Pred = 0;
+  uint32_t Dst = 0, A = 0, B = 0, C = 0;
+  uint64_t Imm = 0;
+
+  BytecodeInst(Opcode Op) : Op(Op) {}
+};
+
+// BytecodeGEPIndex - A non-constant getelementptr index, which adds the sign
+// extended value of Slot times Scale to the address.
+//
+struct BytecodeGEPIndex {
+  uint32_t Slot;
+  uint8_t Shift;
+  int64_t Scale;
+};
+
+struct BytecodeSwitchCase {
+  uint64_t Value;
+  uint32_t Target;
+};
+
+// BytecodeCall - A call site.  Calls to functions that have no bytecode box
+// their arguments into GenericValues, using the types of CI's operands.
+//
+struct BytecodeCall {
+  CallInst *CI;
+  Function *Callee;           // Null for indirect calls through CalleeSlot.
+  uint32_t CalleeSlot = 0;
+  uint32_t FirstArg, NumArgs; // Argument slots in BytecodeFunction::Args.
+
+  // The callee's bytecode, looked up on the first direct call.
+  BytecodeFunction *Target = nullptr;
+  bool Resolved = false;
+};
+
+// BytecodeFunction - A function lowered to bytecode.  Its frame holds the
+// arguments in slots [0, NumArgs), then one slot per instruction result and
+// PHI temporary, then from FirstConstant on the constants, whose values are
+// copied in from InitialSlots on entry.
+//
+struct BytecodeFunction {
+  Function *F;
+  std::vector<BytecodeInst> Code;
+  unsigned NumArgs = 0;
+  unsigned FirstConstant = 0;
+  unsigned NumSlots = 0;
+  std::vector<uint64_t> InitialSlots;
+
+  std::vector<BytecodeGEPIndex> GEPIndices;
+  std::vector<BytecodeSwitchCase> Cases;
+  std::vector<BytecodeCall> Calls;
+  std::vector<uint32_t> Args;
+};
+
+// BytecodeEngine - Decodes functions on first use and runs them with a
+// threaded dispatch loop.
+//
+class BytecodeEngine {
+public:
+  explicit BytecodeEngine(Interpreter &Interp);
+  ~BytecodeEngine();
+
+  /// getFunction - Return the bytecode for F, or null if F can't be decoded
+  /// and must be run by the instruction walker.
+  ///
+  BytecodeFunction *getFunction(Function *F);
+
+  /// run - Run BF with the given arguments and return its result.
+  ///
+  GenericValue run(BytecodeFunction &BF, ArrayRef<GenericValue> ArgVals);
+
+private:
+  Interpreter &Interp;
+  DenseMap<Function *, std::unique_ptr<BytecodeFunction>> Functions;
+
+  // Slots of every bytecode frame live, stacked, in this one vector.
+  std::vector<uint64_t> Slots;
+};
+
+} // End llvm namespace
+
+#endif
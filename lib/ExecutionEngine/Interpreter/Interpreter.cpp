@@ -16,9 +16,14 @@
 #include "llvm/CodeGen/IntrinsicLowering.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
 #include <cstring>
 using namespace llvm;
 
+static cl::opt<bool> UseBytecode(
+    "interpreter-bytecode", cl::init(true), cl::Hidden,
+    cl::desc("Lower functions to register bytecode before interpreting them"));
+
 namespace {
 
 static struct RegisterInterp {
@@ -52,7 +57,7 @@ ExecutionEngine *Interpreter::create(std::unique_ptr<Module> M,
 // Interpreter ctor - Initialize stuff
 //
 Interpreter::Interpreter(std::unique_ptr<Module> M)
-    : ExecutionEngine(std::move(M)) {
+    : ExecutionEngine(std::move(M)), Bytecode(*this) {
 
   memset(&ExitValue.Untyped, 0, sizeof(ExitValue.Untyped));
   // Initialize the "backend"
@@ -92,6 +97,12 @@ GenericValue Interpreter::runFunction(Function *F,
   ArrayRef<GenericValue> ActualArgs =
       ArgValues.slice(0, std::min(ArgValues.size(), ArgCount));
 
+  // Functions that can be lowered to bytecode run as bytecode.  The bytecode
+  // keeps its own stack, so only use it when nothing is being interpreted.
+  if (UseBytecode && ECStack.empty())
+    if (BytecodeFunction *BF = Bytecode.getFunction(F))
+      return Bytecode.run(*BF, ActualArgs);
+
   // Set up the function call.
   callFunction(F, ActualArgs);
 
@@ -100,3 +111,11 @@ GenericValue Interpreter::runFunction(Function *F,
 
   return ExitValue;
 }
+
+GenericValue Interpreter::interpretFunction(Function *F,
+                                            ArrayRef<GenericValue> ArgVals) {
+  assert(ECStack.empty() && "Can't start interpreting from a nested frame!");
+  callFunction(F, ArgVals);
+  run();
+  return ExitValue;
+}
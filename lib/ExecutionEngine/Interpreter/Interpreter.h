@@ -13,6 +13,7 @@
 #ifndef LLVM_LIB_EXECUTIONENGINE_INTERPRETER_INTERPRETER_H
 #define LLVM_LIB_EXECUTIONENGINE_INTERPRETER_INTERPRETER_H
 
+#include "Bytecode.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/GenericValue.h"
 #include "llvm/IR/CallSite.h"
@@ -84,6 +85,11 @@ class Interpreter : public ExecutionEngine, public InstVisitor<Interpreter> {
   // registered with the atexit() library function.
   std::vector<Function*> AtExitHandlers;
 
+  // Bytecode - Runs the functions that can be lowered to register bytecode.
+  BytecodeEngine Bytecode;
+
+  friend class BytecodeDecoder;
+
 public:
   explicit Interpreter(std::unique_ptr<Module> M);
   ~Interpreter() override;
@@ -113,6 +119,11 @@ public:
     return nullptr;
   }
 
+  /// interpretFunction - Run F by walking its instructions, without using
+  /// bytecode.  The execution stack must be empty.
+  ///
+  GenericValue interpretFunction(Function *F, ArrayRef<GenericValue> ArgVals);
+
   // Methods used to execute code:
   // Place a call on the stack
   void callFunction(Function *F, ArrayRef<GenericValue> ArgVals);
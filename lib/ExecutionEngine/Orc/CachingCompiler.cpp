@@ -0,0 +1,143 @@
+//===------ CachingCompiler.cpp - Compile IR through an on-disk cache -----===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/Orc/CachingCompiler.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/ExecutionEngine/Orc/Core.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/ModuleSummaryIndex.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include <mutex>
+
+#define DEBUG_TYPE "orc"
+
+namespace llvm {
+namespace orc {
+
+struct CachingIRCompiler::CacheState {
+  CacheState(ExecutionSession &ES, IRCompileLayer::CompileFunction Compile,
+             std::string CacheDir, std::string TargetKey,
+             CachePruningPolicy Policy)
+      : ES(ES), Compile(std::move(Compile)), CacheDir(std::move(CacheDir)),
+        TargetKey(std::move(TargetKey)), Policy(std::move(Policy)) {}
+
+  ExecutionSession &ES;
+  IRCompileLayer::CompileFunction Compile;
+  std::string CacheDir;
+  std::string TargetKey;
+  CachePruningPolicy Policy;
+
+  // pruneCache is not safe to run concurrently on the same directory.
+  std::mutex PruneMutex;
+};
+
+CachingIRCompiler::CachingIRCompiler(ExecutionSession &ES,
+                                     IRCompileLayer::CompileFunction Compile,
+                                     std::string CacheDir,
+                                     std::string TargetKey,
+                                     CachePruningPolicy Policy)
+    : State(std::make_shared<CacheState>(ES, std::move(Compile),
+                                         std::move(CacheDir),
+                                         std::move(TargetKey),
+                                         std::move(Policy))) {}
+
+std::string CachingIRCompiler::getTargetKey(const TargetMachine &TM) {
+  std::string Key;
+  raw_string_ostream OS(Key);
+  OS << TM.getTargetTriple().str() << ':' << TM.getTargetCPU() << ':'
+     << TM.getTargetFeatureString() << ":O" << unsigned(TM.getOptLevel())
+     << ":R" << unsigned(TM.getRelocationModel()) << ":C"
+     << unsigned(TM.getCodeModel());
+  return OS.str();
+}
+
+std::string CachingIRCompiler::getCacheKey(Module &M) const {
+  // Let the bitcode writer hash the module, as ThinLTO does for its cache
+  // keys. The bitcode itself is thrown away.
+  ModuleHash Hash;
+  raw_null_ostream NullOS;
+  WriteBitcodeToFile(M, NullOS, /*ShouldPreserveUseListOrder=*/false,
+                     /*Index=*/nullptr, /*GenerateHash=*/true, &Hash);
+
+  SHA1 Hasher;
+  Hasher.update(ArrayRef<uint8_t>(reinterpret_cast<const uint8_t *>(&Hash[0]),
+                                  sizeof(Hash)));
+  Hasher.update(State->TargetKey);
+  return toHex(Hasher.result());
+}
+
+void CachingIRCompiler::addToCache(StringRef EntryPath, MemoryBufferRef Obj) {
+  // Write to a temporary file and rename it into place, so that other
+  // processes sharing the cache never see a partially written object. The
+  // temporary name does not start with "llvmcache-", which keeps pruneCache
+  // away from it.
+  SmallString<128> TempModel(State->CacheDir);
+  sys::path::append(TempModel, "tmp-%%%%%%.o");
+  auto Temp = sys::fs::TempFile::create(TempModel);
+  if (!Temp) {
+    consumeError(Temp.takeError());
+    return;
+  }
+
+  {
+    raw_fd_ostream OS(Temp->FD, /*shouldClose=*/false);
+    OS << Obj.getBuffer();
+    OS.flush();
+    if (OS.has_error()) {
+      OS.clear_error();
+      consumeError(Temp->discard());
+      return;
+    }
+  }
+
+  if (auto Err = Temp->keep(EntryPath)) {
+    consumeError(std::move(Err));
+    return;
+  }
+
+  std::lock_guard<std::mutex> Lock(State->PruneMutex);
+  pruneCache(State->CacheDir, State->Policy);
+}
+
+Expected<std::unique_ptr<MemoryBuffer>>
+CachingIRCompiler::operator()(Module &M) {
+  SmallString<128> EntryPath(State->CacheDir);
+  sys::path::append(EntryPath, "llvmcache-" + getCacheKey(M));
+
+  if (auto Cached = MemoryBuffer::getFile(EntryPath, /*FileSize=*/-1,
+                                          /*RequiresNullTerminator=*/false)) {
+    // Treat entries that do not parse as objects, e.g. ones truncated by a
+    // full disk, as misses. The recompiled object replaces them.
+    auto Obj = object::ObjectFile::createObjectFile((*Cached)->getMemBufferRef());
+    if (Obj) {
+      LLVM_DEBUG(dbgs() << "Object cache hit for " << M.getModuleIdentifier()
+                        << ": " << EntryPath << "\n");
+      State->ES.recordObjectCacheLookup(/*Hit=*/true);
+      return std::move(*Cached);
+    }
+    consumeError(Obj.takeError());
+  }
+
+  LLVM_DEBUG(dbgs() << "Object cache miss for " << M.getModuleIdentifier()
+                    << ": " << EntryPath << "\n");
+  State->ES.recordObjectCacheLookup(/*Hit=*/false);
+
+  auto Obj = State->Compile(M);
+  if (Obj && *Obj)
+    addToCache(EntryPath, (*Obj)->getMemBufferRef());
+  return Obj;
+}
+
+} // end namespace orc
+} // end namespace llvm
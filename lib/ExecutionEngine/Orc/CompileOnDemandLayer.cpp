@@ -7,12 +7,26 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/ExecutionEngine/Orc/CompileOnDemandLayer.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Mangler.h"
 #include "llvm/IR/Module.h"
 
 using namespace llvm;
 using namespace llvm::orc;
 
+#define DEBUG_TYPE "orc"
+
+STATISTIC(NumCountedFunctions, "Number of functions emitted with call counters");
+STATISTIC(NumSpeculated, "Number of functions compiled speculatively");
+STATISTIC(NumSpeculationHits,
+          "Number of speculatively compiled functions that were called");
+STATISTIC(NumSpeculationsWasted,
+          "Number of speculatively compiled functions that were never called");
+STATISTIC(NumTieredUp, "Number of hot functions recompiled by the optimizing "
+                       "layer");
+
 static ThreadSafeModule extractSubModule(ThreadSafeModule &TSM,
                                          StringRef Suffix,
                                          GVPredicate ShouldExtract) {
@@ -72,7 +86,7 @@ public:
         Parent(Parent) {}
 
   PartitioningIRMaterializationUnit(
-      ThreadSafeModule TSM, SymbolFlagsMap SymbolFlags,
+      ThreadSafeModule TSM, VModuleKey K, SymbolFlagsMap SymbolFlags,
       SymbolNameToDefinitionMap SymbolToDefinition,
       CompileOnDemandLayer &Parent)
       : IRMaterializationUnit(std::move(TSM), std::move(K),
@@ -88,9 +102,9 @@ private:
 
   void discard(const JITDylib &V, const SymbolStringPtr &Name) override {
     // All original symbols were materialized by the CODLayer and should be
-    // final. The function bodies provided by M should never be overridden.
-    llvm_unreachable("Discard should never be called on an "
-                     "ExtractingIRMaterializationUnit");
+    // final. The function bodies provided by M are never overridden, so this
+    // is only called when the module is removed, and the unit goes with it.
+    SymbolToDefinition.erase(Name);
   }
 
   mutable std::mutex SourceModuleMutex;
@@ -111,12 +125,40 @@ CompileOnDemandLayer::CompileOnDemandLayer(
     ExecutionSession &ES, IRLayer &BaseLayer, LazyCallThroughManager &LCTMgr,
     IndirectStubsManagerBuilder BuildIndirectStubsManager)
     : IRLayer(ES), BaseLayer(BaseLayer), LCTMgr(LCTMgr),
-      BuildIndirectStubsManager(std::move(BuildIndirectStubsManager)) {}
+      BuildIndirectStubsManager(std::move(BuildIndirectStubsManager)) {
+  ES.registerResourceManager(*this);
+}
 
 void CompileOnDemandLayer::setPartitionFunction(PartitionFunction Partition) {
   this->Partition = std::move(Partition);
 }
 
+CompileOnDemandLayer::~CompileOnDemandLayer() {
+  getExecutionSession().deregisterResourceManager(*this);
+  NumSpeculationsWasted += Speculation.getWasted();
+}
+
+void CompileOnDemandLayer::setSpeculation(unsigned MaxCallees) {
+  std::lock_guard<std::mutex> Lock(CODLayerMutex);
+  MaxSpeculatedCallees = MaxCallees;
+}
+
+CompileOnDemandLayer::SpeculationStats
+CompileOnDemandLayer::getSpeculationStats() const {
+  std::lock_guard<std::mutex> Lock(CODLayerMutex);
+  return Speculation;
+}
+
+void CompileOnDemandLayer::setTierUpLayer(IRLayer &OptimizingLayer,
+                                          uint64_t Threshold) {
+  assert(Threshold > 0 && "Functions must be called to become hot");
+  std::lock_guard<std::mutex> Lock(CODLayerMutex);
+  this->OptimizingLayer = &OptimizingLayer;
+  TierUpThreshold = Threshold;
+  if (!TierUpThreads)
+    TierUpThreads = llvm::make_unique<ThreadPool>(1);
+}
+
 void CompileOnDemandLayer::emit(MaterializationResponsibility R,
                                 ThreadSafeModule TSM) {
   assert(TSM.getModule() && "Null module");
@@ -156,9 +198,34 @@ void CompileOnDemandLayer::emit(MaterializationResponsibility R,
     return;
   }
 
-  R.replace(reexports(PDR.getImplDylib(), std::move(NonCallables), true));
+  // Speculation needs to know which functions have stubs, and when they are
+  // first called.
+  LazyReexportsMaterializationUnit::NotifyFirstCallFunction NotifyFirstCall;
+  if (MaxSpeculatedCallees) {
+    std::lock_guard<std::mutex> Lock(CODLayerMutex);
+    for (auto &KV : Callables)
+      PDR.getLazyCallables().insert(KV.first);
+    NotifyFirstCall = [this](JITDylib &ImplD, const SymbolStringPtr &Name) {
+      notifyFirstCall(ImplD, Name);
+    };
+  }
+
+  // Remember which stubs belong to the module, so that they can be released
+  // when it is removed.
+  if (R.getVModuleKey() != VModuleKey()) {
+    SymbolNameSet CallableNames;
+    for (auto &KV : Callables)
+      CallableNames.insert(KV.first);
+    std::lock_guard<std::mutex> Lock(CODLayerMutex);
+    ModuleCallables[R.getVModuleKey()].push_back(
+        std::make_pair(&R.getTargetJITDylib(), std::move(CallableNames)));
+  }
+
+  R.replace(reexports(PDR.getImplDylib(), std::move(NonCallables), true,
+                      R.getVModuleKey()));
   R.replace(lazyReexports(LCTMgr, PDR.getISManager(), PDR.getImplDylib(),
-                          std::move(Callables)));
+                          std::move(Callables), R.getVModuleKey(),
+                          std::move(NotifyFirstCall)));
 }
 
 CompileOnDemandLayer::PerDylibResources &
@@ -184,6 +251,15 @@ CompileOnDemandLayer::getPerDylibResources(JITDylib &TargetD) {
   return I->second;
 }
 
+CompileOnDemandLayer::PerDylibResources *
+CompileOnDemandLayer::findPerDylibResourcesForImpl(JITDylib &ImplD) {
+  // Callers must hold CODLayerMutex.
+  for (auto &KV : DylibResources)
+    if (&KV.second.getImplDylib() == &ImplD)
+      return &KV.second;
+  return nullptr;
+}
+
 void CompileOnDemandLayer::cleanUpModule(Module &M) {
   for (auto &F : M.functions()) {
     if (F.isDeclaration())
@@ -260,7 +336,8 @@ void CompileOnDemandLayer::emitPartition(
   // If the partition is empty, return the whole module to the symbol table.
   if (GVsToExtract->empty()) {
     R.replace(llvm::make_unique<PartitioningIRMaterializationUnit>(
-        std::move(TSM), R.getSymbols(), std::move(Defs), *this));
+        std::move(TSM), R.getVModuleKey(), R.getSymbols(), std::move(Defs),
+        *this));
     return;
   }
 
@@ -285,6 +362,23 @@ void CompileOnDemandLayer::emitPartition(
 
   expandPartition(*GVsToExtract);
 
+  // Pick the callees to compile ahead of time, unless this partition is
+  // itself being compiled speculatively.
+  SymbolNameSet Speculations;
+  if (MaxSpeculatedCallees) {
+    PerDylibResources *PDR = nullptr;
+    bool IsSpeculative = true;
+    {
+      std::lock_guard<std::mutex> Lock(CODLayerMutex);
+      PDR = findPerDylibResourcesForImpl(R.getTargetJITDylib());
+      for (auto &Name : R.getRequestedSymbols())
+        if (!PDR || !PDR->getPendingSpeculations().count(Name))
+          IsSpeculative = false;
+    }
+    if (PDR && !IsSpeculative)
+      Speculations = findLikelyCallees(*TSM.getModule(), *GVsToExtract, *PDR);
+  }
+
   // Extract the requested partiton (plus any necessary aliases) and
   // put the rest back into the impl dylib.
   auto ShouldExtract = [&](const GlobalValue &GV) -> bool {
@@ -295,8 +389,335 @@ void CompileOnDemandLayer::emitPartition(
   R.replace(llvm::make_unique<PartitioningIRMaterializationUnit>(
       ES, std::move(TSM), R.getVModuleKey(), *this));
 
+  // The callees are now defined by the unit holding the rest of the module.
+  // Look them up before compiling this partition, so that a concurrent
+  // dispatcher can compile them alongside it.
+  if (!Speculations.empty())
+    ES.lookupSpeculatively(
+        JITDylibSearchList({{&R.getTargetJITDylib(), true}}),
+        std::move(Speculations),
+        [&ES](Expected<SymbolMap> Result) {
+          if (!Result)
+            ES.reportError(Result.takeError());
+        },
+        [&ES](Error Err) {
+          if (Err)
+            ES.reportError(std::move(Err));
+        });
+
+  if (OptimizingLayer)
+    addTierUpCounters(R.getTargetJITDylib(), R.getVModuleKey(), ExtractedTSM);
+
   BaseLayer.emit(std::move(R), std::move(ExtractedTSM));
 }
 
+SymbolNameSet
+CompileOnDemandLayer::findLikelyCallees(const Module &M,
+                                        const GlobalValueSet &Partition,
+                                        PerDylibResources &PDR) {
+  // Count the direct call sites of functions that still have a body in the
+  // source module, i.e. have not been compiled.
+  DenseMap<const Function *, unsigned> CallSites;
+  for (auto *GV : Partition) {
+    auto *F = dyn_cast<Function>(GV);
+    if (!F || F->isDeclaration())
+      continue;
+    for (auto &I : instructions(F))
+      if (auto *Call = dyn_cast<CallBase>(&I))
+        if (auto *Callee = Call->getCalledFunction())
+          if (!Callee->isDeclaration() && !Partition.count(Callee))
+            ++CallSites[Callee];
+  }
+
+  struct Candidate {
+    const Function *F;
+    bool HasProfile;
+    uint64_t EntryCount;
+    unsigned NumCallSites;
+  };
+  std::vector<Candidate> Candidates;
+  for (auto &KV : CallSites) {
+    auto Count = KV.first->getEntryCount();
+    if (Count.hasValue() && Count.getCount() == 0)
+      continue;
+    Candidates.push_back({KV.first, Count.hasValue(),
+                          Count.hasValue() ? Count.getCount() : 0,
+                          KV.second});
+  }
+  llvm::sort(Candidates, [](const Candidate &LHS, const Candidate &RHS) {
+    return std::make_tuple(LHS.HasProfile, LHS.EntryCount, LHS.NumCallSites,
+                           RHS.F->getName()) >
+           std::make_tuple(RHS.HasProfile, RHS.EntryCount, RHS.NumCallSites,
+                           LHS.F->getName());
+  });
+
+  // Only functions called through stubs are tracked for hits. Others, e.g.
+  // promoted local functions, are left to compile on demand.
+  MangleAndInterner Mangle(getExecutionSession(), M.getDataLayout());
+  SymbolNameSet Speculations;
+  std::lock_guard<std::mutex> Lock(CODLayerMutex);
+  for (auto &C : Candidates) {
+    if (Speculations.size() == MaxSpeculatedCallees)
+      break;
+    auto Name = Mangle(C.F->getName());
+    if (!PDR.getLazyCallables().count(Name) ||
+        !PDR.getPendingSpeculations().insert(Name).second)
+      continue;
+    Speculations.insert(std::move(Name));
+    ++Speculation.Compiled;
+    ++NumSpeculated;
+  }
+  return Speculations;
+}
+
+void CompileOnDemandLayer::notifyFirstCall(JITDylib &ImplD,
+                                           const SymbolStringPtr &Name) {
+  std::lock_guard<std::mutex> Lock(CODLayerMutex);
+  auto *PDR = findPerDylibResourcesForImpl(ImplD);
+  if (PDR && PDR->getPendingSpeculations().erase(Name)) {
+    ++Speculation.Hits;
+    ++NumSpeculationHits;
+  }
+}
+
+void CompileOnDemandLayer::addTierUpCounters(JITDylib &ImplD, VModuleKey K,
+                                             ThreadSafeModule &TSM) {
+  auto &ES = getExecutionSession();
+
+  auto TP = std::make_shared<TieredPartition>();
+  TP->ImplD = &ImplD;
+  TP->K = K;
+  {
+    std::lock_guard<std::mutex> Lock(CODLayerMutex);
+    if (auto *PDR = findPerDylibResourcesForImpl(ImplD))
+      TP->ISMgr = &PDR->getISManager();
+  }
+  if (!TP->ISMgr)
+    return;
+
+  // Only functions called through a stub can be re-pointed. The stub of a
+  // function is built when it is first looked up, which is what triggers the
+  // emission of its partition.
+  auto Lock = TSM.getContextLock();
+  auto &M = *TSM.getModule();
+  MangleAndInterner Mangle(ES, M.getDataLayout());
+  std::vector<std::pair<Function *, SymbolStringPtr>> Counted;
+  for (auto &F : M) {
+    if (F.isDeclaration())
+      continue;
+    auto StubName = Mangle(F.getName());
+    if (TP->ISMgr->findStub(*StubName, false))
+      Counted.push_back(std::make_pair(&F, std::move(StubName)));
+  }
+  if (Counted.empty())
+    return;
+
+  TP->TSM = cloneToNewContext(TSM);
+  TP->NumPending = Counted.size();
+
+  LLVMContext &Ctx = M.getContext();
+  Type *IntPtrTy = M.getDataLayout().getIntPtrType(Ctx);
+  Type *Int8PtrTy = Type::getInt8PtrTy(Ctx);
+  FunctionType *NotifyTy =
+      FunctionType::get(Type::getVoidTy(Ctx), {Int8PtrTy}, false);
+  Constant *Notify = ConstantExpr::getIntToPtr(
+      ConstantInt::get(IntPtrTy, pointerToJITTargetAddress(&notifyHotFunction)),
+      NotifyTy->getPointerTo());
+
+  for (auto &KV : Counted) {
+    Function &F = *KV.first;
+    auto TF = llvm::make_unique<TieredFunction>();
+    TF->Parent = this;
+    TF->Partition = TP;
+    TF->Name = F.getName();
+    TF->StubName = std::move(KV.second);
+
+    // Count calls after the static allocas, so that they stay in the entry
+    // block, and call the host when the count reaches the threshold:
+    //
+    //   %n = atomicrmw add <counter>, 1 monotonic
+    //   br (%n == Threshold - 1), %tierup.hot, %tierup.body
+    BasicBlock &Entry = F.getEntryBlock();
+    BasicBlock::iterator SplitPt = Entry.begin();
+    while (isa<AllocaInst>(*SplitPt))
+      ++SplitPt;
+    BasicBlock *Body = Entry.splitBasicBlock(SplitPt, "tierup.body");
+    BasicBlock *Hot = BasicBlock::Create(Ctx, "tierup.hot", &F, Body);
+    Entry.getTerminator()->eraseFromParent();
+
+    IRBuilder<> B(&Entry);
+    Value *Counter = ConstantExpr::getIntToPtr(
+        ConstantInt::get(IntPtrTy, pointerToJITTargetAddress(&TF->Calls)),
+        IntPtrTy->getPointerTo());
+    Value *Calls = B.CreateAtomicRMW(AtomicRMWInst::Add, Counter,
+                                     ConstantInt::get(IntPtrTy, 1),
+                                     AtomicOrdering::Monotonic);
+    B.CreateCondBr(
+        B.CreateICmpEQ(Calls, ConstantInt::get(IntPtrTy, TierUpThreshold - 1)),
+        Hot, Body);
+
+    B.SetInsertPoint(Hot);
+    B.CreateCall(NotifyTy, Notify,
+                 {ConstantExpr::getIntToPtr(
+                     ConstantInt::get(IntPtrTy,
+                                      pointerToJITTargetAddress(TF.get())),
+                     Int8PtrTy)});
+    B.CreateBr(Body);
+
+    std::lock_guard<std::mutex> Lock(CODLayerMutex);
+    TieredFunctions.push_back(std::move(TF));
+    ++NumCountedFunctions;
+  }
+}
+
+void CompileOnDemandLayer::notifyHotFunction(void *Ctx) {
+  // Called from JIT'd code: hand the work to the tier-up thread and return.
+  auto &TF = *static_cast<TieredFunction *>(Ctx);
+  TF.Parent->TierUpThreads->async([&TF]() { TF.Parent->tierUp(TF); });
+}
+
+void CompileOnDemandLayer::tierUp(TieredFunction &TF) {
+  auto &ES = getExecutionSession();
+  auto &TP = *TF.Partition;
+
+  // Hold the partition lock throughout, so that prepareToRemove waits for a
+  // tier-up that has started and stops the ones that have not.
+  std::lock_guard<std::mutex> Lock(TP.Mutex);
+  if (TP.Removed) {
+    TP.Skipped.push_back(&TF);
+    return;
+  }
+
+  // Take the function's definition from the uninstrumented copy. Everything
+  // else it references stays a declaration and resolves to the definitions
+  // already emitted to the implementation dylib.
+  ThreadSafeModule OptTSM =
+      cloneToNewContext(TP.TSM, [&](const GlobalValue &GV) {
+        return GV.getName() == TF.Name;
+      });
+  if (--TP.NumPending == 0)
+    TP.TSM = ThreadSafeModule();
+
+  // The original name is already defined by the counted version, so give the
+  // optimized one a new hidden name in the implementation dylib.
+  auto &M = *OptTSM.getModule();
+  Function *F = M.getFunction(TF.Name);
+  assert(F && !F->isDeclaration() && "Counted function not in partition");
+  F->setName(TF.Name + ".tierup");
+  F->setVisibility(GlobalValue::HiddenVisibility);
+  auto OptName = MangleAndInterner(ES, M.getDataLayout())(F->getName());
+
+  if (auto Err = OptimizingLayer->add(*TP.ImplD, std::move(OptTSM), TP.K)) {
+    ES.reportError(std::move(Err));
+    return;
+  }
+
+  auto Sym = ES.lookup(JITDylibSearchList({{TP.ImplD, true}}), OptName);
+  if (!Sym) {
+    ES.reportError(Sym.takeError());
+    return;
+  }
+
+  // Stub pointers are updated with a single pointer-sized store, so callers
+  // jump either to the counted or to the optimized version.
+  if (auto Err = TP.ISMgr->updatePointer(*TF.StubName, Sym->getAddress())) {
+    ES.reportError(std::move(Err));
+    return;
+  }
+  ++NumTieredUp;
+}
+
+void CompileOnDemandLayer::prepareToRemove(VModuleKey K) {
+  std::vector<std::shared_ptr<TieredPartition>> Partitions;
+  {
+    std::lock_guard<std::mutex> Lock(CODLayerMutex);
+    for (auto &TF : TieredFunctions)
+      if (TF->Partition->K == K)
+        Partitions.push_back(TF->Partition);
+  }
+  if (Partitions.empty())
+    return;
+
+  // Stop the tier-ups of the module's functions, then wait for any that are
+  // queued to return. An optimized copy added before this point was added
+  // with the module's key and is removed along with the module.
+  for (auto &TP : Partitions) {
+    std::lock_guard<std::mutex> Lock(TP->Mutex);
+    TP->Removed = true;
+  }
+  TierUpThreads->wait();
+}
+
+void CompileOnDemandLayer::cancelRemove(VModuleKey K) {
+  std::vector<std::shared_ptr<TieredPartition>> Partitions;
+  {
+    std::lock_guard<std::mutex> Lock(CODLayerMutex);
+    for (auto &TF : TieredFunctions)
+      if (TF->Partition->K == K)
+        Partitions.push_back(TF->Partition);
+  }
+
+  for (auto &TP : Partitions) {
+    std::lock_guard<std::mutex> Lock(TP->Mutex);
+    TP->Removed = false;
+    for (TieredFunction *TF : TP->Skipped)
+      TierUpThreads->async([TF]() { TF->Parent->tierUp(*TF); });
+    TP->Skipped.clear();
+  }
+}
+
+Error CompileOnDemandLayer::removeResources(VModuleKey K) {
+  std::vector<std::pair<PerDylibResources *, SymbolNameSet>> Callables;
+  std::vector<std::shared_ptr<TieredPartition>> Partitions;
+  {
+    std::lock_guard<std::mutex> Lock(CODLayerMutex);
+    auto I = ModuleCallables.find(K);
+    if (I != ModuleCallables.end()) {
+      for (auto &KV : I->second) {
+        auto &PDR = DylibResources.find(KV.first)->second;
+        for (auto &Name : KV.second) {
+          PDR.getLazyCallables().erase(Name);
+          PDR.getPendingSpeculations().erase(Name);
+        }
+        Callables.push_back(std::make_pair(&PDR, std::move(KV.second)));
+      }
+      ModuleCallables.erase(I);
+    }
+
+    for (auto &TF : TieredFunctions)
+      if (TF->Partition->K == K)
+        Partitions.push_back(TF->Partition);
+  }
+
+  // prepareToRemove has already stopped the module's tier-ups; drop their
+  // counters.
+  if (!Partitions.empty()) {
+    for (auto &TP : Partitions) {
+      std::lock_guard<std::mutex> Lock(TP->Mutex);
+      assert(TP->Removed && "Tier-ups not stopped before removal");
+      TP->TSM = ThreadSafeModule();
+      TP->Skipped.clear();
+    }
+
+    std::lock_guard<std::mutex> Lock(CODLayerMutex);
+    TieredFunctions.erase(
+        std::remove_if(TieredFunctions.begin(), TieredFunctions.end(),
+                       [K](const std::unique_ptr<TieredFunction> &TF) {
+                         return TF->Partition->K == K;
+                       }),
+        TieredFunctions.end());
+  }
+
+  for (auto &KV : Callables) {
+    std::vector<StringRef> StubNames;
+    for (auto &Name : KV.second)
+      StubNames.push_back(*Name);
+    KV.first->getISManager().removeStubs(StubNames);
+    LCTMgr.releaseCallThroughTrampolines(KV.first->getImplDylib(), KV.second);
+  }
+
+  return Error::success();
+}
+
 } // end namespace orc
 } // end namespace llvm
@@ -7,6 +7,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/ExecutionEngine/Orc/Core.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Config/llvm-config.h"
 #include "llvm/ExecutionEngine/Orc/OrcError.h"
 #include "llvm/IR/Mangler.h"
@@ -20,6 +21,10 @@
 
 #define DEBUG_TYPE "orc"
 
+STATISTIC(NumSnapshotLookups,
+          "Number of lookups answered without taking the session lock");
+STATISTIC(NumSnapshotRebuilds, "Number of symbol table snapshots taken");
+
 using namespace llvm;
 
 namespace {
@@ -144,6 +149,8 @@ RegisterDependenciesFunction NoDependenciesToRegister =
 
 void MaterializationUnit::anchor() {}
 
+ResourceManager::~ResourceManager() {}
+
 raw_ostream &operator<<(raw_ostream &OS, const SymbolStringPtr &Sym) {
   return OS << *Sym;
 }
@@ -436,7 +443,7 @@ Error MaterializationResponsibility::defineMaterializing(
 #endif
   }
 
-  return JD.defineMaterializing(NewSymbolFlags);
+  return JD.defineMaterializing(NewSymbolFlags, K);
 }
 
 void MaterializationResponsibility::failMaterialization() {
@@ -481,6 +488,10 @@ MaterializationResponsibility::delegate(const SymbolNameSet &Symbols,
     SymbolFlags.erase(I);
   }
 
+  if (NewKey != K)
+    JD.getExecutionSession().runSessionLocked(
+        [&]() { JD.trackSymbols(NewKey, DelegatedFlags); });
+
   return MaterializationResponsibility(JD, std::move(DelegatedFlags),
                                        std::move(NewKey));
 }
@@ -728,7 +739,8 @@ SymbolNameSet ReexportsGenerator::operator()(JITDylib &JD,
   return Added;
 }
 
-Error JITDylib::defineMaterializing(const SymbolFlagsMap &SymbolFlags) {
+Error JITDylib::defineMaterializing(const SymbolFlagsMap &SymbolFlags,
+                                   VModuleKey K) {
   return ES.runSessionLocked([&]() -> Error {
     std::vector<SymbolMap::iterator> AddedSyms;
 
@@ -754,6 +766,8 @@ Error JITDylib::defineMaterializing(const SymbolFlagsMap &SymbolFlags) {
       }
     }
 
+    trackSymbols(K, SymbolFlags);
+    noteSymbolTableChanged();
     return Error::success();
   });
 }
@@ -763,6 +777,7 @@ void JITDylib::replace(std::unique_ptr<MaterializationUnit> MU) {
 
   auto MustRunMU =
       ES.runSessionLocked([&, this]() -> std::unique_ptr<MaterializationUnit> {
+        trackSymbols(MU->getVModuleKey(), MU->getSymbols());
 
 #ifndef NDEBUG
         for (auto &KV : MU->getSymbols()) {
@@ -976,6 +991,7 @@ void JITDylib::emit(const SymbolFlagsMap &Emitted) {
             DependantSym.setFlags(DependantSym.getFlags() &
                                   ~JITSymbolFlags::Materializing);
             DependantJD.MaterializingInfos.erase(DependantMII);
+            DependantJD.noteSymbolTableChanged();
           }
         }
       }
@@ -994,6 +1010,7 @@ void JITDylib::emit(const SymbolFlagsMap &Emitted) {
         auto &Sym = Symbols[Name];
         Sym.setFlags(Sym.getFlags() & ~JITSymbolFlags::Materializing);
         MaterializingInfos.erase(MII);
+        noteSymbolTableChanged();
       }
     }
 
@@ -1017,6 +1034,8 @@ void JITDylib::notifyFailed(const SymbolNameSet &FailedSymbols) {
       auto I = Symbols.find(Name);
       assert(I != Symbols.end() && "Symbol not present in this JITDylib");
       Symbols.erase(I);
+      untrackSymbol(Name);
+      noteSymbolTableChanged();
 
       auto MII = MaterializingInfos.find(Name);
 
@@ -1135,9 +1154,16 @@ Error JITDylib::remove(const SymbolNameSet &Names) {
       }
 
       auto SymI = SymbolMaterializerItrPair.first;
+      untrackSymbol(SymI->first);
       Symbols.erase(SymI);
     }
 
+    // The snapshot may hold addresses of the removed symbols, so drop it
+    // rather than waiting for lookups to notice the new generation.
+    noteSymbolTableChanged();
+    std::atomic_store(&Snapshot, std::shared_ptr<const SymbolTableSnapshot>());
+    StaleSnapshotLookups = 0;
+
     return Error::success();
   });
 }
@@ -1265,6 +1291,61 @@ void JITDylib::lodgeQueryImpl(
     Unresolved.erase(Name);
 }
 
+JITDylib::SnapshotLookupResult
+JITDylib::lookupInSnapshot(const SymbolStringPtr &Name, bool MatchNonExported,
+                           JITEvaluatedSymbol &Result, bool &IsStale) const {
+  auto S = std::atomic_load(&Snapshot);
+  IsStale =
+      !S || S->Generation != SymbolTableGeneration.load(std::memory_order_acquire);
+  if (!S)
+    return SnapshotLookupResult::Unknown;
+
+  // Symbols are only removed from the table after the snapshot has been
+  // dropped, so a ready entry is valid even if the snapshot is stale.
+  auto I = S->Symbols.find(Name);
+  if (I != S->Symbols.end()) {
+    auto Flags = I->second.getFlags();
+    if (Flags.isExported() || MatchNonExported) {
+      if (Flags.isLazy() || Flags.isMaterializing() ||
+          I->second.getAddress() == 0)
+        return SnapshotLookupResult::Unknown;
+      Result = I->second;
+      return SnapshotLookupResult::Found;
+    }
+  }
+
+  // An absent (or unmatchable) symbol only means "not defined here" if
+  // nothing has been added since the snapshot was taken and no generator
+  // could add it now.
+  if (IsStale || S->HasGenerator)
+    return SnapshotLookupResult::Unknown;
+  return SnapshotLookupResult::NotDefined;
+}
+
+void JITDylib::noteStaleSnapshotLookup() {
+  // Taking a snapshot copies the whole table, so only do it once the number
+  // of lookups that missed the current one is a fraction of the table size.
+  // Copying is then amortized over those lookups, and a dylib that keeps
+  // changing does not pay for a copy per change.
+  const size_t SnapshotRebuildRatio = 8;
+
+  auto Generation = SymbolTableGeneration.load(std::memory_order_acquire);
+  auto S = std::atomic_load(&Snapshot);
+  if (S && S->Generation == Generation)
+    return;
+  if (++StaleSnapshotLookups * SnapshotRebuildRatio < Symbols.size())
+    return;
+
+  auto NewS = std::make_shared<SymbolTableSnapshot>();
+  NewS->Symbols = Symbols;
+  NewS->Generation = Generation;
+  NewS->HasGenerator = static_cast<bool>(DefGenerator);
+  std::atomic_store(&Snapshot,
+                    std::shared_ptr<const SymbolTableSnapshot>(std::move(NewS)));
+  StaleSnapshotLookups = 0;
+  ++NumSnapshotRebuilds;
+}
+
 SymbolNameSet JITDylib::legacyLookup(std::shared_ptr<AsynchronousSymbolQuery> Q,
                                      SymbolNameSet Names) {
   assert(Q && "Query can not be null");
@@ -1306,7 +1387,8 @@ SymbolNameSet JITDylib::legacyLookup(std::shared_ptr<AsynchronousSymbolQuery> Q,
   {
     std::lock_guard<std::recursive_mutex> Lock(ES.OutstandingMUsMutex);
     for (auto &MU : MUs)
-      ES.OutstandingMUs.push_back(make_pair(this, std::move(MU)));
+      ES.OutstandingMUs.push_back(
+          {this, std::move(MU), MaterializationPriority::Blocking});
   }
   ES.runOutstandingMUs();
 
@@ -1522,9 +1604,42 @@ Error JITDylib::defineImpl(MaterializationUnit &MU) {
   for (auto &Sym : MUDefsOverridden)
     MU.doDiscard(*this, Sym);
 
+  trackSymbols(MU.getVModuleKey(), MU.getSymbols());
+  noteSymbolTableChanged();
   return Error::success();
 }
 
+void JITDylib::trackSymbols(VModuleKey K, const SymbolFlagsMap &SymbolFlags) {
+  // Symbols defined without a key keep any key they were defined with
+  // before, e.g. when a materializer hands them on to another unit.
+  if (K == VModuleKey())
+    return;
+
+  for (auto &KV : SymbolFlags) {
+    auto I = SymbolModules.find(KV.first);
+    if (I != SymbolModules.end()) {
+      if (I->second == K)
+        continue;
+      untrackSymbol(KV.first);
+    }
+    SymbolModules[KV.first] = K;
+    ModuleSymbols[K].insert(KV.first);
+  }
+}
+
+void JITDylib::untrackSymbol(const SymbolStringPtr &Name) {
+  auto I = SymbolModules.find(Name);
+  if (I == SymbolModules.end())
+    return;
+
+  auto MSI = ModuleSymbols.find(I->second);
+  assert(MSI != ModuleSymbols.end() && "Tracked symbol has no module");
+  MSI->second.erase(Name);
+  if (MSI->second.empty())
+    ModuleSymbols.erase(MSI);
+  SymbolModules.erase(I);
+}
+
 void JITDylib::detachQueryHelper(AsynchronousSymbolQuery &Q,
                                  const SymbolNameSet &QuerySymbols) {
   for (auto &QuerySymbol : QuerySymbols) {
@@ -1592,6 +1707,81 @@ JITDylib &ExecutionSession::createJITDylib(std::string Name,
   });
 }
 
+void ExecutionSession::registerResourceManager(ResourceManager &RM) {
+  runSessionLocked([&]() { ResourceManagers.push_back(&RM); });
+}
+
+void ExecutionSession::deregisterResourceManager(ResourceManager &RM) {
+  runSessionLocked([&]() {
+    auto I = std::find(ResourceManagers.begin(), ResourceManagers.end(), &RM);
+    assert(I != ResourceManagers.end() && "RM was not registered");
+    ResourceManagers.erase(I);
+  });
+}
+
+Error ExecutionSession::removeModule(VModuleKey K) {
+  assert(K != VModuleKey() && "Can not remove the default module key");
+
+  // Work on the module, e.g. recompilation, may need the session lock, so
+  // stop it before taking the lock to remove the module's symbols.
+  std::vector<ResourceManager *> RMs =
+      runSessionLocked([this]() { return ResourceManagers; });
+  for (auto *RM : RMs)
+    RM->prepareToRemove(K);
+
+  if (auto Err = runSessionLocked([&]() -> Error {
+        // Check every dylib before removing anything, so that a failure
+        // leaves the session unmodified.
+        std::vector<std::pair<JITDylib *, SymbolNameSet>> ToRemove;
+        SymbolNameSet Materializing;
+        for (auto &JD : JDs) {
+          auto I = JD->ModuleSymbols.find(K);
+          if (I == JD->ModuleSymbols.end())
+            continue;
+          for (auto &Name : I->second) {
+            auto SymI = JD->Symbols.find(Name);
+            assert(SymI != JD->Symbols.end() && "Tracked symbol not defined");
+            if (SymI->second.getFlags().isMaterializing())
+              Materializing.insert(Name);
+          }
+          ToRemove.push_back(std::make_pair(JD.get(), I->second));
+        }
+
+        if (!Materializing.empty())
+          return make_error<SymbolsCouldNotBeRemoved>(std::move(Materializing));
+
+        for (auto &KV : ToRemove)
+          cantFail(KV.first->remove(KV.second));
+
+        RMs = ResourceManagers;
+        return Error::success();
+      })) {
+    for (auto *RM : RMs)
+      RM->cancelRemove(K);
+    return Err;
+  }
+
+  // Layers closer to the object level were registered first. Release the
+  // resources of the layers above them first, e.g. stubs before the code
+  // they point to.
+  Error Err = Error::success();
+  for (auto I = RMs.rbegin(), E = RMs.rend(); I != E; ++I)
+    Err = joinErrors(std::move(Err), (*I)->removeResources(K));
+
+  releaseVModule(K);
+  return Err;
+}
+
+uint64_t ExecutionSession::getModuleResourceSize(VModuleKey K) {
+  std::vector<ResourceManager *> RMs =
+      runSessionLocked([this]() { return ResourceManagers; });
+
+  uint64_t Size = 0;
+  for (auto *RM : RMs)
+    Size += RM->getResourceSize(K);
+  return Size;
+}
+
 void ExecutionSession::legacyFailQuery(AsynchronousSymbolQuery &Q, Error Err) {
   assert(!!Err && "Error should be in failure state");
 
@@ -1742,6 +1932,69 @@ void ExecutionSession::lookup(
     const JITDylibSearchList &SearchOrder, SymbolNameSet Symbols,
     SymbolsResolvedCallback OnResolve, SymbolsReadyCallback OnReady,
     RegisterDependenciesFunction RegisterDependencies) {
+  lookupImpl(SearchOrder, std::move(Symbols), std::move(OnResolve),
+             std::move(OnReady), std::move(RegisterDependencies),
+             MaterializationPriority::Blocking);
+}
+
+void ExecutionSession::lookupSpeculatively(const JITDylibSearchList &SearchOrder,
+                                           SymbolNameSet Symbols,
+                                           SymbolsResolvedCallback OnResolve,
+                                           SymbolsReadyCallback OnReady) {
+  lookupImpl(SearchOrder, std::move(Symbols), std::move(OnResolve),
+             std::move(OnReady), NoDependenciesToRegister,
+             MaterializationPriority::Speculative);
+}
+
+bool ExecutionSession::lookupInSnapshots(const JITDylibSearchList &SearchOrder,
+                                         const SymbolNameSet &Symbols,
+                                         SymbolMap &Result,
+                                         JITDylib *&StaleJD) const {
+  StaleJD = nullptr;
+  for (auto &Name : Symbols) {
+    bool Found = false;
+    for (auto &KV : SearchOrder) {
+      JITEvaluatedSymbol Sym;
+      bool IsStale;
+      auto R = KV.first->lookupInSnapshot(Name, KV.second, Sym, IsStale);
+      if (R == JITDylib::SnapshotLookupResult::NotDefined)
+        continue;
+      if (R == JITDylib::SnapshotLookupResult::Unknown) {
+        if (IsStale)
+          StaleJD = KV.first;
+        return false;
+      }
+      Result[Name] = Sym;
+      Found = true;
+      break;
+    }
+
+    // Let the locked path report the missing symbol.
+    if (!Found)
+      return false;
+  }
+  return true;
+}
+
+void ExecutionSession::lookupImpl(
+    const JITDylibSearchList &SearchOrder, SymbolNameSet Symbols,
+    SymbolsResolvedCallback OnResolve, SymbolsReadyCallback OnReady,
+    RegisterDependenciesFunction RegisterDependencies,
+    MaterializationPriority Priority) {
+
+  // Symbols that are already ready need neither the session lock nor any
+  // materialization, which makes repeated lookups of finalized symbols (e.g.
+  // from lazy call-throughs) cheap and lets them run concurrently.
+  JITDylib *StaleJD = nullptr;
+  {
+    SymbolMap Ready;
+    if (lookupInSnapshots(SearchOrder, Symbols, Ready, StaleJD)) {
+      ++NumSnapshotLookups;
+      OnResolve(std::move(Ready));
+      OnReady(Error::success());
+      return;
+    }
+  }
 
   // lookup can be re-entered recursively if running on a single thread. Run any
   // outstanding MUs in case this query depends on them, otherwise this lookup
@@ -1755,6 +2008,7 @@ void ExecutionSession::lookup(
   bool QueryIsFullyResolved = false;
   bool QueryIsFullyReady = false;
   bool QueryFailed = false;
+  SymbolDependenceMap Waiting;
 
   runSessionLocked([&]() {
     for (auto &KV : SearchOrder) {
@@ -1767,6 +2021,9 @@ void ExecutionSession::lookup(
       JD.lodgeQuery(Q, Unresolved, MatchNonExported, CollectedMUsMap[&JD]);
     }
 
+    if (StaleJD)
+      StaleJD->noteStaleSnapshotLookup();
+
     if (Unresolved.empty()) {
       // Query lodged successfully.
 
@@ -1779,6 +2036,12 @@ void ExecutionSession::lookup(
       // Call the register dependencies function.
       if (RegisterDependencies && !Q->QueryRegistrations.empty())
         RegisterDependencies(Q->QueryRegistrations);
+
+      // Remember what a blocking query waits on, so that speculative units
+      // already queued for those symbols can be promoted.
+      if (Priority == MaterializationPriority::Blocking &&
+          PromoteMaterialization)
+        Waiting = Q->QueryRegistrations;
     } else {
       // Query failed due to unresolved symbols.
       QueryFailed = true;
@@ -1809,10 +2072,13 @@ void ExecutionSession::lookup(
 
     for (auto &KV : CollectedMUsMap)
       for (auto &MU : KV.second)
-        OutstandingMUs.push_back(std::make_pair(KV.first, std::move(MU)));
+        OutstandingMUs.push_back({KV.first, std::move(MU), Priority});
   }
 
   runOutstandingMUs();
+
+  if (!Waiting.empty())
+    promoteMaterializations(Waiting);
 }
 
 Expected<SymbolMap> ExecutionSession::lookup(
@@ -1968,25 +2234,74 @@ void ExecutionSession::dump(raw_ostream &OS) {
 
 void ExecutionSession::runOutstandingMUs() {
   while (1) {
-    std::pair<JITDylib *, std::unique_ptr<MaterializationUnit>> JITDylibAndMU;
+    OutstandingMU Next{nullptr, nullptr, MaterializationPriority::Blocking};
+    auto Dispatch = SpeculativeDispatches.end();
 
     {
       std::lock_guard<std::recursive_mutex> Lock(OutstandingMUsMutex);
       if (!OutstandingMUs.empty()) {
-        JITDylibAndMU = std::move(OutstandingMUs.back());
+        Next = std::move(OutstandingMUs.back());
         OutstandingMUs.pop_back();
+
+        if (Next.Priority == MaterializationPriority::Speculative &&
+            PromoteMaterialization) {
+          SymbolNameSet Symbols;
+          for (auto &KV : Next.MU->getSymbols())
+            Symbols.insert(KV.first);
+          Dispatch = SpeculativeDispatches.insert(
+              SpeculativeDispatches.end(),
+              {Next.JD, std::move(Symbols), false});
+        }
       }
     }
 
-    if (JITDylibAndMU.first) {
-      assert(JITDylibAndMU.second && "JITDylib, but no MU?");
-      dispatchMaterialization(*JITDylibAndMU.first,
-                              std::move(JITDylibAndMU.second));
-    } else
+    if (!Next.JD)
       break;
+
+    assert(Next.MU && "JITDylib, but no MU?");
+    dispatchMaterialization(*Next.JD, std::move(Next.MU), Next.Priority);
+
+    if (Dispatch != SpeculativeDispatches.end()) {
+      SpeculativeDispatch D;
+      {
+        std::lock_guard<std::recursive_mutex> Lock(OutstandingMUsMutex);
+        D = std::move(*Dispatch);
+        SpeculativeDispatches.erase(Dispatch);
+      }
+      if (D.Promoted)
+        PromoteMaterialization(*D.JD, D.Symbols);
+    }
   }
 }
 
+void ExecutionSession::promoteMaterializations(
+    const SymbolDependenceMap &Waiting) {
+  auto IsWaitedOn = [&](JITDylib *JD, const SymbolStringPtr &Name) {
+    auto I = Waiting.find(JD);
+    return I != Waiting.end() && I->second.count(Name);
+  };
+
+  {
+    std::lock_guard<std::recursive_mutex> Lock(OutstandingMUsMutex);
+    for (auto &O : OutstandingMUs)
+      if (O.Priority == MaterializationPriority::Speculative)
+        for (auto &KV : O.MU->getSymbols())
+          if (IsWaitedOn(O.JD, KV.first)) {
+            O.Priority = MaterializationPriority::Blocking;
+            break;
+          }
+    for (auto &D : SpeculativeDispatches)
+      for (auto &Name : D.Symbols)
+        if (IsWaitedOn(D.JD, Name)) {
+          D.Promoted = true;
+          break;
+        }
+  }
+
+  for (auto &KV : Waiting)
+    PromoteMaterialization(*KV.first, KV.second);
+}
+
 MangleAndInterner::MangleAndInterner(ExecutionSession &ES, const DataLayout &DL)
     : ES(ES), DL(DL) {}
 
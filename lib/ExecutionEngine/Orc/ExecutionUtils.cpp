@@ -86,7 +86,8 @@ iterator_range<CtorDtorIterator> getDestructors(const Module &M) {
                     CtorDtorIterator(DtorsList, true));
 }
 
-void CtorDtorRunner::add(iterator_range<CtorDtorIterator> CtorDtors) {
+void CtorDtorRunner::add(iterator_range<CtorDtorIterator> CtorDtors,
+                         VModuleKey K) {
   if (empty(CtorDtors))
     return;
 
@@ -110,7 +111,24 @@ void CtorDtorRunner::add(iterator_range<CtorDtorIterator> CtorDtors) {
     }
 
     CtorDtorsByPriority[CtorDtor.Priority].push_back(
-        Mangle(CtorDtor.Func->getName()));
+        std::make_pair(Mangle(CtorDtor.Func->getName()), K));
+  }
+}
+
+void CtorDtorRunner::remove(VModuleKey K) {
+  assert(K != VModuleKey() && "Can not remove the default module key");
+  for (auto I = CtorDtorsByPriority.begin(), E = CtorDtorsByPriority.end();
+       I != E;) {
+    auto &CtorDtors = I->second;
+    CtorDtors.erase(std::remove_if(CtorDtors.begin(), CtorDtors.end(),
+                                   [K](const CtorDtorList::value_type &CD) {
+                                     return CD.second == K;
+                                   }),
+                    CtorDtors.end());
+    if (CtorDtors.empty())
+      I = CtorDtorsByPriority.erase(I);
+    else
+      ++I;
   }
 }
 
@@ -120,8 +138,8 @@ Error CtorDtorRunner::run() {
   SymbolNameSet Names;
 
   for (auto &KV : CtorDtorsByPriority) {
-    for (auto &Name : KV.second) {
-      auto Added = Names.insert(Name).second;
+    for (auto &CD : KV.second) {
+      auto Added = Names.insert(CD.first).second;
       (void)Added;
       assert(Added && "Ctor/Dtor names clashed");
     }
@@ -132,10 +150,10 @@ Error CtorDtorRunner::run() {
           ES.lookup(JITDylibSearchList({{&JD, true}}), std::move(Names),
                     NoDependenciesToRegister, true)) {
     for (auto &KV : CtorDtorsByPriority) {
-      for (auto &Name : KV.second) {
-        assert(CtorDtorMap->count(Name) && "No entry for Name");
+      for (auto &CD : KV.second) {
+        assert(CtorDtorMap->count(CD.first) && "No entry for Name");
         auto CtorDtor = reinterpret_cast<CtorDtorTy>(
-            static_cast<uintptr_t>((*CtorDtorMap)[Name].getAddress()));
+            static_cast<uintptr_t>((*CtorDtorMap)[CD.first].getAddress()));
         CtorDtor();
       }
     }
@@ -20,6 +20,16 @@ void IRCompileLayer::setNotifyCompiled(NotifyCompiledFunction NotifyCompiled) {
   this->NotifyCompiled = std::move(NotifyCompiled);
 }
 
+IRCompileLayer::CompileFunction IRCompileLayer::getCompileFunction() const {
+  std::lock_guard<std::mutex> Lock(IRLayerMutex);
+  return Compile;
+}
+
+void IRCompileLayer::setCompileFunction(CompileFunction Compile) {
+  std::lock_guard<std::mutex> Lock(IRLayerMutex);
+  this->Compile = std::move(Compile);
+}
+
 void IRCompileLayer::emit(MaterializationResponsibility R,
                           ThreadSafeModule TSM) {
   assert(TSM.getModule() && "Module must not be null");
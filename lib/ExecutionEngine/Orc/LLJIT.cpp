@@ -10,6 +10,7 @@
 #include "llvm/ExecutionEngine/Orc/OrcError.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
 #include "llvm/IR/Mangler.h"
+#include "llvm/Support/FileSystem.h"
 
 namespace {
 
@@ -59,18 +60,63 @@ Error LLJIT::defineAbsolute(StringRef Name, JITEvaluatedSymbol Sym) {
 }
 
 Error LLJIT::addIRModule(JITDylib &JD, ThreadSafeModule TSM) {
+  return addIRModule(JD, std::move(TSM), ES->allocateVModule());
+}
+
+Error LLJIT::addIRModule(JITDylib &JD, ThreadSafeModule TSM, VModuleKey K) {
   assert(TSM && "Can not add null module");
 
   if (auto Err = applyDataLayout(*TSM.getModule()))
     return Err;
 
-  return CompileLayer.add(JD, std::move(TSM), ES->allocateVModule());
+  return CompileLayer.add(JD, std::move(TSM), std::move(K));
 }
 
 Error LLJIT::addObjectFile(JITDylib &JD, std::unique_ptr<MemoryBuffer> Obj) {
+  return addObjectFile(JD, std::move(Obj), ES->allocateVModule());
+}
+
+Error LLJIT::addObjectFile(JITDylib &JD, std::unique_ptr<MemoryBuffer> Obj,
+                           VModuleKey K) {
   assert(Obj && "Can not add null object");
 
-  return ObjLinkingLayer.add(JD, std::move(Obj), ES->allocateVModule());
+  return ObjLinkingLayer.add(JD, std::move(Obj), std::move(K));
+}
+
+Error LLJIT::removeModule(VModuleKey K) {
+  if (auto Err = ES->removeModule(K))
+    return Err;
+  CtorRunner.remove(K);
+  DtorRunner.remove(K);
+  return Error::success();
+}
+
+Error LLJIT::enableObjectCache(StringRef CacheDir, CachePruningPolicy Policy) {
+  // The compile threads of a multi-threaded instance each build their own
+  // TargetMachine, so build one here just to find the key.
+  if (TargetKey.empty() && TargetKeyJTMB) {
+    auto TM = TargetKeyJTMB->createTargetMachine();
+    if (!TM)
+      return TM.takeError();
+    TargetKey = CachingIRCompiler::getTargetKey(**TM);
+  }
+
+  if (TargetKey.empty())
+    return make_error<StringError>(
+        "Can not identify the target to key the object cache with",
+        inconvertibleErrorCode());
+
+  if (auto EC = sys::fs::create_directories(CacheDir))
+    return errorCodeToError(EC);
+
+  CompileLayer.setCompileFunction(CachingIRCompiler(
+      *ES, CompileLayer.getCompileFunction(), CacheDir, TargetKey,
+      std::move(Policy)));
+  return Error::success();
+}
+
+void LLJIT::enableSlabAllocation(JITSlabAllocator::Options Opts) {
+  SlabAllocator = llvm::make_unique<JITSlabAllocator>(Opts);
 }
 
 Expected<JITEvaluatedSymbol> LLJIT::lookupLinkerMangled(JITDylib &JD,
@@ -81,9 +127,8 @@ Expected<JITEvaluatedSymbol> LLJIT::lookupLinkerMangled(JITDylib &JD,
 LLJIT::LLJIT(std::unique_ptr<ExecutionSession> ES,
              std::unique_ptr<TargetMachine> TM, DataLayout DL)
     : ES(std::move(ES)), Main(this->ES->getMainJITDylib()), DL(std::move(DL)),
-      ObjLinkingLayer(
-          *this->ES,
-          []() { return llvm::make_unique<SectionMemoryManager>(); }),
+      TargetKey(CachingIRCompiler::getTargetKey(*TM)),
+      ObjLinkingLayer(*this->ES, [this]() { return createMemoryManager(); }),
       CompileLayer(*this->ES, ObjLinkingLayer,
                    TMOwningSimpleCompiler(std::move(TM))),
       CtorRunner(Main), DtorRunner(Main) {}
@@ -91,9 +136,8 @@ LLJIT::LLJIT(std::unique_ptr<ExecutionSession> ES,
 LLJIT::LLJIT(std::unique_ptr<ExecutionSession> ES, JITTargetMachineBuilder JTMB,
              DataLayout DL, unsigned NumCompileThreads)
     : ES(std::move(ES)), Main(this->ES->getMainJITDylib()), DL(std::move(DL)),
-      ObjLinkingLayer(
-          *this->ES,
-          []() { return llvm::make_unique<SectionMemoryManager>(); }),
+      TargetKeyJTMB(JTMB),
+      ObjLinkingLayer(*this->ES, [this]() { return createMemoryManager(); }),
       CompileLayer(*this->ES, ObjLinkingLayer,
                    ConcurrentIRCompiler(std::move(JTMB))),
       CtorRunner(Main), DtorRunner(Main) {
@@ -106,13 +150,16 @@ LLJIT::LLJIT(std::unique_ptr<ExecutionSession> ES, JITTargetMachineBuilder JTMB,
 
   // Create a thread pool to compile on and set the execution session
   // dispatcher to use the thread pool.
-  CompileThreads = llvm::make_unique<ThreadPool>(NumCompileThreads);
-  this->ES->setDispatchMaterialization(
-      [this](JITDylib &JD, std::unique_ptr<MaterializationUnit> MU) {
-        // FIXME: Switch to move capture once we have c++14.
-        auto SharedMU = std::shared_ptr<MaterializationUnit>(std::move(MU));
-        auto Work = [SharedMU, &JD]() { SharedMU->doMaterialize(JD); };
-        CompileThreads->async(std::move(Work));
+  CompileThreads =
+      llvm::make_unique<MaterializationThreadPool>(NumCompileThreads);
+  this->ES->setPrioritizedDispatchMaterialization(
+      [this](JITDylib &JD, std::unique_ptr<MaterializationUnit> MU,
+             MaterializationPriority Priority) {
+        CompileThreads->dispatch(JD, std::move(MU), Priority);
+      });
+  this->ES->setPromoteMaterialization(
+      [this](JITDylib &JD, const SymbolNameSet &Symbols) {
+        CompileThreads->promote(JD, Symbols);
       });
 }
 
@@ -137,9 +184,15 @@ Error LLJIT::applyDataLayout(Module &M) {
   return Error::success();
 }
 
-void LLJIT::recordCtorDtors(Module &M) {
-  CtorRunner.add(getConstructors(M));
-  DtorRunner.add(getDestructors(M));
+void LLJIT::recordCtorDtors(Module &M, VModuleKey K) {
+  CtorRunner.add(getConstructors(M), K);
+  DtorRunner.add(getDestructors(M), K);
+}
+
+std::unique_ptr<RuntimeDyld::MemoryManager> LLJIT::createMemoryManager() {
+  if (SlabAllocator)
+    return SlabAllocator->createMemoryManager();
+  return llvm::make_unique<SectionMemoryManager>();
 }
 
 Expected<std::unique_ptr<LLLazyJIT>>
@@ -173,15 +226,30 @@ LLLazyJIT::Create(JITTargetMachineBuilder JTMB, DataLayout DL,
       std::move(*LCTMgr), std::move(ISMBuilder)));
 }
 
+void LLLazyJIT::enableTieredCompilation(
+    JITTargetMachineBuilder OptimizingJTMB, uint64_t Threshold,
+    IRTransformLayer::TransformFunction OptimizeTransform) {
+  TierUpCompileLayer = llvm::make_unique<IRCompileLayer>(
+      *ES, ObjLinkingLayer, ConcurrentIRCompiler(std::move(OptimizingJTMB)));
+  TierUpTransformLayer = llvm::make_unique<IRTransformLayer>(
+      *ES, *TierUpCompileLayer, std::move(OptimizeTransform));
+  CODLayer.setTierUpLayer(*TierUpTransformLayer, Threshold);
+}
+
 Error LLLazyJIT::addLazyIRModule(JITDylib &JD, ThreadSafeModule TSM) {
+  return addLazyIRModule(JD, std::move(TSM), ES->allocateVModule());
+}
+
+Error LLLazyJIT::addLazyIRModule(JITDylib &JD, ThreadSafeModule TSM,
+                                 VModuleKey K) {
   assert(TSM && "Can not add null module");
 
   if (auto Err = applyDataLayout(*TSM.getModule()))
     return Err;
 
-  recordCtorDtors(*TSM.getModule());
+  recordCtorDtors(*TSM.getModule(), K);
 
-  return CODLayer.add(JD, std::move(TSM), ES->allocateVModule());
+  return CODLayer.add(JD, std::move(TSM), std::move(K));
 }
 
 LLLazyJIT::LLLazyJIT(
@@ -37,6 +37,20 @@ Expected<JITTargetAddress> LazyCallThroughManager::getCallThroughTrampoline(
   return *Trampoline;
 }
 
+void LazyCallThroughManager::releaseCallThroughTrampolines(
+    JITDylib &SourceJD, const SymbolNameSet &SymbolNames) {
+  std::lock_guard<std::mutex> Lock(LCTMMutex);
+  for (auto I = Reexports.begin(); I != Reexports.end();) {
+    if (I->second.first != &SourceJD || !SymbolNames.count(I->second.second)) {
+      ++I;
+      continue;
+    }
+    TP->releaseTrampoline(I->first);
+    Notifiers.erase(I->first);
+    I = Reexports.erase(I);
+  }
+}
+
 JITTargetAddress
 LazyCallThroughManager::callThroughToSymbol(JITTargetAddress TrampolineAddr) {
   JITDylib *SourceJD = nullptr;
@@ -124,14 +138,22 @@ createLocalLazyCallThroughManager(const Triple &T, ExecutionSession &ES,
 
 LazyReexportsMaterializationUnit::LazyReexportsMaterializationUnit(
     LazyCallThroughManager &LCTManager, IndirectStubsManager &ISManager,
-    JITDylib &SourceJD, SymbolAliasMap CallableAliases, VModuleKey K)
+    JITDylib &SourceJD, SymbolAliasMap CallableAliases, VModuleKey K,
+    NotifyFirstCallFunction NotifyFirstCall)
     : MaterializationUnit(extractFlags(CallableAliases), std::move(K)),
       LCTManager(LCTManager), ISManager(ISManager), SourceJD(SourceJD),
       CallableAliases(std::move(CallableAliases)),
+      NotifyFirstCall(NotifyFirstCall),
       NotifyResolved(LazyCallThroughManager::createNotifyResolvedFunction(
-          [&ISManager](JITDylib &JD, const SymbolStringPtr &SymbolName,
-                       JITTargetAddress ResolvedAddr) {
-            return ISManager.updatePointer(*SymbolName, ResolvedAddr);
+          [&ISManager, NotifyFirstCall](JITDylib &JD,
+                                        const SymbolStringPtr &SymbolName,
+                                        JITTargetAddress ResolvedAddr)
+              -> Error {
+            if (auto Err = ISManager.updatePointer(*SymbolName, ResolvedAddr))
+              return Err;
+            if (NotifyFirstCall)
+              NotifyFirstCall(JD, SymbolName);
+            return Error::success();
           })) {}
 
 StringRef LazyReexportsMaterializationUnit::getName() const {
@@ -152,7 +174,8 @@ void LazyReexportsMaterializationUnit::materialize(
 
   if (!CallableAliases.empty())
     R.replace(lazyReexports(LCTManager, ISManager, SourceJD,
-                            std::move(CallableAliases)));
+                            std::move(CallableAliases), R.getVModuleKey(),
+                            NotifyFirstCall));
 
   IndirectStubsManager::StubInitsMap StubInits;
   for (auto &Alias : RequestedAliases) {
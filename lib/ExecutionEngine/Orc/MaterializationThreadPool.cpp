@@ -0,0 +1,272 @@
+//===--- MaterializationThreadPool.cpp - Prioritized dispatch -------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/Orc/MaterializationThreadPool.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MathExtras.h"
+#include <algorithm>
+
+using namespace llvm;
+using namespace llvm::orc;
+
+// The pool and index of the worker running on this thread, if any, so that
+// units dispatched while materializing stay with the worker that needs them.
+static LLVM_THREAD_LOCAL const MaterializationThreadPool *CurrentPool = nullptr;
+static LLVM_THREAD_LOCAL unsigned CurrentWorker = 0;
+
+void MaterializationThreadPool::LatencyHistogram::add(
+    std::chrono::microseconds Duration) {
+  uint64_t US = std::max<int64_t>(Duration.count(), 0);
+  unsigned Bucket = US == 0 ? 0 : Log2_64(US) + 1;
+  ++Buckets[std::min(Bucket, NumBuckets - 1)];
+  ++Count;
+  Total += Duration;
+  Max = std::max(Max, Duration);
+}
+
+std::chrono::microseconds
+MaterializationThreadPool::LatencyHistogram::getPercentileBound(
+    double P) const {
+  assert(P > 0 && P <= 100 && "Percentile out of range");
+  if (Count == 0)
+    return std::chrono::microseconds(0);
+  uint64_t Rank = std::max<uint64_t>(1, uint64_t(P / 100 * Count + 0.5));
+  uint64_t Seen = 0;
+  for (unsigned I = 0; I != NumBuckets - 1; ++I) {
+    Seen += Buckets[I];
+    if (Seen >= Rank)
+      return std::min(std::chrono::microseconds(uint64_t(1) << I), Max);
+  }
+  return Max;
+}
+
+void MaterializationThreadPool::LatencyHistogram::print(raw_ostream &OS) const {
+  OS << "count " << Count << ", total " << Total.count() << "us, p50 <= "
+     << getPercentileBound(50).count() << "us, p99 <= "
+     << getPercentileBound(99).count() << "us, max " << Max.count() << "us\n";
+  for (unsigned I = 0; I != NumBuckets; ++I) {
+    if (!Buckets[I])
+      continue;
+    if (I == NumBuckets - 1)
+      OS << format("      >= %8" PRIu64 "us: ", uint64_t(1) << (I - 1));
+    else
+      OS << format("      <  %8" PRIu64 "us: ", uint64_t(1) << I);
+    OS << Buckets[I] << "\n";
+  }
+}
+
+MaterializationThreadPool::MaterializationThreadPool(unsigned NumThreads) {
+#if LLVM_ENABLE_THREADS
+  for (unsigned I = 0; I != NumThreads; ++I)
+    Workers.push_back(llvm::make_unique<Worker>());
+  for (unsigned I = 0; I != NumThreads; ++I)
+    Threads.emplace_back([this, I]() { run(I); });
+#endif
+}
+
+MaterializationThreadPool::~MaterializationThreadPool() {
+  {
+    std::lock_guard<std::mutex> Lock(StateMutex);
+    ShuttingDown = true;
+  }
+  WorkAvailable.notify_all();
+  for (auto &T : Threads)
+    T.join();
+}
+
+void MaterializationThreadPool::dispatch(
+    JITDylib &JD, std::unique_ptr<MaterializationUnit> MU,
+    MaterializationPriority Priority) {
+  auto T = std::make_shared<Task>();
+  T->JD = &JD;
+  T->MU = std::move(MU);
+  T->Dispatched = Clock::now();
+
+  // Without threads, materialize on the dispatching thread like the default
+  // dispatcher does.
+  if (Workers.empty()) {
+    materialize(*T);
+    return;
+  }
+
+  unsigned Target = CurrentPool == this
+                        ? CurrentWorker
+                        : NextWorker.fetch_add(1) % Workers.size();
+  T->Worker = Target;
+  {
+    std::lock_guard<std::mutex> Lock(StateMutex);
+    ++NumPending;
+  }
+  if (Priority == MaterializationPriority::Speculative) {
+    std::lock_guard<std::mutex> Lock(SpeculativeMutex);
+    for (auto &KV : T->MU->getSymbols()) {
+      T->Symbols.push_back(KV.first);
+      SpeculativeTasks[{&JD, KV.first}] = T;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> Lock(Workers[Target]->Mutex);
+    Workers[Target]->Queues[getQueueIndex(Priority)].push_back(std::move(T));
+  }
+  {
+    std::lock_guard<std::mutex> Lock(StateMutex);
+    ++NumQueued;
+  }
+  WorkAvailable.notify_one();
+}
+
+void MaterializationThreadPool::promote(JITDylib &JD,
+                                        const SymbolNameSet &Symbols) {
+  std::vector<TaskPtr> Found;
+  {
+    std::lock_guard<std::mutex> Lock(SpeculativeMutex);
+    for (auto &Name : Symbols) {
+      auto I = SpeculativeTasks.find({&JD, Name});
+      if (I != SpeculativeTasks.end())
+        Found.push_back(I->second);
+    }
+  }
+
+  // The task stays in its speculative queue too; whichever copy is reached
+  // first runs it and the other is skipped.
+  for (auto &T : Found) {
+    auto &W = *Workers[T->Worker];
+    std::lock_guard<std::mutex> Lock(W.Mutex);
+    if (T->Taken || T->Promoted)
+      continue;
+    T->Promoted = true;
+    W.Queues[getQueueIndex(MaterializationPriority::Blocking)].push_back(T);
+    ++NumPromoted;
+  }
+}
+
+void MaterializationThreadPool::wait() {
+  std::unique_lock<std::mutex> Lock(StateMutex);
+  AllDone.wait(Lock, [this]() { return NumPending == 0; });
+}
+
+bool MaterializationThreadPool::takeTask(unsigned Self, TaskPtr &T) {
+  auto Take = [&](std::deque<TaskPtr> &Queue, bool FromBack) {
+    while (!Queue.empty()) {
+      TaskPtr Candidate = FromBack ? Queue.back() : Queue.front();
+      if (FromBack)
+        Queue.pop_back();
+      else
+        Queue.pop_front();
+      // Skip the other copy of a promoted task that already ran.
+      if (Candidate->Taken)
+        continue;
+      Candidate->Taken = true;
+      T = std::move(Candidate);
+      return true;
+    }
+    return false;
+  };
+
+  bool Found = false;
+  for (unsigned Q = 0; Q != 2 && !Found; ++Q) {
+    // The newest unit in our own queue is the most likely to be needed by
+    // the work this worker did last.
+    {
+      auto &W = *Workers[Self];
+      std::lock_guard<std::mutex> Lock(W.Mutex);
+      Found = Take(W.Queues[Q], /*FromBack=*/true);
+    }
+
+    // Steal the oldest unit of the same priority from another worker.
+    for (unsigned I = 1, E = Workers.size(); I != E && !Found; ++I) {
+      auto &W = *Workers[(Self + I) % E];
+      std::lock_guard<std::mutex> Lock(W.Mutex);
+      if ((Found = Take(W.Queues[Q], /*FromBack=*/false)))
+        ++NumStolen;
+    }
+  }
+  if (!Found)
+    return false;
+
+  if (!T->Symbols.empty()) {
+    std::lock_guard<std::mutex> Lock(SpeculativeMutex);
+    for (auto &Name : T->Symbols) {
+      auto I = SpeculativeTasks.find({T->JD, Name});
+      if (I != SpeculativeTasks.end() && I->second == T)
+        SpeculativeTasks.erase(I);
+    }
+  }
+  return true;
+}
+
+void MaterializationThreadPool::run(unsigned Self) {
+  CurrentPool = this;
+  CurrentWorker = Self;
+
+  while (true) {
+    TaskPtr T;
+    if (takeTask(Self, T)) {
+      {
+        std::lock_guard<std::mutex> Lock(StateMutex);
+        --NumQueued;
+      }
+      materialize(*T);
+      {
+        std::lock_guard<std::mutex> Lock(StateMutex);
+        if (--NumPending == 0)
+          AllDone.notify_all();
+      }
+      continue;
+    }
+
+    // NumQueued may briefly lag behind the queues in either direction, so
+    // it is only used to decide whether to sleep.
+    std::unique_lock<std::mutex> Lock(StateMutex);
+    WorkAvailable.wait(Lock,
+                       [this]() { return NumQueued > 0 || ShuttingDown; });
+    if (ShuttingDown && NumQueued <= 0)
+      return;
+  }
+}
+
+void MaterializationThreadPool::materialize(Task &T) {
+  std::string Name = T.MU->getName();
+  auto Started = Clock::now();
+  T.MU->doMaterialize(*T.JD);
+  T.MU.reset();
+  auto Finished = Clock::now();
+
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  std::lock_guard<std::mutex> Lock(LatenciesMutex);
+  auto &L = Latencies[Name];
+  L.Queued.add(duration_cast<microseconds>(Started - T.Dispatched));
+  L.Materializing.add(duration_cast<microseconds>(Finished - Started));
+}
+
+StringMap<MaterializationThreadPool::UnitLatencies>
+MaterializationThreadPool::getLatencies() const {
+  std::lock_guard<std::mutex> Lock(LatenciesMutex);
+  return Latencies;
+}
+
+void MaterializationThreadPool::printLatencies(raw_ostream &OS) const {
+  auto Snapshot = getLatencies();
+  std::vector<StringRef> Names;
+  for (auto &KV : Snapshot)
+    Names.push_back(KV.first());
+  llvm::sort(Names);
+
+  OS << "Materialization latencies (" << Workers.size() << " workers, "
+     << getNumStolen() << " units stolen):\n";
+  for (StringRef Name : Names) {
+    auto &L = Snapshot[Name];
+    OS << "  " << Name << "\n    queued:        ";
+    L.Queued.print(OS);
+    OS << "    materializing: ";
+    L.Materializing.print(OS);
+  }
+}
@@ -81,7 +81,13 @@ RTDyldObjectLinkingLayer::RTDyldObjectLinkingLayer(
     NotifyLoadedFunction NotifyLoaded, NotifyEmittedFunction NotifyEmitted)
     : ObjectLayer(ES), GetMemoryManager(GetMemoryManager),
       NotifyLoaded(std::move(NotifyLoaded)),
-      NotifyEmitted(std::move(NotifyEmitted)) {}
+      NotifyEmitted(std::move(NotifyEmitted)) {
+  ES.registerResourceManager(*this);
+}
+
+RTDyldObjectLinkingLayer::~RTDyldObjectLinkingLayer() {
+  getExecutionSession().deregisterResourceManager(*this);
+}
 
 void RTDyldObjectLinkingLayer::emit(MaterializationResponsibility R,
                                     std::unique_ptr<MemoryBuffer> O) {
@@ -127,6 +133,7 @@ void RTDyldObjectLinkingLayer::emit(MaterializationResponsibility R,
   {
     auto Tmp = GetMemoryManager();
     std::lock_guard<std::mutex> Lock(RTDyldLayerMutex);
+    auto &MemMgrs = Resources[K].MemMgrs;
     MemMgrs.push_back(std::move(Tmp));
     MemMgr = MemMgrs.back().get();
   }
@@ -190,6 +197,15 @@ Error RTDyldObjectLinkingLayer::onObjLoad(
 
   R.resolve(Symbols);
 
+  uint64_t Size = 0;
+  for (auto &Sec : Obj.sections())
+    if (LoadedObjInfo->getSectionLoadAddress(Sec))
+      Size += Sec.getSize();
+  {
+    std::lock_guard<std::mutex> Lock(RTDyldLayerMutex);
+    Resources[K].Size += Size;
+  }
+
   if (NotifyLoaded)
     NotifyLoaded(K, Obj, *LoadedObjInfo);
 
@@ -211,5 +227,30 @@ void RTDyldObjectLinkingLayer::onObjEmit(VModuleKey K,
     NotifyEmitted(K);
 }
 
+Error RTDyldObjectLinkingLayer::removeResources(VModuleKey K) {
+  ModuleResources Removed;
+  {
+    std::lock_guard<std::mutex> Lock(RTDyldLayerMutex);
+    auto I = Resources.find(K);
+    if (I == Resources.end())
+      return Error::success();
+    Removed = std::move(I->second);
+    Resources.erase(I);
+  }
+
+  // Destroying the memory managers releases the memory, but leaves the EH
+  // frames registered.
+  for (auto &MemMgr : Removed.MemMgrs)
+    MemMgr->deregisterEHFrames();
+
+  return Error::success();
+}
+
+uint64_t RTDyldObjectLinkingLayer::getResourceSize(VModuleKey K) const {
+  std::lock_guard<std::mutex> Lock(RTDyldLayerMutex);
+  auto I = Resources.find(K);
+  return I != Resources.end() ? I->second.Size : 0;
+}
+
 } // End namespace orc.
 } // End namespace llvm.
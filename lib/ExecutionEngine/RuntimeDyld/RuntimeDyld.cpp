@@ -15,6 +15,7 @@
 #include "RuntimeDyldELF.h"
 #include "RuntimeDyldImpl.h"
 #include "RuntimeDyldMachO.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Object/COFF.h"
 #include "llvm/Object/ELFObjectFile.h"
 #include "llvm/Support/MSVCErrorWorkarounds.h"
@@ -22,6 +23,8 @@
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/MutexGuard.h"
 
+#include <atomic>
+#include <chrono>
 #include <future>
 
 using namespace llvm;
@@ -29,8 +32,20 @@ using namespace llvm::object;
 
 #define DEBUG_TYPE "dyld"
 
+STATISTIC(NumRelocationsApplied, "Number of relocations applied");
+STATISTIC(NumExternalSymbolsResolved,
+          "Number of external symbols relocations were resolved against");
+STATISTIC(NumSymbolLookups, "Number of external symbol lookups");
+
 namespace {
 
+// Process-wide totals behind RuntimeDyld::getRelocationStats. Unlike the
+// statistics above these are kept in release builds too.
+std::atomic<uint64_t> TotalRelocations(0);
+std::atomic<uint64_t> TotalExternalSymbols(0);
+std::atomic<uint64_t> TotalLookups(0);
+std::atomic<uint64_t> TotalApplyNanoseconds(0);
+
 enum RuntimeDyldErrorCode {
   GenericRTDyldError = 1
 };
@@ -149,9 +164,9 @@ void RuntimeDyldImpl::resolveLocalRelocations() {
     uint64_t Addr = Sections[Idx].getLoadAddress();
     LLVM_DEBUG(dbgs() << "Resolving relocations Section #" << Idx << "\t"
                       << format("%p", (uintptr_t)Addr) << "\n");
-    resolveRelocationList(it->second, Addr);
+    queueRelocationList(it->second, Addr);
   }
-  Relocations.clear();
+  applyPendingRelocations();
 }
 
 void RuntimeDyldImpl::mapSectionAddress(const void *LocalAddress,
@@ -1032,79 +1047,110 @@ void RuntimeDyldImpl::reassignSectionAddress(unsigned SectionID,
   Sections[SectionID].setLoadAddress(Addr);
 }
 
-void RuntimeDyldImpl::resolveRelocationList(const RelocationList &Relocs,
-                                            uint64_t Value) {
+void RuntimeDyldImpl::queueRelocationList(const RelocationList &Relocs,
+                                          uint64_t Value) {
   for (unsigned i = 0, e = Relocs.size(); i != e; ++i) {
     const RelocationEntry &RE = Relocs[i];
     // Ignore relocations for sections that were not loaded
     if (Sections[RE.SectionID].getAddress() == nullptr)
       continue;
-    resolveRelocation(RE, Value);
+    PendingRelocations.push_back({&RE, Value});
   }
 }
 
-void RuntimeDyldImpl::applyExternalSymbolRelocations(
-    const StringMap<JITEvaluatedSymbol> ExternalSymbolMap) {
-  while (!ExternalSymbolRelocations.empty()) {
+void RuntimeDyldImpl::applyPendingRelocations() {
+  auto Start = std::chrono::steady_clock::now();
+
+  // Group the relocations by the section they patch, so that each section is
+  // written in one pass and the format picks its resolver once per section.
+  // The sort is stable: relocations that patch the same section are applied
+  // in the order they were queued.
+  std::stable_sort(PendingRelocations.begin(), PendingRelocations.end(),
+                   [](const PendingRelocation &LHS,
+                      const PendingRelocation &RHS) {
+                     return LHS.RE->SectionID < RHS.RE->SectionID;
+                   });
+
+  ArrayRef<PendingRelocation> Pending(PendingRelocations);
+  while (!Pending.empty()) {
+    unsigned SectionID = Pending.front().RE->SectionID;
+    size_t RunSize = 1;
+    while (RunSize != Pending.size() &&
+           Pending[RunSize].RE->SectionID == SectionID)
+      ++RunSize;
+    resolveRelocationRun(SectionID, Pending.take_front(RunSize));
+    Pending = Pending.drop_front(RunSize);
+  }
+
+  auto Elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - Start);
+  NumRelocationsApplied += PendingRelocations.size();
+  TotalRelocations += PendingRelocations.size();
+  TotalApplyNanoseconds += Elapsed.count();
+
+  PendingRelocations.clear();
+  ExternalSymbolRelocations.clear();
+  Relocations.clear();
+}
 
-    StringMap<RelocationList>::iterator i = ExternalSymbolRelocations.begin();
+void RuntimeDyldImpl::resolveRelocationRun(unsigned SectionID,
+                                           ArrayRef<PendingRelocation> Relocs) {
+  for (const PendingRelocation &PR : Relocs)
+    resolveRelocation(*PR.RE, PR.Value);
+}
 
-    StringRef Name = i->first();
+void RuntimeDyldImpl::applyExternalSymbolRelocations(
+    const StringMap<JITEvaluatedSymbol> ExternalSymbolMap) {
+  // All lookups have been made by now, so no new relocations can appear while
+  // the map is walked. The lists are cleared by applyPendingRelocations.
+  for (auto &RelocKV : ExternalSymbolRelocations) {
+    StringRef Name = RelocKV.first();
+    const RelocationList &Relocs = RelocKV.second;
     if (Name.size() == 0) {
       // This is an absolute symbol, use an address of zero.
       LLVM_DEBUG(dbgs() << "Resolving absolute relocations."
                         << "\n");
-      RelocationList &Relocs = i->second;
-      resolveRelocationList(Relocs, 0);
-    } else {
-      uint64_t Addr = 0;
-      JITSymbolFlags Flags;
-      RTDyldSymbolTable::const_iterator Loc = GlobalSymbolTable.find(Name);
-      if (Loc == GlobalSymbolTable.end()) {
-        auto RRI = ExternalSymbolMap.find(Name);
-        assert(RRI != ExternalSymbolMap.end() && "No result for symbol");
-        Addr = RRI->second.getAddress();
-        Flags = RRI->second.getFlags();
-        // The call to getSymbolAddress may have caused additional modules to
-        // be loaded, which may have added new entries to the
-        // ExternalSymbolRelocations map.  Consquently, we need to update our
-        // iterator.  This is also why retrieval of the relocation list
-        // associated with this symbol is deferred until below this point.
-        // New entries may have been added to the relocation list.
-        i = ExternalSymbolRelocations.find(Name);
-      } else {
-        // We found the symbol in our global table.  It was probably in a
-        // Module that we loaded previously.
-        const auto &SymInfo = Loc->second;
-        Addr = getSectionLoadAddress(SymInfo.getSectionID()) +
-               SymInfo.getOffset();
-        Flags = SymInfo.getFlags();
-      }
+      queueRelocationList(Relocs, 0);
+      continue;
+    }
 
-      // FIXME: Implement error handling that doesn't kill the host program!
-      if (!Addr)
-        report_fatal_error("Program used external function '" + Name +
-                           "' which could not be resolved!");
-
-      // If Resolver returned UINT64_MAX, the client wants to handle this symbol
-      // manually and we shouldn't resolve its relocations.
-      if (Addr != UINT64_MAX) {
-
-        // Tweak the address based on the symbol flags if necessary.
-        // For example, this is used by RuntimeDyldMachOARM to toggle the low bit
-        // if the target symbol is Thumb.
-        Addr = modifyAddressBasedOnFlags(Addr, Flags);
-
-        LLVM_DEBUG(dbgs() << "Resolving relocations Name: " << Name << "\t"
-                          << format("0x%lx", Addr) << "\n");
-        // This list may have been updated when we called getSymbolAddress, so
-        // don't change this code to get the list earlier.
-        RelocationList &Relocs = i->second;
-        resolveRelocationList(Relocs, Addr);
-      }
+    uint64_t Addr = 0;
+    JITSymbolFlags Flags;
+    RTDyldSymbolTable::const_iterator Loc = GlobalSymbolTable.find(Name);
+    if (Loc == GlobalSymbolTable.end()) {
+      auto RRI = ExternalSymbolMap.find(Name);
+      assert(RRI != ExternalSymbolMap.end() && "No result for symbol");
+      Addr = RRI->second.getAddress();
+      Flags = RRI->second.getFlags();
+    } else {
+      // We found the symbol in our global table.  It was probably in a
+      // Module that we loaded previously.
+      const auto &SymInfo = Loc->second;
+      Addr = getSectionLoadAddress(SymInfo.getSectionID()) +
+             SymInfo.getOffset();
+      Flags = SymInfo.getFlags();
     }
 
-    ExternalSymbolRelocations.erase(i);
+    // FIXME: Implement error handling that doesn't kill the host program!
+    if (!Addr)
+      report_fatal_error("Program used external function '" + Name +
+                         "' which could not be resolved!");
+
+    // If Resolver returned UINT64_MAX, the client wants to handle this symbol
+    // manually and we shouldn't resolve its relocations.
+    if (Addr == UINT64_MAX)
+      continue;
+
+    // Tweak the address based on the symbol flags if necessary.
+    // For example, this is used by RuntimeDyldMachOARM to toggle the low bit
+    // if the target symbol is Thumb.
+    Addr = modifyAddressBasedOnFlags(Addr, Flags);
+
+    LLVM_DEBUG(dbgs() << "Resolving relocations Name: " << Name << "\t"
+                      << format("0x%lx", Addr) << "\n");
+    ++NumExternalSymbolsResolved;
+    ++TotalExternalSymbols;
+    queueRelocationList(Relocs, Addr);
   }
 }
 
@@ -1136,6 +1182,8 @@ Error RuntimeDyldImpl::resolveExternalSymbols() {
       using ExpectedLookupResult = Expected<JITSymbolResolver::LookupResult>;
 #endif
 
+      ++NumSymbolLookups;
+      ++TotalLookups;
       auto NewSymbolsP = std::make_shared<std::promise<ExpectedLookupResult>>();
       auto NewSymbolsF = NewSymbolsP->get_future();
       Resolver.lookup(NewSymbols,
@@ -1186,6 +1234,8 @@ void RuntimeDyldImpl::finalizeAsync(
         for (auto &KV : *Result)
           Resolved[KV.first] = KV.second;
 
+        // Queue the relocations against external symbols ahead of the local
+        // ones, then apply both in one pass.
         SharedThis->applyExternalSymbolRelocations(Resolved);
         SharedThis->resolveLocalRelocations();
         SharedThis->registerEHFrames();
@@ -1209,6 +1259,8 @@ void RuntimeDyldImpl::finalizeAsync(
   }
 
   if (!Symbols.empty()) {
+    ++NumSymbolLookups;
+    ++TotalLookups;
     SharedThis->Resolver.lookup(Symbols, PostResolveContinuation);
   } else
     PostResolveContinuation(std::map<StringRef, JITEvaluatedSymbol>());
@@ -1348,6 +1400,25 @@ bool RuntimeDyld::hasError() { return Dyld->hasError(); }
 
 StringRef RuntimeDyld::getErrorString() { return Dyld->getErrorString(); }
 
+RuntimeDyld::RelocationStats RuntimeDyld::getRelocationStats() {
+  RelocationStats S;
+  S.NumRelocations = TotalRelocations;
+  S.NumExternalSymbols = TotalExternalSymbols;
+  S.NumLookups = TotalLookups;
+  S.ApplyNanoseconds = TotalApplyNanoseconds;
+  return S;
+}
+
+void RuntimeDyld::printRelocationStats(raw_ostream &OS) {
+  RelocationStats S = getRelocationStats();
+  OS << "RuntimeDyld: " << S.NumRelocations << " relocations applied in "
+     << format("%.3f", S.ApplyNanoseconds / 1e6) << " ms";
+  if (S.ApplyNanoseconds)
+    OS << format(" (%.1f M/s)", S.NumRelocations * 1e3 / S.ApplyNanoseconds);
+  OS << "\n  " << S.NumExternalSymbols << " external symbols resolved in "
+     << S.NumLookups << " lookups\n";
+}
+
 void RuntimeDyld::finalizeWithMemoryManagerLocking() {
   bool MemoryFinalizationLocked = MemMgr.FinalizationLocked;
   MemMgr.FinalizationLocked = true;
@@ -920,6 +920,29 @@ void RuntimeDyldELF::resolveRelocation(const RelocationEntry &RE,
                            RE.SymOffset, RE.SectionID);
 }
 
+void RuntimeDyldELF::resolveRelocationRun(
+    unsigned SectionID, ArrayRef<PendingRelocation> Relocs) {
+  // Switch on the architecture once for the whole run on the common JIT
+  // hosts, rather than once per relocation.
+  const SectionEntry &Section = Sections[SectionID];
+  switch (Arch) {
+  case Triple::x86_64:
+    for (const PendingRelocation &PR : Relocs)
+      resolveX86_64Relocation(Section, PR.RE->Offset, PR.Value,
+                              PR.RE->RelType, PR.RE->Addend, PR.RE->SymOffset);
+    break;
+  case Triple::aarch64:
+  case Triple::aarch64_be:
+    for (const PendingRelocation &PR : Relocs)
+      resolveAArch64Relocation(Section, PR.RE->Offset, PR.Value,
+                               PR.RE->RelType, PR.RE->Addend);
+    break;
+  default:
+    RuntimeDyldImpl::resolveRelocationRun(SectionID, Relocs);
+    break;
+  }
+}
+
 void RuntimeDyldELF::resolveRelocation(const SectionEntry &Section,
                                        uint64_t Offset, uint64_t Value,
                                        uint32_t Type, int64_t Addend,
@@ -173,6 +173,8 @@ public:
   loadObject(const object::ObjectFile &O) override;
 
   void resolveRelocation(const RelocationEntry &RE, uint64_t Value) override;
+  void resolveRelocationRun(unsigned SectionID,
+                            ArrayRef<PendingRelocation> Relocs) override;
   Expected<relocation_iterator>
   processRelocationRef(unsigned SectionID, relocation_iterator RelI,
                        const ObjectFile &Obj,
@@ -13,6 +13,7 @@
 #ifndef LLVM_LIB_EXECUTIONENGINE_RUNTIMEDYLD_RUNTIMEDYLDIMPL_H
 #define LLVM_LIB_EXECUTIONENGINE_RUNTIMEDYLD_RUNTIMEDYLDIMPL_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/Triple.h"
@@ -29,6 +30,7 @@
 #include <map>
 #include <system_error>
 #include <unordered_map>
+#include <vector>
 
 using namespace llvm;
 using namespace llvm::object;
@@ -283,6 +285,15 @@ protected:
   // modules.  This map is indexed by symbol name.
   StringMap<RelocationList> ExternalSymbolRelocations;
 
+  // A relocation whose target value is known, waiting to be applied. The
+  // entry stays owned by Relocations or ExternalSymbolRelocations until the
+  // queue has been applied.
+  struct PendingRelocation {
+    const RelocationEntry *RE;
+    uint64_t Value;
+  };
+  std::vector<PendingRelocation> PendingRelocations;
+
 
   typedef std::map<RelocationValueRef, uintptr_t> StubMap;
 
@@ -407,14 +418,25 @@ protected:
   /// \return Pointer to the memory area for emitting target address.
   uint8_t *createStubFunction(uint8_t *Addr, unsigned AbiVariant = 0);
 
-  /// Resolves relocations from Relocs list with address from Value.
-  void resolveRelocationList(const RelocationList &Relocs, uint64_t Value);
+  /// Queues the relocations from Relocs list, with address from Value, to be
+  /// applied by applyPendingRelocations.
+  void queueRelocationList(const RelocationList &Relocs, uint64_t Value);
+
+  /// Applies the queued relocations section by section, and clears the
+  /// relocation lists they came from.
+  void applyPendingRelocations();
 
   /// A object file specific relocation resolver
   /// \param RE The relocation to be resolved
   /// \param Value Target symbol address to apply the relocation action
   virtual void resolveRelocation(const RelocationEntry &RE, uint64_t Value) = 0;
 
+  /// Applies a run of relocations that all patch the section SectionID. The
+  /// default calls resolveRelocation for each one; formats override it to
+  /// pick the target-specific resolver once for the whole run.
+  virtual void resolveRelocationRun(unsigned SectionID,
+                                    ArrayRef<PendingRelocation> Relocs);
+
   /// Parses one or more object file relocations (some object files use
   ///        relocation pairs) and stores it to Relocations or SymbolRelocations
   ///        (this depends on the object file type).
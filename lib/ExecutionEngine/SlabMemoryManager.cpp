@@ -0,0 +1,385 @@
+//===- SlabMemoryManager.cpp - Slab-based memory manager for RtDyld -------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the slab-based memory manager for RuntimeDyld.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/SlabMemoryManager.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace llvm {
+
+constexpr size_t JITSlabAllocator::HugePageSize;
+
+JITSlabAllocator::JITSlabAllocator(Options Opts,
+                                   SectionMemoryManager::MemoryMapper *MM)
+    : Opts(Opts), MMapper(MM), PageSize(sys::Process::getPageSize()) {}
+
+JITSlabAllocator::~JITSlabAllocator() {
+  assert(NumMemoryManagers == 0 &&
+         "JITSlabAllocator destroyed before its memory managers");
+  for (Pool *P : {&CodePool, &DataPool})
+    for (sys::MemoryBlock &Slab : P->Slabs) {
+      if (MMapper)
+        MMapper->releaseMappedMemory(Slab);
+      else
+        sys::Memory::releaseMappedMemory(Slab);
+    }
+}
+
+std::unique_ptr<RuntimeDyld::MemoryManager>
+JITSlabAllocator::createMemoryManager() {
+  return llvm::make_unique<SlabMemoryManager>(*this);
+}
+
+sys::MemoryBlock JITSlabAllocator::allocate(AllocationPurpose Purpose,
+                                            size_t Size, std::error_code &EC) {
+  EC = std::error_code();
+  Size = alignTo(Size, PageSize);
+
+  std::lock_guard<std::mutex> Lock(AllocatorMutex);
+  Pool &P = getPool(Purpose);
+
+  // Reuse memory that was given back, lowest address first.
+  for (auto I = P.FreeRanges.begin(), E = P.FreeRanges.end(); I != E; ++I) {
+    if (I->second < Size)
+      continue;
+    uintptr_t Start = I->first;
+    size_t Remaining = I->second - Size;
+    P.FreeRanges.erase(I);
+    if (Remaining)
+      P.FreeRanges[Start + Size] = Remaining;
+    ReservedBytes += Size;
+    return sys::MemoryBlock(reinterpret_cast<void *>(Start), Size);
+  }
+
+  if (P.End - P.Cur < Size) {
+    size_t Granularity = Opts.UseHugePages ? HugePageSize : PageSize;
+    size_t SlabSize = alignTo(std::max(Opts.SlabSize, Size), Granularity);
+    unsigned Flags = sys::Memory::MF_READ | sys::Memory::MF_WRITE;
+
+    // Mappings are only page aligned, so map an extra huge page to be able to
+    // align the slab to a huge page boundary. The hint is only passed on where
+    // it becomes transparent huge page advice; on Windows it would request
+    // locked large pages instead.
+    size_t MapSize = SlabSize;
+    if (Opts.UseHugePages) {
+#ifdef LLVM_ON_UNIX
+      Flags |= sys::Memory::MF_HUGE_HINT;
+#endif
+      MapSize += HugePageSize;
+    }
+
+    sys::MemoryBlock Slab =
+        MMapper ? MMapper->allocateMappedMemory(Purpose, MapSize, nullptr,
+                                                Flags, EC)
+                : sys::Memory::allocateMappedMemory(MapSize, nullptr, Flags,
+                                                    EC);
+    if (EC)
+      return sys::MemoryBlock();
+    P.Slabs.push_back(Slab);
+
+    // Keep what is left of the previous slab for later requests.
+    uintptr_t OldCur = P.Cur, OldEnd = P.End;
+    P.Cur = alignTo(reinterpret_cast<uintptr_t>(Slab.base()), Granularity);
+    P.End = P.Cur + SlabSize;
+    if (OldCur != OldEnd)
+      addFreeRange(P, OldCur, OldEnd - OldCur);
+  }
+
+  uintptr_t Start = P.Cur;
+  P.Cur += Size;
+  ReservedBytes += Size;
+  return sys::MemoryBlock(reinterpret_cast<void *>(Start), Size);
+}
+
+void JITSlabAllocator::addFreeRange(Pool &P, uintptr_t Start, size_t Size) {
+  auto Next = P.FreeRanges.lower_bound(Start);
+  if (Next != P.FreeRanges.end() && Next->first == Start + Size) {
+    Size += Next->second;
+    Next = P.FreeRanges.erase(Next);
+  }
+  if (Next != P.FreeRanges.begin()) {
+    auto Prev = std::prev(Next);
+    if (Prev->first + Prev->second == Start) {
+      Start = Prev->first;
+      Size += Prev->second;
+      P.FreeRanges.erase(Prev);
+    }
+  }
+
+  // Ranges just below the slab tail become part of it again, which keeps code
+  // packed in address order.
+  if (Start + Size == P.Cur) {
+    P.Cur = Start;
+    return;
+  }
+  P.FreeRanges[Start] = Size;
+}
+
+void JITSlabAllocator::release(AllocationPurpose Purpose,
+                               sys::MemoryBlock Block, bool Protected) {
+  assert(Block.size() % PageSize == 0 && "Released range is not page-sized");
+
+  // Memory that can not be made writable again is not reused.
+  if (Protected &&
+      protect(Block, sys::Memory::MF_READ | sys::Memory::MF_WRITE)) {
+    std::lock_guard<std::mutex> Lock(AllocatorMutex);
+    ReservedBytes -= Block.size();
+    return;
+  }
+
+  std::lock_guard<std::mutex> Lock(AllocatorMutex);
+  ReservedBytes -= Block.size();
+  addFreeRange(getPool(Purpose), reinterpret_cast<uintptr_t>(Block.base()),
+               Block.size());
+}
+
+std::error_code JITSlabAllocator::protect(const sys::MemoryBlock &Block,
+                                          unsigned Flags) {
+  ++NumProtectionChanges;
+  if (MMapper)
+    return MMapper->protectMappedMemory(Block, Flags);
+  return sys::Memory::protectMappedMemory(Block, Flags);
+}
+
+JITSlabAllocator::Stats JITSlabAllocator::getStats() const {
+  std::lock_guard<std::mutex> Lock(AllocatorMutex);
+  Stats S;
+  for (const Pool *P : {&CodePool, &DataPool}) {
+    S.NumSlabs += P->Slabs.size();
+    for (const sys::MemoryBlock &Slab : P->Slabs)
+      S.SlabBytes += Slab.size();
+    for (auto &KV : P->FreeRanges) {
+      S.FreeBytes += KV.second;
+      S.LargestFreeRange = std::max<uint64_t>(S.LargestFreeRange, KV.second);
+    }
+    S.NumFreeRanges += P->FreeRanges.size();
+    S.SlabTailBytes += P->End - P->Cur;
+  }
+  S.NumMemoryManagers = NumMemoryManagers;
+  S.ReservedBytes = ReservedBytes;
+  S.SectionBytes = SectionBytes;
+  S.NumFinalizations = NumFinalizations;
+  S.NumProtectionChanges = NumProtectionChanges;
+  return S;
+}
+
+void JITSlabAllocator::printStats(raw_ostream &OS) const {
+  Stats S = getStats();
+  OS << "JIT slab allocator: " << S.NumSlabs << " slabs, " << S.SlabBytes
+     << " bytes mapped" << (Opts.UseHugePages ? " (huge pages)" : "") << "\n";
+  OS << "  " << S.NumMemoryManagers << " memory managers hold "
+     << S.ReservedBytes << " bytes, " << S.SectionBytes
+     << " bytes in finalized sections\n";
+  OS << "  free: " << S.FreeBytes << " bytes in " << S.NumFreeRanges
+     << " ranges (largest " << S.LargestFreeRange << "), slab tails: "
+     << S.SlabTailBytes << " bytes\n";
+  OS << "  " << S.NumFinalizations << " finalizations, "
+     << S.NumProtectionChanges << " protection changes\n";
+}
+
+SlabMemoryManager::SlabMemoryManager(JITSlabAllocator &Slabs) : Slabs(Slabs) {
+  std::lock_guard<std::mutex> Lock(Slabs.AllocatorMutex);
+  ++Slabs.NumMemoryManagers;
+}
+
+SlabMemoryManager::~SlabMemoryManager() {
+  for (MemoryGroup *Group : {&CodeMem, &RODataMem, &RWDataMem}) {
+    // Read-write data keeps its permissions when finalized.
+    bool NeedsUnprotect = Group != &RWDataMem;
+    for (unsigned I = 0, E = Group->Ranges.size(); I != E; ++I)
+      Slabs.release(getPurpose(*Group), Group->Ranges[I],
+                    NeedsUnprotect && I < Group->FirstPending);
+  }
+
+  std::lock_guard<std::mutex> Lock(Slabs.AllocatorMutex);
+  --Slabs.NumMemoryManagers;
+  Slabs.SectionBytes -= FinalizedSectionBytes;
+}
+
+JITSlabAllocator::AllocationPurpose
+SlabMemoryManager::getPurpose(const MemoryGroup &MemGroup) const {
+  if (&MemGroup == &CodeMem)
+    return JITSlabAllocator::AllocationPurpose::Code;
+  if (&MemGroup == &RODataMem)
+    return JITSlabAllocator::AllocationPurpose::ROData;
+  return JITSlabAllocator::AllocationPurpose::RWData;
+}
+
+void SlabMemoryManager::reserveAllocationSpace(
+    uintptr_t CodeSize, uint32_t CodeAlign, uintptr_t RODataSize,
+    uint32_t RODataAlign, uintptr_t RWDataSize, uint32_t RWDataAlign) {
+  reserve(CodeMem, CodeSize, CodeAlign);
+  reserve(RODataMem, RODataSize, RODataAlign);
+  reserve(RWDataMem, RWDataSize, RWDataAlign);
+}
+
+void SlabMemoryManager::reserve(MemoryGroup &MemGroup, uintptr_t Size,
+                                unsigned Alignment) {
+  if (!Size)
+    return;
+  if (!Alignment)
+    Alignment = 16;
+
+  // The sizes computed by RuntimeDyld include the padding between sections,
+  // but not the padding needed to align the first one. If the reservation
+  // fails, sections are allocated one range at a time instead.
+  uintptr_t Addr = alignTo(MemGroup.Cur, Alignment);
+  if (!MemGroup.End || Addr + Size > MemGroup.End)
+    obtainRange(MemGroup, Size + Alignment);
+}
+
+bool SlabMemoryManager::obtainRange(MemoryGroup &MemGroup, uintptr_t Size) {
+  trimCurrentRange(MemGroup);
+
+  std::error_code EC;
+  sys::MemoryBlock Block = Slabs.allocate(getPurpose(MemGroup), Size, EC);
+  if (EC)
+    return false;
+
+  uintptr_t Start = reinterpret_cast<uintptr_t>(Block.base());
+  uintptr_t End = Start + Block.size();
+
+  // The allocator usually hands out the pages right after the previous range,
+  // which then simply grows.
+  if (MemGroup.Ranges.size() > MemGroup.FirstPending) {
+    sys::MemoryBlock &Last = MemGroup.Ranges.back();
+    uintptr_t LastStart = reinterpret_cast<uintptr_t>(Last.base());
+    if (LastStart + Last.size() == Start) {
+      if (!MemGroup.End)
+        MemGroup.Cur = Start;
+      Last = sys::MemoryBlock(Last.base(), End - LastStart);
+      MemGroup.End = End;
+      return true;
+    }
+  }
+
+  MemGroup.Ranges.push_back(Block);
+  MemGroup.Cur = Start;
+  MemGroup.End = End;
+  return true;
+}
+
+void SlabMemoryManager::trimCurrentRange(MemoryGroup &MemGroup) {
+  if (!MemGroup.End)
+    return;
+  assert(MemGroup.Ranges.size() > MemGroup.FirstPending &&
+         "Allocating from memory that was finalized");
+
+  // Give the pages that no section was allocated in back to the allocator.
+  sys::MemoryBlock &Last = MemGroup.Ranges.back();
+  uintptr_t Start = reinterpret_cast<uintptr_t>(Last.base());
+  uintptr_t UsedEnd = alignTo(MemGroup.Cur, Slabs.PageSize);
+  if (UsedEnd < MemGroup.End)
+    Slabs.release(getPurpose(MemGroup),
+                  sys::MemoryBlock(reinterpret_cast<void *>(UsedEnd),
+                                   MemGroup.End - UsedEnd),
+                  false);
+
+  if (UsedEnd == Start) {
+    MemGroup.Ranges.pop_back();
+    MemGroup.Cur = MemGroup.End = 0;
+    return;
+  }
+  Last = sys::MemoryBlock(Last.base(), UsedEnd - Start);
+  MemGroup.End = UsedEnd;
+}
+
+uint8_t *SlabMemoryManager::allocateCodeSection(uintptr_t Size,
+                                                unsigned Alignment,
+                                                unsigned SectionID,
+                                                StringRef SectionName) {
+  return allocateSection(CodeMem, Size, Alignment);
+}
+
+uint8_t *SlabMemoryManager::allocateDataSection(uintptr_t Size,
+                                                unsigned Alignment,
+                                                unsigned SectionID,
+                                                StringRef SectionName,
+                                                bool IsReadOnly) {
+  return allocateSection(IsReadOnly ? RODataMem : RWDataMem, Size, Alignment);
+}
+
+uint8_t *SlabMemoryManager::allocateSection(MemoryGroup &MemGroup,
+                                            uintptr_t Size,
+                                            unsigned Alignment) {
+  if (!Alignment)
+    Alignment = 16;
+
+  assert(!(Alignment & (Alignment - 1)) && "Alignment must be a power of two.");
+
+  uintptr_t Addr = alignTo(MemGroup.Cur, Alignment);
+  if (!MemGroup.End || Addr + Size > MemGroup.End) {
+    if (!obtainRange(MemGroup, Size + Alignment))
+      return nullptr;
+    Addr = alignTo(MemGroup.Cur, Alignment);
+  }
+
+  MemGroup.Cur = Addr + Size;
+  SectionBytes += Size;
+  return reinterpret_cast<uint8_t *>(Addr);
+}
+
+std::error_code
+SlabMemoryManager::applyMemoryGroupPermissions(MemoryGroup &MemGroup,
+                                               unsigned Permissions) {
+  // Ranges are page aligned and usually adjacent, so permissions are changed
+  // once per run of adjacent ranges.
+  auto &Ranges = MemGroup.Ranges;
+  for (unsigned I = MemGroup.FirstPending, E = Ranges.size(); I != E;) {
+    uintptr_t Start = reinterpret_cast<uintptr_t>(Ranges[I].base());
+    uintptr_t End = Start + Ranges[I].size();
+    for (++I; I != E && reinterpret_cast<uintptr_t>(Ranges[I].base()) == End;
+         ++I)
+      End += Ranges[I].size();
+
+    // protectMappedMemory invalidates the instruction cache for executable
+    // ranges.
+    sys::MemoryBlock Run(reinterpret_cast<void *>(Start), End - Start);
+    if (std::error_code EC = Slabs.protect(Run, Permissions))
+      return EC;
+  }
+
+  MemGroup.FirstPending = Ranges.size();
+  return std::error_code();
+}
+
+bool SlabMemoryManager::finalizeMemory(std::string *ErrMsg) {
+  // Sections allocated from now on go to pages that are still writable.
+  for (MemoryGroup *Group : {&CodeMem, &RODataMem, &RWDataMem}) {
+    trimCurrentRange(*Group);
+    Group->Cur = Group->End = 0;
+  }
+
+  std::error_code EC = applyMemoryGroupPermissions(
+      CodeMem, sys::Memory::MF_READ | sys::Memory::MF_EXEC);
+  if (!EC)
+    EC = applyMemoryGroupPermissions(RODataMem, sys::Memory::MF_READ);
+  if (EC) {
+    if (ErrMsg)
+      *ErrMsg = EC.message();
+    return true;
+  }
+
+  // Read-write data memory already has the correct permissions.
+  RWDataMem.FirstPending = RWDataMem.Ranges.size();
+
+  std::lock_guard<std::mutex> Lock(Slabs.AllocatorMutex);
+  ++Slabs.NumFinalizations;
+  Slabs.SectionBytes += SectionBytes - FinalizedSectionBytes;
+  FinalizedSectionBytes = SectionBytes;
+  return false;
+}
+
+} // namespace llvm
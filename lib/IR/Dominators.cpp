@@ -366,6 +366,10 @@ bool DominatorTreeWrapperPass::runOnFunction(Function &F) {
 }
 
 void DominatorTreeWrapperPass::verifyAnalysis() const {
+  // Deferred updates are verified once the tree is flushed, before the next
+  // pass gets it.
+  if (DT.hasDeferredUpdates())
+    return;
   if (VerifyDomInfo)
     assert(DT.verify(DominatorTree::VerificationLevel::Full));
   else if (ExpensiveChecksEnabled)
@@ -31,11 +31,13 @@
 #include "llvm/MC/MCSymbol.h"
 #include "llvm/MC/MCValue.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/LEB128.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <cstring>
@@ -67,6 +69,11 @@ STATISTIC(FragmentLayouts, "Number of fragment layouts");
 STATISTIC(ObjectBytes, "Number of emitted object file bytes");
 STATISTIC(RelaxationSteps, "Number of assembler layout and relaxation steps");
 STATISTIC(RelaxedInstructions, "Number of relaxed instructions");
+STATISTIC(RelaxationRounds, "Number of section relaxation rounds");
+STATISTIC(RelaxedFragments, "Number of relaxed fragments");
+STATISTIC(CheckedFragments, "Number of fragments checked for relaxation");
+STATISTIC(SkippedFragmentChecks,
+          "Number of relaxation checks skipped by the dependency index");
 STATISTIC(PaddingFragmentsRelaxations,
           "Number of Padding Fragments relaxations");
 STATISTIC(PaddingFragmentsBytes,
@@ -75,6 +82,11 @@ STATISTIC(PaddingFragmentsBytes,
 } // end namespace stats
 } // end anonymous namespace
 
+static cl::opt<bool> IncrementalRelaxation(
+    "mc-incremental-relaxation", cl::Hidden, cl::init(true),
+    cl::desc("Only revisit fragments whose fixups depend on fragments that "
+             "changed size in the previous relaxation round"));
+
 // FIXME FIXME FIXME: There are number of places in this file where we convert
 // what is a 64-bit assembler value used for computation into a value in the
 // object file, which may truncate it. We should detect that truncation where
@@ -754,6 +766,186 @@ MCAssembler::handleFixup(const MCAsmLayout &Layout, MCFragment &F,
   return std::make_tuple(Target, FixedValue, IsResolved);
 }
 
+namespace {
+/// A fragment that may need relaxation, together with the layout orders of
+/// the fragments its fixups depend on.
+///
+/// A fixup in fragment F that refers to a symbol in fragment G of the same
+/// section evaluates to a value that only changes when a fragment in
+/// [min(F, G), max(F, G)] changes size, or when an alignment in that range
+/// changes size because of an earlier change. Fills and orgs whose size
+/// depends on symbols are not recorded when their size changes, so a fragment
+/// with one anywhere before its range end is rechecked every round, as is
+/// everything else the index can't reason about.
+struct RelaxationDependency {
+  enum DependencyKind {
+    /// Recheck when a fragment in [Lo, Hi) changed size.
+    DK_Range,
+    /// Recheck when a fragment before Hi changed size.
+    DK_Prefix,
+    /// Recheck every round.
+    DK_Always
+  };
+
+  MCFragment *F;
+  DependencyKind Kind;
+  unsigned Lo, Hi;
+
+  bool needsRecheck(ArrayRef<unsigned> Changed) const {
+    switch (Kind) {
+    case DK_Always:
+      return true;
+    case DK_Prefix:
+      return !Changed.empty() && Changed.front() < Hi;
+    case DK_Range: {
+      auto I = std::lower_bound(Changed.begin(), Changed.end(), Lo);
+      return I != Changed.end() && *I < Hi;
+    }
+    }
+    llvm_unreachable("Unknown dependency kind");
+  }
+};
+} // end anonymous namespace
+
+struct MCAssembler::RelaxationState {
+  struct SectionState {
+    bool Initialized = false;
+    /// The fragments that may need relaxation, in layout order.
+    std::vector<RelaxationDependency> Deps;
+    /// OffsetDependent[I] is the number of fragments before layout order I
+    /// whose size depends on their own offset, and SymbolDependent[I] the
+    /// number whose size depends on symbol values.
+    std::vector<unsigned> OffsetDependent;
+    std::vector<unsigned> SymbolDependent;
+    /// Layout orders of the fragments relaxed in the previous round, sorted.
+    SmallVector<unsigned, 16> Changed;
+
+    void init(MCSection &Sec, const MCAsmBackend &Backend);
+  };
+
+  DenseMap<const MCSection *, SectionState> Sections;
+};
+
+/// Collect the fragments defining the symbols \p E refers to. Returns false
+/// if the value of \p E may depend on something other than the offsets of
+/// those fragments.
+static bool
+collectReferencedFragments(const MCExpr *E,
+                           SmallVectorImpl<const MCFragment *> &Frags) {
+  switch (E->getKind()) {
+  case MCExpr::Constant:
+    return true;
+  case MCExpr::Target:
+    return false;
+  case MCExpr::Unary:
+    return collectReferencedFragments(cast<MCUnaryExpr>(E)->getSubExpr(),
+                                      Frags);
+  case MCExpr::Binary: {
+    const MCBinaryExpr *BE = cast<MCBinaryExpr>(E);
+    return collectReferencedFragments(BE->getLHS(), Frags) &&
+           collectReferencedFragments(BE->getRHS(), Frags);
+  }
+  case MCExpr::SymbolRef: {
+    const MCSymbol &Sym = cast<MCSymbolRefExpr>(E)->getSymbol();
+    if (Sym.isVariable())
+      return false;
+    // Undefined and absolute symbols do not move during layout.
+    if (Sym.isInSection())
+      Frags.push_back(Sym.getFragment());
+    return true;
+  }
+  }
+  llvm_unreachable("Invalid assembly expression kind!");
+}
+
+static void
+computeRelaxationDependency(RelaxationDependency &D,
+                            const MCAsmBackend &Backend,
+                            ArrayRef<unsigned> OffsetDependent,
+                            ArrayRef<unsigned> SymbolDependent) {
+  D.Kind = RelaxationDependency::DK_Always;
+  const auto *RF = dyn_cast<MCRelaxableFragment>(D.F);
+  if (!RF)
+    return;
+
+  // Fixups are usually PC-relative, so the fragment itself is always part of
+  // the range. Including it also makes sure that a fragment relaxed in one
+  // round is rechecked in the next.
+  unsigned Order = RF->getLayoutOrder();
+  D.Lo = Order;
+  D.Hi = Order + 1;
+  SmallVector<const MCFragment *, 4> Frags;
+  bool IsOffsetDependent = false;
+  for (const MCFixup &Fixup : RF->getFixups()) {
+    if (!collectReferencedFragments(Fixup.getValue(), Frags))
+      return;
+    // The value of a fixup that is aligned down to 32 bits depends on the
+    // fragment's own offset modulo 4, which any earlier fragment can change.
+    const MCFixupKindInfo &Info = Backend.getFixupKindInfo(Fixup.getKind());
+    if (Info.Flags & MCFixupKindInfo::FKF_IsAlignedDownTo32Bits)
+      IsOffsetDependent = true;
+  }
+  for (const MCFragment *Frag : Frags) {
+    if (Frag->getParent() != RF->getParent())
+      return;
+    D.Lo = std::min(D.Lo, Frag->getLayoutOrder());
+    D.Hi = std::max(D.Hi, Frag->getLayoutOrder() + 1);
+  }
+  // A symbolic fill or org before the range can change size because of a
+  // relaxation anywhere, shifting the range and its alignments.
+  if (SymbolDependent[D.Hi] != 0)
+    return;
+  D.Kind = IsOffsetDependent || OffsetDependent[D.Hi] != OffsetDependent[D.Lo]
+               ? RelaxationDependency::DK_Prefix
+               : RelaxationDependency::DK_Range;
+}
+
+void MCAssembler::RelaxationState::SectionState::init(
+    MCSection &Sec, const MCAsmBackend &Backend) {
+  Initialized = true;
+  OffsetDependent.push_back(0);
+  SymbolDependent.push_back(0);
+  for (MCFragment &F : Sec) {
+    bool IsOffsetDependent = false, IsSymbolDependent = false;
+    int64_t Unused;
+    switch (F.getKind()) {
+    default:
+      break;
+    case MCFragment::FT_Align:
+    case MCFragment::FT_Padding:
+      IsOffsetDependent = true;
+      break;
+    case MCFragment::FT_Fill:
+      IsSymbolDependent =
+          !cast<MCFillFragment>(F).getNumValues().evaluateAsAbsolute(Unused);
+      break;
+    case MCFragment::FT_Org:
+      IsOffsetDependent = true;
+      IsSymbolDependent =
+          !cast<MCOrgFragment>(F).getOffset().evaluateAsAbsolute(Unused);
+      break;
+    }
+    OffsetDependent.push_back(OffsetDependent.back() + IsOffsetDependent);
+    SymbolDependent.push_back(SymbolDependent.back() + IsSymbolDependent);
+
+    switch (F.getKind()) {
+    default:
+      break;
+    case MCFragment::FT_Relaxable:
+    case MCFragment::FT_Dwarf:
+    case MCFragment::FT_DwarfFrame:
+    case MCFragment::FT_LEB:
+    case MCFragment::FT_Padding:
+    case MCFragment::FT_CVInlineLines:
+    case MCFragment::FT_CVDefRange:
+      Deps.push_back({&F, RelaxationDependency::DK_Always, 0, 0});
+      break;
+    }
+  }
+  for (RelaxationDependency &D : Deps)
+    computeRelaxationDependency(D, Backend, OffsetDependent, SymbolDependent);
+}
+
 void MCAssembler::layout(MCAsmLayout &Layout) {
   assert(getBackendPtr() && "Expected assembler backend");
   DEBUG_WITH_TYPE("mc-dump", {
@@ -782,7 +974,8 @@ void MCAssembler::layout(MCAsmLayout &Layout) {
   }
 
   // Layout until everything fits.
-  while (layoutOnce(Layout))
+  RelaxationState State;
+  while (layoutOnce(Layout, State))
     if (getContext().hadError())
       return;
 
@@ -1038,51 +1231,69 @@ bool MCAssembler::relaxCVDefRange(MCAsmLayout &Layout,
   return OldSize != F.getContents().size();
 }
 
-bool MCAssembler::layoutSectionOnce(MCAsmLayout &Layout, MCSection &Sec) {
+bool MCAssembler::relaxFragment(MCAsmLayout &Layout, MCFragment &F) {
+  switch(F.getKind()) {
+  default:
+    return false;
+  case MCFragment::FT_Relaxable:
+    assert(!getRelaxAll() &&
+           "Did not expect a MCRelaxableFragment in RelaxAll mode");
+    return relaxInstruction(Layout, cast<MCRelaxableFragment>(F));
+  case MCFragment::FT_Dwarf:
+    return relaxDwarfLineAddr(Layout, cast<MCDwarfLineAddrFragment>(F));
+  case MCFragment::FT_DwarfFrame:
+    return relaxDwarfCallFrameFragment(Layout,
+                                       cast<MCDwarfCallFrameFragment>(F));
+  case MCFragment::FT_LEB:
+    return relaxLEB(Layout, cast<MCLEBFragment>(F));
+  case MCFragment::FT_Padding:
+    return relaxPaddingFragment(Layout, cast<MCPaddingFragment>(F));
+  case MCFragment::FT_CVInlineLines:
+    return relaxCVInlineLineTable(Layout, cast<MCCVInlineLineTableFragment>(F));
+  case MCFragment::FT_CVDefRange:
+    return relaxCVDefRange(Layout, cast<MCCVDefRangeFragment>(F));
+  }
+}
+
+bool MCAssembler::layoutSectionOnce(MCAsmLayout &Layout, MCSection &Sec,
+                                    RelaxationState &State) {
+  ++stats::RelaxationRounds;
+
+  // The first round checks every fragment. Later rounds only check the
+  // fragments whose fixups may have been affected by the fragments relaxed in
+  // the previous round.
+  RelaxationState::SectionState &S = State.Sections[&Sec];
+  bool CheckAll = !S.Initialized || !IncrementalRelaxation;
+  if (!S.Initialized)
+    S.init(Sec, getBackend());
+
   // Holds the first fragment which needed relaxing during this layout. It will
   // remain NULL if none were relaxed.
   // When a fragment is relaxed, all the fragments following it should get
   // invalidated because their offset is going to change.
   MCFragment *FirstRelaxedFragment = nullptr;
+  SmallVector<unsigned, 16> Changed;
 
-  // Attempt to relax all the fragments in the section.
-  for (MCSection::iterator I = Sec.begin(), IE = Sec.end(); I != IE; ++I) {
-    // Check if this is a fragment that needs relaxation.
-    bool RelaxedFrag = false;
-    switch(I->getKind()) {
-    default:
-      break;
-    case MCFragment::FT_Relaxable:
-      assert(!getRelaxAll() &&
-             "Did not expect a MCRelaxableFragment in RelaxAll mode");
-      RelaxedFrag = relaxInstruction(Layout, *cast<MCRelaxableFragment>(I));
-      break;
-    case MCFragment::FT_Dwarf:
-      RelaxedFrag = relaxDwarfLineAddr(Layout,
-                                       *cast<MCDwarfLineAddrFragment>(I));
-      break;
-    case MCFragment::FT_DwarfFrame:
-      RelaxedFrag =
-        relaxDwarfCallFrameFragment(Layout,
-                                    *cast<MCDwarfCallFrameFragment>(I));
-      break;
-    case MCFragment::FT_LEB:
-      RelaxedFrag = relaxLEB(Layout, *cast<MCLEBFragment>(I));
-      break;
-    case MCFragment::FT_Padding:
-      RelaxedFrag = relaxPaddingFragment(Layout, *cast<MCPaddingFragment>(I));
-      break;
-    case MCFragment::FT_CVInlineLines:
-      RelaxedFrag =
-          relaxCVInlineLineTable(Layout, *cast<MCCVInlineLineTableFragment>(I));
-      break;
-    case MCFragment::FT_CVDefRange:
-      RelaxedFrag = relaxCVDefRange(Layout, *cast<MCCVDefRangeFragment>(I));
-      break;
+  // Attempt to relax the fragments in the section.
+  for (RelaxationDependency &D : S.Deps) {
+    if (!CheckAll && !D.needsRecheck(S.Changed)) {
+      ++stats::SkippedFragmentChecks;
+      continue;
     }
-    if (RelaxedFrag && !FirstRelaxedFragment)
-      FirstRelaxedFragment = &*I;
+    ++stats::CheckedFragments;
+    if (!relaxFragment(Layout, *D.F))
+      continue;
+
+    ++stats::RelaxedFragments;
+    Changed.push_back(D.F->getLayoutOrder());
+    // Relaxing an instruction re-encodes its fixups.
+    computeRelaxationDependency(D, getBackend(), S.OffsetDependent,
+                                S.SymbolDependent);
+    if (!FirstRelaxedFragment)
+      FirstRelaxedFragment = D.F;
   }
+  S.Changed = std::move(Changed);
+
   if (FirstRelaxedFragment) {
     Layout.invalidateFragmentsFrom(FirstRelaxedFragment);
     return true;
@@ -1090,13 +1301,13 @@ bool MCAssembler::layoutSectionOnce(MCAsmLayout &Layout, MCSection &Sec) {
   return false;
 }
 
-bool MCAssembler::layoutOnce(MCAsmLayout &Layout) {
+bool MCAssembler::layoutOnce(MCAsmLayout &Layout, RelaxationState &State) {
   ++stats::RelaxationSteps;
 
   bool WasRelaxed = false;
   for (iterator it = begin(), ie = end(); it != ie; ++it) {
     MCSection &Sec = *it;
-    while (layoutSectionOnce(Layout, Sec))
+    while (layoutSectionOnce(Layout, Sec, State))
       WasRelaxed = true;
   }
 
@@ -13,6 +13,7 @@
 #include "llvm/BinaryFormat/COFF.h"
 #include "llvm/Support/Endian.h"
 #include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/raw_ostream.h"
 #include <cassert>
 #include <cstddef>
@@ -115,16 +116,65 @@ tailcall:
   }
 }
 
+// Below this many strings, clearing and scanning the 257 * 257 buckets of
+// parallelMultikeySort costs more than sorting on one thread.
+static const size_t MinParallelSortStrings = 1024;
+
+// Sorts the same way as multikeySort(Vec, 0), but first distributes the
+// strings into buckets by their last two characters and then sorts the
+// buckets concurrently. Since the strings are unique, the sort order is total
+// and the result does not depend on how the work is split.
+static void parallelMultikeySort(MutableArrayRef<StringPair *> Vec) {
+  // Characters are in [-1, 255], so there are 257 * 257 buckets. Number them
+  // in descending order of the characters to match multikeySort.
+  const unsigned NumChars = 257;
+  auto BucketOf = [&](StringPair *P) {
+    unsigned C0 = charTailAt(P, 0) + 1;
+    unsigned C1 = charTailAt(P, 1) + 1;
+    return (NumChars - 1 - C0) * NumChars + (NumChars - 1 - C1);
+  };
+
+  std::vector<size_t> Begin(NumChars * NumChars + 1);
+  for (StringPair *P : Vec)
+    ++Begin[BucketOf(P) + 1];
+  for (size_t I = 1; I < Begin.size(); ++I)
+    Begin[I] += Begin[I - 1];
+
+  std::vector<StringPair *> Sorted(Vec.size());
+  std::vector<size_t> Next(Begin.begin(), Begin.end() - 1);
+  for (StringPair *P : Vec)
+    Sorted[Next[BucketOf(P)]++] = P;
+
+  // Only buckets of strings longer than one character need any more sorting.
+  std::vector<unsigned> Buckets;
+  for (unsigned B = 0; B < NumChars * NumChars; ++B)
+    if (Begin[B + 1] - Begin[B] > 1 && B % NumChars != NumChars - 1)
+      Buckets.push_back(B);
+
+  parallel::for_each(parallel::par, Buckets.begin(), Buckets.end(),
+                     [&](unsigned B) {
+                       size_t N = Begin[B + 1] - Begin[B];
+                       multikeySort(
+                           makeMutableArrayRef(Sorted.data() + Begin[B], N), 2);
+                     });
+  std::copy(Sorted.begin(), Sorted.end(), Vec.begin());
+}
+
 void StringTableBuilder::finalize() {
   assert(K != DWARF);
   finalizeStringTable(/*Optimize=*/true);
 }
 
+void StringTableBuilder::finalizeParallel() {
+  assert(K != DWARF);
+  finalizeStringTable(/*Optimize=*/true, /*Parallel=*/true);
+}
+
 void StringTableBuilder::finalizeInOrder() {
   finalizeStringTable(/*Optimize=*/false);
 }
 
-void StringTableBuilder::finalizeStringTable(bool Optimize) {
+void StringTableBuilder::finalizeStringTable(bool Optimize, bool Parallel) {
   Finalized = true;
 
   if (Optimize) {
@@ -133,7 +183,10 @@ void StringTableBuilder::finalizeStringTable(bool Optimize) {
     for (StringPair &P : StringIndexMap)
       Strings.push_back(&P);
 
-    multikeySort(Strings, 0);
+    if (Parallel && Strings.size() >= MinParallelSortStrings)
+      parallelMultikeySort(Strings);
+    else
+      multikeySort(Strings, 0);
     initSize();
 
     StringRef Previous;
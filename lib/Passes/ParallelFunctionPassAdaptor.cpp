@@ -0,0 +1,290 @@
+//===- ParallelFunctionPassAdaptor.cpp ------------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+/// \file
+///
+/// This file implements the parallel module to function pass adaptor.
+///
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Passes/ParallelFunctionPassAdaptor.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/Attributes.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Linker/IRMover.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "parallel-function"
+
+STATISTIC(NumPartitions, "Number of module partitions optimized in parallel");
+STATISTIC(NumSerialModules,
+          "Number of modules the parallel function adaptor ran serially");
+
+static cl::opt<unsigned> ParallelFunctionThreads(
+    "parallel-function-threads", cl::Hidden, cl::init(0),
+    cl::desc("Maximum number of threads used to run parallel-function "
+             "pipelines (0 = one per hardware thread)"));
+
+/// Returns why \p M has to be processed serially, or null if it can be split.
+static const char *getReasonToRunSerially(const Module &M) {
+  // Distinct debug info metadata would be duplicated when the functions are
+  // moved back into the module.
+  if (M.getNamedMetadata("llvm.dbg.cu"))
+    return "module has debug info";
+  // An ifunc needs the definition of its resolver, which may be in another
+  // partition.
+  if (!M.ifunc_empty())
+    return "module has ifuncs";
+  // Values are matched up by name when the partitions are merged back.
+  for (const GlobalValue &GV : M.global_values())
+    if (!GV.hasName())
+      return "module has unnamed globals";
+  for (const Function &F : M) {
+    if (F.getSubprogram())
+      return "module has debug info";
+    // Replacing the body would leave blockaddress constants dangling.
+    for (const BasicBlock &BB : F)
+      if (BB.hasAddressTaken())
+        return "module has address-taken blocks";
+  }
+  return nullptr;
+}
+
+/// Runs the pipeline over the bitcode module \p Input in a private context and
+/// writes the optimized module to \p Output.
+static void optimizePartition(
+    StringRef Input, SmallVectorImpl<char> &Output,
+    const ParallelModuleToFunctionPassAdaptor::RunPipelineFn &RunPipeline) {
+  LLVMContext Ctx;
+  Expected<std::unique_ptr<Module>> MOrErr =
+      parseBitcodeFile(MemoryBufferRef(Input, "<partition>"), Ctx);
+  if (!MOrErr)
+    report_fatal_error("failed to read module partition: " +
+                       toString(MOrErr.takeError()));
+  Module &M = **MOrErr;
+
+  RunPipeline(M);
+
+  // Only the function definitions are moved back, so drop the module-level
+  // state that every partition has a copy of and that the linker would
+  // otherwise append to the original module once per partition.
+  M.setModuleInlineAsm("");
+  while (!M.named_metadata_empty())
+    M.eraseNamedMetadata(&*M.named_metadata_begin());
+  // The comdats are still there in the original module and are restored
+  // after merging.
+  for (Function &F : M)
+    if (!F.isDeclaration())
+      F.setComdat(nullptr);
+
+  raw_svector_ostream OS(Output);
+  WriteBitcodeToFile(M, OS);
+}
+
+PreservedAnalyses
+ParallelModuleToFunctionPassAdaptor::run(Module &M, ModuleAnalysisManager &) {
+  unsigned NumThreads = Threads ? Threads : ParallelFunctionThreads;
+  if (!NumThreads)
+    NumThreads = hardware_concurrency();
+
+  std::vector<Function *> Defs;
+  for (Function &F : M)
+    if (!F.isDeclaration())
+      Defs.push_back(&F);
+
+  const char *SerialReason = getReasonToRunSerially(M);
+  if (!SerialReason && (NumThreads < 2 || Defs.size() < 2))
+    SerialReason = "nothing to run in parallel";
+  if (SerialReason) {
+    LLVM_DEBUG(dbgs() << "parallel-function: running serially, "
+                      << SerialReason << "\n");
+    ++NumSerialModules;
+    RunPipeline(M);
+    return PreservedAnalyses::none();
+  }
+
+  // Split the functions into contiguous ranges of roughly the same number of
+  // instructions. The partitioning depends on the module and the thread count
+  // but not on scheduling, so a given configuration always produces the same
+  // output.
+  unsigned MaxPartitions = std::min<size_t>(NumThreads, Defs.size());
+  uint64_t TotalSize = 0;
+  for (Function *F : Defs)
+    TotalSize += F->getInstructionCount() + 1;
+  DenseMap<const Function *, unsigned> PartitionOf;
+  uint64_t Size = 0;
+  unsigned Partition = 0;
+  for (Function *F : Defs) {
+    PartitionOf[F] = Partition;
+    Size += F->getInstructionCount() + 1;
+    if (Partition + 1 < MaxPartitions &&
+        Size * MaxPartitions >= TotalSize * (Partition + 1))
+      ++Partition;
+  }
+  unsigned NumParts = PartitionOf[Defs.back()] + 1;
+  NumPartitions += NumParts;
+
+  // Remember what merging the partitions back changes, so it can be undone.
+  std::vector<std::string> FunctionOrder;
+  for (Function &F : M)
+    FunctionOrder.push_back(F.getName());
+  struct SavedDefinition {
+    std::string Name;
+    GlobalValue::LinkageTypes Linkage;
+    Comdat *C;
+  };
+  std::vector<SavedDefinition> SavedDefs;
+  for (Function *F : Defs)
+    SavedDefs.push_back({F->getName(), F->getLinkage(), F->getComdat()});
+
+  // The linker never resolves references to local symbols across modules, so
+  // make all of them external while the partitions are out.
+  std::vector<std::pair<std::string, GlobalValue::LinkageTypes>> SavedLocals;
+  for (GlobalValue &GV : M.global_values()) {
+    if (!GV.hasLocalLinkage())
+      continue;
+    SavedLocals.emplace_back(GV.getName(), GV.getLinkage());
+    GV.setLinkage(GlobalValue::ExternalLinkage);
+  }
+
+  // Each partition has the definitions of its own functions and of all global
+  // variables, so that constant initializers can still be folded, and
+  // declarations of everything else.
+  std::vector<SmallString<0>> Inputs(NumParts), Outputs(NumParts);
+  for (unsigned I = 0; I != NumParts; ++I) {
+    ValueToValueMapTy VMap;
+    std::unique_ptr<Module> Part =
+        CloneModule(M, VMap, [&](const GlobalValue *GV) {
+          if (const auto *F = dyn_cast<Function>(GV))
+            return PartitionOf.lookup(F) == I;
+          return isa<GlobalVariable>(GV);
+        });
+    raw_svector_ostream OS(Inputs[I]);
+    WriteBitcodeToFile(*Part, OS);
+  }
+
+  {
+    ThreadPool Pool(NumParts);
+    for (unsigned I = 0; I != NumParts; ++I)
+      Pool.async([&, I] {
+        optimizePartition(Inputs[I], Outputs[I], RunPipeline);
+      });
+    Pool.wait();
+  }
+
+  // Function passes may also change module-level state outside of the bodies
+  // they optimize: InstCombine raises the alignment of global variables whose
+  // accesses it proves to be aligned, and emitting library calls infers
+  // attributes on their declarations. Each partition changed its own copies,
+  // so collect the changes of all of them and apply them to M once every body
+  // is back. A body relying on a raised alignment then never sees a global
+  // with a lower one.
+  StringSet<> OriginalGlobals;
+  for (const GlobalVariable &GV : M.globals())
+    OriginalGlobals.insert(GV.getName());
+  StringMap<unsigned> GlobalAlignments;
+  std::vector<std::pair<std::string, AttributeList>> DeclarationAttributes;
+
+  // Merge the partitions back in order, replacing the original bodies.
+  for (unsigned I = 0; I != NumParts; ++I) {
+    Expected<std::unique_ptr<Module>> PartOrErr = parseBitcodeFile(
+        MemoryBufferRef(Outputs[I], "<partition>"), M.getContext());
+    if (!PartOrErr)
+      report_fatal_error("failed to read optimized module partition: " +
+                         toString(PartOrErr.takeError()));
+    std::unique_ptr<Module> Part = std::move(*PartOrErr);
+
+    for (const GlobalVariable &GV : Part->globals()) {
+      if (!OriginalGlobals.count(GV.getName()))
+        continue;
+      unsigned &Align = GlobalAlignments[GV.getName()];
+      Align = std::max(Align, GV.getAlignment());
+    }
+
+    std::vector<GlobalValue *> ValuesToLink;
+    for (Function &F : *Part) {
+      if (F.isDeclaration()) {
+        if (!F.hasLocalLinkage() && !F.getAttributes().isEmpty())
+          DeclarationAttributes.emplace_back(F.getName(), F.getAttributes());
+        continue;
+      }
+      M.getFunction(F.getName())->deleteBody();
+      ValuesToLink.push_back(&F);
+    }
+    IRMover Mover(M);
+    if (Error Err = Mover.move(std::move(Part), ValuesToLink,
+                               [](GlobalValue &, IRMover::ValueAdder) {},
+                               /*IsPerformingImport=*/false))
+      report_fatal_error("failed to merge optimized module partition: " +
+                         toString(std::move(Err)));
+  }
+
+  for (const auto &Align : GlobalAlignments) {
+    GlobalVariable *GV = M.getNamedGlobal(Align.getKey());
+    if (GV && Align.getValue() > GV->getAlignment())
+      GV->setAlignment(Align.getValue());
+  }
+  LLVMContext &Ctx = M.getContext();
+  for (const auto &Decl : DeclarationAttributes) {
+    // Definitions got their attributes from the partition that optimized
+    // them.
+    Function *F = M.getFunction(Decl.first);
+    if (!F || !F->isDeclaration())
+      continue;
+    AttributeList Attrs = F->getAttributes();
+    for (unsigned I = Decl.second.index_begin(), E = Decl.second.index_end();
+         I != E; ++I)
+      if (Decl.second.hasAttributes(I))
+        Attrs = Attrs.addAttributes(Ctx, I,
+                                    AttrBuilder(Decl.second.getAttributes(I)));
+    F->setAttributes(Attrs);
+  }
+
+  for (const auto &Local : SavedLocals)
+    M.getNamedValue(Local.first)->setLinkage(Local.second);
+  for (const SavedDefinition &Def : SavedDefs) {
+    Function *F = M.getFunction(Def.Name);
+    F->setLinkage(Def.Linkage);
+    F->setComdat(Def.C);
+  }
+
+  // Linking put the new definitions at the end of the function list. Restore
+  // the original order and keep the declarations the pipeline added after it,
+  // like a serial run would.
+  Module::FunctionListType &Functions = M.getFunctionList();
+  StringSet<> Original;
+  for (const std::string &Name : FunctionOrder)
+    Original.insert(Name);
+  std::vector<Function *> Added;
+  for (Function &F : M)
+    if (!Original.count(F.getName()))
+      Added.push_back(&F);
+  for (const std::string &Name : FunctionOrder)
+    Functions.splice(Functions.end(), Functions,
+                     M.getFunction(Name)->getIterator());
+  for (Function *F : Added)
+    Functions.splice(Functions.end(), Functions, F->getIterator());
+
+  return PreservedAnalyses::none();
+}
@@ -18,6 +18,7 @@
 #include "llvm/ADT/StringSwitch.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/AliasAnalysisEvaluator.h"
+#include "llvm/Analysis/AliasQueryCache.h"
 #include "llvm/Analysis/AssumptionCache.h"
 #include "llvm/Analysis/BasicAliasAnalysis.h"
 #include "llvm/Analysis/BlockFrequencyInfo.h"
@@ -58,9 +59,11 @@
 #include "llvm/IR/PassManager.h"
 #include "llvm/IR/SafepointIRVerifier.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Passes/ParallelFunctionPassAdaptor.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/FormatVariadic.h"
 #include "llvm/Support/Regex.h"
+#include "llvm/Support/TargetRegistry.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Transforms/AggressiveInstCombine/AggressiveInstCombine.h"
 #include "llvm/Transforms/IPO/AlwaysInliner.h"
@@ -88,6 +91,7 @@
 #include "llvm/Transforms/IPO/SyntheticCountsPropagation.h"
 #include "llvm/Transforms/IPO/WholeProgramDevirt.h"
 #include "llvm/Transforms/InstCombine/InstCombine.h"
+#include "llvm/Transforms/InstCombine/InstCombineChangeLog.h"
 #include "llvm/Transforms/Instrumentation.h"
 #include "llvm/Transforms/Instrumentation/AddressSanitizer.h"
 #include "llvm/Transforms/Instrumentation/BoundsChecking.h"
@@ -1450,6 +1454,59 @@ static bool callbacksAcceptPassName(StringRef Name, CallbacksT &Callbacks) {
   return false;
 }
 
+/// Print \p Pipeline back in the textual pipeline format.
+template <typename PipelineElementT>
+static void printPipeline(raw_ostream &OS,
+                          ArrayRef<PipelineElementT> Pipeline) {
+  bool First = true;
+  for (const PipelineElementT &E : Pipeline) {
+    if (!First)
+      OS << ',';
+    First = false;
+    OS << E.Name;
+    if (!E.InnerPipeline.empty()) {
+      OS << '(';
+      printPipeline(OS, makeArrayRef(E.InnerPipeline));
+      OS << ')';
+    }
+  }
+}
+
+/// Run the module pipeline \p PipelineText over \p M with pass and analysis
+/// managers of its own. This is what each worker of a parallel-function
+/// pipeline runs, so it must not share state with the PassBuilder that parsed
+/// the outer pipeline: it uses the default AA pipeline and runs no callbacks
+/// or instrumentation.
+static void runIsolatedPipeline(TargetMachine *TM, Optional<PGOOptions> PGOOpt,
+                                StringRef PipelineText, bool VerifyEachPass,
+                                bool DebugLogging, Module &M) {
+  // TargetMachine lazily creates and caches subtargets, so each worker gets
+  // its own copy.
+  std::unique_ptr<TargetMachine> WorkerTM;
+  if (TM)
+    WorkerTM.reset(TM->getTarget().createTargetMachine(
+        TM->getTargetTriple().str(), TM->getTargetCPU(),
+        TM->getTargetFeatureString(), TM->Options, TM->getRelocationModel(),
+        TM->getCodeModel(), TM->getOptLevel()));
+
+  PassBuilder PB(WorkerTM.get(), PGOOpt);
+  LoopAnalysisManager LAM(DebugLogging);
+  FunctionAnalysisManager FAM(DebugLogging);
+  CGSCCAnalysisManager CGAM(DebugLogging);
+  ModuleAnalysisManager MAM(DebugLogging);
+  PB.registerModuleAnalyses(MAM);
+  PB.registerCGSCCAnalyses(CGAM);
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerLoopAnalyses(LAM);
+  PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+  ModulePassManager MPM(DebugLogging);
+  if (auto Err =
+          PB.parsePassPipeline(MPM, PipelineText, VerifyEachPass, DebugLogging))
+    report_fatal_error(toString(std::move(Err)));
+  MPM.run(M, MAM);
+}
+
 template <typename CallbacksT>
 static bool isModulePassName(StringRef Name, CallbacksT &Callbacks) {
   // Manually handle aliases for pre-configured pipeline fragments.
@@ -1463,6 +1520,8 @@ static bool isModulePassName(StringRef Name, CallbacksT &Callbacks) {
     return true;
   if (Name == "function")
     return true;
+  if (Name == "parallel-function")
+    return true;
 
   // Explicitly handle custom-parsed pass names.
   if (parseRepeatPassName(Name))
@@ -1640,6 +1699,31 @@ Error PassBuilder::parseModulePass(ModulePassManager &MPM,
       MPM.addPass(createModuleToFunctionPassAdaptor(std::move(FPM)));
       return Error::success();
     }
+    if (Name == "parallel-function") {
+      // The workers parse the nested pipeline again with a PassBuilder of
+      // their own, which doesn't have any of the callbacks registered here, so
+      // check that such a PassBuilder accepts it.
+      PassBuilder WorkerPB(TM, PGOOpt);
+      FunctionPassManager FPM(DebugLogging);
+      if (auto Err = WorkerPB.parseFunctionPassPipeline(
+              FPM, InnerPipeline, VerifyEachPass, DebugLogging))
+        return Err;
+      std::string PipelineText;
+      raw_string_ostream OS(PipelineText);
+      OS << "function(";
+      printPipeline(OS, makeArrayRef(InnerPipeline));
+      OS << ')';
+      OS.flush();
+      TargetMachine *WorkerTM = TM;
+      Optional<PGOOptions> WorkerPGOOpt = PGOOpt;
+      MPM.addPass(ParallelModuleToFunctionPassAdaptor(
+          [WorkerTM, WorkerPGOOpt, PipelineText, VerifyEachPass,
+           DebugLogging](Module &M) {
+            runIsolatedPipeline(WorkerTM, WorkerPGOOpt, PipelineText,
+                                VerifyEachPass, DebugLogging, M);
+          }));
+      return Error::success();
+    }
     if (auto Count = parseRepeatPassName(Name)) {
       ModulePassManager NestedMPM(DebugLogging);
       if (auto Err = parseModulePassPipeline(NestedMPM, InnerPipeline,
@@ -13,6 +13,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Passes/StandardInstrumentations.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/Optional.h"
 #include "llvm/Analysis/CallGraphSCCPass.h"
 #include "llvm/Analysis/LazyCallGraph.h"
@@ -21,8 +22,11 @@
 #include "llvm/IR/IRPrintingPasses.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/PassInstrumentation.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
 #include "llvm/Support/raw_ostream.h"
 
 using namespace llvm;
@@ -235,8 +239,260 @@ void PrintIRInstrumentation::registerCallbacks(
   }
 }
 
+/// Pass managers, adaptors and repeated-pass wrappers only forward what their
+/// passes preserve.
+static bool isPassManager(StringRef PassID) {
+  return PassID.startswith("PassManager<") || PassID.contains("PassAdaptor<") ||
+         PassID.startswith("RepeatedPass<") ||
+         PassID.startswith("DevirtSCCRepeatedPass<");
+}
+
+/// Returns the IR unit wrapped into \p IR.
+static const void *unwrapIRUnit(Any IR) {
+  if (any_isa<const Module *>(IR))
+    return any_cast<const Module *>(IR);
+  if (any_isa<const Function *>(IR))
+    return any_cast<const Function *>(IR);
+  if (any_isa<const LazyCallGraph::SCC *>(IR))
+    return any_cast<const LazyCallGraph::SCC *>(IR);
+  if (any_isa<const Loop *>(IR))
+    return any_cast<const Loop *>(IR);
+  llvm_unreachable("Unknown wrapped IR type");
+}
+
+/// Hashes the printed IR of the functions a pass over \p IR may change.
+static size_t hashIR(Any IR) {
+  std::string Str;
+  raw_string_ostream OS(Str);
+  if (any_isa<const Module *>(IR)) {
+    any_cast<const Module *>(IR)->print(OS, nullptr);
+  } else if (any_isa<const Function *>(IR)) {
+    any_cast<const Function *>(IR)->print(OS);
+  } else if (any_isa<const LazyCallGraph::SCC *>(IR)) {
+    for (const LazyCallGraph::Node &N :
+         *any_cast<const LazyCallGraph::SCC *>(IR))
+      N.getFunction().print(OS);
+  } else if (any_isa<const Loop *>(IR)) {
+    any_cast<const Loop *>(IR)->getHeader()->getParent()->print(OS);
+  } else {
+    llvm_unreachable("Unknown wrapped IR type");
+  }
+  return hash_value(OS.str());
+}
+
+static double toSeconds(std::chrono::steady_clock::duration D) {
+  return std::chrono::duration<double>(D).count();
+}
+
+static cl::opt<std::string> AnalysisReuseReportFile(
+    "analysis-reuse-report", cl::Hidden, cl::value_desc("filename"),
+    cl::desc("Write a JSON report of the analyses each pass computes and "
+             "invalidates to the given file (new pass manager only)"));
+
+AnalysisReuseReport::AnalysisReuseReport(std::string ReportFile)
+    : ReportFile(std::move(ReportFile)) {}
+
+AnalysisReuseReport::~AnalysisReuseReport() {
+  if (ReportFile.empty())
+    return;
+  std::error_code EC;
+  raw_fd_ostream OS(ReportFile, EC, sys::fs::F_Text);
+  if (EC) {
+    errs() << "warning: could not open analysis reuse report '" << ReportFile
+           << "': " << EC.message() << "\n";
+    return;
+  }
+  print(OS);
+}
+
+void AnalysisReuseReport::popSkippedPasses(StringRef PassID) {
+  while (!PassStack.empty() && PassStack.back().Name != PassID)
+    PassStack.pop_back();
+  assert(!PassStack.empty() && "malformed PassStack");
+}
+
+bool AnalysisReuseReport::beforePass(StringRef PassID, Any IR) {
+  // A pass that another BeforePass callback skipped never gets an AfterPass
+  // callback. Only pass managers and adaptors run passes of their own, so any
+  // other pass still on the stack was skipped.
+  while (!PassStack.empty() && PassStack.back().IRHash)
+    PassStack.pop_back();
+  LastPass = None;
+  Optional<size_t> IRHash;
+  if (!isPassManager(PassID))
+    IRHash = hashIR(IR);
+  PassStack.push_back({PassID, IRHash});
+  return true;
+}
+
+void AnalysisReuseReport::afterPass(StringRef PassID, Any IR) {
+  popSkippedPasses(PassID);
+  RunningPass P = PassStack.pop_back_val();
+  bool WithoutChange = P.IRHash && *P.IRHash == hashIR(IR);
+  if (P.IRHash) {
+    PassCounters &C = Passes[PassID];
+    ++C.Runs;
+    C.RunsWithoutChange += WithoutChange;
+  }
+  LastPass = Invalidation{PassID, WithoutChange};
+  LastPassForwards = !P.IRHash;
+}
+
+void AnalysisReuseReport::afterPassInvalidated(StringRef PassID) {
+  popSkippedPasses(PassID);
+  RunningPass P = PassStack.pop_back_val();
+  if (P.IRHash)
+    ++Passes[PassID].Runs;
+  LastPass = Invalidation{PassID, false};
+  LastPassForwards = !P.IRHash;
+}
+
+void AnalysisReuseReport::beforeAnalysis(StringRef AnalysisID, Any IR) {
+  StringRef RequestedBy =
+      PassStack.empty() ? StringRef("<none>") : PassStack.back().Name;
+  AnalysisStack.push_back({AnalysisID, unwrapIRUnit(IR), RequestedBy,
+                           Clock::now(), Clock::duration::zero()});
+}
+
+void AnalysisReuseReport::afterAnalysis(StringRef AnalysisID, Any IR) {
+  assert(!AnalysisStack.empty() && AnalysisStack.back().Name == AnalysisID &&
+         "malformed AnalysisStack");
+  RunningAnalysis A = AnalysisStack.pop_back_val();
+  Clock::duration Elapsed = Clock::now() - A.Start;
+  Clock::duration Own = Elapsed - A.NestedTime;
+  if (!AnalysisStack.empty())
+    AnalysisStack.back().NestedTime += Elapsed;
+
+  PairCounters &C = Pairs[{A.RequestedBy, AnalysisID}];
+  ++C.Computed;
+  C.ComputeTime += Own;
+
+  auto It = InvalidatedBy.find({AnalysisID, A.IR});
+  if (It == InvalidatedBy.end())
+    return;
+  PairCounters &IC = Pairs[{It->second.Pass, AnalysisID}];
+  ++IC.Recomputed;
+  IC.RecomputeTime += Own;
+  if (It->second.WithoutChange)
+    IC.WastedTime += Own;
+  InvalidatedBy.erase(It);
+}
+
+void AnalysisReuseReport::analysisInvalidated(StringRef AnalysisID, Any IR) {
+  auto Key = std::make_pair(AnalysisID, unwrapIRUnit(IR));
+
+  // A pass manager or adaptor only drops what one of its passes did not
+  // preserve, possibly a result recomputed since. That pass was charged when
+  // it ran, and stays responsible for the result being computed again.
+  if (LastPass && LastPassForwards) {
+    auto It = LastInvalidatedBy.find(Key);
+    if (It != LastInvalidatedBy.end())
+      InvalidatedBy[Key] = It->second;
+    return;
+  }
+
+  // Results are invalidated right after the pass that didn't preserve them,
+  // or by a pass that is still running, e.g. when it updates the call graph.
+  Invalidation Inv =
+      LastPass ? *LastPass
+               : Invalidation{PassStack.empty() ? StringRef("<none>")
+                                                : PassStack.back().Name,
+                              false};
+  PairCounters &C = Pairs[{Inv.Pass, AnalysisID}];
+  ++C.Invalidated;
+  C.InvalidatedWithoutChange += Inv.WithoutChange;
+  InvalidatedBy[Key] = Inv;
+  LastInvalidatedBy[Key] = Inv;
+}
+
+void AnalysisReuseReport::print(raw_ostream &OS) const {
+  std::map<StringRef, PairCounters> Analyses;
+  std::map<StringRef, PairCounters> OverInvalidating;
+  std::map<StringRef, std::vector<StringRef>> OverInvalidated;
+  json::Array PairsJSON;
+  for (const auto &P : Pairs) {
+    StringRef Pass = P.first.first, Analysis = P.first.second;
+    const PairCounters &C = P.second;
+    PairCounters &A = Analyses[Analysis];
+    A.Computed += C.Computed;
+    A.Invalidated += C.Invalidated;
+    A.Recomputed += C.Recomputed;
+    A.ComputeTime += C.ComputeTime;
+    if (C.InvalidatedWithoutChange) {
+      PairCounters &O = OverInvalidating[Pass];
+      O.InvalidatedWithoutChange += C.InvalidatedWithoutChange;
+      O.WastedTime += C.WastedTime;
+      OverInvalidated[Pass].push_back(Analysis);
+    }
+    PairsJSON.push_back(json::Object{
+        {"pass", Pass},
+        {"analysis", Analysis},
+        {"computed", C.Computed},
+        {"compute_seconds", toSeconds(C.ComputeTime)},
+        {"invalidated", C.Invalidated},
+        {"invalidated_without_change", C.InvalidatedWithoutChange},
+        {"recomputed", C.Recomputed},
+        {"recompute_seconds", toSeconds(C.RecomputeTime)},
+        {"wasted_seconds", toSeconds(C.WastedTime)}});
+  }
+
+  json::Array AnalysesJSON;
+  for (const auto &A : Analyses)
+    AnalysesJSON.push_back(
+        json::Object{{"analysis", A.first},
+                     {"computed", A.second.Computed},
+                     {"invalidated", A.second.Invalidated},
+                     {"recomputed", A.second.Recomputed},
+                     {"compute_seconds", toSeconds(A.second.ComputeTime)}});
+
+  json::Array OverInvalidatingJSON;
+  for (const auto &O : OverInvalidating) {
+    auto PC = Passes.find(O.first);
+    unsigned Runs = PC == Passes.end() ? 0 : PC->second.Runs;
+    unsigned RunsWithoutChange =
+        PC == Passes.end() ? 0 : PC->second.RunsWithoutChange;
+    json::Array Invalidated;
+    for (StringRef Analysis : OverInvalidated.find(O.first)->second)
+      Invalidated.push_back(Analysis);
+    OverInvalidatingJSON.push_back(json::Object{
+        {"pass", O.first},
+        {"runs", Runs},
+        {"runs_without_change", RunsWithoutChange},
+        {"invalidations_without_change", O.second.InvalidatedWithoutChange},
+        {"invalidated_analyses", std::move(Invalidated)},
+        {"wasted_seconds", toSeconds(O.second.WastedTime)}});
+  }
+
+  json::Object Root{{"analyses", std::move(AnalysesJSON)},
+                    {"pairs", std::move(PairsJSON)},
+                    {"over_invalidating_passes",
+                     std::move(OverInvalidatingJSON)}};
+  OS << formatv("{0:2}", json::Value(std::move(Root))) << "\n";
+}
+
+void AnalysisReuseReport::registerCallbacks(
+    PassInstrumentationCallbacks &PIC) {
+  PIC.registerBeforePassCallback(
+      [this](StringRef P, Any IR) { return this->beforePass(P, IR); });
+  PIC.registerAfterPassCallback(
+      [this](StringRef P, Any IR) { this->afterPass(P, IR); });
+  PIC.registerAfterPassInvalidatedCallback(
+      [this](StringRef P) { this->afterPassInvalidated(P); });
+  PIC.registerBeforeAnalysisCallback(
+      [this](StringRef A, Any IR) { this->beforeAnalysis(A, IR); });
+  PIC.registerAfterAnalysisCallback(
+      [this](StringRef A, Any IR) { this->afterAnalysis(A, IR); });
+  PIC.registerAnalysisInvalidatedCallback(
+      [this](StringRef A, Any IR) { this->analysisInvalidated(A, IR); });
+}
+
 void StandardInstrumentations::registerCallbacks(
     PassInstrumentationCallbacks &PIC) {
   PrintIR.registerCallbacks(PIC);
   TimePasses.registerCallbacks(PIC);
+  if (!AnalysisReuseReportFile.empty()) {
+    AnalysisReuse = llvm::make_unique<AnalysisReuseReport>(
+        AnalysisReuseReportFile);
+    AnalysisReuse->registerCallbacks(PIC);
+  }
 }
@@ -15,6 +15,7 @@
 #include "llvm/CodeGen/GlobalISel/Combiner.h"
 #include "llvm/CodeGen/GlobalISel/CombinerHelper.h"
 #include "llvm/CodeGen/GlobalISel/CombinerInfo.h"
+#include "llvm/CodeGen/GlobalISel/CombinerMatchTable.h"
 #include "llvm/CodeGen/GlobalISel/MIPatternMatch.h"
 #include "llvm/CodeGen/MachineFunctionPass.h"
 #include "llvm/CodeGen/TargetPassConfig.h"
@@ -26,7 +27,17 @@ using namespace llvm;
 using namespace MIPatternMatch;
 
 namespace {
+#define AARCH64GENPRELEGALIZERCOMBINERHELPER_GENCOMBINERHELPER_H
+#include "AArch64GenGICombiner.inc"
+#undef AARCH64GENPRELEGALIZERCOMBINERHELPER_GENCOMBINERHELPER_H
+
+#define AARCH64GENPRELEGALIZERCOMBINERHELPER_GENCOMBINERHELPER_CPP
+#include "AArch64GenGICombiner.inc"
+#undef AARCH64GENPRELEGALIZERCOMBINERHELPER_GENCOMBINERHELPER_CPP
+
 class AArch64PreLegalizerCombinerInfo : public CombinerInfo {
+  AArch64GenPreLegalizerCombinerHelper Generated;
+
 public:
   AArch64PreLegalizerCombinerInfo()
       : CombinerInfo(/*AllowIllegalOps*/ true, /*ShouldLegalizeIllegal*/ false,
@@ -39,17 +50,7 @@ bool AArch64PreLegalizerCombinerInfo::combine(GISelChangeObserver &Observer,
                                               MachineInstr &MI,
                                               MachineIRBuilder &B) const {
   CombinerHelper Helper(Observer, B);
-
-  switch (MI.getOpcode()) {
-  default:
-    return false;
-  case TargetOpcode::G_LOAD:
-  case TargetOpcode::G_SEXTLOAD:
-  case TargetOpcode::G_ZEXTLOAD:
-    return Helper.tryCombineExtendingLoads(MI);
-  }
-
-  return false;
+  return Generated.tryCombineAll(Observer, MI, B, Helper);
 }
 
 // Pass boilerplate
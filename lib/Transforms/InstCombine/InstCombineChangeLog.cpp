@@ -0,0 +1,76 @@
+//===- InstCombineChangeLog.cpp - Changes since the last instcombine ------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Transforms/InstCombine/InstCombineChangeLog.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/CommandLine.h"
+
+using namespace llvm;
+
+static cl::opt<bool> EnableIncrementalInstCombine(
+    "instcombine-incremental", cl::Hidden, cl::init(false),
+    cl::desc("Only add the instructions touched since instcombine last ran "
+             "on a function to its initial worklist (new pass manager only)"));
+
+bool llvm::isInstCombineIncrementalEnabled() {
+  return EnableIncrementalInstCombine;
+}
+
+static size_t getFingerprint(const Instruction &I) {
+  hash_code H = hash_combine(I.getOpcode(), I.getType(), I.getParent(),
+                             I.getPrevNode(), I.getNextNode(),
+                             I.getRawSubclassOptionalData(), I.getNumUses());
+  if (const auto *Cmp = dyn_cast<CmpInst>(&I))
+    H = hash_combine(H, Cmp->getPredicate());
+  if (const auto *PN = dyn_cast<PHINode>(&I))
+    H = hash_combine(H, hash_combine_range(PN->block_begin(), PN->block_end()));
+  for (const Value *Op : I.operands())
+    H = hash_combine(H, Op);
+  return H;
+}
+
+void InstCombineChangeLog::recordSnapshot(const Function &F) {
+  Fingerprints.clear();
+  for (const Instruction &I : instructions(F))
+    Fingerprints[&I] = getFingerprint(I);
+  HasSnapshot = true;
+}
+
+void InstCombineChangeLog::collectTouched(
+    const Function &F, SmallPtrSetImpl<const Instruction *> &Touched) const {
+  SmallVector<const Instruction *, 16> Changed;
+  for (const Instruction &I : instructions(F)) {
+    auto It = Fingerprints.find(&I);
+    if (It == Fingerprints.end() || It->second != getFingerprint(I))
+      Changed.push_back(&I);
+  }
+
+  SmallVector<const Instruction *, 16> Worklist(Changed.begin(),
+                                                Changed.end());
+  while (!Worklist.empty()) {
+    const Instruction *I = Worklist.pop_back_val();
+    if (!Touched.insert(I).second)
+      continue;
+    for (const User *U : I->users())
+      Worklist.push_back(cast<Instruction>(U));
+  }
+
+  for (const Instruction *I : Changed)
+    for (const Value *Op : I->operands())
+      if (const auto *OpI = dyn_cast<Instruction>(Op))
+        Touched.insert(OpI);
+}
+
+AnalysisKey InstCombineChangeLogAnalysis::Key;
+InstCombineChangeLog
+InstCombineChangeLogAnalysis::run(Function &, FunctionAnalysisManager &) {
+  return InstCombineChangeLog();
+}
@@ -94,6 +94,7 @@
 #include "llvm/Support/KnownBits.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/InstCombine/InstCombine.h"
+#include "llvm/Transforms/InstCombine/InstCombineChangeLog.h"
 #include "llvm/Transforms/InstCombine/InstCombineWorklist.h"
 #include "llvm/Transforms/Utils/Local.h"
 #include <algorithm>
@@ -115,6 +116,8 @@ STATISTIC(NumSunkInst , "Number of instructions sunk");
 STATISTIC(NumExpand,    "Number of expansions");
 STATISTIC(NumFactor   , "Number of factorizations");
 STATISTIC(NumReassoc  , "Number of reassociations");
+STATISTIC(NumVisited  , "Number of instructions visited");
+STATISTIC(NumUntouched, "Number of untouched insts left off the worklist");
 DEBUG_COUNTER(VisitCounter, "instcombine-visit",
               "Controls which instructions are visited");
 
@@ -3192,6 +3195,8 @@ bool InstCombiner::run() {
     if (!DebugCounter::shouldExecute(VisitCounter))
       continue;
 
+    ++NumVisited;
+
     // Instruction isn't dead, see if we can constant propagate it.
     if (!I->use_empty() &&
         (I->getNumOperands() == 0 || isa<Constant>(I->getOperand(0)))) {
@@ -3339,10 +3344,15 @@ bool InstCombiner::run() {
 /// them to the worklist (this significantly speeds up instcombine on code where
 /// many instructions are dead or constant).  Additionally, if we find a branch
 /// whose condition is a known constant, we only visit the reachable successors.
-static bool AddReachableCodeToWorklist(BasicBlock *BB, const DataLayout &DL,
-                                       SmallPtrSetImpl<BasicBlock *> &Visited,
-                                       InstCombineWorklist &ICWorklist,
-                                       const TargetLibraryInfo *TLI) {
+///
+/// If \p Touched is set, only the instructions in it and the ones whose
+/// operands get folded are added to the worklist.
+static bool
+AddReachableCodeToWorklist(BasicBlock *BB, const DataLayout &DL,
+                           SmallPtrSetImpl<BasicBlock *> &Visited,
+                           InstCombineWorklist &ICWorklist,
+                           const TargetLibraryInfo *TLI,
+                           const SmallPtrSetImpl<const Instruction *> *Touched) {
   bool MadeIRChange = false;
   SmallVector<BasicBlock*, 256> Worklist;
   Worklist.push_back(BB);
@@ -3386,6 +3396,7 @@ static bool AddReachableCodeToWorklist(BasicBlock *BB, const DataLayout &DL,
         }
 
       // See if we can constant fold its operands.
+      bool FoldedOperand = false;
       for (Use &U : Inst->operands()) {
         if (!isa<ConstantVector>(U) && !isa<ConstantExpr>(U))
           continue;
@@ -3403,13 +3414,19 @@ static bool AddReachableCodeToWorklist(BasicBlock *BB, const DataLayout &DL,
                             << "\n    New = " << *FoldRes << '\n');
           U = FoldRes;
           MadeIRChange = true;
+          FoldedOperand = true;
         }
       }
 
       // Skip processing debug intrinsics in InstCombine. Processing these call instructions
       // consumes non-trivial amount of time and provides no value for the optimization.
-      if (!isa<DbgInfoIntrinsic>(Inst))
-        InstrsForInstCombineWorklist.push_back(Inst);
+      if (isa<DbgInfoIntrinsic>(Inst))
+        continue;
+      if (Touched && !FoldedOperand && !Touched->count(Inst)) {
+        ++NumUntouched;
+        continue;
+      }
+      InstrsForInstCombineWorklist.push_back(Inst);
     }
 
     // Recursively visit successors.  If this is a branch or switch on a
@@ -3448,17 +3465,18 @@ static bool AddReachableCodeToWorklist(BasicBlock *BB, const DataLayout &DL,
 ///
 /// This also does basic constant propagation and other forward fixing to make
 /// the combiner itself run much faster.
-static bool prepareICWorklistFromFunction(Function &F, const DataLayout &DL,
-                                          TargetLibraryInfo *TLI,
-                                          InstCombineWorklist &ICWorklist) {
+static bool prepareICWorklistFromFunction(
+    Function &F, const DataLayout &DL, TargetLibraryInfo *TLI,
+    InstCombineWorklist &ICWorklist,
+    const SmallPtrSetImpl<const Instruction *> *Touched) {
   bool MadeIRChange = false;
 
   // Do a depth-first traversal of the function, populate the worklist with
   // the reachable instructions.  Ignore blocks that are not reachable.  Keep
   // track of which blocks we visit.
   SmallPtrSet<BasicBlock *, 32> Visited;
-  MadeIRChange |=
-      AddReachableCodeToWorklist(&F.front(), DL, Visited, ICWorklist, TLI);
+  MadeIRChange |= AddReachableCodeToWorklist(&F.front(), DL, Visited,
+                                             ICWorklist, TLI, Touched);
 
   // Do a quick scan over the function.  If we find any blocks that are
   // unreachable, remove any instructions inside of them.  This prevents
@@ -3479,7 +3497,7 @@ static bool combineInstructionsOverFunction(
     Function &F, InstCombineWorklist &Worklist, AliasAnalysis *AA,
     AssumptionCache &AC, TargetLibraryInfo &TLI, DominatorTree &DT,
     OptimizationRemarkEmitter &ORE, bool ExpensiveCombines = true,
-    LoopInfo *LI = nullptr) {
+    LoopInfo *LI = nullptr, InstCombineChangeLog *ChangeLog = nullptr) {
   auto &DL = F.getParent()->getDataLayout();
   ExpensiveCombines |= EnableExpensiveCombines;
 
@@ -3506,7 +3524,19 @@ static bool combineInstructionsOverFunction(
     LLVM_DEBUG(dbgs() << "\n\nINSTCOMBINE ITERATION #" << Iteration << " on "
                       << F.getName() << "\n");
 
-    MadeIRChange |= prepareICWorklistFromFunction(F, DL, &TLI, Worklist);
+    // With a change log, only start from the instructions touched since the
+    // previous iteration, or since instcombine last ran on the function. The
+    // snapshot is taken before combining, so the next iteration revisits
+    // everything this one changed.
+    SmallPtrSet<const Instruction *, 32> Touched;
+    bool Incremental = ChangeLog && ChangeLog->hasSnapshot();
+    if (Incremental)
+      ChangeLog->collectTouched(F, Touched);
+    MadeIRChange |= prepareICWorklistFromFunction(F, DL, &TLI, Worklist,
+                                                  Incremental ? &Touched
+                                                              : nullptr);
+    if (ChangeLog)
+      ChangeLog->recordSnapshot(F);
 
     InstCombiner IC(Worklist, Builder, F.hasMinSize(), ExpensiveCombines, AA,
                     AC, TLI, DT, ORE, DL, LI);
@@ -3529,8 +3559,11 @@ PreservedAnalyses InstCombinePass::run(Function &F,
   auto *LI = AM.getCachedResult<LoopAnalysis>(F);
 
   auto *AA = &AM.getResult<AAManager>(F);
+  auto *ChangeLog = isInstCombineIncrementalEnabled()
+                        ? &AM.getResult<InstCombineChangeLogAnalysis>(F)
+                        : nullptr;
   if (!combineInstructionsOverFunction(F, Worklist, AA, AC, TLI, DT, ORE,
-                                       ExpensiveCombines, LI))
+                                       ExpensiveCombines, LI, ChangeLog))
     // No changes, all analyses are preserved.
     return PreservedAnalyses::all();
 
@@ -537,6 +537,7 @@ static bool doCallSiteSplitting(Function &F, TargetLibraryInfo &TLI,
         break;
     }
   }
+  DTU.deferFlush();
   return Changed;
 }
 
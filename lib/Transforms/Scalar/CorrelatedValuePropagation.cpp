@@ -372,8 +372,12 @@ static bool processSwitch(SwitchInst *SI, LazyValueInfo *LVI,
 
       ++NumDeadCases;
       Changed = true;
-      if (--SuccessorsCount[Succ] == 0)
+      if (--SuccessorsCount[Succ] == 0) {
         DTU.applyUpdatesPermissive({{DominatorTree::Delete, BB, Succ}});
+        // Values LVI couldn't solve in Succ might be solvable without the
+        // edge from BB.
+        LVI->applyUpdates({{DominatorTree::Delete, BB, Succ}});
+      }
       continue;
     }
     if (State == LazyValueInfo::True) {
@@ -706,6 +710,7 @@ static Constant *getConstantAt(Value *V, Instruction *At, LazyValueInfo *LVI) {
 static bool runImpl(Function &F, LazyValueInfo *LVI, DominatorTree *DT,
                     const SimplifyQuery &SQ) {
   bool FnChanged = false;
+  LVI->resetSolveBudget();
   // Visiting in a pre-order depth-first traversal causes us to simplify early
   // blocks before querying later blocks (which require us to analyze early
   // blocks).  Eagerly simplifying shallow blocks means there is strictly less
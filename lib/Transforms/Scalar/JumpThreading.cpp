@@ -343,6 +343,7 @@ bool JumpThreadingPass::runImpl(Function &F, TargetLibraryInfo *TLI_,
   LLVM_DEBUG(dbgs() << "Jump threading on function '" << F.getName() << "'\n");
   TLI = TLI_;
   LVI = LVI_;
+  LVI->resetSolveBudget();
   AA = AA_;
   DTU = DTU_;
   BFI.reset();
@@ -418,8 +419,9 @@ bool JumpThreadingPass::runImpl(Function &F, TargetLibraryInfo *TLI_,
   } while (Changed);
 
   LoopHeaders.clear();
-  // Flush only the Dominator Tree.
-  DTU->getDomTree();
+  // Flush only the Dominator Tree. We're done changing the CFG, so the tree
+  // may catch up with it when it is queried next.
+  DTU->deferFlush();
   LVI->enableDT();
   return EverChanged;
 }
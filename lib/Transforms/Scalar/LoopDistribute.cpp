@@ -960,7 +960,8 @@ private:
 /// Shared implementation between new and old PMs.
 static bool runImpl(Function &F, LoopInfo *LI, DominatorTree *DT,
                     ScalarEvolution *SE, OptimizationRemarkEmitter *ORE,
-                    std::function<const LoopAccessInfo &(Loop &)> &GetLAA) {
+                    std::function<const LoopAccessInfo &(Loop &)> &GetLAA,
+                    SmallVectorImpl<Loop *> *ChangedLoops = nullptr) {
   // Build up a worklist of inner-loops to vectorize. This is necessary as the
   // act of distributing a loop creates new loops and can invalidate iterators
   // across the loops.
@@ -979,8 +980,12 @@ static bool runImpl(Function &F, LoopInfo *LI, DominatorTree *DT,
 
     // If distribution was forced for the specific loop to be
     // enabled/disabled, follow that.  Otherwise use the global flag.
-    if (LDL.isForced().getValueOr(EnableLoopDistribute))
-      Changed |= LDL.processLoop(GetLAA);
+    if (LDL.isForced().getValueOr(EnableLoopDistribute) &&
+        LDL.processLoop(GetLAA)) {
+      if (ChangedLoops)
+        ChangedLoops->push_back(L);
+      Changed = true;
+    }
   }
 
   // Process each loop nest in the function.
@@ -1049,10 +1054,12 @@ PreservedAnalyses LoopDistributePass::run(Function &F,
     return LAM.getResult<LoopAccessAnalysis>(L, AR);
   };
 
-  bool Changed = runImpl(F, &LI, &DT, &SE, &ORE, GetLAA);
+  SmallVector<Loop *, 4> ChangedLoops;
+  bool Changed = runImpl(F, &LI, &DT, &SE, &ORE, GetLAA, &ChangedLoops);
   if (!Changed)
     return PreservedAnalyses::all();
-  PreservedAnalyses PA;
+  // Keep the loop access info of the loop nests that weren't distributed.
+  PreservedAnalyses PA = invalidateChangedLoopNests(LAM, SE, ChangedLoops);
   PA.preserve<LoopAnalysis>();
   PA.preserve<DominatorTreeAnalysis>();
   PA.preserve<GlobalsAA>();
@@ -155,6 +155,7 @@ bool LowerSwitch::runOnFunction(Function &F) {
   // that the latter can handle some of the simple cases w/o a DominatorTree,
   // it's easier to refrain from using the tree than to keep it up to date.
   LVI->disableDT();
+  LVI->resetSolveBudget();
 
   bool Changed = false;
   SmallPtrSet<BasicBlock*, 8> DeleteList;
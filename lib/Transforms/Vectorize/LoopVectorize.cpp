@@ -7532,6 +7532,7 @@ bool LoopVectorizePass::runImpl(
   GetLAA = &GetLAA_;
   DB = &DB_;
   ORE = &ORE_;
+  ChangedLoops.clear();
 
   // Don't attempt if
   // 1. the target claims to have no vector registers, and
@@ -7551,7 +7552,10 @@ bool LoopVectorizePass::runImpl(
   // will simplify all loops, regardless of whether anything end up being
   // vectorized.
   for (auto &L : *LI)
-    Changed |= simplifyLoop(L, DT, LI, SE, AC, false /* PreserveLCSSA */);
+    if (simplifyLoop(L, DT, LI, SE, AC, false /* PreserveLCSSA */)) {
+      ChangedLoops.push_back(L);
+      Changed = true;
+    }
 
   // Build up a worklist of inner-loops to vectorize. This is necessary as
   // the act of vectorizing or partially unrolling a loop creates new loops
@@ -7569,9 +7573,12 @@ bool LoopVectorizePass::runImpl(
 
     // For the inner loops we actually process, form LCSSA to simplify the
     // transform.
-    Changed |= formLCSSARecursively(*L, *DT, LI, SE);
-
-    Changed |= processLoop(L);
+    bool LoopChanged = formLCSSARecursively(*L, *DT, LI, SE);
+    LoopChanged |= processLoop(L);
+    if (LoopChanged) {
+      ChangedLoops.push_back(L);
+      Changed = true;
+    }
   }
 
   // Process each loop nest in the function.
@@ -7611,6 +7618,9 @@ PreservedAnalyses LoopVectorizePass::run(Function &F,
     // only for non-VPlan-native path.
     // TODO: Preserve Loop and Dominator analyses for VPlan-native path.
     if (!EnableVPlanNativePath) {
+      // Keep the loop access info of the loop nests that weren't changed for
+      // the passes that follow.
+      PA = invalidateChangedLoopNests(LAM, SE, ChangedLoops);
       PA.preserve<LoopAnalysis>();
       PA.preserve<DominatorTreeAnalysis>();
     }
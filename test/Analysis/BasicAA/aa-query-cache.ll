@@ -0,0 +1,33 @@
+; REQUIRES: asserts
+; RUN: opt -disable-output -stats -enable-aa-query-cache -aa-pipeline=basic-aa \
+; RUN:   -passes='aa-eval,aa-eval' < %s 2>&1 | FileCheck %s --check-prefix=REUSE
+; RUN: opt -disable-output -stats -enable-aa-query-cache -aa-pipeline=basic-aa \
+; RUN:   -passes='aa-eval,invalidate<aa-query-cache>,aa-eval' < %s 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=INVALIDATE
+; RUN: opt -disable-output -stats -enable-aa-query-cache -aa-pipeline=basic-aa \
+; RUN:   -passes='aa-eval,instcombine,aa-eval' < %s 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=CHANGED
+
+; The second aa-eval asks the same three queries as the first one. They are
+; answered from the cache unless it was invalidated in between, or a pass
+; changed the function. instcombine itself never reads the cache.
+
+; REUSE-DAG: 3 aa-query-cache - Number of alias queries answered from the cache
+; REUSE-DAG: 3 aa-query-cache - Number of alias queries not found in the cache
+
+; INVALIDATE-NOT: answered from the cache
+; INVALIDATE: 6 aa-query-cache - Number of alias queries not found in the cache
+
+; CHANGED-NOT: answered from the cache
+; CHANGED: 3 aa-query-cache - Number of cached alias queries dropped because the function changed
+; CHANGED: 6 aa-query-cache - Number of alias queries not found in the cache
+
+define i32 @f(i32* %a, i32* %b, i32* noalias %c) {
+  %x = load i32, i32* %a
+  %y = load i32, i32* %b
+  %z = load i32, i32* %c
+  %x0 = add i32 %x, 0
+  %s = add i32 %x0, %y
+  %t = add i32 %s, %z
+  ret i32 %t
+}
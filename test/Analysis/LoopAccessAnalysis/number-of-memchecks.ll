@@ -1,5 +1,7 @@
 ; RUN: opt -loop-accesses -analyze < %s | FileCheck %s
 ; RUN: opt -passes='require<scalar-evolution>,require<aa>,loop(print-access-info)' -disable-output  < %s 2>&1 | FileCheck %s
+; RUN: opt -loop-accesses -analyze -memory-check-group-by-base=false < %s \
+; RUN:     | FileCheck %s
 
 target datalayout = "e-m:e-i64:64-i128:128-n32:64-S128"
 target triple = "aarch64--linux-gnueabi"
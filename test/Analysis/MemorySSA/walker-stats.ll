@@ -0,0 +1,40 @@
+; RUN: opt -aa-pipeline=basic-aa -disable-output < %s 2>&1 \
+; RUN:   -passes='early-cse-memssa,print<memoryssa-walker-stats>' \
+; RUN:   | FileCheck %s --check-prefixes=CHECK,NOBUDGET
+; RUN: opt -aa-pipeline=basic-aa -disable-output < %s 2>&1 \
+; RUN:   -memssa-function-walk-budget=1 \
+; RUN:   -passes='early-cse-memssa,print<memoryssa-walker-stats>' \
+; RUN:   | FileCheck %s --check-prefixes=CHECK,BUDGET
+; RUN: opt -aa-pipeline=basic-aa -disable-output < %s 2>&1 \
+; RUN:   -memssa-clobber-cache=false \
+; RUN:   -passes='early-cse-memssa,print<memoryssa-walker-stats>' \
+; RUN:   | FileCheck %s --check-prefixes=CHECK,NOBUDGET,NOCACHE
+
+; EarlyCSE asks for the clobbers of %b and of both stores, because a store
+; separates them from the loads they are compared with. %b's access was
+; optimized when MemorySSA was built; the stores have to be walked, and with a
+; budget of one step the second walk is over budget.
+
+; CHECK-LABEL: MemorySSA walker statistics for function: f
+; NOBUDGET-NEXT: walks: {{[1-9][0-9]*}}
+; BUDGET-NEXT:   walks: {{[0-9]+}}
+; CHECK-NEXT:    walk steps: {{[0-9]+}}
+; NOBUDGET-NEXT: optimized access hits: {{[1-9][0-9]*}}
+; BUDGET-NEXT:   optimized access hits: {{[0-9]+}}
+; NOCACHE-NEXT:  clobber cache hits: 0
+; NOCACHE-NEXT:  clobber cache misses: 0
+; CHECK:         walks over budget:
+; NOBUDGET-SAME: {{ 0$}}
+; BUDGET-SAME:   {{ [1-9][0-9]*$}}
+
+define i32 @f(i32* noalias %p, i32* noalias %q, i32* noalias %r) {
+entry:
+  %a = load i32, i32* %p
+  %c = load i32, i32* %r
+  store i32 1, i32* %q
+  %b = load i32, i32* %p
+  store i32 %a, i32* %p
+  store i32 %c, i32* %r
+  %s = add i32 %a, %b
+  ret i32 %s
+}
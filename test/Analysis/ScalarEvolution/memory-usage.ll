@@ -0,0 +1,58 @@
+; RUN: opt < %s -passes='print<scalar-evolution>,print<scalar-evolution-memory>' \
+; RUN:     -disable-output 2>&1 | FileCheck %s
+
+; Bounding the range and backedge-taken count caches must not change the
+; results.
+; RUN: opt < %s -passes='print<scalar-evolution>' -disable-output 2>%t.unbounded
+; RUN: opt < %s -passes='print<scalar-evolution>' -disable-output \
+; RUN:     -scalar-evolution-derived-cache-limit=1 2>%t.bounded
+; RUN: diff %t.unbounded %t.bounded
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+
+; CHECK-LABEL: ScalarEvolution memory usage for function 'nested':
+; CHECK-NEXT: Cache{{ +}}Entries{{ +}}Bytes
+; CHECK-NEXT: SCEV nodes{{ +[1-9][0-9]* +[1-9][0-9]*$}}
+; CHECK-NEXT: SCEV predicates{{ +[0-9]+ +[0-9]+$}}
+; CHECK-NEXT: ValueExprMap{{ +[1-9][0-9]* +[1-9][0-9]*$}}
+; CHECK-NEXT: ExprValueMap{{ +[0-9]+ +[0-9]+$}}
+; CHECK-NEXT: HasRecMap{{ +[0-9]+ +[0-9]+$}}
+; CHECK-NEXT: MinTrailingZerosCache{{ +[0-9]+ +[0-9]+$}}
+; CHECK-NEXT: BackedgeTakenCounts{{ +}}2{{ +[1-9][0-9]*$}}
+; CHECK-NEXT: PredicatedBackedgeTakenCounts{{ +[0-9]+ +[0-9]+$}}
+; CHECK-NEXT: ConstantEvolutionLoopExitValue{{ +[0-9]+ +[0-9]+$}}
+; CHECK-NEXT: ValuesAtScopes{{ +[0-9]+ +[0-9]+$}}
+; CHECK-NEXT: LoopDispositions{{ +[0-9]+ +[0-9]+$}}
+; CHECK-NEXT: LoopPropertiesCache{{ +[0-9]+ +[0-9]+$}}
+; CHECK-NEXT: BlockDispositions{{ +[0-9]+ +[0-9]+$}}
+; CHECK-NEXT: UnsignedRanges{{ +[1-9][0-9]* +[1-9][0-9]*$}}
+; CHECK-NEXT: SignedRanges{{ +[1-9][0-9]* +[1-9][0-9]*$}}
+; CHECK-NEXT: LoopUsers{{ +[0-9]+ +[0-9]+$}}
+; CHECK-NEXT: PredicatedSCEVRewrites{{ +[0-9]+ +[0-9]+$}}
+; CHECK-NEXT: Total{{ +[1-9][0-9]*$}}
+
+define void @nested(i32* %p, i64 %n) {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %idx = add i64 %i, %j
+  %addr = getelementptr inbounds i32, i32* %p, i64 %idx
+  store i32 0, i32* %addr
+  %j.next = add nuw nsw i64 %j, 1
+  %inner.cond = icmp ult i64 %j.next, 100
+  br i1 %inner.cond, label %inner, label %outer.latch
+
+outer.latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %outer.cond = icmp ult i64 %i.next, %n
+  br i1 %outer.cond, label %outer, label %exit
+
+exit:
+  ret void
+}
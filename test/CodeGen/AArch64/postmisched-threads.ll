@@ -0,0 +1,42 @@
+; Scheduling blocks on several threads must give the same result as the
+; serial post-RA machine scheduler, however the blocks are grouped into tasks.
+; RUN: llc < %s -mtriple=aarch64-unknown-linux-gnu -mcpu=cortex-a57 \
+; RUN:   -enable-post-misched -o %t.serial.s
+; RUN: llc < %s -mtriple=aarch64-unknown-linux-gnu -mcpu=cortex-a57 \
+; RUN:   -enable-post-misched -postmisched-threads=4 \
+; RUN:   -postmisched-blocks-per-task=1 -o %t.parallel.s
+; RUN: diff %t.serial.s %t.parallel.s
+; RUN: llc < %s -mtriple=aarch64-unknown-linux-gnu -mcpu=cortex-a57 \
+; RUN:   -enable-post-misched -postmisched-threads=2 \
+; RUN:   -postmisched-blocks-per-task=3 -o %t.grouped.s
+; RUN: diff %t.serial.s %t.grouped.s
+
+define i64 @blocks(i64* %p, i64* %q, i1 %c) {
+entry:
+  %a = load i64, i64* %p
+  %q1 = getelementptr i64, i64* %q, i64 1
+  %b = load i64, i64* %q1
+  %m = mul i64 %a, %b
+  br i1 %c, label %then, label %else
+
+then:
+  %p2 = getelementptr i64, i64* %p, i64 2
+  %x = load i64, i64* %p2
+  %p3 = getelementptr i64, i64* %p, i64 3
+  %y = load i64, i64* %p3
+  %s = add i64 %x, %m
+  %t = mul i64 %s, %y
+  br label %exit
+
+else:
+  %q2 = getelementptr i64, i64* %q, i64 2
+  %z = load i64, i64* %q2
+  %d = sub i64 %z, %m
+  %e = mul i64 %d, %a
+  store i64 %e, i64* %q
+  br label %exit
+
+exit:
+  %r = phi i64 [ %t, %then ], [ %e, %else ]
+  ret i64 %r
+}
@@ -0,0 +1,45 @@
+; RUN: llc < %s -mtriple=x86_64-unknown-unknown | FileCheck %s
+; RUN: llc < %s -mtriple=x86_64-unknown-unknown -combiner-precise-worklist | FileCheck %s
+; RUN: llc < %s -mtriple=x86_64-unknown-unknown -combiner-max-node-revisits=1 | FileCheck %s
+; RUN: llc < %s -mtriple=x86_64-unknown-unknown -combiner-print-node-stats \
+; RUN:   -o /dev/null 2>&1 | FileCheck %s --check-prefix=STATS
+; RUN: llc < %s -mtriple=x86_64-unknown-unknown -combiner-print-node-stats \
+; RUN:   -combiner-max-node-revisits=1 -o /dev/null 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=CAP
+
+; The worklist tuning options must not change the result of simple folds.
+; Neither add is folded while the DAG is built; the combiner reassociates the
+; two into a single add of the constant 3.
+
+define i32 @add_add(i32 %a) {
+; CHECK-LABEL: add_add:
+; CHECK:       leal 3(%rdi), %eax
+; CHECK-NEXT:  retq
+  %b = add i32 %a, 1
+  %c = add i32 %b, 2
+  ret i32 %c
+}
+
+; STATS:      === DAG combiner node statistics for 'add_add'
+; STATS-NEXT: Node Visits Revisits Skipped Combines
+; STATS:      add {{[1-9][0-9]*}} {{[0-9]+}} 0 {{[1-9][0-9]*}}
+
+; The add is visited before its operands, and again after each of them is
+; combined. Without a cap it is revisited twice; with a cap of one revisit,
+; the last visit is skipped.
+
+define i32 @shl_add(i32 %a, i32 %b) {
+; CHECK-LABEL: shl_add:
+  %a1 = shl i32 %a, 1
+  %a2 = shl i32 %a1, 1
+  %b1 = shl i32 %b, 1
+  %b2 = shl i32 %b1, 1
+  %s = add i32 %a2, %b2
+  ret i32 %s
+}
+
+; STATS:      === DAG combiner node statistics for 'shl_add'
+; STATS:      add {{[0-9]+}} {{[2-9]|[1-9][0-9]+}} 0
+
+; CAP:        === DAG combiner node statistics for 'shl_add'
+; CAP:        add {{[0-9]+}} 1 {{[1-9][0-9]*}}
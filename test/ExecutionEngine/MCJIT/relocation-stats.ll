@@ -0,0 +1,22 @@
+; RUN: %lli -print-relocation-stats %s 2>&1 | FileCheck %s
+;
+; The call to abs is resolved against the host process, and the references to
+; @table are relocations within the object.
+
+; CHECK: RuntimeDyld: {{[1-9][0-9]*}} relocations applied in
+; CHECK: {{[1-9][0-9]*}} external symbols resolved in {{[1-9][0-9]*}} lookups
+
+@table = global [2 x i32] [i32 -3, i32 3]
+
+declare i32 @abs(i32)
+
+define i32 @main() {
+entry:
+  %p0 = getelementptr [2 x i32], [2 x i32]* @table, i32 0, i32 0
+  %p1 = getelementptr [2 x i32], [2 x i32]* @table, i32 0, i32 1
+  %a = load i32, i32* %p0
+  %b = load i32, i32* %p1
+  %c = call i32 @abs(i32 %a)
+  %d = sub i32 %c, %b
+  ret i32 %d
+}
@@ -0,0 +1,26 @@
+; RUN: lli -jit-kind=orc-lazy -jit-slab-size=1024 %s
+; RUN: lli -jit-kind=orc-lazy -jit-slab-size=1024 -jit-huge-pages \
+; RUN:     -print-jit-memory-stats %s 2>&1 | FileCheck %s
+;
+; Each function is emitted as an object of its own. With -jit-slab-size their
+; code shares a single slab, and every object is finalized on its own.
+
+; CHECK: JIT slab allocator: {{[12]}} slabs, {{[0-9]+}} bytes mapped (huge pages)
+; CHECK: 3 finalizations
+
+define i32 @foo() {
+entry:
+  ret i32 0
+}
+
+define i32 @bar() {
+entry:
+  %0 = call i32() @foo()
+  ret i32 %0
+}
+
+define i32 @main(i32 %argc, i8** nocapture readnone %argv) {
+entry:
+  %0 = call i32() @bar()
+  ret i32 %0
+}
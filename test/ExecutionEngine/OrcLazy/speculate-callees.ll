@@ -0,0 +1,43 @@
+; RUN: lli -jit-kind=orc-lazy -speculate-callees=2 %s
+; RUN: lli -jit-kind=orc-lazy -speculate-callees=2 -stats %s 2>&1 \
+; RUN:     | FileCheck %s
+; RUN: lli -jit-kind=orc-lazy -speculate-callees=2 -compile-threads=2 %s
+; REQUIRES: asserts
+;
+; Compiling @main speculatively compiles both of its callees, but only @foo
+; is called. @baz is only called by @foo, so it is left to compile on demand
+; rather than being speculated by the speculative compile of @foo.
+
+; CHECK: 2 orc - Number of functions compiled speculatively
+; CHECK: 1 orc - Number of speculatively compiled functions that were called
+; CHECK: 1 orc - Number of speculatively compiled functions that were never called
+
+define i32 @baz() {
+entry:
+  ret i32 0
+}
+
+define i32 @foo() {
+entry:
+  %r = call i32 @baz()
+  ret i32 %r
+}
+
+define i32 @bar() {
+entry:
+  ret i32 1
+}
+
+define i32 @main(i32 %argc, i8** nocapture readnone %argv) {
+entry:
+  %c = icmp eq i32 %argc, 100
+  br i1 %c, label %rare, label %common
+
+rare:
+  %b = call i32 @bar()
+  ret i32 %b
+
+common:
+  %f = call i32 @foo()
+  ret i32 %f
+}
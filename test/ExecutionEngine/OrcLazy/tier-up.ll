@@ -0,0 +1,37 @@
+; RUN: lli -jit-kind=orc-lazy -tier-up-threshold=10 %s
+; RUN: lli -jit-kind=orc-lazy -tier-up-threshold=10 -stats %s 2>&1 \
+; RUN:     | FileCheck %s
+; REQUIRES: asserts
+;
+; @foo is called through its stub 100 times, so it is recompiled once its
+; counter reaches the threshold. @main is only called once and stays at the
+; first tier. Later calls must still compute the same result.
+
+; CHECK: 2 orc - Number of functions emitted with call counters
+; CHECK: 1 orc - Number of hot functions recompiled by the optimizing layer
+
+define i32 @foo(i32 %x) {
+entry:
+  %r = add i32 %x, 1
+  ret i32 %r
+}
+
+define i32 @main(i32 %argc, i8** nocapture readnone %argv) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %sum = phi i32 [ 0, %entry ], [ %sum.next, %loop ]
+  %v = call i32 @foo(i32 %i)
+  %sum.next = add i32 %sum, %v
+  %i.next = add i32 %i, 1
+  %done = icmp eq i32 %i.next, 100
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ; sum(1..100) = 5050
+  %ok = icmp eq i32 %sum.next, 5050
+  %ret = select i1 %ok, i32 0, i32 1
+  ret i32 %ret
+}
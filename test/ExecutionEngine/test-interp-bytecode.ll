@@ -0,0 +1,245 @@
+; RUN: %lli -force-interpreter %s
+; RUN: %lli -force-interpreter -interpreter-bytecode=false %s
+
+; Functions the interpreter lowers to bytecode must compute what the
+; instruction walker computes.  main returns the number of failed checks.
+
+%pair = type { i8, i32 }
+
+@table = global [4 x i16] [i16 1, i16 -2, i16 300, i16 -400]
+@counter = global i32 0
+
+declare void @llvm.memset.p0i8.i64(i8*, i8, i64, i1)
+
+define i32 @fib(i32 %n) {
+entry:
+  %small = icmp slt i32 %n, 2
+  br i1 %small, label %done, label %recurse
+
+recurse:
+  %n1 = sub i32 %n, 1
+  %f1 = call i32 @fib(i32 %n1)
+  %n2 = sub i32 %n, 2
+  %f2 = call i32 @fib(i32 %n2)
+  %sum = add i32 %f1, %f2
+  ret i32 %sum
+
+done:
+  ret i32 %n
+}
+
+; PHIs that read each other see the values from before the branch.
+define i32 @swap_phis(i32 %a, i32 %b, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %x = phi i32 [ %a, %entry ], [ %y, %loop ]
+  %y = phi i32 [ %b, %entry ], [ %x, %loop ]
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %count = load i32, i32* @counter
+  %count.next = add i32 %count, 1
+  store i32 %count.next, i32* @counter
+  %i.next = add i32 %i, 1
+  %again = icmp ult i32 %i.next, %n
+  br i1 %again, label %loop, label %exit
+
+exit:
+  %r = sub i32 %x, %y
+  ret i32 %r
+}
+
+define i32 @classify(i32 %x) {
+entry:
+  switch i32 %x, label %other [ i32 0, label %zero
+                                i32 7, label %seven
+                                i32 -1, label %seven ]
+
+zero:
+  br label %done
+
+seven:
+  br label %done
+
+other:
+  br label %done
+
+done:
+  %r = phi i32 [ 10, %zero ], [ 20, %seven ], [ 30, %other ]
+  ret i32 %r
+}
+
+; Vectors have no bytecode, so this is interpreted instruction by instruction
+; even when called from bytecode.
+define i32 @vector_lane(i32 %a) {
+  %v = insertelement <2 x i32> <i32 1, i32 2>, i32 %a, i32 1
+  %e = extractelement <2 x i32> %v, i32 1
+  ret i32 %e
+}
+
+define i1 @check_narrow(i8 %x, i8 %y, i16 %z) {
+  %sum = add i8 %x, %y
+  %e0 = icmp ne i8 %sum, 44
+  %sdiv = sdiv i8 %x, 3
+  %e1 = icmp ne i8 %sdiv, -18
+  %ashr = ashr i8 %x, 2
+  %e2 = icmp ne i8 %ashr, -14
+  %slt = icmp slt i8 %x, %y
+  %e3 = xor i1 %slt, true
+  %e4 = icmp ult i8 %x, %y
+  %sext = sext i8 %x to i32
+  %e5 = icmp ne i32 %sext, -56
+  %zext = zext i8 %x to i32
+  %e6 = icmp ne i32 %zext, 200
+  %trunc = trunc i16 %z to i8
+  %e7 = icmp ne i8 %trunc, 52
+  %srem = srem i16 %z, -7
+  %e8 = icmp ne i16 %srem, 5
+  %shl = shl i16 %z, 4
+  %e9 = icmp ne i16 %shl, 9024
+  %sel = select i1 %slt, i8 %y, i8 %x
+  %e10 = icmp ne i8 %sel, 100
+
+  %r0 = or i1 %e0, %e1
+  %r1 = or i1 %r0, %e2
+  %r2 = or i1 %r1, %e3
+  %r3 = or i1 %r2, %e4
+  %r4 = or i1 %r3, %e5
+  %r5 = or i1 %r4, %e6
+  %r6 = or i1 %r5, %e7
+  %r7 = or i1 %r6, %e8
+  %r8 = or i1 %r7, %e9
+  %r9 = or i1 %r8, %e10
+  ret i1 %r9
+}
+
+define i1 @check_fp(float %f, double %d) {
+  %fm = fmul float %f, 4.0
+  %e0 = fcmp une float %fm, 6.0
+  %dd = fdiv double %d, 0.5
+  %e1 = fcmp une double %dd, -4.5
+  %ext = fpext float %f to double
+  %sum = fadd double %ext, %d
+  %e2 = fcmp une double %sum, -0.75
+  %i = fptosi double %d to i32
+  %e3 = icmp ne i32 %i, -2
+  %u = fptoui float %fm to i8
+  %e4 = icmp ne i8 %u, 6
+  %back = sitofp i32 %i to float
+  %e5 = fcmp une float %back, -2.0
+  %nan = fdiv double 0.0, 0.0
+  %e6 = fcmp ord double %nan, %d
+  %rem = frem double 7.5, 2.0
+  %e7 = fcmp une double %rem, 1.5
+  %bits = bitcast float %f to i32
+  %e8 = icmp ne i32 %bits, 1069547520
+  %tr = fptrunc double %d to float
+  %e9 = fcmp one float %tr, -2.25
+
+  %r0 = or i1 %e0, %e1
+  %r1 = or i1 %r0, %e2
+  %r2 = or i1 %r1, %e3
+  %r3 = or i1 %r2, %e4
+  %r4 = or i1 %r3, %e5
+  %r5 = or i1 %r4, %e6
+  %r6 = or i1 %r5, %e7
+  %r7 = or i1 %r6, %e8
+  %r8 = or i1 %r7, %e9
+  ret i1 %r8
+}
+
+define i1 @check_memory(i64 %idx) {
+  %p = alloca %pair
+  %f0 = getelementptr %pair, %pair* %p, i32 0, i32 0
+  %f1 = getelementptr %pair, %pair* %p, i32 0, i32 1
+  store i8 -1, i8* %f0
+  store i32 123456, i32* %f1
+  %v0 = load i8, i8* %f0
+  %e0 = icmp ne i8 %v0, -1
+  %v1 = load i32, i32* %f1
+  %e1 = icmp ne i32 %v1, 123456
+
+  %t = getelementptr [4 x i16], [4 x i16]* @table, i64 0, i64 %idx
+  %tv = load i16, i16* %t
+  %e2 = icmp ne i16 %tv, 300
+  %neg = sub i64 1, %idx
+  %neg32 = trunc i64 %neg to i32
+  %t2 = getelementptr i16, i16* %t, i32 %neg32
+  %tv2 = load i16, i16* %t2
+  %e3 = icmp ne i16 %tv2, -2
+
+  %w = alloca i24
+  store i24 -5, i24* %w
+  %wv = load i24, i24* %w
+  %e4 = icmp ne i24 %wv, -5
+
+  %buf = alloca [8 x i8]
+  %b = getelementptr [8 x i8], [8 x i8]* %buf, i32 0, i32 0
+  call void @llvm.memset.p0i8.i64(i8* %b, i8 7, i64 8, i1 false)
+  %b5 = getelementptr i8, i8* %b, i32 5
+  %bv = load i8, i8* %b5
+  %e5 = icmp ne i8 %bv, 7
+  %pi = ptrtoint i8* %b to i64
+  %pi3 = add i64 %pi, 3
+  %bp = inttoptr i64 %pi3 to i8*
+  %bpv = load i8, i8* %bp
+  %e6 = icmp ne i8 %bpv, 7
+
+  %r0 = or i1 %e0, %e1
+  %r1 = or i1 %r0, %e2
+  %r2 = or i1 %r1, %e3
+  %r3 = or i1 %r2, %e4
+  %r4 = or i1 %r3, %e5
+  %r5 = or i1 %r4, %e6
+  ret i1 %r5
+}
+
+define i32 @main() {
+  %fib = call i32 @fib(i32 15)
+  %e0 = icmp ne i32 %fib, 610
+  %swap3 = call i32 @swap_phis(i32 10, i32 3, i32 3)
+  %e1 = icmp ne i32 %swap3, 7
+  %swap2 = call i32 @swap_phis(i32 10, i32 3, i32 2)
+  %e2 = icmp ne i32 %swap2, -7
+  %count = load i32, i32* @counter
+  %e3 = icmp ne i32 %count, 5
+  %c0 = call i32 @classify(i32 0)
+  %e4 = icmp ne i32 %c0, 10
+  %cm1 = call i32 @classify(i32 -1)
+  %e5 = icmp ne i32 %cm1, 20
+  %c5 = call i32 @classify(i32 5)
+  %e6 = icmp ne i32 %c5, 30
+  %fp = select i1 %e0, i32 (i32)* @fib, i32 (i32)* @classify
+  %c7 = call i32 %fp(i32 7)
+  %e7 = icmp ne i32 %c7, 20
+  %lane = call i32 @vector_lane(i32 5)
+  %e8 = icmp ne i32 %lane, 5
+  %e9 = call i1 @check_narrow(i8 200, i8 100, i16 4660)
+  %e10 = call i1 @check_fp(float 1.5, double -2.25)
+  %e11 = call i1 @check_memory(i64 2)
+
+  %n0 = zext i1 %e0 to i32
+  %n1 = zext i1 %e1 to i32
+  %n2 = zext i1 %e2 to i32
+  %n3 = zext i1 %e3 to i32
+  %n4 = zext i1 %e4 to i32
+  %n5 = zext i1 %e5 to i32
+  %n6 = zext i1 %e6 to i32
+  %n7 = zext i1 %e7 to i32
+  %n8 = zext i1 %e8 to i32
+  %n9 = zext i1 %e9 to i32
+  %n10 = zext i1 %e10 to i32
+  %n11 = zext i1 %e11 to i32
+  %s0 = add i32 %n0, %n1
+  %s1 = add i32 %s0, %n2
+  %s2 = add i32 %s1, %n3
+  %s3 = add i32 %s2, %n4
+  %s4 = add i32 %s3, %n5
+  %s5 = add i32 %s4, %n6
+  %s6 = add i32 %s5, %n7
+  %s7 = add i32 %s6, %n8
+  %s8 = add i32 %s7, %n9
+  %s9 = add i32 %s8, %n10
+  %s10 = add i32 %s9, %n11
+  ret i32 %s10
+}
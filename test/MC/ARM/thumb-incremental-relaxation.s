@@ -0,0 +1,29 @@
+@ RUN: llvm-mc -filetype=obj -triple=thumbv7-unknown-linux-gnueabi %s -o %t1
+@ RUN: llvm-mc -filetype=obj -triple=thumbv7-unknown-linux-gnueabi %s -o %t2 \
+@ RUN:   -mc-incremental-relaxation=false
+@ RUN: cmp %t1 %t2
+@ RUN: llvm-objdump -d -triple=thumbv7-unknown-linux-gnueabi %t1 | FileCheck %s
+
+@ Relaxing the branch to far moves the literal load from offset 2 to offset 4.
+@ Nothing between the load and its literal changes size, but the load's PC is
+@ aligned down to 4 bytes, so the literal ends up misaligned relative to it and
+@ the load has to be relaxed in the second round.
+
+	.syntax unified
+	.text
+	.thumb
+	.p2align 2
+	.globl	foo
+	.type	foo,%function
+	.thumb_func
+foo:
+@ CHECK-LABEL: foo:
+@ CHECK-NEXT: b.w
+	b	far
+@ CHECK-NEXT: ldr.w r0, [pc
+	ldr	r0, lit
+lit:
+	.short	0
+	.space	4096
+far:
+	bx	lr
@@ -0,0 +1,53 @@
+# RUN: llvm-mc -filetype=obj -triple=x86_64-unknown-unknown %s -o %t1
+# RUN: llvm-mc -filetype=obj -triple=x86_64-unknown-unknown %s -o %t2 \
+# RUN:   -mc-incremental-relaxation=false
+# RUN: cmp %t1 %t2
+# RUN: llvm-objdump -d %t1 | FileCheck %s
+
+# Only relaxing the jump to far pushes done out of range of the first jump, so
+# the second round has to revisit it. That in turn grows the alignment before
+# near and must not change the encoding of the jump to near.
+
+	.text
+	.globl	foo
+foo:
+# CHECK-LABEL: foo:
+# CHECK-NEXT: e9 {{.*}} jmp
+	jmp	done
+	.space	90, 0x90
+# CHECK:      eb {{.*}} jmp
+	jmp	near
+	.p2align	4, 0x90
+near:
+	.space	20, 0x90
+# CHECK:      e9 {{.*}} jmp
+	jmp	far
+	.space	9, 0x90
+done:
+	retq
+	.space	130, 0x90
+far:
+	retq
+
+# The fill is sized by the jump to far2 before it, and lies before the range
+# of the jump to near2. Relaxing the jump to far2 grows the fill, which shifts
+# that range and grows the alignment inside it enough to push near2 out of
+# range.
+
+	.section	.text.fill,"ax",@progbits
+	.globl	bar
+bar:
+start_of_j:
+# CHECK-LABEL: Disassembly of section .text.fill:
+# CHECK:      e9 {{.*}} jmp {{.*}} <far2>
+	jmp	far2
+end_of_j:
+	.fill	(end_of_j - start_of_j) * 8, 1, 0x90
+# CHECK:      e9 {{.*}} jmp {{.*}} <near2>
+	jmp	near2
+	.space	120, 0x90
+	.p2align	4, 0x90
+near2:
+	.space	130, 0x90
+far2:
+	retq
@@ -0,0 +1,52 @@
+; Check the analysis reuse report for a pipeline that throws away a dominator
+; tree without changing the function.
+
+; RUN: opt -disable-output -disable-verify %s -analysis-reuse-report=%t.json \
+; RUN:     -passes='function(require<domtree>,invalidate<domtree>,require<domtree>)'
+; RUN: FileCheck %s < %t.json
+; RUN: FileCheck %s --check-prefix=NOMGR < %t.json
+
+; The function pass manager abandons the dominator tree again after its last
+; pass, because invalidate<domtree> did not preserve it. That invalidation is
+; charged to invalidate<domtree>, not to the pass manager.
+; NOMGR-NOT: "pass": "PassManager<
+
+; CHECK: "analyses": [
+; CHECK: "analysis": "DominatorTreeAnalysis",
+; CHECK-NEXT: "compute_seconds": {{.*}},
+; CHECK-NEXT: "computed": 2,
+; CHECK-NEXT: "invalidated": 1,
+; CHECK-NEXT: "recomputed": 1
+
+; CHECK: "over_invalidating_passes": [
+; CHECK-NEXT: {
+; CHECK-NEXT: "invalidated_analyses": [
+; CHECK-NEXT: "DominatorTreeAnalysis"
+; CHECK-NEXT: ],
+; CHECK-NEXT: "invalidations_without_change": 1,
+; CHECK-NEXT: "pass": "InvalidateAnalysisPass<{{.*}}DominatorTreeAnalysis>",
+; CHECK-NEXT: "runs": 1,
+; CHECK-NEXT: "runs_without_change": 1,
+; CHECK-NEXT: "wasted_seconds": {{.*}}
+; CHECK-NEXT: }
+; CHECK-NEXT: ],
+
+; CHECK: "pairs": [
+; CHECK: "analysis": "DominatorTreeAnalysis",
+; CHECK-NEXT: "compute_seconds": 0,
+; CHECK-NEXT: "computed": 0,
+; CHECK-NEXT: "invalidated": 1,
+; CHECK-NEXT: "invalidated_without_change": 1,
+; CHECK-NEXT: "pass": "InvalidateAnalysisPass<{{.*}}DominatorTreeAnalysis>",
+; CHECK-NEXT: "recompute_seconds": {{.*}},
+; CHECK-NEXT: "recomputed": 1,
+; CHECK: "analysis": "DominatorTreeAnalysis",
+; CHECK-NEXT: "compute_seconds": {{.*}},
+; CHECK-NEXT: "computed": 2,
+; CHECK-NEXT: "invalidated": 0,
+; CHECK-NEXT: "invalidated_without_change": 0,
+; CHECK-NEXT: "pass": "RequireAnalysisPass<{{.*}}DominatorTreeAnalysis{{.*}}>",
+
+define void @f() {
+  ret void
+}
@@ -0,0 +1,94 @@
+; Check that a parallel-function pipeline merges the optimized partitions back
+; into the module, and that the output does not depend on thread scheduling.
+; It is not expected to match the serial function pipeline in general.
+
+; RUN: opt -S -passes='parallel-function(instcombine,simplify-cfg)' \
+; RUN:     -parallel-function-threads=2 %s -o %t.parallel2
+; RUN: opt -S -passes='parallel-function(instcombine,simplify-cfg)' \
+; RUN:     -parallel-function-threads=4 %s -o %t.parallel4
+; RUN: opt -S -passes='parallel-function(instcombine,simplify-cfg)' \
+; RUN:     -parallel-function-threads=4 %s -o %t.parallel4.again
+; RUN: diff %t.parallel4 %t.parallel4.again
+; RUN: FileCheck %s < %t.parallel2
+; RUN: FileCheck %s < %t.parallel4
+
+; RUN: not opt -disable-output -passes='parallel-function(no-such-pass)' %s \
+; RUN:     2>&1 | FileCheck %s --check-prefix=BAD
+; BAD: unknown function pass 'no-such-pass'
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+
+$comdat_fn = comdat any
+
+%struct.S = type { i32, i32 }
+
+@table = internal constant [2 x i32] [i32 3, i32 4]
+@g = global %struct.S zeroinitializer
+@hello = private constant [7 x i8] c"hello\0A\00"
+
+; InstCombine raises the alignment of @buf for the load in @load_buf; the
+; partition's copy of @buf must not be the only one that changes.
+; CHECK: @buf = dso_local global [8 x i8] zeroinitializer, align 4
+@buf = dso_local global [8 x i8] zeroinitializer, align 1
+
+; CHECK-LABEL: define internal i32 @local_fn(i32 %x)
+; CHECK-NEXT: ret i32 %x
+define internal i32 @local_fn(i32 %x) {
+  %a = add i32 %x, 0
+  ret i32 %a
+}
+
+; CHECK-LABEL: define linkonce_odr i32 @comdat_fn(i32 %x) comdat
+; CHECK-NEXT: %a = shl i32 %x, 1
+; CHECK-NEXT: ret i32 %a
+define linkonce_odr i32 @comdat_fn(i32 %x) comdat {
+  %a = mul i32 %x, 2
+  ret i32 %a
+}
+
+; CHECK-LABEL: define i32 @load_table()
+; CHECK-NEXT: ret i32 4
+define i32 @load_table() {
+  %p = getelementptr [2 x i32], [2 x i32]* @table, i32 0, i32 1
+  %v = load i32, i32* %p
+  ret i32 %v
+}
+
+; CHECK-LABEL: define i32 @caller(i32 %x)
+; CHECK-NEXT: entry:
+; CHECK-NEXT: %a = call i32 @local_fn(i32 %x)
+; CHECK-NEXT: %b = call i32 @comdat_fn(i32 %a)
+; CHECK-NEXT: store i32 %b, i32* getelementptr inbounds (%struct.S, %struct.S* @g, i64 0, i32 1)
+; CHECK-NEXT: ret i32 %b
+define i32 @caller(i32 %x) {
+entry:
+  %a = call i32 @local_fn(i32 %x)
+  br label %next
+
+next:
+  %b = call i32 @comdat_fn(i32 %a)
+  %f = getelementptr %struct.S, %struct.S* @g, i32 0, i32 1
+  store i32 %b, i32* %f
+  ret i32 %b
+}
+
+; CHECK-LABEL: define i32 @load_buf()
+; CHECK-NEXT: %v = load i32, i32* bitcast ([8 x i8]* @buf to i32*), align 4
+define i32 @load_buf() {
+  %v = load i32, i32* bitcast ([8 x i8]* @buf to i32*), align 1
+  ret i32 %v
+}
+
+; Turning the printf into a puts infers attributes on the existing puts
+; declaration, which has to keep them.
+; CHECK-LABEL: define void @say_hello()
+; CHECK-NEXT: call i32 @puts(
+define void @say_hello() {
+  %s = getelementptr [7 x i8], [7 x i8]* @hello, i32 0, i32 0
+  call i32 (i8*, ...) @printf(i8* %s)
+  ret void
+}
+
+; CHECK: declare i32 @puts(i8* nocapture readonly)
+declare i32 @printf(i8*, ...)
+declare i32 @puts(i8*)
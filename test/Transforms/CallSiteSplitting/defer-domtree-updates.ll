@@ -0,0 +1,55 @@
+; RUN: opt < %s -passes='function(callsite-splitting,verify<domtree>)' \
+; RUN:     -defer-domtree-updates -S | FileCheck %s
+; RUN: opt < %s -passes='function(callsite-splitting,verify<domtree>)' \
+; RUN:     -defer-domtree-updates -disable-output -stats 2>&1 \
+; RUN:     | FileCheck %s --check-prefix=STATS
+; REQUIRES: asserts
+
+; The dominator tree updates for the split are left to the tree. The analysis
+; manager flushes them when it hands the tree to the verifier.
+
+target datalayout = "e-m:e-i8:8:32-i16:16:32-i64:64-i128:128-n32:64-S128"
+target triple = "aarch64-linaro-linux-gnueabi"
+
+; CHECK-LABEL: @test_eq_eq
+; CHECK-LABEL: Header.split:
+; CHECK: %[[CALL1:.*]] = call i32 @callee(i32* null, i32 %v, i32 1)
+; CHECK-LABEL: TBB.split:
+; CHECK: %[[CALL2:.*]] = call i32 @callee(i32* nonnull %a, i32 1, i32 2)
+; CHECK-LABEL: Tail
+; CHECK: %[[MERGED:.*]] = phi i32 [ %[[CALL1]], %Header.split ], [ %[[CALL2]], %TBB.split ]
+; CHECK: ret i32 %[[MERGED]]
+define i32 @test_eq_eq(i32* %a, i32 %v) {
+Header:
+  %tobool1 = icmp eq i32* %a, null
+  br i1 %tobool1, label %Tail, label %TBB
+
+TBB:
+  %cmp = icmp eq i32 %v, 1
+  br i1 %cmp, label %Tail, label %End
+
+Tail:
+  %p = phi i32[1,%Header], [2, %TBB]
+  %r = call i32 @callee(i32* %a, i32 %v, i32 %p)
+  ret i32 %r
+
+End:
+  ret i32 %v
+}
+
+define i32 @callee(i32* %a, i32 %v, i32 %p) {
+entry:
+  %c = icmp ne i32* %a, null
+  br i1 %c, label %BB1, label %BB2
+
+BB1:
+  call void @dummy(i32* %a, i32 %p)
+  br label %BB2
+
+BB2:
+  ret i32 %v
+}
+
+declare void @dummy(i32*, i32)
+
+; STATS: {{[1-9][0-9]*}} dom-tree-updater - Number of updates deferred until a tree is queried
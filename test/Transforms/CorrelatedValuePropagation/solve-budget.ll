@@ -0,0 +1,41 @@
+; RUN: opt < %s -correlated-propagation -S | FileCheck %s --check-prefix=DEFAULT
+; RUN: opt < %s -passes=correlated-propagation -S | FileCheck %s --check-prefix=DEFAULT
+; RUN: opt < %s -correlated-propagation -lvi-function-solve-budget=1 -S \
+; RUN:     | FileCheck %s --check-prefix=BUDGET
+
+; Proving the comparison requires walking back through the chain of blocks to
+; the branch in %entry, which takes more solver steps than the budget allows.
+
+define i1 @chain(i32 %x) {
+; DEFAULT-LABEL: @chain(
+; DEFAULT:       then:
+; DEFAULT-NEXT:    ret i1 true
+; BUDGET-LABEL: @chain(
+; BUDGET:       then:
+; BUDGET-NEXT:    [[CMP:%.*]] = icmp ult i32 %x, 20
+; BUDGET-NEXT:    ret i1 [[CMP]]
+entry:
+  %c = icmp ult i32 %x, 10
+  br i1 %c, label %b1, label %else
+
+b1:
+  call void @f()
+  br label %b2
+
+b2:
+  call void @f()
+  br label %b3
+
+b3:
+  call void @f()
+  br label %then
+
+then:
+  %cmp = icmp ult i32 %x, 20
+  ret i1 %cmp
+
+else:
+  ret i1 false
+}
+
+declare void @f()
@@ -0,0 +1,74 @@
+; RUN: opt < %s -passes='instcombine,sroa,instcombine' -S \
+; RUN:     -instcombine-incremental | FileCheck %s
+; RUN: opt < %s -passes='instcombine,sroa,instcombine' -disable-output \
+; RUN:     -instcombine-incremental -stats 2>&1 | FileCheck %s --check-prefix=STATS
+; RUN: opt < %s -passes='instcombine,sroa,instcombine' -disable-output \
+; RUN:     -stats 2>&1 | FileCheck %s --check-prefix=FULL
+; RUN: opt < %s -passes='instcombine,sroa,instcombine' -disable-output \
+; RUN:     -instcombine-incremental -debug-only=instcombine 2>&1 \
+; RUN:     | FileCheck %s --check-prefix=DEBUG
+; REQUIRES: asserts
+
+; Instcombine can't forward the store to the load in another block, but once
+; SROA has promoted the alloca, the subtraction it left behind is touched and
+; the second instcombine folds it.
+
+; CHECK-LABEL: define i32 @promoted(
+; CHECK-NEXT: entry:
+; CHECK-NEXT: br label %next
+; CHECK: next:
+; CHECK-NEXT: ret i32 0
+define i32 @promoted(i32 %x) {
+entry:
+  %p = alloca i32
+  store i32 %x, i32* %p
+  br label %next
+
+next:
+  %v = load i32, i32* %p
+  %s = sub i32 %v, %x
+  ret i32 %s
+}
+
+; SROA only changes the operand of %m, but the fold it enables is two users
+; further down: %m now has four trailing zeros, and so does %m2.
+
+; CHECK-LABEL: define i32 @two_steps(
+; CHECK: next:
+; CHECK-NEXT: ret i32 0
+define i32 @two_steps(i32 %x, i32 %y, i32 %z) {
+entry:
+  %p = alloca i32
+  %xs = shl i32 %x, 4
+  store i32 %xs, i32* %p
+  br label %next
+
+next:
+  %v = load i32, i32* %p
+  %m = mul i32 %v, %y
+  %m2 = mul i32 %m, %z
+  %r = and i32 %m2, 15
+  ret i32 %r
+}
+
+; Nothing touches this function between the instcombine runs, so the second
+; one doesn't visit any of its instructions. It has to stay the last function
+; for the DEBUG-NOT check.
+
+; DEBUG-LABEL: INSTCOMBINE ITERATION #1 on unchanged
+; DEBUG: IC: Visiting: %a = add i32 %x, %y
+; DEBUG-LABEL: INSTCOMBINE ITERATION #1 on unchanged
+; DEBUG-NOT: IC: Visiting
+
+; CHECK-LABEL: define i32 @unchanged(
+; CHECK-NEXT: %a = add i32 %x, %y
+; CHECK-NEXT: %b = mul i32 %a, %y
+; CHECK-NEXT: ret i32 %b
+define i32 @unchanged(i32 %x, i32 %y) {
+  %a = add i32 %x, %y
+  %b = mul i32 %a, %y
+  ret i32 %b
+}
+
+; STATS: {{[1-9][0-9]*}} instcombine - Number of untouched insts left off the worklist
+; FULL-NOT: Number of untouched insts left off the worklist
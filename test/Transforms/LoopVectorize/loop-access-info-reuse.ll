@@ -0,0 +1,51 @@
+; RUN: opt -passes='function(loop-vectorize,loop-load-elim)' \
+; RUN:     -force-vector-width=4 -force-vector-interleave=1 \
+; RUN:     -debug-pass-manager -disable-output < %s 2>&1 | FileCheck %s
+
+; Vectorizing the first loop only drops the analyses of its loop nest, so
+; loop-load-elim reuses the loop access info of the second loop that
+; loop-vectorize computed.
+
+; CHECK: Running pass: LoopVectorizePass on f
+; CHECK-DAG: Running analysis: LoopAccessAnalysis on vec
+; CHECK-DAG: Running analysis: LoopAccessAnalysis on dep
+; CHECK: Clearing all analysis results for: vec
+; CHECK-NOT: Clearing all analysis results for: dep
+; CHECK: Running pass: LoopLoadEliminationPass on f
+; CHECK-NOT: Running analysis: LoopAccessAnalysis on dep
+; CHECK: Finished llvm::Function pass manager run.
+
+define void @f(i32* noalias %a, i32* noalias %b, i32* noalias %c, i64 %n) {
+entry:
+  br label %vec
+
+vec:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %vec ]
+  %b.i = getelementptr inbounds i32, i32* %b, i64 %i
+  %x = load i32, i32* %b.i
+  %y = add i32 %x, 1
+  %a.i = getelementptr inbounds i32, i32* %a, i64 %i
+  store i32 %y, i32* %a.i
+  %i.next = add nuw nsw i64 %i, 1
+  %vec.cond = icmp eq i64 %i.next, %n
+  br i1 %vec.cond, label %between, label %vec
+
+between:
+  br label %dep
+
+; The store feeds the load of the next iteration, so this loop isn't
+; vectorized.
+dep:
+  %j = phi i64 [ 0, %between ], [ %j.next, %dep ]
+  %c.j = getelementptr inbounds i32, i32* %c, i64 %j
+  %v = load i32, i32* %c.j
+  %w = mul i32 %v, 3
+  %j.next = add nuw nsw i64 %j, 1
+  %c.j.next = getelementptr inbounds i32, i32* %c, i64 %j.next
+  store i32 %w, i32* %c.j.next
+  %dep.cond = icmp eq i64 %j.next, %n
+  br i1 %dep.cond, label %exit, label %dep
+
+exit:
+  ret void
+}
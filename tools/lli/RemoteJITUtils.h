@@ -13,70 +13,12 @@
 #ifndef LLVM_TOOLS_LLI_REMOTEJITUTILS_H
 #define LLVM_TOOLS_LLI_REMOTEJITUTILS_H
 
-#include "llvm/ExecutionEngine/Orc/RawByteChannel.h"
+#include "llvm/ExecutionEngine/Orc/FDRawByteChannel.h"
 #include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
 #include <mutex>
 
-#if !defined(_MSC_VER) && !defined(__MINGW32__) && !defined(MOLLENOS)
-#include <unistd.h>
-#else
-#include <io.h>
-#endif
-
-/// RPC channel that reads from and writes from file descriptors.
-class FDRawChannel final : public llvm::orc::rpc::RawByteChannel {
-public:
-  FDRawChannel(int InFD, int OutFD) : InFD(InFD), OutFD(OutFD) {}
-
-  llvm::Error readBytes(char *Dst, unsigned Size) override {
-    assert(Dst && "Attempt to read into null.");
-    ssize_t Completed = 0;
-    while (Completed < static_cast<ssize_t>(Size)) {
-#if defined(LLVM_ON_VALI)
-      ssize_t Read = ::read(InFD, (void*)(Dst + Completed), Size - Completed);
-#else
-      ssize_t Read = ::read(InFD, Dst + Completed, Size - Completed);
-#endif
-      if (Read <= 0) {
-        auto ErrNo = errno;
-        if (ErrNo == EAGAIN || ErrNo == EINTR)
-          continue;
-        else
-          return llvm::errorCodeToError(
-                   std::error_code(errno, std::generic_category()));
-      }
-      Completed += Read;
-    }
-    return llvm::Error::success();
-  }
-
-  llvm::Error appendBytes(const char *Src, unsigned Size) override {
-    assert(Src && "Attempt to append from null.");
-    ssize_t Completed = 0;
-    while (Completed < static_cast<ssize_t>(Size)) {
-#if defined(LLVM_ON_VALI)
-      ssize_t Written = ::write(OutFD, (void*)(Src + Completed), Size - Completed);
-#else
-      ssize_t Written = ::write(OutFD, Src + Completed, Size - Completed);
-#endif
-      if (Written < 0) {
-        auto ErrNo = errno;
-        if (ErrNo == EAGAIN || ErrNo == EINTR)
-          continue;
-        else
-          return llvm::errorCodeToError(
-                   std::error_code(errno, std::generic_category()));
-      }
-      Completed += Written;
-    }
-    return llvm::Error::success();
-  }
-
-  llvm::Error send() override { return llvm::Error::success(); }
-
-private:
-  int InFD, OutFD;
-};
+/// RPC channel that reads from and writes to the pipes of the child process.
+using FDRawChannel = llvm::orc::rpc::FDRawByteChannel;
 
 // launch the remote process (see lli.cpp) and return a channel to it.
 std::unique_ptr<FDRawChannel> launchRemote();
@@ -38,6 +38,7 @@
 #include "llvm/IRReader/IRReader.h"
 #include "llvm/Object/Archive.h"
 #include "llvm/Object/ObjectFile.h"
+#include "llvm/Passes/PassBuilder.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/DynamicLibrary.h"
@@ -113,6 +114,43 @@ namespace {
                "rather than individual functions"),
       cl::init(false));
 
+  cl::opt<unsigned> SpeculateCallees(
+      "speculate-callees",
+      cl::desc("Compile up to this many likely callees of each function "
+               "ahead of their first call (jit-kind=orc-lazy only)"),
+      cl::init(0));
+
+  cl::opt<unsigned> TierUpThreshold(
+      "tier-up-threshold",
+      cl::desc("Recompile functions called this many times with aggressive "
+               "code generation on a background thread (jit-kind=orc-lazy "
+               "only, 0 disables tiered compilation)"),
+      cl::init(0));
+
+  cl::opt<unsigned> JITSlabSize(
+      "jit-slab-size",
+      cl::desc("Carve JIT'd code and data out of slabs of this many KB shared "
+               "by all objects (jit-kind=orc-lazy only, 0 maps memory for "
+               "each object)"),
+      cl::init(0));
+
+  cl::opt<bool> JITHugePages(
+      "jit-huge-pages",
+      cl::desc("Ask for huge pages to back the slabs of -jit-slab-size"),
+      cl::init(false));
+
+  cl::opt<bool> PrintJITMemoryStats(
+      "print-jit-memory-stats",
+      cl::desc("Print the usage and fragmentation of the slabs of "
+               "-jit-slab-size on exit"),
+      cl::init(false));
+
+  cl::opt<bool> PrintRelocationStats(
+      "print-relocation-stats",
+      cl::desc("Print the number of relocations applied and the relocation "
+               "throughput before running main (mcjit) or on exit (orc-lazy)"),
+      cl::init(false));
+
   cl::list<std::string>
       JITDylibs("jd",
                 cl::desc("Specifies the JITDylib to be used for any subsequent "
@@ -608,6 +646,8 @@ int main(int argc, char **argv, char * const *envp) {
     // Trigger compilation separately so code regions that need to be
     // invalidated will be known.
     (void)EE->getPointerToFunction(EntryFn);
+    if (PrintRelocationStats)
+      RuntimeDyld::printRelocationStats(errs());
     // Clear instruction cache before code will be executed.
     if (RTDyldMM)
       static_cast<SectionMemoryManager*>(RTDyldMM)->invalidateInstructionCache();
@@ -749,6 +789,37 @@ static orc::IRTransformLayer::TransformFunction createDebugDumper() {
   llvm_unreachable("Unknown DumpKind");
 }
 
+/// Returns a transform that runs the O3 pipeline over each module that is
+/// recompiled by the tier-up layer.
+static orc::IRTransformLayer::TransformFunction
+createTierUpOptimizer(orc::JITTargetMachineBuilder JTMB) {
+  return [JTMB](orc::ThreadSafeModule TSM,
+                const orc::MaterializationResponsibility &R) mutable
+             -> Expected<orc::ThreadSafeModule> {
+    auto TM = JTMB.createTargetMachine();
+    if (!TM)
+      return TM.takeError();
+
+    auto Lock = TSM.getContextLock();
+
+    PassBuilder PB((*TM).get());
+    LoopAnalysisManager LAM;
+    FunctionAnalysisManager FAM;
+    CGSCCAnalysisManager CGAM;
+    ModuleAnalysisManager MAM;
+    FAM.registerPass([&] { return PB.buildDefaultAAPipeline(); });
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+    ModulePassManager MPM = PB.buildPerModuleDefaultPipeline(PassBuilder::O3);
+    MPM.run(*TSM.getModule(), MAM);
+    return TSM;
+  };
+}
+
 static void exitOnLazyCallThroughFailure() { exit(1); }
 
 int runOrcLazyJIT(const char *ProgName) {
@@ -781,6 +852,9 @@ int runOrcLazyJIT(const char *ProgName) {
 
   DataLayout DL = ExitOnErr(JTMB.getDefaultDataLayoutForTarget());
 
+  orc::JITTargetMachineBuilder TierUpJTMB = JTMB;
+  TierUpJTMB.setCodeGenOptLevel(CodeGenOpt::Aggressive);
+
   auto J = ExitOnErr(orc::LLLazyJIT::Create(
       std::move(JTMB), DL,
       pointerToJITTargetAddress(exitOnLazyCallThroughFailure),
@@ -789,6 +863,20 @@ int runOrcLazyJIT(const char *ProgName) {
   if (PerModuleLazy)
     J->setPartitionFunction(orc::CompileOnDemandLayer::compileWholeModule);
 
+  if (SpeculateCallees)
+    J->setSpeculation(SpeculateCallees);
+
+  if (TierUpThreshold)
+    J->enableTieredCompilation(TierUpJTMB, TierUpThreshold,
+                               createTierUpOptimizer(TierUpJTMB));
+
+  if (JITSlabSize) {
+    JITSlabAllocator::Options SlabOpts;
+    SlabOpts.SlabSize = JITSlabSize * 1024;
+    SlabOpts.UseHugePages = JITHugePages;
+    J->enableSlabAllocation(SlabOpts);
+  }
+
   auto Dump = createDebugDumper();
 
   J->setLazyCompileTransform([&](orc::ThreadSafeModule TSM,
@@ -885,6 +973,11 @@ int runOrcLazyJIT(const char *ProgName) {
   ExitOnErr(J->runDestructors());
   CXXRuntimeOverrides.runDestructors();
 
+  if (PrintJITMemoryStats && J->getSlabAllocator())
+    J->getSlabAllocator()->printStats(errs());
+  if (PrintRelocationStats)
+    RuntimeDyld::printRelocationStats(errs());
+
   return Result;
 }
 
@@ -905,6 +998,21 @@ void disallowOrcOptions() {
     errs() << "-per-module-lazy requires -jit-kind=orc-lazy\n";
     exit(1);
   }
+
+  if (JITSlabSize != 0) {
+    errs() << "-jit-slab-size requires -jit-kind=orc-lazy\n";
+    exit(1);
+  }
+
+  if (JITHugePages) {
+    errs() << "-jit-huge-pages requires -jit-kind=orc-lazy\n";
+    exit(1);
+  }
+
+  if (PrintJITMemoryStats) {
+    errs() << "-print-jit-memory-stats requires -jit-kind=orc-lazy\n";
+    exit(1);
+  }
 }
 
 std::unique_ptr<FDRawChannel> launchRemote() {
@@ -303,7 +303,7 @@ uint32_t StringTableSection::findIndex(StringRef Name) const {
 }
 
 void StringTableSection::prepareForLayout() {
-  StrTabBuilder.finalize();
+  StrTabBuilder.finalizeParallel();
   Size = StrTabBuilder.getSize();
 }
 
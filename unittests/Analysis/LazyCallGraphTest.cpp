@@ -12,6 +12,7 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/SourceMgr.h"
 #include "gtest/gtest.h"
@@ -390,6 +391,46 @@ TEST(LazyCallGraphTest, BasicGraphFormation) {
   EXPECT_EQ(J, std::next(CG.postorder_ref_scc_begin(), 4));
 }
 
+// Describes the RefSCCs in postorder along with the edges of every node.
+static std::string describeRefSCCs(LazyCallGraph &CG) {
+  std::string Description;
+  raw_string_ostream OS(Description);
+  CG.buildRefSCCs();
+  for (LazyCallGraph::RefSCC &RC : CG.postorder_ref_sccs()) {
+    OS << "RefSCC\n";
+    for (LazyCallGraph::SCC &C : RC)
+      for (LazyCallGraph::Node &N : C) {
+        OS << "  " << N.getName() << " ->";
+        for (LazyCallGraph::Edge &E : *N)
+          OS << " " << E.getFunction().getName()
+             << (E.isCall() ? " (call)" : " (ref)");
+        OS << "\n";
+      }
+  }
+  return OS.str();
+}
+
+TEST(LazyCallGraphTest, ParallelEdgeScan) {
+  auto *Threads = static_cast<cl::opt<unsigned> *>(
+      cl::getRegisteredOptions()["lcg-edge-scan-threads"]);
+  ASSERT_NE(nullptr, Threads);
+
+  for (const char *Assembly : {DiamondOfTriangles, DiamondOfTrianglesRefGraph}) {
+    LLVMContext Context;
+    std::unique_ptr<Module> M = parseAssembly(Context, Assembly);
+    LazyCallGraph SerialCG = buildCG(*M);
+    std::string Serial = describeRefSCCs(SerialCG);
+
+    // Scanning the functions up front must give the same graph, with the
+    // edges in the same order.
+    Threads->setValue(4);
+    LazyCallGraph ParallelCG = buildCG(*M);
+    std::string Parallel = describeRefSCCs(ParallelCG);
+    Threads->setValue(0);
+    EXPECT_EQ(Serial, Parallel);
+  }
+}
+
 static Function &lookupFunction(Module &M, StringRef Name) {
   for (Function &F : M)
     if (F.getName() == Name)
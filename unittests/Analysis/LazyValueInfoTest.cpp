@@ -0,0 +1,119 @@
+//===- LazyValueInfoTest.cpp - LazyValueInfo unit tests -------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/LazyValueInfo.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/ConstantRange.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/SourceMgr.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+class LazyValueInfoTest : public testing::Test {
+protected:
+  void parseAssembly(const char *Assembly) {
+    SMDiagnostic Error;
+    M = parseAssemblyString(Assembly, Error, Context);
+    ASSERT_TRUE(M) << "Bad assembly?";
+
+    F = M->getFunction("f");
+    ASSERT_TRUE(F) << "Test must have a function @f";
+    X = &*F->arg_begin();
+    for (BasicBlock &BB : *F) {
+      if (BB.getName() == "use")
+        Use = &BB;
+      else if (BB.getName() == "other")
+        Other = &BB;
+    }
+    ASSERT_TRUE(Use && Other) << "Test must have blocks %use and %other";
+
+    TLII.reset(new TargetLibraryInfoImpl(Triple(M->getTargetTriple())));
+    TLI.reset(new TargetLibraryInfo(*TLII));
+    AC.reset(new AssumptionCache(*F));
+    LVI.reset(new LazyValueInfo(AC.get(), &M->getDataLayout(), TLI.get(),
+                                nullptr));
+  }
+
+  ConstantRange getRangeInUse() {
+    return LVI->getConstantRange(X, Use, &Use->front());
+  }
+
+  LLVMContext Context;
+  std::unique_ptr<Module> M;
+  Function *F = nullptr;
+  Value *X = nullptr;
+  BasicBlock *Use = nullptr;
+  BasicBlock *Other = nullptr;
+  std::unique_ptr<TargetLibraryInfoImpl> TLII;
+  std::unique_ptr<TargetLibraryInfo> TLI;
+  std::unique_ptr<AssumptionCache> AC;
+  std::unique_ptr<LazyValueInfo> LVI;
+};
+
+} // end anonymous namespace
+
+// A new edge into a block makes the values cached for it less precise, so
+// they have to be dropped.
+TEST_F(LazyValueInfoTest, InsertedEdgeDropsCachedValues) {
+  parseAssembly("define void @f(i32 %x, i1 %b) {\n"
+                "entry:\n"
+                "  br i1 %b, label %bb, label %other\n"
+                "bb:\n"
+                "  %c = icmp ult i32 %x, 10\n"
+                "  br i1 %c, label %use, label %exit\n"
+                "other:\n"
+                "  ret void\n"
+                "use:\n"
+                "  %y = add i32 %x, 1\n"
+                "  ret void\n"
+                "exit:\n"
+                "  ret void\n"
+                "}\n");
+
+  EXPECT_EQ(getRangeInUse(), ConstantRange(APInt(32, 0), APInt(32, 10)));
+
+  Other->getTerminator()->eraseFromParent();
+  BranchInst::Create(Use, Other);
+  LVI->applyUpdates({{cfg::UpdateKind::Insert, Other, Use}});
+
+  EXPECT_TRUE(getRangeInUse().isFullSet());
+}
+
+// Without an edge into a block, values that were overdefined in it may be
+// solvable, so the overdefined markers have to be dropped.
+TEST_F(LazyValueInfoTest, DeletedEdgeDropsOverdefinedValues) {
+  parseAssembly("define void @f(i32 %x, i1 %b) {\n"
+                "entry:\n"
+                "  br i1 %b, label %bb, label %other\n"
+                "bb:\n"
+                "  %c = icmp ult i32 %x, 10\n"
+                "  br i1 %c, label %use, label %exit\n"
+                "other:\n"
+                "  br label %use\n"
+                "use:\n"
+                "  %y = add i32 %x, 1\n"
+                "  ret void\n"
+                "exit:\n"
+                "  ret void\n"
+                "}\n");
+
+  EXPECT_TRUE(getRangeInUse().isFullSet());
+
+  Other->getTerminator()->eraseFromParent();
+  ReturnInst::Create(Context, Other);
+  LVI->applyUpdates({{cfg::UpdateKind::Delete, Other, Use}});
+
+  EXPECT_EQ(getRangeInUse(), ConstantRange(APInt(32, 0), APInt(32, 10)));
+}
@@ -682,6 +682,43 @@ TEST_F(MemorySSATest, TestStoreDoubleQuery) {
   EXPECT_TRUE(MSSA.isLiveOnEntryDef(LiveOnEntry));
 }
 
+// Repeated clobber queries for an explicit location are answered from the
+// walker's cache until MemorySSA changes.
+TEST_F(MemorySSATest, LocationQueriesAreCached) {
+  F = Function::Create(FunctionType::get(B.getVoidTy(), {}, false),
+                       GlobalValue::ExternalLinkage, "F", &M);
+  B.SetInsertPoint(BasicBlock::Create(C, "", F));
+  Type *Int8 = Type::getInt8Ty(C);
+  Value *A = B.CreateAlloca(Int8, ConstantInt::get(Int8, 1), "A");
+  Value *Other = B.CreateAlloca(Int8, ConstantInt::get(Int8, 1), "Other");
+  StoreInst *StoreA = B.CreateStore(ConstantInt::get(Int8, 0), A);
+  StoreInst *StoreOther = B.CreateStore(ConstantInt::get(Int8, 1), Other);
+
+  setupAnalyses();
+  MemorySSA &MSSA = *Analyses->MSSA;
+  MemorySSAWalker *Walker = Analyses->Walker;
+  const MemorySSA::WalkerStatistics &Stats = MSSA.getWalkerStatistics();
+
+  MemoryAccess *StartAccess = MSSA.getMemoryAccess(StoreOther);
+  MemoryLocation LocA = MemoryLocation::get(StoreA);
+  MemoryAccess *Clobber = Walker->getClobberingMemoryAccess(StartAccess, LocA);
+  EXPECT_EQ(Clobber, MSSA.getMemoryAccess(StoreA));
+  EXPECT_EQ(Stats.CacheHits, 0u);
+  EXPECT_EQ(Stats.CacheMisses, 1u);
+  unsigned Walks = Stats.Walks;
+
+  EXPECT_EQ(Walker->getClobberingMemoryAccess(StartAccess, LocA), Clobber);
+  EXPECT_EQ(Stats.CacheHits, 1u);
+  EXPECT_EQ(Stats.CacheMisses, 1u);
+  EXPECT_EQ(Stats.Walks, Walks);
+
+  MSSA.invalidateClobberCache();
+  EXPECT_EQ(Walker->getClobberingMemoryAccess(StartAccess, LocA), Clobber);
+  EXPECT_EQ(Stats.CacheHits, 1u);
+  EXPECT_EQ(Stats.CacheMisses, 2u);
+  EXPECT_EQ(Stats.Walks, Walks + 1);
+}
+
 // Bug: During phi optimization, the walker wouldn't cache to the proper result
 // in the farthest-walked BB.
 //
@@ -0,0 +1,129 @@
+//===- SlabMemoryManagerTest.cpp - Unit tests for the slab memory manager -===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/SlabMemoryManager.h"
+#include "llvm/Support/Process.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+TEST(SlabMemoryManagerTest, ObjectsShareSlabs) {
+  JITSlabAllocator Slabs;
+  std::vector<std::unique_ptr<RuntimeDyld::MemoryManager>> MemMgrs;
+  std::vector<uint8_t *> Code;
+
+  for (unsigned i = 0; i < 100; ++i) {
+    auto MemMgr = Slabs.createMemoryManager();
+    ASSERT_TRUE(MemMgr->needsToReserveAllocationSpace());
+    MemMgr->reserveAllocationSpace(256, 16, 64, 8, 64, 8);
+
+    uint8_t *code = MemMgr->allocateCodeSection(256, 16, 1, "");
+    uint8_t *rodata = MemMgr->allocateDataSection(64, 8, 2, "", true);
+    uint8_t *rwdata = MemMgr->allocateDataSection(64, 8, 3, "", false);
+    ASSERT_NE((uint8_t *)nullptr, code);
+    ASSERT_NE((uint8_t *)nullptr, rodata);
+    ASSERT_NE((uint8_t *)nullptr, rwdata);
+
+    for (unsigned j = 0; j < 256; ++j)
+      code[j] = 1 + (i % 254);
+    rodata[0] = 2;
+    rwdata[0] = 3;
+
+    std::string Error;
+    EXPECT_FALSE(MemMgr->finalizeMemory(&Error));
+    rwdata[1] = 4;
+
+    Code.push_back(code);
+    MemMgrs.push_back(std::move(MemMgr));
+  }
+
+  for (unsigned i = 0; i < 100; ++i)
+    for (unsigned j = 0; j < 256; ++j)
+      EXPECT_EQ(1 + (i % 254), Code[i][j]);
+
+  // One slab for code and one for data, and one protection change each for
+  // the code and the read-only data of every object.
+  JITSlabAllocator::Stats S = Slabs.getStats();
+  EXPECT_EQ(2U, S.NumSlabs);
+  EXPECT_EQ(100U, S.NumMemoryManagers);
+  EXPECT_EQ(100U, S.NumFinalizations);
+  EXPECT_EQ(200U, S.NumProtectionChanges);
+  EXPECT_EQ(100U * (256 + 64 + 64), S.SectionBytes);
+  EXPECT_EQ(0U, S.NumFreeRanges);
+
+  MemMgrs.clear();
+  S = Slabs.getStats();
+  EXPECT_EQ(0U, S.NumMemoryManagers);
+  EXPECT_EQ(0U, S.ReservedBytes);
+  EXPECT_EQ(0U, S.SectionBytes);
+}
+
+TEST(SlabMemoryManagerTest, ReleasedMemoryIsReused) {
+  JITSlabAllocator Slabs;
+
+  auto MemMgr = Slabs.createMemoryManager();
+  uint8_t *code1 = MemMgr->allocateCodeSection(1024, 0, 1, "");
+  ASSERT_NE((uint8_t *)nullptr, code1);
+  std::string Error;
+  EXPECT_FALSE(MemMgr->finalizeMemory(&Error));
+  MemMgr.reset();
+
+  // The finalized code is made writable again before it is handed out.
+  MemMgr = Slabs.createMemoryManager();
+  uint8_t *code2 = MemMgr->allocateCodeSection(1024, 0, 1, "");
+  EXPECT_EQ(code1, code2);
+  for (unsigned i = 0; i < 1024; ++i)
+    code2[i] = 1;
+  EXPECT_FALSE(MemMgr->finalizeMemory(&Error));
+
+  EXPECT_EQ(1U, Slabs.getStats().NumSlabs);
+}
+
+TEST(SlabMemoryManagerTest, AllocationsAfterFinalizeUseFreshPages) {
+  static const size_t PageSize = sys::Process::getPageSize();
+  JITSlabAllocator Slabs;
+  auto MemMgr = Slabs.createMemoryManager();
+
+  uint8_t *code1 = MemMgr->allocateCodeSection(16, 0, 1, "");
+  std::string Error;
+  EXPECT_FALSE(MemMgr->finalizeMemory(&Error));
+
+  uint8_t *code2 = MemMgr->allocateCodeSection(16, 0, 2, "");
+  ASSERT_NE((uint8_t *)nullptr, code2);
+  EXPECT_NE((uintptr_t)code1 / PageSize, (uintptr_t)code2 / PageSize);
+  for (unsigned i = 0; i < 16; ++i)
+    code2[i] = 1;
+  EXPECT_FALSE(MemMgr->finalizeMemory(&Error));
+}
+
+TEST(SlabMemoryManagerTest, LargeAndAlignedAllocations) {
+  JITSlabAllocator::Options Opts;
+  Opts.SlabSize = 64 * 1024;
+  JITSlabAllocator Slabs(Opts);
+  auto MemMgr = Slabs.createMemoryManager();
+
+  uint8_t *code = MemMgr->allocateCodeSection(0x100000, 0, 1, "");
+  ASSERT_NE((uint8_t *)nullptr, code);
+  for (unsigned i = 0; i < 0x100000; ++i)
+    code[i] = 1;
+
+  for (unsigned i = 0; i < 1000; ++i) {
+    unsigned Align = 8 << (i % 6);
+    uint8_t *data = MemMgr->allocateDataSection(i % 16 + 1, Align, i, "",
+                                                i % 2 == 0);
+    ASSERT_NE((uint8_t *)nullptr, data);
+    EXPECT_EQ((uintptr_t)0, (uintptr_t)data % Align);
+  }
+
+  std::string Error;
+  EXPECT_FALSE(MemMgr->finalizeMemory(&Error));
+}
+
+} // Namespace
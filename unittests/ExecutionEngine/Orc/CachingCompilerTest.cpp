@@ -0,0 +1,79 @@
+//===----- CachingCompilerTest.cpp - Unit tests for the object cache ------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/Orc/CachingCompiler.h"
+#include "OrcTestCommon.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/Core.h"
+#include "llvm/Support/FileSystem.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+using namespace llvm::orc;
+
+namespace {
+
+std::unique_ptr<Module> createModule(LLVMContext &Ctx, TargetMachine &TM,
+                                     StringRef FnName) {
+  auto M = llvm::make_unique<Module>("cached", Ctx);
+  M->setTargetTriple(TM.getTargetTriple().str());
+  M->setDataLayout(TM.createDataLayout());
+  Function *F = Function::Create(
+      FunctionType::get(Type::getInt32Ty(Ctx), {}, false),
+      GlobalValue::ExternalLinkage, FnName, M.get());
+  IRBuilder<> B(BasicBlock::Create(Ctx, "entry", F));
+  B.CreateRet(B.getInt32(42));
+  return M;
+}
+
+TEST(CachingCompilerTest, HitsAfterFirstCompile) {
+  OrcNativeTarget::initialize();
+
+  std::unique_ptr<TargetMachine> TM(
+      EngineBuilder().selectTarget(Triple("x86_64-unknown-linux-gnu"), "", "",
+                                   SmallVector<std::string, 1>()));
+  if (!TM)
+    return;
+
+  SmallString<128> CacheDir;
+  ASSERT_FALSE(
+      sys::fs::createUniqueDirectory("orc-object-cache", CacheDir));
+
+  ExecutionSession ES;
+  unsigned NumCompiles = 0;
+  SimpleCompiler Compile(*TM);
+  CachingIRCompiler CachingCompile(
+      ES,
+      [&](Module &M) -> Expected<std::unique_ptr<MemoryBuffer>> {
+        ++NumCompiles;
+        return Compile(M);
+      },
+      CacheDir.str(), CachingIRCompiler::getTargetKey(*TM));
+
+  // Compile identical modules from separate contexts, as separate processes
+  // would.
+  LLVMContext Ctx1, Ctx2, Ctx3;
+  auto Obj1 = cantFail(CachingCompile(*createModule(Ctx1, *TM, "foo")));
+  EXPECT_EQ(NumCompiles, 1U);
+  EXPECT_EQ(ES.getObjectCacheHits(), 0U);
+  EXPECT_EQ(ES.getObjectCacheMisses(), 1U);
+
+  auto Obj2 = cantFail(CachingCompile(*createModule(Ctx2, *TM, "foo")));
+  EXPECT_EQ(NumCompiles, 1U) << "Expected the object to come from the cache";
+  EXPECT_EQ(ES.getObjectCacheHits(), 1U);
+  EXPECT_EQ(Obj1->getBuffer(), Obj2->getBuffer());
+
+  // A module that only differs in a symbol name must not hit.
+  cantFail(CachingCompile(*createModule(Ctx3, *TM, "bar")));
+  EXPECT_EQ(NumCompiles, 2U);
+  EXPECT_EQ(ES.getObjectCacheMisses(), 2U);
+
+  EXPECT_FALSE(sys::fs::remove_directories(CacheDir));
+}
+
+} // end anonymous namespace
@@ -11,6 +11,7 @@
 #include "llvm/ExecutionEngine/Orc/Core.h"
 #include "llvm/ExecutionEngine/Orc/OrcError.h"
 
+#include <future>
 #include <set>
 #include <thread>
 
@@ -196,6 +197,83 @@ TEST_F(CoreAPIsStandardTest, RemoveSymbolsTest) {
   EXPECT_TRUE(OnReadyRun) << "OnReady should have been run";
 }
 
+TEST_F(CoreAPIsStandardTest, RemoveModuleTest) {
+  // Test that:
+  // (1) Modules with materializing symbols can not be removed, and nothing is
+  //     removed in the attempt.
+  // (2) Removing a module removes its symbols from every JITDylib, and no
+  //     other symbols.
+  // (3) Registered ResourceManagers are asked for the module's size, told to
+  //     stop work on it before every attempt, told to resume it after a failed
+  //     attempt, and told to release its resources.
+  class TestResourceManager : public ResourceManager {
+  public:
+    void prepareToRemove(VModuleKey K) override { Prepared.push_back(K); }
+    void cancelRemove(VModuleKey K) override { Cancelled.push_back(K); }
+    Error removeResources(VModuleKey K) override {
+      Removed.push_back(K);
+      return Error::success();
+    }
+    uint64_t getResourceSize(VModuleKey K) const override { return 16 * K; }
+    std::vector<VModuleKey> Prepared;
+    std::vector<VModuleKey> Cancelled;
+    std::vector<VModuleKey> Removed;
+  };
+
+  TestResourceManager RM;
+  ES.registerResourceManager(RM);
+
+  auto K1 = ES.allocateVModule();
+  auto K2 = ES.allocateVModule();
+  auto &JD2 = ES.createJITDylib("JD2");
+
+  cantFail(JD.define(absoluteSymbols({{Foo, FooSym}}, K1)));
+  cantFail(JD2.define(absoluteSymbols({{Bar, BarSym}}, K1)));
+  cantFail(JD.define(absoluteSymbols({{Baz, BazSym}}, K2)));
+
+  // Qux belongs to K1 too, and will be materializing for the first attempt.
+  Optional<MaterializationResponsibility> QuxR;
+  cantFail(JD.define(llvm::make_unique<SimpleMaterializationUnit>(
+      SymbolFlagsMap({{Qux, QuxSym.getFlags()}}),
+      [&](MaterializationResponsibility R) { QuxR.emplace(std::move(R)); },
+      SimpleMaterializationUnit::DiscardFunction(),
+      SimpleMaterializationUnit::DestructorFunction(), K1)));
+
+  ES.lookup(JITDylibSearchList({{&JD, false}}), {Qux},
+            [](Expected<SymbolMap> Result) { cantFail(Result.takeError()); },
+            [](Error Err) { cantFail(std::move(Err)); },
+            NoDependenciesToRegister);
+
+  EXPECT_EQ(16 * K1, ES.getModuleResourceSize(K1));
+
+  {
+    auto Err = ES.removeModule(K1);
+    EXPECT_TRUE(Err.isA<SymbolsCouldNotBeRemoved>())
+        << "Expected a SymbolsCouldNotBeRemoved error";
+    consumeError(std::move(Err));
+  }
+  EXPECT_EQ(std::vector<VModuleKey>({K1}), RM.Prepared);
+  EXPECT_EQ(std::vector<VModuleKey>({K1}), RM.Cancelled);
+  EXPECT_TRUE(RM.Removed.empty()) << "Resources removed by failed attempt";
+  EXPECT_EQ(1U, JD.lookupFlags({Foo}).size()) << "Foo removed by failed attempt";
+
+  QuxR->resolve({{Qux, QuxSym}});
+  QuxR->emit();
+
+  cantFail(ES.removeModule(K1));
+  EXPECT_EQ(std::vector<VModuleKey>({K1, K1}), RM.Prepared);
+  EXPECT_EQ(std::vector<VModuleKey>({K1}), RM.Cancelled)
+      << "Successful removal should not be cancelled";
+  EXPECT_EQ(std::vector<VModuleKey>({K1}), RM.Removed);
+
+  auto Flags = JD.lookupFlags({Foo, Baz, Qux});
+  EXPECT_EQ(1U, Flags.size()) << "Only Baz should remain in JD";
+  EXPECT_TRUE(Flags.count(Baz)) << "Baz should not have been removed";
+  EXPECT_TRUE(JD2.lookupFlags({Bar}).empty()) << "Bar should have been removed";
+
+  ES.deregisterResourceManager(RM);
+}
+
 TEST_F(CoreAPIsStandardTest, ChainedJITDylibLookup) {
   cantFail(JD.define(absoluteSymbols({{Foo, FooSym}})));
 
@@ -241,6 +319,81 @@ TEST_F(CoreAPIsStandardTest, LookupWithHiddenSymbols) {
       << "Wrong result for \"Bar\"";
 }
 
+TEST_F(CoreAPIsStandardTest, SnapshotLookupsSeeDefinitionChanges) {
+  // Test that lookups answered from symbol table snapshots respect the search
+  // order as definitions are added to and removed from earlier dylibs.
+  auto &JD2 = ES.createJITDylib("JD2");
+  cantFail(JD2.define(absoluteSymbols({{Foo, FooSym}})));
+
+  JITDylibSearchList SearchOrder({{&JD, false}, {&JD2, false}});
+  auto LookupFoo = [&]() { return ES.lookup(SearchOrder, Foo); };
+
+  for (unsigned I = 0; I != 4; ++I)
+    EXPECT_EQ(cantFail(LookupFoo()).getAddress(), FooSym.getAddress())
+        << "Expected \"Foo\" from JD2";
+
+  cantFail(JD.define(absoluteSymbols({{Foo, BarSym}})));
+  for (unsigned I = 0; I != 4; ++I)
+    EXPECT_EQ(cantFail(LookupFoo()).getAddress(), BarSym.getAddress())
+        << "Expected the new definition of \"Foo\" in JD to shadow JD2's";
+
+  cantFail(JD.remove({Foo}));
+  EXPECT_EQ(cantFail(LookupFoo()).getAddress(), FooSym.getAddress())
+      << "Expected \"Foo\" from JD2 after removal from JD";
+
+  cantFail(JD2.remove({Foo}));
+  auto Result = LookupFoo();
+  EXPECT_FALSE(!!Result) << "Expected lookup of removed symbol to fail";
+  consumeError(Result.takeError());
+}
+
+TEST_F(CoreAPIsStandardTest, SnapshotLookupOfHiddenSymbol) {
+  auto FooHiddenFlags = FooSym.getFlags() & ~JITSymbolFlags::Exported;
+  cantFail(JD.define(absoluteSymbols(
+      {{Foo, JITEvaluatedSymbol(FooSym.getAddress(), FooHiddenFlags)}})));
+
+  for (unsigned I = 0; I != 4; ++I) {
+    EXPECT_EQ(cantFail(ES.lookup(JITDylibSearchList({{&JD, true}}), Foo))
+                  .getAddress(),
+              FooSym.getAddress())
+        << "Expected hidden \"Foo\" to match non-exported lookups";
+
+    auto Result = ES.lookup(JITDylibSearchList({{&JD, false}}), Foo);
+    EXPECT_FALSE(!!Result) << "Expected hidden \"Foo\" not to match";
+    consumeError(Result.takeError());
+  }
+}
+
+TEST_F(CoreAPIsStandardTest, SnapshotLookupDoesNotTakeSessionLock) {
+#if LLVM_ENABLE_THREADS
+  cantFail(JD.define(absoluteSymbols({{Foo, FooSym}})));
+
+  // Materialize Foo and let the locked lookups publish a snapshot.
+  for (unsigned I = 0; I != 4; ++I)
+    cantFail(ES.lookup(JITDylibSearchList({{&JD, false}}), Foo));
+
+  std::promise<void> LockHeld, ReleaseLock;
+  std::thread LockHolder([&]() {
+    ES.runSessionLocked([&]() {
+      LockHeld.set_value();
+      ReleaseLock.get_future().wait();
+    });
+  });
+  LockHeld.get_future().wait();
+
+  auto Lookup = std::async(std::launch::async, [&]() {
+    return ES.lookup(JITDylibSearchList({{&JD, false}}), Foo);
+  });
+  EXPECT_EQ(Lookup.wait_for(std::chrono::seconds(10)),
+            std::future_status::ready)
+      << "Lookup of a ready symbol blocked on the session lock";
+
+  ReleaseLock.set_value();
+  LockHolder.join();
+  EXPECT_EQ(cantFail(Lookup.get()).getAddress(), FooSym.getAddress());
+#endif
+}
+
 TEST_F(CoreAPIsStandardTest, LookupFlagsTest) {
   // Test that lookupFlags works on a predefined symbol, and does not trigger
   // materialization of a lazy symbol. Make the lazy symbol weak to test that
@@ -20,6 +20,10 @@ public:
   Expected<JITTargetAddress> getTrampoline() {
     llvm_unreachable("Unimplemented");
   }
+
+  void releaseTrampoline(JITTargetAddress TrampolineAddr) {
+    llvm_unreachable("Unimplemented");
+  }
 };
 
 class DummyCallbackManager : public JITCompileCallbackManager {
@@ -51,6 +55,10 @@ public:
   Error updatePointer(StringRef Name, JITTargetAddress NewAddr) override {
     llvm_unreachable("Not implemented");
   }
+
+  void removeStubs(ArrayRef<StringRef> StubNames) override {
+    llvm_unreachable("Not implemented");
+  }
 };
 
 TEST(LegacyCompileOnDemandLayerTest, FindSymbol) {
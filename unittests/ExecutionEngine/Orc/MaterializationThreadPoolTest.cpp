@@ -0,0 +1,187 @@
+//===- MaterializationThreadPoolTest.cpp - Unit tests for the dispatcher --===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/Orc/MaterializationThreadPool.h"
+#include "OrcTestCommon.h"
+#include "gtest/gtest.h"
+
+#include <future>
+
+using namespace llvm;
+using namespace llvm::orc;
+
+namespace {
+
+class MaterializationThreadPoolTest : public CoreAPIsBasedStandardTest {
+protected:
+  void usePool(MaterializationThreadPool &Pool) {
+    ES.setPrioritizedDispatchMaterialization(
+        [&Pool](JITDylib &JD, std::unique_ptr<MaterializationUnit> MU,
+                MaterializationPriority Priority) {
+          Pool.dispatch(JD, std::move(MU), Priority);
+        });
+    ES.setPromoteMaterialization(
+        [&Pool](JITDylib &JD, const SymbolNameSet &Symbols) {
+          Pool.promote(JD, Symbols);
+        });
+  }
+
+  // Defines Name in JD with a unit that calls OnMaterialize and then emits
+  // Sym.
+  void defineSymbol(SymbolStringPtr Name, JITEvaluatedSymbol Sym,
+                    std::function<void()> OnMaterialize) {
+    cantFail(JD.define(llvm::make_unique<SimpleMaterializationUnit>(
+        SymbolFlagsMap({{Name, Sym.getFlags()}}),
+        [Name, Sym, OnMaterialize](MaterializationResponsibility R) {
+          OnMaterialize();
+          R.resolve({{Name, Sym}});
+          R.emit();
+        })));
+  }
+
+  static void onResolve(Expected<SymbolMap> Result) {
+    cantFail(std::move(Result));
+  }
+  static void onReady(Error Err) { cantFail(std::move(Err)); }
+};
+
+#if LLVM_ENABLE_THREADS
+
+TEST_F(MaterializationThreadPoolTest, BlockingBeforeSpeculative) {
+  MaterializationThreadPool Pool(1);
+  usePool(Pool);
+
+  std::promise<void> GateStarted, GateOpen;
+  std::shared_future<void> GateOpenFuture = GateOpen.get_future().share();
+  std::mutex OrderMutex;
+  std::vector<std::string> Order;
+  auto Record = [&](std::string Label) {
+    std::lock_guard<std::mutex> Lock(OrderMutex);
+    Order.push_back(std::move(Label));
+  };
+
+  defineSymbol(Foo, FooSym, [&]() {
+    GateStarted.set_value();
+    GateOpenFuture.wait();
+    Record("gate");
+  });
+  defineSymbol(Bar, BarSym, [&]() { Record("speculative"); });
+  defineSymbol(Baz, BazSym, [&]() { Record("blocking"); });
+
+  // Keep the only worker busy while the other two units are queued, the
+  // speculative one first.
+  ES.lookup({{&JD, false}}, {Foo}, onResolve, onReady,
+            NoDependenciesToRegister);
+  GateStarted.get_future().wait();
+  ES.lookupSpeculatively({{&JD, false}}, {Bar}, onResolve, onReady);
+  ES.lookup({{&JD, false}}, {Baz}, onResolve, onReady,
+            NoDependenciesToRegister);
+  GateOpen.set_value();
+  Pool.wait();
+
+  EXPECT_EQ(Order, std::vector<std::string>({"gate", "blocking",
+                                             "speculative"}));
+
+  auto Latencies = Pool.getLatencies();
+  ASSERT_EQ(Latencies.count("<Simple>"), 1U);
+  EXPECT_EQ(Latencies["<Simple>"].Queued.getCount(), 3U);
+  EXPECT_EQ(Latencies["<Simple>"].Materializing.getCount(), 3U);
+}
+
+TEST_F(MaterializationThreadPoolTest, BlockingLookupPromotesSpeculative) {
+  MaterializationThreadPool Pool(1);
+  usePool(Pool);
+
+  std::promise<void> GateStarted, GateOpen;
+  std::shared_future<void> GateOpenFuture = GateOpen.get_future().share();
+  std::mutex OrderMutex;
+  std::vector<std::string> Order;
+  auto Record = [&](std::string Label) {
+    std::lock_guard<std::mutex> Lock(OrderMutex);
+    Order.push_back(std::move(Label));
+  };
+
+  defineSymbol(Foo, FooSym, [&]() {
+    GateStarted.set_value();
+    GateOpenFuture.wait();
+    Record("gate");
+  });
+  defineSymbol(Bar, BarSym, [&]() { Record("bar"); });
+  defineSymbol(Baz, BazSym, [&]() { Record("baz"); });
+
+  // Queue two speculative units behind the gate, then block on the older
+  // one. Left speculative it would run after Baz, the newest unit.
+  ES.lookup({{&JD, false}}, {Foo}, onResolve, onReady,
+            NoDependenciesToRegister);
+  GateStarted.get_future().wait();
+  ES.lookupSpeculatively({{&JD, false}}, {Bar}, onResolve, onReady);
+  ES.lookupSpeculatively({{&JD, false}}, {Baz}, onResolve, onReady);
+  ES.lookup({{&JD, false}}, {Bar}, onResolve, onReady,
+            NoDependenciesToRegister);
+  GateOpen.set_value();
+  Pool.wait();
+
+  EXPECT_EQ(Order, std::vector<std::string>({"gate", "bar", "baz"}));
+  EXPECT_EQ(Pool.getNumPromoted(), 1U);
+}
+
+TEST_F(MaterializationThreadPoolTest, IdleWorkerSteals) {
+  MaterializationThreadPool Pool(2);
+  usePool(Pool);
+
+  std::promise<void> GateStarted, GateOpen, OthersDone;
+  std::shared_future<void> GateOpenFuture = GateOpen.get_future().share();
+  std::atomic<unsigned> NumDone{0};
+  auto Done = [&]() {
+    if (++NumDone == 3)
+      OthersDone.set_value();
+  };
+
+  defineSymbol(Foo, FooSym, [&]() {
+    GateStarted.set_value();
+    GateOpenFuture.wait();
+  });
+  defineSymbol(Bar, BarSym, Done);
+  defineSymbol(Baz, BazSym, Done);
+  defineSymbol(Qux, QuxSym, Done);
+
+  // The units are spread round-robin, so at least one of them lands in the
+  // queue of the worker stuck on the gate and has to be stolen.
+  ES.lookup({{&JD, false}}, {Foo}, onResolve, onReady,
+            NoDependenciesToRegister);
+  GateStarted.get_future().wait();
+  for (auto &Name : {Bar, Baz, Qux})
+    ES.lookup({{&JD, false}}, {Name}, onResolve, onReady,
+              NoDependenciesToRegister);
+
+  auto OthersDoneFuture = OthersDone.get_future();
+  EXPECT_EQ(OthersDoneFuture.wait_for(std::chrono::seconds(10)),
+            std::future_status::ready);
+  GateOpen.set_value();
+  Pool.wait();
+
+  EXPECT_GE(Pool.getNumStolen(), 1U);
+}
+
+#endif
+
+TEST(MaterializationThreadPoolHistogramTest, PercentileBounds) {
+  MaterializationThreadPool::LatencyHistogram H;
+  for (unsigned I = 0; I != 99; ++I)
+    H.add(std::chrono::microseconds(1));
+  H.add(std::chrono::microseconds(1000));
+
+  EXPECT_EQ(H.getCount(), 100U);
+  EXPECT_EQ(H.getTotal().count(), 1099);
+  EXPECT_EQ(H.getMax().count(), 1000);
+  EXPECT_EQ(H.getPercentileBound(50).count(), 2);
+  EXPECT_EQ(H.getPercentileBound(99).count(), 2);
+  EXPECT_EQ(H.getPercentileBound(100).count(), 1000);
+}
+
+} // end anonymous namespace
@@ -0,0 +1,121 @@
+//===------------- OrcRemoteTargetTest.cpp - Remote JIT server tests ------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/Orc/FDRawByteChannel.h"
+#include "llvm/ExecutionEngine/Orc/OrcABISupport.h"
+#include "llvm/ExecutionEngine/Orc/OrcRemoteTargetServer.h"
+#include "gtest/gtest.h"
+#include <cstring>
+#include <thread>
+
+using namespace llvm;
+using namespace llvm::orc;
+using namespace llvm::orc::remote;
+
+namespace {
+
+#if LLVM_ON_UNIX
+
+// Runs a JIT server on a thread of this process, on the far end of a pair of
+// pipes, so that its writes can be checked directly.
+class RemoteServerTest : public testing::Test {
+protected:
+  void SetUp() override {
+    ASSERT_EQ(0, pipe(ToServer));
+    ASSERT_EQ(0, pipe(ToClient));
+    ServerChannel =
+        llvm::make_unique<rpc::FDRawByteChannel>(ToServer[0], ToClient[1]);
+    ClientChannel =
+        llvm::make_unique<rpc::FDRawByteChannel>(ToClient[0], ToServer[1]);
+    ServerThread = std::thread([this]() {
+      using ServerT = OrcRemoteTargetServer<rpc::FDRawByteChannel,
+                                            OrcGenericABI>;
+      ServerT Server(
+          *ServerChannel, [](const std::string &) { return 0; },
+          [](uint8_t *, uint32_t) {}, [](uint8_t *, uint32_t) {});
+      while (!Server.receivedTerminate())
+        cantFail(Server.handleOne());
+    });
+    Client = llvm::make_unique<
+        rpc::SingleThreadedRPCEndpoint<rpc::RawByteChannel>>(*ClientChannel,
+                                                             true);
+  }
+
+  void TearDown() override {
+    cantFail(Client->callB<utils::TerminateSession>());
+    ServerThread.join();
+    for (int FD : {ToServer[0], ToServer[1], ToClient[0], ToClient[1]})
+      close(FD);
+  }
+
+  int ToServer[2], ToClient[2];
+  std::unique_ptr<rpc::FDRawByteChannel> ServerChannel, ClientChannel;
+  std::unique_ptr<rpc::SingleThreadedRPCEndpoint<rpc::RawByteChannel>> Client;
+  std::thread ServerThread;
+  ResourceIdMgr::ResourceId AllocID = 1;
+};
+
+TEST_F(RemoteServerTest, BatchedMemoryCalls) {
+  cantFail(Client->callB<mem::CreateRemoteAllocator>(AllocID));
+
+  // One small block, and one larger than the channel buffers.
+  std::vector<std::tuple<uint64_t, uint32_t>> Blocks;
+  Blocks.push_back(std::make_tuple(100, 16));
+  Blocks.push_back(std::make_tuple(200000, 16));
+  std::vector<JITTargetAddress> Addrs =
+      cantFail(Client->callB<mem::ReserveMemBatch>(AllocID, Blocks));
+  ASSERT_EQ(2U, Addrs.size());
+
+  std::vector<char> Small(100, 'a'), Large(200000, 'b');
+  std::vector<DirectBufferWriter> Writes;
+  Writes.push_back(DirectBufferWriter(Small.data(), Addrs[0], Small.size()));
+  Writes.push_back(DirectBufferWriter(Large.data(), Addrs[1], Large.size()));
+
+  std::vector<std::tuple<JITTargetAddress, uint32_t>> Protections;
+  Protections.push_back(std::make_tuple(Addrs[0], sys::Memory::MF_READ));
+  Protections.push_back(std::make_tuple(Addrs[1], sys::Memory::MF_READ));
+
+  // Send both calls before waiting for either result.
+  unsigned NumResults = 0;
+  auto OnResult = [&](Error Err) {
+    EXPECT_FALSE(!!Err) << "Batched call failed";
+    ++NumResults;
+    return Error::success();
+  };
+  cantFail(Client->appendCallAsync<mem::WriteMemBatch>(OnResult, Writes));
+  cantFail(Client->appendCallAsync<mem::SetProtectionsBatch>(OnResult, AllocID,
+                                                             Protections));
+  cantFail(Client->sendAppendedCalls());
+  while (NumResults != 2)
+    cantFail(Client->handleOne());
+
+  const char *Dst0 = reinterpret_cast<const char *>(Addrs[0]);
+  const char *Dst1 = reinterpret_cast<const char *>(Addrs[1]);
+  EXPECT_EQ(0, memcmp(Dst0, Small.data(), Small.size()));
+  EXPECT_EQ(0, memcmp(Dst1, Large.data(), Large.size()));
+
+  cantFail(Client->callB<mem::DestroyRemoteAllocator>(AllocID));
+}
+
+TEST_F(RemoteServerTest, WritePtrBatch) {
+  // Enough pointers that the batch is larger than the channel buffers.
+  std::vector<uintptr_t> Targets(20000, 0);
+  std::vector<std::tuple<JITTargetAddress, JITTargetAddress>> Ptrs;
+  for (unsigned I = 0; I != Targets.size(); ++I)
+    Ptrs.push_back(std::make_tuple(pointerToJITTargetAddress(&Targets[I]),
+                                   JITTargetAddress(I + 1)));
+
+  cantFail(Client->callB<mem::WritePtrBatch>(Ptrs));
+
+  for (unsigned I = 0; I != Targets.size(); ++I)
+    EXPECT_EQ(uintptr_t(I + 1), Targets[I]);
+}
+
+#endif // LLVM_ON_UNIX
+
+} // end anonymous namespace
@@ -98,6 +98,51 @@ TEST(RTDyldObjectLinkingLayerTest, TestSetProcessAllSections) {
       << "Expected to see debug section when ProcessAllSections is true";
 }
 
+TEST(RTDyldObjectLinkingLayerTest, TestRemoveModule) {
+  LLVMContext Context;
+  auto M = llvm::make_unique<Module>("", Context);
+  M->setTargetTriple("x86_64-unknown-linux-gnu");
+  Type *Int32Ty = IntegerType::get(Context, 32);
+  new GlobalVariable(*M, Int32Ty, false, GlobalValue::ExternalLinkage,
+                     ConstantInt::get(Int32Ty, 42), "foo");
+
+  OrcNativeTarget::initialize();
+  std::unique_ptr<TargetMachine> TM(EngineBuilder().selectTarget(
+      Triple(M->getTargetTriple()), "", "", SmallVector<std::string, 1>()));
+  if (!TM)
+    return;
+
+  class MemoryManagerWrapper : public SectionMemoryManager {
+  public:
+    MemoryManagerWrapper(bool &Destroyed) : Destroyed(Destroyed) {}
+    ~MemoryManagerWrapper() override { Destroyed = true; }
+
+  private:
+    bool &Destroyed;
+  };
+
+  bool MemMgrDestroyed = false;
+  ExecutionSession ES;
+  auto &JD = ES.createJITDylib("main");
+  RTDyldObjectLinkingLayer ObjLayer(ES, [&MemMgrDestroyed]() {
+    return llvm::make_unique<MemoryManagerWrapper>(MemMgrDestroyed);
+  });
+
+  auto K = ES.allocateVModule();
+  cantFail(ObjLayer.add(JD, SimpleCompiler(*TM)(*M), K));
+  auto Foo = cantFail(ES.lookup({&JD}, "foo"));
+  EXPECT_EQ(42, *jitTargetAddressToPointer<int32_t *>(Foo.getAddress()));
+  EXPECT_GE(ES.getModuleResourceSize(K), 4U) << "foo not counted";
+
+  cantFail(ES.removeModule(K));
+  EXPECT_TRUE(MemMgrDestroyed) << "Memory manager should have been destroyed";
+  EXPECT_EQ(0U, ES.getModuleResourceSize(K));
+
+  auto Missing = ES.lookup({&JD}, "foo");
+  EXPECT_FALSE(!!Missing) << "foo should have been removed";
+  consumeError(Missing.takeError());
+}
+
 TEST(RTDyldObjectLinkingLayerTest, TestOverrideObjectFlags) {
 
   OrcNativeTarget::initialize();
@@ -349,3 +349,70 @@ TEST(DominatorTreeBatchUpdates, InfiniteLoop2) {
   PDT.applyUpdates(DomUpdates);
   EXPECT_TRUE(PDT.verify());
 }
+
+TEST(DominatorTreeBatchUpdates, DeferredUpdates) {
+  std::vector<CFGBuilder::Arc> Arcs = {
+      {"1", "2"}, {"2", "3"}, {"3", "4"},  {"4", "5"},  {"5", "6"},  {"5", "7"},
+      {"3", "8"}, {"8", "9"}, {"9", "10"}, {"8", "11"}, {"11", "12"}};
+
+  std::vector<CFGBuilder::Update> Updates = {
+      {CFGInsert, {"2", "4"}},  {CFGInsert, {"12", "10"}},
+      {CFGInsert, {"10", "9"}}, {CFGInsert, {"7", "6"}},
+      {CFGInsert, {"7", "5"}},  {CFGDelete, {"3", "8"}},
+      {CFGInsert, {"10", "7"}}, {CFGInsert, {"2", "8"}},
+      {CFGDelete, {"3", "4"}},  {CFGDelete, {"8", "9"}},
+      {CFGDelete, {"11", "12"}}};
+
+  CFGHolder Holder;
+  CFGBuilder B(Holder.F, Arcs, Updates);
+  DominatorTree DT(*Holder.F);
+  EXPECT_TRUE(DT.verify());
+  PostDominatorTree PDT(*Holder.F);
+  EXPECT_TRUE(PDT.verify());
+
+  // Defer the updates in two rounds, as two passes would.
+  auto DomUpdates = ToDomUpdates(B, Updates);
+  const size_t Half = DomUpdates.size() / 2;
+  for (size_t i = 0; i < Half; ++i)
+    ASSERT_TRUE(B.applyUpdate());
+  DT.deferUpdates(makeArrayRef(DomUpdates).take_front(Half));
+  PDT.deferUpdates(makeArrayRef(DomUpdates).take_front(Half));
+  while (B.applyUpdate())
+    ;
+  DT.deferUpdates(makeArrayRef(DomUpdates).drop_front(Half));
+  PDT.deferUpdates(makeArrayRef(DomUpdates).drop_front(Half));
+  EXPECT_TRUE(DT.hasDeferredUpdates());
+  EXPECT_TRUE(PDT.hasDeferredUpdates());
+
+  // Flushing the trees applies the updates.
+  DT.flushDeferredUpdates();
+  PDT.flushDeferredUpdates();
+  EXPECT_FALSE(DT.hasDeferredUpdates());
+  EXPECT_FALSE(PDT.hasDeferredUpdates());
+  EXPECT_TRUE(DT.dominates(B.getOrAddBlock("2"), B.getOrAddBlock("8")));
+  EXPECT_TRUE(DT.verify());
+  EXPECT_TRUE(PDT.verify());
+}
+
+TEST(DominatorTreeBatchUpdates, DeferredUpdatesRecalculate) {
+  std::vector<CFGBuilder::Update> Updates = {
+      {CFGInsert, {"2", "3"}}, {CFGDelete, {"2", "3"}},
+      {CFGInsert, {"2", "3"}}, {CFGDelete, {"2", "3"}}};
+
+  CFGHolder Holder;
+  CFGBuilder B(Holder.F, {{"1", "2"}}, Updates);
+  DominatorTree DT(*Holder.F);
+  EXPECT_TRUE(DT.verify());
+
+  // There are more updates than nodes in the tree, so they are dropped and
+  // the tree is recalculated instead.
+  while (B.applyUpdate())
+    ;
+  auto DomUpdates = ToDomUpdates(B, Updates);
+  DT.deferUpdates(DomUpdates);
+  EXPECT_TRUE(DT.hasDeferredUpdates());
+  DT.flushDeferredUpdates();
+  EXPECT_FALSE(DT.hasDeferredUpdates());
+  EXPECT_EQ(DT.getNode(B.getOrAddBlock("3")), nullptr);
+  EXPECT_TRUE(DT.verify());
+}
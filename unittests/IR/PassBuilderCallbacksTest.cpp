@@ -322,6 +322,7 @@ struct MockPassInstrumentationCallbacks {
   MOCK_METHOD1(runAfterPassInvalidated, void(StringRef PassID));
   MOCK_METHOD2(runBeforeAnalysis, void(StringRef PassID, llvm::Any));
   MOCK_METHOD2(runAfterAnalysis, void(StringRef PassID, llvm::Any));
+  MOCK_METHOD2(runAnalysisInvalidated, void(StringRef PassID, llvm::Any));
 
   void registerPassInstrumentation() {
     Callbacks.registerBeforePassCallback([this](StringRef P, llvm::Any IR) {
@@ -336,6 +337,10 @@ struct MockPassInstrumentationCallbacks {
     });
     Callbacks.registerAfterAnalysisCallback(
         [this](StringRef P, llvm::Any IR) { this->runAfterAnalysis(P, IR); });
+    Callbacks.registerAnalysisInvalidatedCallback(
+        [this](StringRef P, llvm::Any IR) {
+          this->runAnalysisInvalidated(P, IR);
+        });
   }
 
   void ignoreNonMockPassInstrumentation(StringRef IRName) {
@@ -355,6 +360,9 @@ struct MockPassInstrumentationCallbacks {
     EXPECT_CALL(*this,
                 runAfterAnalysis(Not(HasNameRegex("Mock")), HasName(IRName)))
         .Times(AnyNumber());
+    EXPECT_CALL(*this, runAnalysisInvalidated(Not(HasNameRegex("Mock")),
+                                              HasName(IRName)))
+        .Times(AnyNumber());
   }
 };
 
@@ -923,6 +931,44 @@ TEST_F(FunctionCallbacksTest, AnalysisUtilities) {
   PM.run(*M, AM);
 }
 
+TEST_F(FunctionCallbacksTest, InstrumentedAnalysisInvalidation) {
+  CallbacksHandle.registerPassInstrumentation();
+  CallbacksHandle.ignoreNonMockPassInstrumentation("<string>");
+  CallbacksHandle.ignoreNonMockPassInstrumentation("foo");
+
+  EXPECT_CALL(AnalysisHandle, run(HasName("foo"), _));
+  EXPECT_CALL(AnalysisHandle, invalidate(HasName("foo"), _, _));
+
+  // The invalidation is reported after the analysis has run.
+  ::testing::Sequence PISequence;
+  EXPECT_CALL(
+      CallbacksHandle,
+      runAfterAnalysis(HasNameRegex("MockAnalysisHandle"), HasName("foo")))
+      .InSequence(PISequence);
+  EXPECT_CALL(CallbacksHandle,
+              runAnalysisInvalidated(HasNameRegex("MockAnalysisHandle"),
+                                     HasName("foo")))
+      .InSequence(PISequence);
+  EXPECT_CALL(
+      CallbacksHandle,
+      runBeforeAnalysis(HasNameRegex("MockAnalysisHandle"), HasName("foo")));
+
+  // The names of the require and invalidate passes mention the mock analysis.
+  EXPECT_CALL(CallbacksHandle,
+              runBeforePass(HasNameRegex("AnalysisPass<.*MockAnalysisHandle"),
+                            HasName("foo")))
+      .Times(2);
+  EXPECT_CALL(CallbacksHandle,
+              runAfterPass(HasNameRegex("AnalysisPass<.*MockAnalysisHandle"),
+                           HasName("foo")))
+      .Times(2);
+
+  StringRef PipelineText = "require<test-analysis>,invalidate<test-analysis>";
+  ASSERT_THAT_ERROR(PB.parsePassPipeline(PM, PipelineText, true), Succeeded())
+      << "Pipeline was: " << PipelineText;
+  PM.run(*M, AM);
+}
+
 TEST_F(LoopCallbacksTest, PassUtilities) {
   EXPECT_CALL(AnalysisHandle, run(HasName("loop"), _, _));
   EXPECT_CALL(AnalysisHandle, invalidate(HasName("loop"), _, _));
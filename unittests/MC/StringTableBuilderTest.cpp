@@ -11,6 +11,7 @@
 #include "llvm/Support/Endian.h"
 #include "gtest/gtest.h"
 #include <string>
+#include <vector>
 
 using namespace llvm;
 
@@ -103,4 +104,43 @@ TEST(StringTableBuilderTest, ELFInOrder) {
   EXPECT_EQ(9U, B.getOffset("foobar"));
 }
 
+TEST(StringTableBuilderTest, ParallelMatchesSerial) {
+  // Names that share lots of suffixes with each other, like C++ mangled names
+  // do, plus some short strings that end up in the same buckets. There are
+  // enough of them for finalizeParallel to actually sort in parallel.
+  std::vector<std::string> Names = {"", "a", "v", "Ev", "ab", "b"};
+  const char *Params[] = {"v", "i", "PKc", "RKNS_6stringE", "S0_", "Ev"};
+  for (unsigned I = 0; I < 2000; ++I) {
+    std::string Name = "_ZN" + std::to_string(I % 7) + "ns" +
+                       std::to_string(I % 13) + "4func" + std::to_string(I) +
+                       "E";
+    for (unsigned J = 0; J <= I % 4; ++J)
+      Name += Params[(I + J) % 6];
+    Names.push_back(Name);
+    Names.push_back(Name.substr(Name.size() / 2));
+  }
+
+  for (StringTableBuilder::Kind K :
+       {StringTableBuilder::ELF, StringTableBuilder::MachO,
+        StringTableBuilder::RAW}) {
+    for (unsigned Alignment : {1, 4}) {
+      StringTableBuilder Serial(K, Alignment), Parallel(K, Alignment);
+      for (const std::string &Name : Names) {
+        Serial.add(Name);
+        Parallel.add(Name);
+      }
+      Serial.finalize();
+      Parallel.finalizeParallel();
+
+      SmallString<0> SerialData, ParallelData;
+      raw_svector_ostream SerialOS(SerialData), ParallelOS(ParallelData);
+      Serial.write(SerialOS);
+      Parallel.write(ParallelOS);
+      EXPECT_EQ(SerialData, ParallelData);
+      for (const std::string &Name : Names)
+        EXPECT_EQ(Serial.getOffset(Name), Parallel.getOffset(Name));
+    }
+  }
+}
+
 }
@@ -0,0 +1,566 @@
+//===- GICombinerEmitter.cpp - tblgen combiner-helper generator -----------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+/// \file This tablegen backend emits code for use by the GlobalISel combiners.
+/// See include/llvm/Target/GlobalISel/Combine.td.
+///
+/// For each selected GICombinerHelper, the generated file defines a class
+/// with a single method:
+///     bool tryCombineAll(GISelChangeObserver &Observer, MachineInstr &MI,
+///                        MachineIRBuilder &B, CombinerHelper &Helper) const;
+/// The rules are compiled into one match table that switches on the opcode of
+/// the root instruction and then tries the rules for that opcode in order.
+/// The table is run by executeCombinerMatchTable(), see
+/// include/llvm/CodeGen/GlobalISel/CombinerMatchTable.h.
+///
+//===----------------------------------------------------------------------===//
+
+#include "CodeGenTarget.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/TableGen/Error.h"
+#include "llvm/TableGen/Record.h"
+#include "llvm/TableGen/TableGenBackend.h"
+#include <map>
+#include <string>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "gicombiner-emitter"
+
+STATISTIC(NumCombineRulesTotal, "Total number of combine rules");
+STATISTIC(NumCombineRulesEmitted, "Number of combine rules emitted");
+
+cl::OptionCategory
+    GICombinerEmitterCat("Options for -gen-global-isel-combiner");
+static cl::list<std::string>
+    SelectedCombiners("combiners", cl::desc("Emit the specified combiners"),
+                      cl::cat(GICombinerEmitterCat), cl::CommaSeparated);
+
+namespace {
+
+/// A named value declared in a rule's defs and the C++ expression it expands
+/// to in the match and apply code.
+struct RuleDef {
+  std::string Name;
+  std::string Expansion;
+  /// The storage type for match data, empty for the root.
+  std::string MatchDataType;
+};
+
+class CombineRule {
+  /// A unique ID for this rule, used in the generated code.
+  unsigned ID;
+  /// The record defining this rule.
+  const Record &TheDef;
+  /// The opcodes the root may have.
+  std::vector<const CodeGenInstruction *> RootOpcodes;
+  /// The C++ predicate, empty if the opcode check is all the match needs.
+  std::string MatchCode;
+  /// The C++ code run when the rule is applied.
+  std::string ApplyCode;
+  std::vector<RuleDef> Defs;
+
+public:
+  CombineRule(unsigned ID, const Record &R) : ID(ID), TheDef(R) {}
+
+  bool parseDefs();
+  bool parseMatcher(const CodeGenTarget &Target);
+  bool parseApply();
+
+  unsigned getID() const { return ID; }
+  StringRef getName() const { return TheDef.getName(); }
+  const Record &getDef() const { return TheDef; }
+  ArrayRef<const CodeGenInstruction *> getRootOpcodes() const {
+    return RootOpcodes;
+  }
+  bool hasMatchCode() const { return !MatchCode.empty(); }
+  ArrayRef<RuleDef> getDefs() const { return Defs; }
+
+  /// Return \p Code with every ${name} replaced by its expansion.
+  std::string expandCode(StringRef Code) const;
+  std::string getExpandedMatchCode() const { return expandCode(MatchCode); }
+  std::string getExpandedApplyCode() const { return expandCode(ApplyCode); }
+
+  /// Give the match data of this rule storage named with \p Prefix.
+  void assignMatchDataStorage(StringRef Prefix);
+};
+
+/// A match table under construction. Labels are resolved to table indices
+/// when the table is emitted.
+class MatchTableBuilder {
+  struct Entry {
+    enum EntryKind { EK_Opcode, EK_Value, EK_LabelRef, EK_LabelDef } Kind;
+    int64_t Value;
+    std::string Text;
+    bool EndLine;
+  };
+  std::vector<Entry> Entries;
+  unsigned NumLabels = 0;
+
+public:
+  unsigned allocateLabel() { return NumLabels++; }
+
+  /// Add a matcher opcode, emitted by name.
+  MatchTableBuilder &opcode(StringRef Name, bool EndLine = false) {
+    Entries.push_back({Entry::EK_Opcode, 0, Name, EndLine});
+    return *this;
+  }
+  /// Add an integer operand, optionally with a comment.
+  MatchTableBuilder &value(int64_t V, StringRef Comment = "",
+                           bool EndLine = false) {
+    Entries.push_back({Entry::EK_Value, V, Comment, EndLine});
+    return *this;
+  }
+  /// Add the table index of \p Label, optionally with a comment.
+  MatchTableBuilder &labelRef(unsigned Label, StringRef Comment = "",
+                              bool EndLine = false) {
+    Entries.push_back({Entry::EK_LabelRef, Label, Comment, EndLine});
+    return *this;
+  }
+  /// Bind \p Label to the index of the next entry.
+  MatchTableBuilder &defineLabel(unsigned Label) {
+    Entries.push_back({Entry::EK_LabelDef, Label, "", false});
+    return *this;
+  }
+
+  void emit(raw_ostream &OS, StringRef Name) const;
+};
+
+class GICombinerEmitter {
+  const CodeGenTarget &Target;
+  Record *Combiner;
+  std::vector<std::unique_ptr<CombineRule>> Rules;
+  DenseMap<const Record *, unsigned> OpcodeValues;
+
+  void gatherRules(std::vector<std::unique_ptr<CombineRule>> &ActiveRules,
+                   const std::vector<Record *> &&RulesAndGroups);
+  std::unique_ptr<CombineRule> makeCombineRule(const Record &R);
+  void buildMatchTable(MatchTableBuilder &Table) const;
+
+public:
+  GICombinerEmitter(const CodeGenTarget &Target, Record *Combiner);
+
+  StringRef getClassName() const {
+    return Combiner->getValueAsString("Classname");
+  }
+  void run(raw_ostream &OS);
+};
+
+} // end anonymous namespace
+
+//===- CombineRule --------------------------------------------------------===//
+
+/// Return true if the operator of \p D is the record named \p Name.
+static bool isOperator(const DagInit *D, StringRef Name) {
+  const DefInit *Op = dyn_cast<DefInit>(D->getOperator());
+  return Op && Op->getDef()->getName() == Name;
+}
+
+bool CombineRule::parseDefs() {
+  DagInit *DefsDag = TheDef.getValueAsDag("Defs");
+  if (!isOperator(DefsDag, "defs")) {
+    PrintError(TheDef.getLoc(), "Expected defs operator");
+    return false;
+  }
+
+  bool HasRoot = false;
+  for (unsigned I = 0, E = DefsDag->getNumArgs(); I < E; ++I) {
+    DefInit *Arg = dyn_cast<DefInit>(DefsDag->getArg(I));
+    StringRef ArgName = DefsDag->getArgNameStr(I);
+    if (!Arg || ArgName.empty()) {
+      PrintError(TheDef.getLoc(), "Expected a named definition in defs");
+      return false;
+    }
+
+    Record *Kind = Arg->getDef();
+    if (Kind->getName() == "root") {
+      if (HasRoot) {
+        PrintError(TheDef.getLoc(), "Combine rules must have exactly one root");
+        return false;
+      }
+      HasRoot = true;
+      Defs.push_back({ArgName, "Root", ""});
+      continue;
+    }
+
+    if (Kind->isSubClassOf("GIDefMatchData")) {
+      Defs.push_back({ArgName, "", Kind->getValueAsString("Type")});
+      continue;
+    }
+
+    PrintError(TheDef.getLoc(),
+               "Unexpected def kind '" + Kind->getName() + "'");
+    return false;
+  }
+
+  if (!HasRoot) {
+    PrintError(TheDef.getLoc(), "Combine rules must have exactly one root");
+    return false;
+  }
+  return true;
+}
+
+bool CombineRule::parseMatcher(const CodeGenTarget &Target) {
+  DagInit *MatchDag = TheDef.getValueAsDag("Match");
+  if (!isOperator(MatchDag, "match")) {
+    PrintError(TheDef.getLoc(), "Expected match operator");
+    return false;
+  }
+
+  for (unsigned I = 0, E = MatchDag->getNumArgs(); I < E; ++I) {
+    Init *Arg = MatchDag->getArg(I);
+
+    if (const CodeInit *Code = dyn_cast<CodeInit>(Arg)) {
+      if (!MatchCode.empty()) {
+        PrintError(TheDef.getLoc(),
+                   "Combine rules may only have one C++ predicate");
+        return false;
+      }
+      MatchCode = Code->getValue().trim();
+      continue;
+    }
+
+    DagInit *Matcher = dyn_cast<DagInit>(Arg);
+    if (Matcher &&
+        isOperator(Matcher, "wip_match_opcode")) {
+      if (!RootOpcodes.empty()) {
+        PrintError(TheDef.getLoc(),
+                   "Combine rules may only have one wip_match_opcode");
+        return false;
+      }
+      StringRef RootName = MatchDag->getArgNameStr(I);
+      const RuleDef &Root = *llvm::find_if(
+          Defs, [](const RuleDef &D) { return D.MatchDataType.empty(); });
+      if (RootName != Root.Name) {
+        PrintError(TheDef.getLoc(),
+                   "wip_match_opcode must be bound to the root '" + Root.Name +
+                       "'");
+        return false;
+      }
+      for (Init *OpcodeArg : Matcher->getArgs()) {
+        DefInit *OpcodeDef = dyn_cast<DefInit>(OpcodeArg);
+        if (!OpcodeDef || !OpcodeDef->getDef()->isSubClassOf("Instruction")) {
+          PrintError(TheDef.getLoc(),
+                     "Arguments of wip_match_opcode must be instructions");
+          return false;
+        }
+        RootOpcodes.push_back(&Target.getInstruction(OpcodeDef->getDef()));
+      }
+      continue;
+    }
+
+    PrintError(TheDef.getLoc(), "Unexpected argument '" + Arg->getAsString() +
+                                    "' in match");
+    return false;
+  }
+
+  if (RootOpcodes.empty()) {
+    PrintError(TheDef.getLoc(),
+               "Combine rules must list the root opcodes with "
+               "wip_match_opcode");
+    return false;
+  }
+  return true;
+}
+
+bool CombineRule::parseApply() {
+  DagInit *ApplyDag = TheDef.getValueAsDag("Apply");
+  if (!isOperator(ApplyDag, "apply") ||
+      ApplyDag->getNumArgs() != 1 || !isa<CodeInit>(ApplyDag->getArg(0))) {
+    PrintError(TheDef.getLoc(), "Expected (apply [{ C++ code }])");
+    return false;
+  }
+  ApplyCode = cast<CodeInit>(ApplyDag->getArg(0))->getValue().trim();
+  return true;
+}
+
+void CombineRule::assignMatchDataStorage(StringRef Prefix) {
+  unsigned Idx = 0;
+  for (RuleDef &D : Defs)
+    if (!D.MatchDataType.empty())
+      D.Expansion = (Prefix + Twine(ID) + "_" + Twine(Idx++)).str();
+}
+
+std::string CombineRule::expandCode(StringRef Code) const {
+  std::string Result;
+  raw_string_ostream OS(Result);
+  while (!Code.empty()) {
+    size_t Start = Code.find("${");
+    if (Start == StringRef::npos) {
+      OS << Code;
+      break;
+    }
+    OS << Code.substr(0, Start);
+    Code = Code.drop_front(Start + 2);
+    size_t End = Code.find('}');
+    if (End == StringRef::npos)
+      PrintFatalError(TheDef.getLoc(), "Unterminated ${ in C++ code");
+    StringRef Var = Code.substr(0, End);
+    Code = Code.drop_front(End + 1);
+
+    auto D = llvm::find_if(Defs, [&](const RuleDef &D) { return D.Name == Var; });
+    if (D == Defs.end())
+      PrintFatalError(TheDef.getLoc(),
+                      "Reference to undeclared name '" + Var + "'");
+    OS << D->Expansion;
+  }
+  return OS.str();
+}
+
+//===- MatchTableBuilder --------------------------------------------------===//
+
+void MatchTableBuilder::emit(raw_ostream &OS, StringRef Name) const {
+  // Resolve the labels first.
+  std::vector<int64_t> LabelValues(NumLabels, -1);
+  int64_t Idx = 0;
+  for (const Entry &E : Entries) {
+    if (E.Kind == Entry::EK_LabelDef)
+      LabelValues[E.Value] = Idx;
+    else
+      ++Idx;
+  }
+
+  OS << "static const int64_t " << Name << "[] = {\n";
+  bool AtLineStart = true;
+  for (const Entry &E : Entries) {
+    if (AtLineStart)
+      OS << "  ";
+    else if (E.Kind != Entry::EK_LabelDef)
+      OS << " ";
+    else
+      OS << "\n  ";
+
+    switch (E.Kind) {
+    case Entry::EK_LabelDef:
+      OS << "// Label " << E.Value << ": @" << LabelValues[E.Value] << "\n";
+      AtLineStart = true;
+      continue;
+    case Entry::EK_Opcode:
+      OS << E.Text << ",";
+      break;
+    case Entry::EK_LabelRef:
+      assert(LabelValues[E.Value] >= 0 && "Reference to undefined label");
+      if (!E.Text.empty())
+        OS << "/*" << E.Text << "*/";
+      OS << "/*Label " << E.Value << "*/ " << LabelValues[E.Value] << ",";
+      break;
+    case Entry::EK_Value:
+      if (!E.Text.empty())
+        OS << "/*" << E.Text << "*/";
+      OS << E.Value << ",";
+      break;
+    }
+    AtLineStart = E.EndLine;
+    if (AtLineStart)
+      OS << "\n";
+  }
+  if (!AtLineStart)
+    OS << "\n";
+  OS << "}; // Size: " << Idx * 8 << " bytes\n\n";
+}
+
+//===- GICombinerEmitter --------------------------------------------------===//
+
+GICombinerEmitter::GICombinerEmitter(const CodeGenTarget &Target,
+                                     Record *Combiner)
+    : Target(Target), Combiner(Combiner) {
+  unsigned Value = 0;
+  for (const CodeGenInstruction *I : Target.getInstructionsByEnumValue())
+    OpcodeValues[I->TheDef] = Value++;
+}
+
+std::unique_ptr<CombineRule>
+GICombinerEmitter::makeCombineRule(const Record &TheDef) {
+  std::unique_ptr<CombineRule> Rule =
+      llvm::make_unique<CombineRule>(Rules.size(), TheDef);
+
+  if (!Rule->parseDefs() || !Rule->parseMatcher(Target) ||
+      !Rule->parseApply())
+    return nullptr;
+  Rule->assignMatchDataStorage("MatchData");
+  return Rule;
+}
+
+/// Recurse into GICombineGroup's so that we can generate the rule list in
+/// declaration order.
+void GICombinerEmitter::gatherRules(
+    std::vector<std::unique_ptr<CombineRule>> &ActiveRules,
+    const std::vector<Record *> &&RulesAndGroups) {
+  for (Record *R : RulesAndGroups) {
+    if (R->isValueUnset("Rules")) {
+      std::unique_ptr<CombineRule> Rule = makeCombineRule(*R);
+      if (Rule == nullptr) {
+        PrintError(R->getLoc(), "Failed to parse rule");
+        continue;
+      }
+      ActiveRules.emplace_back(std::move(Rule));
+      ++NumCombineRulesTotal;
+    } else
+      gatherRules(ActiveRules, R->getValueAsListOfDefs("Rules"));
+  }
+}
+
+/// Build a table of the form:
+///   GICM_SwitchOpcode, Lower, Upper, Default, JumpTable...
+///   // for each opcode with rules:
+///   GICM_Try, OnFail, [GICM_CheckCxxPredicate, ID,] GICM_ApplyAndDone, ID,
+///   ...
+///   GICM_Reject,
+///   // Default:
+///   GICM_Reject
+void GICombinerEmitter::buildMatchTable(MatchTableBuilder &Table) const {
+  // Group the rules by root opcode, keeping declaration order within each
+  // opcode so that priorities are respected.
+  std::map<unsigned, std::vector<const CombineRule *>> RulesByOpcode;
+  for (const auto &Rule : Rules)
+    for (const CodeGenInstruction *I : Rule->getRootOpcodes())
+      RulesByOpcode[OpcodeValues.lookup(I->TheDef)].push_back(Rule.get());
+
+  unsigned DefaultLabel = Table.allocateLabel();
+  if (RulesByOpcode.empty()) {
+    Table.opcode("GICM_Reject", /*EndLine=*/true);
+    return;
+  }
+
+  unsigned LowerBound = RulesByOpcode.begin()->first;
+  unsigned UpperBound = RulesByOpcode.rbegin()->first + 1;
+  std::map<unsigned, unsigned> OpcodeLabels;
+  for (const auto &KV : RulesByOpcode)
+    OpcodeLabels[KV.first] = Table.allocateLabel();
+
+  const auto &Instructions = Target.getInstructionsByEnumValue();
+  Table.opcode("GICM_SwitchOpcode")
+      .value(LowerBound, "[")
+      .value(UpperBound, ")")
+      .labelRef(DefaultLabel, "default:", /*EndLine=*/true);
+  for (unsigned Opcode = LowerBound; Opcode != UpperBound; ++Opcode) {
+    auto It = OpcodeLabels.find(Opcode);
+    if (It == OpcodeLabels.end()) {
+      Table.value(0, "", /*EndLine=*/true);
+      continue;
+    }
+    const CodeGenInstruction *I = Instructions[Opcode];
+    Table.labelRef(It->second, (I->Namespace + "::" + I->TheDef->getName()).str(),
+                   /*EndLine=*/true);
+  }
+
+  for (const auto &KV : RulesByOpcode) {
+    Table.defineLabel(OpcodeLabels[KV.first]);
+    for (const CombineRule *Rule : KV.second) {
+      unsigned NextLabel = Table.allocateLabel();
+      Table.opcode("GICM_Try").labelRef(NextLabel, "on fail goto", true);
+      if (Rule->hasMatchCode())
+        Table.opcode("GICM_CheckCxxPredicate")
+            .value(Rule->getID(), ("Predicate " + Rule->getName()).str(),
+                   /*EndLine=*/true);
+      Table.opcode("GICM_ApplyAndDone")
+          .value(Rule->getID(), ("Rule " + Rule->getName()).str(),
+                 /*EndLine=*/true);
+      Table.defineLabel(NextLabel);
+    }
+    Table.opcode("GICM_Reject", /*EndLine=*/true);
+  }
+  Table.defineLabel(DefaultLabel);
+  Table.opcode("GICM_Reject", /*EndLine=*/true);
+}
+
+void GICombinerEmitter::run(raw_ostream &OS) {
+  gatherRules(Rules, Combiner->getValueAsListOfDefs("Rules"));
+  if (ErrorsPrinted)
+    PrintFatalError(Combiner->getLoc(), "Failed to parse one or more rules");
+
+  MatchTableBuilder Table;
+  buildMatchTable(Table);
+
+  std::string Guard = getClassName().upper();
+  OS << "#ifdef " << Guard << "_GENCOMBINERHELPER_H\n"
+     << "class " << getClassName() << " {\n"
+     << "public:\n"
+     << "  bool tryCombineAll(\n"
+     << "    GISelChangeObserver &Observer,\n"
+     << "    MachineInstr &MI,\n"
+     << "    MachineIRBuilder &B,\n"
+     << "    CombinerHelper &Helper) const;\n"
+     << "};\n\n"
+     << "#endif // ifdef " << Guard << "_GENCOMBINERHELPER_H\n\n";
+
+  OS << "#ifdef " << Guard << "_GENCOMBINERHELPER_CPP\n";
+  Table.emit(OS, (getClassName() + "MatchTable").str());
+
+  OS << "bool " << getClassName() << "::tryCombineAll(\n"
+     << "    GISelChangeObserver &Observer,\n"
+     << "    MachineInstr &MI,\n"
+     << "    MachineIRBuilder &B,\n"
+     << "    CombinerHelper &Helper) const {\n"
+     << "  MachineBasicBlock *MBB = MI.getParent();\n"
+     << "  MachineFunction *MF = MBB->getParent();\n"
+     << "  MachineRegisterInfo &MRI = MF->getRegInfo();\n"
+     << "  MachineInstr *Root = &MI;\n"
+     << "  (void)MBB; (void)MF; (void)MRI;\n\n";
+
+  OS << "  // Match data for the rules that declare it.\n";
+  for (const auto &Rule : Rules)
+    for (const RuleDef &D : Rule->getDefs())
+      if (!D.MatchDataType.empty())
+        OS << "  " << D.MatchDataType << " " << D.Expansion << ";\n";
+  OS << "\n";
+
+  OS << "  auto TestPredicate = [&](int64_t PredicateID) -> bool {\n"
+     << "    switch (PredicateID) {\n";
+  for (const auto &Rule : Rules) {
+    if (!Rule->hasMatchCode())
+      continue;
+    OS << "    case " << Rule->getID() << ": { // " << Rule->getName() << "\n"
+       << "      " << Rule->getExpandedMatchCode() << "\n"
+       << "    }\n";
+  }
+  OS << "    }\n"
+     << "    llvm_unreachable(\"Unknown combiner predicate\");\n"
+     << "  };\n\n";
+
+  OS << "  auto Apply = [&](int64_t ApplyID) {\n"
+     << "    switch (ApplyID) {\n";
+  for (const auto &Rule : Rules) {
+    OS << "    case " << Rule->getID() << ": { // " << Rule->getName() << "\n"
+       << "      " << Rule->getExpandedApplyCode() << "\n"
+       << "      return;\n"
+       << "    }\n";
+    ++NumCombineRulesEmitted;
+  }
+  OS << "    }\n"
+     << "    llvm_unreachable(\"Unknown combiner apply\");\n"
+     << "  };\n\n";
+
+  OS << "  return executeCombinerMatchTable(" << getClassName()
+     << "MatchTable, MI, TestPredicate, Apply);\n"
+     << "}\n"
+     << "#endif // ifdef " << Guard << "_GENCOMBINERHELPER_CPP\n";
+}
+
+//===----------------------------------------------------------------------===//
+
+namespace llvm {
+void EmitGICombiner(RecordKeeper &RK, raw_ostream &OS) {
+  CodeGenTarget Target(RK);
+  emitSourceFileHeader("Global Combiner", OS);
+
+  if (SelectedCombiners.empty())
+    PrintFatalError("No combiners selected with -combiners");
+  for (const auto &Combiner : SelectedCombiners) {
+    Record *CombinerDef = RK.getDef(Combiner);
+    if (!CombinerDef)
+      PrintFatalError("Could not find " + Combiner);
+    GICombinerEmitter(Target, CombinerDef).run(OS);
+  }
+}
+
+} // namespace llvm